@@ -15,6 +15,8 @@
 #include "MassSpawnLocationProcessor.h"
 #include "MassAgentSubsystem.h"
 #include <MilitaryStructureSubsystem.h>
+#include "MassWorldContext.h"
+#include "MassCommandReplaySubsystem.h"
 
 //----------------------------------------------------------------------//
 //  UMassPlayerControllableCharacterTrait
@@ -38,7 +40,7 @@ void ACommanderCharacter::BeginPlay()
 
 	UWorld* World = GetWorld();
 	check(World);
-	MoveToCommandSystem = UWorld::GetSubsystem<UMassMoveToCommandSubsystem>(World);
+	CommandReplaySubsystem = UWorld::GetSubsystem<UMassCommandReplaySubsystem>(World);
 
 	UMassAgentSubsystem* AgentSubsystem = UWorld::GetSubsystem<UMassAgentSubsystem>(GetWorld());
 	check(AgentSubsystem);
@@ -75,14 +77,21 @@ UMilitaryUnit* ACommanderCharacter::GetMyMilitaryUnit() const
 	return MilitaryStructureSubsystem->GetUnitForEntity(GetMassEntityHandle());
 }
 
-static FAutoConsoleCommand SetTeam2MoveToCommandToOrigin(
-	TEXT("pm.SetTeam2MoveToCommandToOrigin"),
-	TEXT("SetTeam2MoveToCommandToOrigin.")
-	TEXT("Usage: \"pm.SetTeam2MoveToCommandToOrigin\""),
+static FAutoConsoleCommand SetTeamMoveToCommandToOrigin(
+	TEXT("pm.SetTeamMoveToCommandToOrigin"),
+	TEXT("SetTeamMoveToCommandToOrigin.")
+	TEXT("Usage: \"pm.SetTeamMoveToCommandToOrigin [TeamIndex]\", TeamIndex defaults to 1"),
 	FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World, FOutputDevice& OutputDevice)
 	{
-		UMassMoveToCommandSubsystem* MoveToCommandSystem = World->GetSubsystem<UMassMoveToCommandSubsystem>();
-		MoveToCommandSystem->EnqueueMoveToCommand(nullptr, FVector(0.f, 0.f, 20.f), false);
+		const int32 TeamIndex = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1;
+		if (TeamIndex < 0 || TeamIndex >= GMaxTeams)
+		{
+			OutputDevice.Logf(ELogVerbosity::Error, TEXT("TeamIndex must be in [0, %d)."), GMaxTeams);
+			return;
+		}
+
+		UMassCommandReplaySubsystem* CommandReplaySubsystem = World->GetSubsystem<UMassCommandReplaySubsystem>();
+		CommandReplaySubsystem->SubmitMoveToCommand(nullptr, FVector(0.f, 0.f, 20.f), TeamIndex);
 	}));
 
 void ACommanderCharacter::SetMoveToCommand(FVector2D CommandLocation) const
@@ -94,7 +103,7 @@ void ACommanderCharacter::SetMoveToCommand(FVector2D CommandLocation) const
 		UE_LOG(LogTemp, Warning, TEXT("Cannot find military unit for player when attempting to set move to command, setting command for all entities on team."));
 
 		// TODO: don't hard-code 20.f below
-		MoveToCommandSystem->EnqueueMoveToCommand(nullptr, FVector(CommandLocation.X, CommandLocation.Y, 20.f), IsPlayerOnTeam1());
+		CommandReplaySubsystem->SubmitMoveToCommand(nullptr, FVector(CommandLocation.X, CommandLocation.Y, 20.f), GetPlayerTeamIndex());
 		return;
 	}
 
@@ -106,7 +115,7 @@ void ACommanderCharacter::SetMoveToCommand(FVector2D CommandLocation) const
 
 	check(MyMilitaryUnit->Parent);
 	// TODO: don't hard-code 20.f below
-	MoveToCommandSystem->EnqueueMoveToCommand(MyMilitaryUnit->Parent, FVector(CommandLocation.X, CommandLocation.Y, 20.f), IsPlayerOnTeam1());
+	CommandReplaySubsystem->SubmitMoveToCommand(MyMilitaryUnit->Parent, FVector(CommandLocation.X, CommandLocation.Y, 20.f), GetPlayerTeamIndex());
 }
 
 void ACommanderCharacter::ChangePlayerToAISoldier()
@@ -126,8 +135,7 @@ void ACommanderCharacter::ChangePlayerToAISoldier()
 	UMassSpawnerSubsystem* SpawnerSystem = UWorld::GetSubsystem<UMassSpawnerSubsystem>(World);
 	check(SpawnerSystem);
 
-	// TODO: A bit hacky to get first actor here.
-	const FMassEntityTemplate* EntityTemplate = SoldierEntityConfig.GetOrCreateEntityTemplate(*World->GetLevel(0)->Actors[0], *SpawnerSystem); // TODO: passing SpawnerSystem is a hack
+	const FMassEntityTemplate* EntityTemplate = SoldierEntityConfig.GetOrCreateEntityTemplate(GetMassWorldContextActor(*World), *SpawnerSystem); // TODO: passing SpawnerSystem is a hack
 	check(EntityTemplate->IsValid());
 
 	FMassEntitySpawnDataGeneratorResult Result;
@@ -150,6 +158,11 @@ void ACommanderCharacter::ChangePlayerToAISoldier()
 	UMilitaryUnit* MyMilitaryUnit = GetMyMilitaryUnit();
 	MyMilitaryUnit->bIsPlayer = false;
 
+	if (CommandReplaySubsystem)
+	{
+		CommandReplaySubsystem->RecordReleaseSoldier(MyMilitaryUnit, GetPlayerTeamIndex());
+	}
+
 	UMilitaryStructureSubsystem* MilitaryStructureSubsystem = UWorld::GetSubsystem<UMilitaryStructureSubsystem>(GetWorld());
 	check(MilitaryStructureSubsystem);
 	MilitaryStructureSubsystem->BindUnitToMassEntity(MyMilitaryUnit, SpawnedEntities[0]);
@@ -180,10 +193,13 @@ void ACommanderCharacter::InitializeFromMassSoldierInternal()
 	UMilitaryStructureSubsystem* MilitaryStructureSubsystem = UWorld::GetSubsystem<UMilitaryStructureSubsystem>(GetWorld());
 	check(MilitaryStructureSubsystem);
 
+	// Taking over the team's highest commander happens in every run of a replay, only swaps to other soldiers are recorded.
+	const bool bIsPossessionSwap = MassSoldierEntityToInitializeWith.IsSet();
+
 	// If we don't have a soldier entity to initialize with, set it to team's highest commander.
 	if (!MassSoldierEntityToInitializeWith.IsSet())
 	{
-		UMilitaryUnit* RootUnit = MilitaryStructureSubsystem->GetRootUnitForTeam(IsPlayerOnTeam1());
+		UMilitaryUnit* RootUnit = MilitaryStructureSubsystem->GetRootUnitForTeam(GetPlayerTeamIndex());
 		if (!RootUnit)
 		{
 			UE_LOG(LogTemp, Warning, TEXT("Cannot find root military unit for player's team on character initialization."));
@@ -221,6 +237,10 @@ void ACommanderCharacter::InitializeFromMassSoldierInternal()
 
 	UMilitaryUnit* SoldierMilitaryUnit = MilitaryStructureSubsystem->GetUnitForEntity(MassSoldierEntityToInitializeWith);
 	SoldierMilitaryUnit->bIsPlayer = true;
+	if (bIsPossessionSwap && CommandReplaySubsystem)
+	{
+		CommandReplaySubsystem->RecordPossessSoldier(SoldierMilitaryUnit, GetPlayerTeamIndex());
+	}
 	MilitaryStructureSubsystem->BindUnitToMassEntity(SoldierMilitaryUnit, PlayerEntityHandle);
 	EntitySubsystem->DestroyEntity(MassSoldierEntityToInitializeWith);
 
@@ -234,7 +254,18 @@ void ACommanderCharacter::InitializeFromMassSoldierInternal()
 	SetActorTransform(NewActorTransform, false, nullptr, ETeleportType::ResetPhysics);
 }
 
+void ACommanderCharacter::PossessMassSoldierForReplay(const FMassEntityHandle MassSoldierEntity)
+{
+	MassSoldierEntityToInitializeWith = MassSoldierEntity;
+	InitializeFromMassSoldierInternal();
+}
+
 bool ACommanderCharacter::IsPlayerOnTeam1() const
+{
+	return GetPlayerTeamIndex() == 0;
+}
+
+uint8 ACommanderCharacter::GetPlayerTeamIndex() const
 {
 	UMassEntitySubsystem* EntitySubsystem = UWorld::GetSubsystem<UMassEntitySubsystem>(GetWorld());
 	check(EntitySubsystem);
@@ -244,7 +275,7 @@ bool ACommanderCharacter::IsPlayerOnTeam1() const
 	FTeamMemberFragment* PlayerEntityTeamMemberFragment = PlayerEntityView.GetFragmentDataPtr<FTeamMemberFragment>();
 	check(PlayerEntityTeamMemberFragment);
 
-	return PlayerEntityTeamMemberFragment->IsOnTeam1;
+	return PlayerEntityTeamMemberFragment->TeamIndex;
 }
 
 FMassEntityHandle ACommanderCharacter::GetMassEntityHandle() const
@@ -283,5 +314,5 @@ void ACommanderCharacter::SpawnProjectile(const FTransform SpawnTransform) const
 	FVector InitialVelocity = SpawnTransform.GetRotation().Vector() * GetProjectileInitialXYVelocityMagnitude(true);
 	// TODO: For some reason we need to adjust the initial velocity for it to align with muzzle. We shouldn't have to do this.
 	InitialVelocity += FVector(0.f, 0.f, ACommanderCharacter_InitialProjectileVelocityZFudge);
-	::SpawnProjectile(World, SpawnTransform.GetLocation(), SpawnTransform.GetRotation(), InitialVelocity, ProjectileEntityConfig, IsPlayerOnTeam1());
+	::SpawnProjectile(World, SpawnTransform.GetLocation(), SpawnTransform.GetRotation(), InitialVelocity, ProjectileEntityConfig, GetPlayerTeamIndex());
 }
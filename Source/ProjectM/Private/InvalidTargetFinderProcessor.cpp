@@ -12,6 +12,26 @@
 #include "MassProjectileDamageProcessor.h"
 #include "MassTargetFinderSubsystem.h"
 #include <MassNavMeshMoveProcessor.h>
+#include "MassTickTierTrait.h"
+#include "MassProcessorBudgetSubsystem.h"
+#include "MassEntityHash.h"
+#include "MassDebugDrawRecorder.h"
+
+struct FProcessEntityData
+{
+	FMassEntityHandle Entity;
+	FMassEntityHandle TargetEntity;
+	float TargetMinCaliberForDamage;
+	FTransform EntityTransform;
+	uint32 HostileTeamsMask = 0;
+	bool bIsEntitySoldier;
+	bool bIsSoldierDying;
+	bool bOnlyCheckIfTargetEntityValidInEntitySubsystem = false;
+	bool bSkipRangeAndObstructionChecks = false;
+
+	// Output of UInvalidTargetFinderProcessor's ProcessEntities step.
+	bool bHasInvalidTarget = false;
+};
 
 void UnstashMoveTarget(const FMassMoveTargetFragment& Source, FMassMoveTargetFragment& Destination, const UWorld& World, const FMassExecutionContext& Context, FMassNavMeshMoveFragment& NavMeshMoveFragment, const FTransform& EntityTransform)
 {
@@ -55,6 +75,9 @@ void CopyMoveTarget(const FMassMoveTargetFragment& Source, FMassMoveTargetFragme
 	Destination.IntentAtGoal = Source.IntentAtGoal;
 }
 
+float UInvalidTargetFinderProcessor_BudgetMs = 1.f;
+FAutoConsoleVariableRef CVarUInvalidTargetFinderProcessor_BudgetMs(TEXT("pm.UInvalidTargetFinderProcessor_BudgetMs"), UInvalidTargetFinderProcessor_BudgetMs, TEXT("Frame time budget for target range and obstruction checks. Due checks over budget happen on a later frame. 0 disables the budget."));
+
 UInvalidTargetFinderProcessor::UInvalidTargetFinderProcessor()
 {
 	bAutoRegisterWithProcessingPhases = true;
@@ -73,8 +96,10 @@ void UInvalidTargetFinderProcessor::ConfigureQueries()
 {
 	BuildQueueEntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
 	BuildQueueEntityQuery.AddRequirement<FTargetEntityFragment>(EMassFragmentAccess::ReadWrite);
-	BuildQueueEntityQuery.AddRequirement<FTeamMemberFragment>(EMassFragmentAccess::ReadOnly);
+	BuildQueueEntityQuery.AddConstSharedRequirement<FTeamHostilityParameters>(EMassFragmentPresence::All);
 	BuildQueueEntityQuery.AddTagRequirement<FMassWillNeedEnemyTargetTag>(EMassFragmentPresence::All);
+	BuildQueueEntityQuery.AddChunkRequirement<FMassTickTierChunkFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
+	BuildQueueEntityQuery.SetChunkFilter(&FMassTickTierChunkFragment::ShouldTickChunkThisFrame);
 
 	BuildQueueForTrackTargetEntityQuery.AddRequirement<FTargetEntityFragment>(EMassFragmentAccess::ReadWrite);
 	BuildQueueForTrackTargetEntityQuery.AddTagRequirement<FMassTrackTargetTag>(EMassFragmentPresence::All);
@@ -97,10 +122,7 @@ bool IsTargetEntityOutOfRange(const FVector& TargetEntityLocation, const FVector
 #if WITH_MASSGAMEPLAY_DEBUG
 	if (UE::Mass::Debug::IsDebuggingEntity(Entity))
 	{
-		AsyncTask(ENamedThreads::GameThread, [World = EntitySubsystem.GetWorld(), EntityLocation, TargetEntityLocation]()
-		{
-			DrawDebugDirectionalArrow(World, EntityLocation, TargetEntityLocation, 10.f, FColor::Yellow, false, 0.1f);
-		});
+		UE::ProjectM::DebugDraw::Arrow(EntitySubsystem.GetWorld(), EntityLocation, TargetEntityLocation, 10.f, FColor::Yellow, false, 0.1f);
 	}
 #endif
 
@@ -113,62 +135,29 @@ bool DidCapsulesCollide(const FCapsule& Capsule1, const FCapsule& Capsule2, cons
 	return TestCapsuleCapsule(Capsule1, Capsule2);
 }
 
-bool IsTargetEntityObstructed(const FVector& EntityLocation, const FVector& TargetEntityLocation, const UMassTargetFinderSubsystem& TargetFinderSubsystem, const FMassEntityHandle& Entity, const UMassEntitySubsystem& EntitySubsystem, const bool& IsEntityOnTeam1, const bool bIsEntitySoldier, const float TargetMinCaliberForDamage, const FMassEntityView& TargetEntityView, const FTransform& EntityTransform)
+bool IsTargetEntityObstructed(const FVector& TargetEntityLocation, const UMassTargetFinderSubsystem& TargetFinderSubsystem, const FMassEntityHandle& Entity, const FMassEntityHandle& TargetEntity, const UMassEntitySubsystem& EntitySubsystem, const uint32 HostileTeamsMask, const bool bIsEntitySoldier, const float TargetMinCaliberForDamage, const FMassEntityView& TargetEntityView, const FTransform& EntityTransform)
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(UInvalidTargetFinderProcessor.IsTargetEntityObstructed);
 
-	const FVector Buffer(10.f, 10.f, 10.f); // We keep a buffer in case EntityLocation and TargetEntityLocation are same value on any axis.
-	FBox QueryBounds(EntityLocation.ComponentMin(TargetEntityLocation) - Buffer, EntityLocation.ComponentMax(TargetEntityLocation) + Buffer);
-	TArray<FMassTargetGridItem> CloseEntities;
-	TargetFinderSubsystem.GetTargetGrid().Query(QueryBounds, CloseEntities);
+	const bool& bIsTargetEntitySoldier = TargetEntityView.HasTag<FMassProjectileDamagableSoldierTag>();
+
+	FLineOfFireQuery LineOfFireQuery;
+	LineOfFireQuery.Entity = Entity;
+	LineOfFireQuery.TargetEntity = TargetEntity;
+	LineOfFireQuery.ProjectileTraceCapsule = GetProjectileTraceCapsuleToTarget(bIsEntitySoldier, bIsTargetEntitySoldier, EntityTransform, TargetEntityLocation);
+	LineOfFireQuery.HostileTeamsMask = HostileTeamsMask;
+	LineOfFireQuery.MinCaliberForDamage = TargetMinCaliberForDamage;
+
+	const ELineOfFireResult LineOfFireResult = TargetFinderSubsystem.QueryLineOfFire(LineOfFireQuery, EntitySubsystem);
 
 #if WITH_MASSGAMEPLAY_DEBUG
 	if (UE::Mass::Debug::IsDebuggingEntity(Entity))
 	{
-		AsyncTask(ENamedThreads::GameThread, [QueryBounds, World = EntitySubsystem.GetWorld()]()
-		{
-			const FVector QueryCenter = (QueryBounds.Min + QueryBounds.Max) / 2.f;
-			const FVector VerticalOffset(0.f, 0.f, 1000.f);
-			DrawDebugBox(World, QueryCenter, QueryBounds.Max - QueryCenter + VerticalOffset, FColor::Blue, false, 0.1f);
-		});
+		DrawCapsule(LineOfFireQuery.ProjectileTraceCapsule, *EntitySubsystem.GetWorld(), LineOfFireResult == ELineOfFireResult::Clear ? FLinearColor::Green : FLinearColor::Red, false, 0.1f);
 	}
 #endif
 
-	const bool& bIsTargetEntitySoldier = TargetEntityView.HasTag<FMassProjectileDamagableSoldierTag>();
-	const FCapsule& ProjectileTraceCapsule = GetProjectileTraceCapsuleToTarget(bIsEntitySoldier, bIsTargetEntitySoldier, EntityTransform, TargetEntityLocation);
-
-	for (const FMassTargetGridItem& OtherEntity : CloseEntities)
-	{
-		TRACE_CPUPROFILER_EVENT_SCOPE(UInvalidTargetFinderProcessor.IsTargetEntityObstructed.ProcessCloseEntity);
-
-		// Skip self.
-		if (OtherEntity.Entity == Entity)
-		{
-			continue;
-		}
-
-		// Skip invalid entities.
-		if (!EntitySubsystem.IsEntityValid(OtherEntity.Entity))
-		{
-			continue;
-		}
-
-		// If same team or undamageable, check for collision.
-		if (IsEntityOnTeam1 == OtherEntity.bIsOnTeam1 || !CanEntityDamageTargetEntity(TargetMinCaliberForDamage, OtherEntity.MinCaliberForDamage)) {
-			const FCapsule& OtherEntityCapsule = TargetFinderSubsystem.GetTargetDynamicData()[OtherEntity.Entity].Capsule;
-			if (DidCapsulesCollide(ProjectileTraceCapsule, OtherEntityCapsule, Entity, *EntitySubsystem.GetWorld()))
-			{
-				return true;
-			}
-		}
-	}
-
-	bool bIsTargetEntityVisibleViaSphereTrace;
-	{
-		TRACE_CPUPROFILER_EVENT_SCOPE(UInvalidTargetFinderProcessor.IsTargetEntityObstructed.IsTargetEntityVisibleViaSphereTrace);
-		bIsTargetEntityVisibleViaSphereTrace = IsTargetEntityVisibleViaSphereTrace(*EntitySubsystem.GetWorld(), ProjectileTraceCapsule.a, ProjectileTraceCapsule.b, false);
-	}
-	return !bIsTargetEntityVisibleViaSphereTrace;
+	return LineOfFireResult != ELineOfFireResult::Clear;
 }
 
 bool UInvalidTargetFinderProcessor_ShouldInvalidateAllTargets = false;
@@ -184,7 +173,7 @@ static FAutoConsoleCommand InvalidateAllTargetsCmd(
 	FConsoleCommandDelegate::CreateStatic(InvalidateAllTargets)
 );
 
-bool IsTargetValid(const FMassEntityHandle& Entity, const FMassEntityHandle& TargetEntity, const UMassEntitySubsystem& EntitySubsystem, const float TargetMinCaliberForDamage, const UMassTargetFinderSubsystem& TargetFinderSubsystem, const bool& IsEntityOnTeam1, const bool bIsEntitySoldier, const FTransform& EntityTransform, const bool bInvalidateAllTargets, const bool bOnlyCheckIfTargetEntityValidInEntitySubsystem, const bool bIsSoldierDying)
+bool IsTargetValid(const FMassEntityHandle& Entity, const FMassEntityHandle& TargetEntity, const UMassEntitySubsystem& EntitySubsystem, const float TargetMinCaliberForDamage, const UMassTargetFinderSubsystem& TargetFinderSubsystem, const uint32 HostileTeamsMask, const bool bIsEntitySoldier, const FTransform& EntityTransform, const bool bInvalidateAllTargets, const bool bOnlyCheckIfTargetEntityValidInEntitySubsystem, const bool bIsSoldierDying, const bool bSkipRangeAndObstructionChecks)
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(UInvalidTargetFinderProcessor.IsTargetValid);
 
@@ -216,13 +205,18 @@ bool IsTargetValid(const FMassEntityHandle& Entity, const FMassEntityHandle& Tar
 		return false;
 	}
 
+	if (bSkipRangeAndObstructionChecks)
+	{
+		return true;
+	}
+
 	const FVector& TargetEntityLocation = TargetEntityView.GetFragmentData<FTransformFragment>().GetTransform().GetLocation();
 	if (IsTargetEntityOutOfRange(TargetEntityLocation, EntityLocation, EntitySubsystem, Entity, bIsEntitySoldier))
 	{
 		return false;
 	}
 
-	if (IsTargetEntityObstructed(EntityLocation, TargetEntityLocation, TargetFinderSubsystem, Entity, EntitySubsystem, IsEntityOnTeam1, bIsEntitySoldier, TargetMinCaliberForDamage, TargetEntityView, EntityTransform))
+	if (IsTargetEntityObstructed(TargetEntityLocation, TargetFinderSubsystem, Entity, TargetEntity, EntitySubsystem, HostileTeamsMask, bIsEntitySoldier, TargetMinCaliberForDamage, TargetEntityView, EntityTransform))
 	{
 		return false;
 	}
@@ -230,30 +224,43 @@ bool IsTargetValid(const FMassEntityHandle& Entity, const FMassEntityHandle& Tar
 	return true;
 }
 
-struct FProcessEntityData
-{
-	FMassEntityHandle Entity;
-	FMassEntityHandle TargetEntity;
-	float TargetMinCaliberForDamage;
-	FTransform EntityTransform;
-	bool bIsEntityOnTeam1;
-	bool bIsEntitySoldier;
-	bool bIsSoldierDying;
-	bool bOnlyCheckIfTargetEntityValidInEntitySubsystem = false;
-};
-
 /** Returns true if entity has invalid target. */
-bool ProcessEntity(const FProcessEntityData& ProcessEntityData, const bool bInvalidateAllTargets, const UMassEntitySubsystem& EntitySubsystem, const UMassTargetFinderSubsystem& TargetFinderSubsystem, TQueue<FMassEntityHandle, EQueueMode::Mpsc>& EntitiesWithInvalidTargetQueue)
+bool ProcessEntity(const FProcessEntityData& ProcessEntityData, const bool bInvalidateAllTargets, const UMassEntitySubsystem& EntitySubsystem, const UMassTargetFinderSubsystem& TargetFinderSubsystem)
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(UInvalidTargetFinderProcessor.ProcessEntity);
 
-	const FMassEntityHandle& TargetEntity = ProcessEntityData.TargetEntity;
-	if (!IsTargetValid(ProcessEntityData.Entity, TargetEntity, EntitySubsystem, ProcessEntityData.TargetMinCaliberForDamage, TargetFinderSubsystem, ProcessEntityData.bIsEntityOnTeam1, ProcessEntityData.bIsEntitySoldier, ProcessEntityData.EntityTransform, bInvalidateAllTargets, ProcessEntityData.bOnlyCheckIfTargetEntityValidInEntitySubsystem, ProcessEntityData.bIsSoldierDying))
+	return !IsTargetValid(ProcessEntityData.Entity, ProcessEntityData.TargetEntity, EntitySubsystem, ProcessEntityData.TargetMinCaliberForDamage, TargetFinderSubsystem, ProcessEntityData.HostileTeamsMask, ProcessEntityData.bIsEntitySoldier, ProcessEntityData.EntityTransform, bInvalidateAllTargets, ProcessEntityData.bOnlyCheckIfTargetEntityValidInEntitySubsystem, ProcessEntityData.bIsSoldierDying, ProcessEntityData.bSkipRangeAndObstructionChecks);
+}
+
+float UInvalidTargetFinderProcessor_RevalidationInterval = 0.5f;
+FAutoConsoleVariableRef CVarUInvalidTargetFinderProcessor_RevalidationInterval(TEXT("pm.UInvalidTargetFinderProcessor_RevalidationInterval"), UInvalidTargetFinderProcessor_RevalidationInterval, TEXT("Average seconds between range and obstruction checks of an entity's target. Each entity is staggered around this value."));
+
+float UInvalidTargetFinderProcessor_RevalidationMoveThreshold = 200.f;
+FAutoConsoleVariableRef CVarUInvalidTargetFinderProcessor_RevalidationMoveThreshold(TEXT("pm.UInvalidTargetFinderProcessor_RevalidationMoveThreshold"), UInvalidTargetFinderProcessor_RevalidationMoveThreshold, TEXT("Distance the entity has to move since the last range and obstruction checks to recheck before the interval elapses."));
+
+/**
+ * Returns true if the range and obstruction checks for the entity's target are due, i.e. the target changed, the interval elapsed, or the entity
+ * moved further than the threshold. Only reads the entity's own state, so that targets that aren't due cost no lookup of the target entity.
+ * Validity and dying checks are cheap and happen every frame regardless.
+ */
+bool ShouldRevalidateTarget(const FTargetEntityFragment& TargetEntityFragment, const FVector& EntityLocation, const float CurrentTime)
+{
+	if (TargetEntityFragment.LastValidatedEntity != TargetEntityFragment.Entity || CurrentTime >= TargetEntityFragment.NextValidationTime)
 	{
-		EntitiesWithInvalidTargetQueue.Enqueue(ProcessEntityData.Entity);
 		return true;
 	}
-	return false;
+
+	return FVector::DistSquared(EntityLocation, TargetEntityFragment.LastValidatedEntityLocation) > FMath::Square(UInvalidTargetFinderProcessor_RevalidationMoveThreshold);
+}
+
+void ScheduleNextTargetValidation(FTargetEntityFragment& TargetEntityFragment, const FMassEntityHandle& Entity, const FVector& EntityLocation, const float CurrentTime)
+{
+	TargetEntityFragment.LastValidatedEntity = TargetEntityFragment.Entity;
+	TargetEntityFragment.LastValidatedEntityLocation = EntityLocation;
+
+	// Spread entities between 0.5x and 1.5x of the interval so that targets acquired on the same frame don't all recheck on the same frame.
+	const float StaggerScale = 0.5f + GetEntityHashFraction(Entity);
+	TargetEntityFragment.NextValidationTime = CurrentTime + UInvalidTargetFinderProcessor_RevalidationInterval * StaggerScale;
 }
 
 void UInvalidTargetFinderProcessor::Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context)
@@ -265,32 +272,69 @@ void UInvalidTargetFinderProcessor::Execute(UMassEntitySubsystem& EntitySubsyste
 		return;
 	}
 
-	TQueue<FProcessEntityData, EQueueMode::Mpsc> EntitiesToCheckQueue;
-	std::atomic<int32> TotalNumEntities = 0;
+	FMassProcessorFrameBudget* FrameBudget = UMassProcessorBudgetSubsystem::FindOrAddBudget(GetWorld(), GetClass()->GetFName(), UInvalidTargetFinderProcessor_BudgetMs);
+
+	// Entities write directly into a preallocated array at an offset reserved per chunk. The matching entity count ignores the tick tier chunk
+	// filter, so it's only an upper bound and the array is shrunk to the entities gathered.
+	const int32 NumEntitiesToCheck = BuildQueueEntityQuery.GetNumMatchingEntities(EntitySubsystem) + BuildQueueForTrackTargetEntityQuery.GetNumMatchingEntities(EntitySubsystem);
+	TArray<FProcessEntityData> EntitiesToCheck;
+	EntitiesToCheck.SetNumUninitialized(NumEntitiesToCheck);
+	std::atomic<int32> NextEntityToCheckIndex = 0;
+
+	// Only the range and obstruction checks are budgeted, the rest is cheap. The quota is based on the entities in chunks that tick this frame.
+	int32 RevalidationQuota = MAX_int32;
+	if (FrameBudget)
+	{
+		RevalidationQuota = FrameBudget->GetWorkQuota(FMassProcessorFrameBudget::CountEntitiesThisFrame(BuildQueueEntityQuery, EntitySubsystem, Context));
+	}
+	std::atomic<int32> NumRevalidationsRequested = 0;
 
 	{
 		TRACE_CPUPROFILER_EVENT_SCOPE(UInvalidTargetFinderProcessor.Execute.BuildQueue);
 
-		BuildQueueEntityQuery.ParallelForEachEntityChunk(EntitySubsystem, Context, [&EntitiesToCheckQueue, &TotalNumEntities](FMassExecutionContext& Context)
+		const float CurrentTime = EntitySubsystem.GetWorld()->GetTimeSeconds();
+		BuildQueueEntityQuery.ParallelForEachEntityChunk(EntitySubsystem, Context, [&EntitySubsystem, &EntitiesToCheck, &NextEntityToCheckIndex, &NumRevalidationsRequested, RevalidationQuota, CurrentTime](FMassExecutionContext& Context)
 		{
 			const int32 NumEntities = Context.GetNumEntities();
+			const int32 FirstEntityToCheckIndex = NextEntityToCheckIndex.fetch_add(NumEntities);
+			check(FirstEntityToCheckIndex + NumEntities <= EntitiesToCheck.Num());
 
 			const TConstArrayView<FTransformFragment> TransformList = Context.GetFragmentView<FTransformFragment>();
 			const TArrayView<FTargetEntityFragment> TargetEntityList = Context.GetMutableFragmentView<FTargetEntityFragment>();
-			const TConstArrayView<FTeamMemberFragment> TeamMemberList = Context.GetFragmentView<FTeamMemberFragment>();
+			const FTeamHostilityParameters& HostilityParameters = Context.GetConstSharedFragment<FTeamHostilityParameters>();
 
 			for (int32 EntityIndex = 0; EntityIndex < NumEntities; ++EntityIndex)
 			{
+				FTargetEntityFragment& TargetEntityFragment = TargetEntityList[EntityIndex];
+
 				FProcessEntityData ProcessEntityData;
 				ProcessEntityData.Entity = Context.GetEntity(EntityIndex);
-				ProcessEntityData.TargetEntity = TargetEntityList[EntityIndex].Entity;
-				ProcessEntityData.TargetMinCaliberForDamage = TargetEntityList[EntityIndex].TargetMinCaliberForDamage;
+				ProcessEntityData.TargetEntity = TargetEntityFragment.Entity;
+				ProcessEntityData.TargetMinCaliberForDamage = TargetEntityFragment.TargetMinCaliberForDamage;
 				ProcessEntityData.EntityTransform = TransformList[EntityIndex].GetTransform();
-				ProcessEntityData.bIsEntityOnTeam1 = TeamMemberList[EntityIndex].IsOnTeam1;
+				ProcessEntityData.HostileTeamsMask = HostilityParameters.HostileTeamsMask;
 				ProcessEntityData.bIsEntitySoldier = Context.DoesArchetypeHaveTag<FMassProjectileDamagableSoldierTag>();
 				ProcessEntityData.bIsSoldierDying = Context.DoesArchetypeHaveTag<FMassSoldierIsDyingTag>();
-				EntitiesToCheckQueue.Enqueue(ProcessEntityData);
-				TotalNumEntities++;
+
+				// An invalid target fails the cheap checks, so there is nothing to schedule.
+				if (EntitySubsystem.IsEntityValid(TargetEntityFragment.Entity))
+				{
+					const FVector& EntityLocation = ProcessEntityData.EntityTransform.GetLocation();
+					ProcessEntityData.bSkipRangeAndObstructionChecks = !ShouldRevalidateTarget(TargetEntityFragment, EntityLocation, CurrentTime);
+
+					// Over budget, leave the schedule untouched so that the checks stay due for the next frame.
+					if (!ProcessEntityData.bSkipRangeAndObstructionChecks && NumRevalidationsRequested.fetch_add(1) >= RevalidationQuota)
+					{
+						ProcessEntityData.bSkipRangeAndObstructionChecks = true;
+					}
+					if (!ProcessEntityData.bSkipRangeAndObstructionChecks)
+					{
+						// If the checks fail, the target gets reset and the schedule is ignored for the next target.
+						ScheduleNextTargetValidation(TargetEntityFragment, ProcessEntityData.Entity, EntityLocation, CurrentTime);
+					}
+				}
+
+				EntitiesToCheck[FirstEntityToCheckIndex + EntityIndex] = ProcessEntityData;
 			}
 		});
 	}
@@ -298,9 +342,11 @@ void UInvalidTargetFinderProcessor::Execute(UMassEntitySubsystem& EntitySubsyste
 	{
 		TRACE_CPUPROFILER_EVENT_SCOPE(UInvalidTargetFinderProcessor.Execute.BuildQueueForTrackTarget);
 
-		BuildQueueForTrackTargetEntityQuery.ParallelForEachEntityChunk(EntitySubsystem, Context, [&EntitiesToCheckQueue, &TotalNumEntities](FMassExecutionContext& Context)
+		BuildQueueForTrackTargetEntityQuery.ParallelForEachEntityChunk(EntitySubsystem, Context, [&EntitiesToCheck, &NextEntityToCheckIndex](FMassExecutionContext& Context)
 		{
 			const int32 NumEntities = Context.GetNumEntities();
+			const int32 FirstEntityToCheckIndex = NextEntityToCheckIndex.fetch_add(NumEntities);
+			check(FirstEntityToCheckIndex + NumEntities <= EntitiesToCheck.Num());
 
 			const TArrayView<FTargetEntityFragment> TargetEntityList = Context.GetMutableFragmentView<FTargetEntityFragment>();
 
@@ -310,41 +356,35 @@ void UInvalidTargetFinderProcessor::Execute(UMassEntitySubsystem& EntitySubsyste
 				ProcessEntityData.Entity = Context.GetEntity(EntityIndex);
 				ProcessEntityData.TargetEntity = TargetEntityList[EntityIndex].Entity;
 				ProcessEntityData.bOnlyCheckIfTargetEntityValidInEntitySubsystem = true;
-				EntitiesToCheckQueue.Enqueue(ProcessEntityData);
-				TotalNumEntities++;
+				EntitiesToCheck[FirstEntityToCheckIndex + EntityIndex] = ProcessEntityData;
 			}
 		});
 	}
 
-	TArray<FProcessEntityData> EntitiesToCheck;
-	{
-		TRACE_CPUPROFILER_EVENT_SCOPE(UInvalidTargetFinderProcessor.Execute.ConvertQueueToArray);
-
-		EntitiesToCheck.Reserve(TotalNumEntities);
-		while (!EntitiesToCheckQueue.IsEmpty())
-		{
-			FProcessEntityData ProcessEntityData;
-			const bool bSuccess = EntitiesToCheckQueue.Dequeue(ProcessEntityData);
-			check(bSuccess);
-			EntitiesToCheck.Add(ProcessEntityData);
-		}
-	}
-
-	TQueue<FMassEntityHandle, EQueueMode::Mpsc> EntitiesWithInvalidTargetQueue;
+	check(NextEntityToCheckIndex <= EntitiesToCheck.Num());
+	EntitiesToCheck.SetNum(NextEntityToCheckIndex, false);
 	std::atomic<int32> NumEntitiesWithInvalidTarget = 0;
 
 	{
 		TRACE_CPUPROFILER_EVENT_SCOPE(UInvalidTargetFinderProcessor.Execute.ProcessEntities);
 
+		const double StartTime = FPlatformTime::Seconds();
 		const bool bInvalidateAllTargets = UInvalidTargetFinderProcessor_ShouldInvalidateAllTargets;
 
 		ParallelFor(EntitiesToCheck.Num(), [&](const int32 JobIndex)
 		{
-			if (ProcessEntity(EntitiesToCheck[JobIndex], bInvalidateAllTargets, EntitySubsystem, *TargetFinderSubsystem.Get(), EntitiesWithInvalidTargetQueue))
+			FProcessEntityData& ProcessEntityData = EntitiesToCheck[JobIndex];
+			ProcessEntityData.bHasInvalidTarget = ProcessEntity(ProcessEntityData, bInvalidateAllTargets, EntitySubsystem, *TargetFinderSubsystem.Get());
+			if (ProcessEntityData.bHasInvalidTarget)
 			{
 				NumEntitiesWithInvalidTarget++;
 			}
 		});
+
+		if (FrameBudget)
+		{
+			FrameBudget->RecordWork(FMath::Min<int32>(NumRevalidationsRequested, RevalidationQuota), FPlatformTime::Seconds() - StartTime);
+		}
 	}
 
 	TSet<FMassEntityHandle> EntitiesWithInvalidTargets;
@@ -352,12 +392,12 @@ void UInvalidTargetFinderProcessor::Execute(UMassEntitySubsystem& EntitySubsyste
 		TRACE_CPUPROFILER_EVENT_SCOPE(UInvalidTargetFinderProcessor.Execute.BuildInvalidTargetsSet);
 
 		EntitiesWithInvalidTargets.Reserve(NumEntitiesWithInvalidTarget);
-		while (!EntitiesWithInvalidTargetQueue.IsEmpty())
+		for (const FProcessEntityData& ProcessEntityData : EntitiesToCheck)
 		{
-			FMassEntityHandle Entity;
-			const bool bSuccess = EntitiesWithInvalidTargetQueue.Dequeue(Entity);
-			check(bSuccess);
-			EntitiesWithInvalidTargets.Add(Entity);
+			if (ProcessEntityData.bHasInvalidTarget)
+			{
+				EntitiesWithInvalidTargets.Add(ProcessEntityData.Entity);
+			}
 		}
 	}
 
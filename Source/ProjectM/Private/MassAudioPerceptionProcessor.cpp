@@ -7,8 +7,15 @@
 #include "MassProjectileDamageProcessor.h"
 #include "MassRepresentationTypes.h"
 #include "MassTrackedVehicleOrientationProcessor.h"
+#include "MassStaticOccluderSubsystem.h"
+#include "MassTraceContextSubsystem.h"
+#include "MassProcessorBudgetSubsystem.h"
+#include "MassTickTierTrait.h"
 #include "Containers/BinaryHeap.h"
 
+float UMassAudioPerceptionProcessor_BudgetMs = 1.f;
+FAutoConsoleVariableRef CVarUMassAudioPerceptionProcessor_BudgetMs(TEXT("pm.UMassAudioPerceptionProcessor_BudgetMs"), UMassAudioPerceptionProcessor_BudgetMs, TEXT("Frame time budget for listening for sounds and their line traces. Entities over budget listen on a later frame. 0 disables the budget."));
+
 UMassAudioPerceptionProcessor::UMassAudioPerceptionProcessor()
 {
 	bAutoRegisterWithProcessingPhases = true;
@@ -25,9 +32,11 @@ void UMassAudioPerceptionProcessor::ConfigureQueries()
 {
 	PreLineTracesEntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
 	PreLineTracesEntityQuery.AddRequirement<FMassMoveTargetFragment>(EMassFragmentAccess::ReadOnly);
-	PreLineTracesEntityQuery.AddRequirement<FTeamMemberFragment>(EMassFragmentAccess::ReadOnly);
+	PreLineTracesEntityQuery.AddConstSharedRequirement<FTeamHostilityParameters>(EMassFragmentPresence::All);
 	PreLineTracesEntityQuery.AddTagRequirement<FMassNeedsEnemyTargetTag>(EMassFragmentPresence::All);
 	PreLineTracesEntityQuery.AddTagRequirement<FMassTrackSoundTag>(EMassFragmentPresence::None);
+	PreLineTracesEntityQuery.AddChunkRequirement<FMassTickTierChunkFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
+	PreLineTracesEntityQuery.SetChunkFilter(&FMassTickTierChunkFragment::ShouldTickChunkThisFrame);
 
 	PostLineTracesEntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
 	PostLineTracesEntityQuery.AddRequirement<FMassMoveTargetFragment>(EMassFragmentAccess::ReadWrite);
@@ -73,7 +82,7 @@ void EnqueueClosestSoundToTraceQueue(TArray<FVector>& CloseSounds, TQueue<FSound
   }
 }
 
-void ProcessEntityForAudioTarget(UMassSoundPerceptionSubsystem* SoundPerceptionSubsystem, const FTransform& EntityTransform, const FMassMoveTargetFragment& MoveTargetFragment, const bool& bIsEntityOnTeam1, const FMassEntityHandle& Entity, const bool bIsEntitySoldier, TQueue<FSoundTraceData, EQueueMode::Mpsc>& SoundTraceQueue)
+void ProcessEntityForAudioTarget(UMassSoundPerceptionSubsystem* SoundPerceptionSubsystem, const FTransform& EntityTransform, const FMassMoveTargetFragment& MoveTargetFragment, const uint32 HostileTeamsMask, const FMassEntityHandle& Entity, const bool bIsEntitySoldier, TQueue<FSoundTraceData, EQueueMode::Mpsc>& SoundTraceQueue)
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(UMassAudioPerceptionProcessor.ProcessEntityForAudioTarget);
 
@@ -84,7 +93,7 @@ void ProcessEntityForAudioTarget(UMassSoundPerceptionSubsystem* SoundPerceptionS
 		return;
 	}
 	TArray<FVector> CloseSounds;
-	if (SoundPerceptionSubsystem->GetSoundsNearLocation(EntityLocation, CloseSounds, !bIsEntityOnTeam1))
+	if (SoundPerceptionSubsystem->GetSoundsNearLocation(EntityLocation, CloseSounds, HostileTeamsMask))
 	{
 		EnqueueClosestSoundToTraceQueue(CloseSounds, SoundTraceQueue, EntityLocation, bIsEntitySoldier, Entity);
 	}
@@ -118,6 +127,9 @@ void DoLineTraces(TQueue<FSoundTraceData, EQueueMode::Mpsc>& SoundTraceQueue, co
   }
 
 	TQueue<FSoundTraceResult, EQueueMode::Mpsc> BestSoundLocations;
+	const UMassStaticOccluderSubsystem* StaticOccluderSubsystem = World.GetSubsystem<UMassStaticOccluderSubsystem>();
+	const UMassTraceContextSubsystem* TraceContextSubsystem = World.GetSubsystem<UMassTraceContextSubsystem>();
+	check(TraceContextSubsystem);
 
 	{
 		TRACE_CPUPROFILER_EVENT_SCOPE(UMassAudioPerceptionProcessor.ParallelFor);
@@ -127,11 +139,13 @@ void DoLineTraces(TQueue<FSoundTraceData, EQueueMode::Mpsc>& SoundTraceQueue, co
 
 			const FSoundTraceData& SoundTrace = SoundTraces[JobIndex];
 
-			bool bHasBlockingHit;
+			const EStaticOcclusionResult StaticOcclusionResult = StaticOccluderSubsystem ? StaticOccluderSubsystem->Raycast(SoundTrace.TraceStart, SoundTrace.TraceEnd) : EStaticOcclusionResult::Unknown;
+			// The field only knows static geometry, so a clear answer still needs the physics trace for movable blockers.
+			bool bHasBlockingHit = StaticOcclusionResult == EStaticOcclusionResult::Blocked;
+			if (!bHasBlockingHit)
 			{
 				TRACE_CPUPROFILER_EVENT_SCOPE(UMassAudioPerceptionProcessor.DoLineTraces.LineTraceTestByChannel);
-				const FCollisionQueryParams CollisionQueryParams(SCENE_QUERY_STAT(DefaultQueryParam), false);
-				bHasBlockingHit = World.LineTraceTestByChannel(SoundTrace.TraceStart, SoundTrace.TraceEnd, ECollisionChannel::ECC_Visibility, CollisionQueryParams);
+				bHasBlockingHit = TraceContextSubsystem->LineTraceTest(World, SoundTrace.TraceStart, SoundTrace.TraceEnd);
 			}
 			if (!bHasBlockingHit)
 			{
@@ -177,34 +191,53 @@ void UMassAudioPerceptionProcessor::Execute(UMassEntitySubsystem& EntitySubsyste
 		return;
 	}
 
+	FMassProcessorFrameBudget* FrameBudget = UMassProcessorBudgetSubsystem::FindOrAddBudget(GetWorld(), GetClass()->GetFName(), UMassAudioPerceptionProcessor_BudgetMs);
+	const double StartTime = FPlatformTime::Seconds();
+	std::atomic<int32> NumEntitiesListened = 0;
+	if (FrameBudget)
+	{
+		FrameBudget->BeginEntitySelection(FMassProcessorFrameBudget::CountEntitiesThisFrame(PreLineTracesEntityQuery, EntitySubsystem, Context));
+	}
+
 	TQueue<FSoundTraceData, EQueueMode::Mpsc> SoundTraceQueue;
 
   {
 		TRACE_CPUPROFILER_EVENT_SCOPE(UMassAudioPerceptionProcessor.Execute.PreLineTracesEntityQuery.ParallelForEachEntityChunk);
-		PreLineTracesEntityQuery.ParallelForEachEntityChunk(EntitySubsystem, Context, [&SoundPerceptionSubsystem = SoundPerceptionSubsystem, &SoundTraceQueue = SoundTraceQueue](const FMassExecutionContext& Context)
+		PreLineTracesEntityQuery.ParallelForEachEntityChunk(EntitySubsystem, Context, [&SoundPerceptionSubsystem = SoundPerceptionSubsystem, &SoundTraceQueue = SoundTraceQueue, &NumEntitiesListened, FrameBudget = FrameBudget](const FMassExecutionContext& Context)
 		{
 			const int32 NumEntities = Context.GetNumEntities();
 
 			const TConstArrayView<FTransformFragment> LocationList = Context.GetFragmentView<FTransformFragment>();
-			const TConstArrayView<FTeamMemberFragment> TeamMemberList = Context.GetFragmentView<FTeamMemberFragment>();
+			const FTeamHostilityParameters& HostilityParameters = Context.GetConstSharedFragment<FTeamHostilityParameters>();
 			const TConstArrayView<FMassMoveTargetFragment> MoveTargetList = Context.GetFragmentView<FMassMoveTargetFragment>();
 
 			for (int32 EntityIndex = 0; EntityIndex < NumEntities; ++EntityIndex)
 			{
 				const FMassEntityHandle& Entity = Context.GetEntity(EntityIndex);
+
+				// Entities over budget keep FMassNeedsEnemyTargetTag and listen on a later frame.
+				if (FrameBudget && !FrameBudget->IsEntitySelected(Entity))
+				{
+					continue;
+				}
+				NumEntitiesListened++;
+
 				const bool& bIsEntitySoldier = Context.DoesArchetypeHaveTag<FMassProjectileDamagableSoldierTag>();
-				ProcessEntityForAudioTarget(SoundPerceptionSubsystem, LocationList[EntityIndex].GetTransform(), MoveTargetList[EntityIndex], TeamMemberList[EntityIndex].IsOnTeam1, Entity, bIsEntitySoldier, SoundTraceQueue);
+				ProcessEntityForAudioTarget(SoundPerceptionSubsystem, LocationList[EntityIndex].GetTransform(), MoveTargetList[EntityIndex], HostilityParameters.HostileTeamsMask, Entity, bIsEntitySoldier, SoundTraceQueue);
 			}
 		});
 	}
 
-	if (SoundTraceQueue.IsEmpty())
+	TMap<FMassEntityHandle, FVector> EntityToBestSoundLocation;
+	if (!SoundTraceQueue.IsEmpty())
 	{
-		return;
+		DoLineTraces(SoundTraceQueue, *EntitySubsystem.GetWorld(), EntityToBestSoundLocation);
 	}
 
-	TMap<FMassEntityHandle, FVector> EntityToBestSoundLocation;
-	DoLineTraces(SoundTraceQueue, *EntitySubsystem.GetWorld(), EntityToBestSoundLocation);
+	if (FrameBudget)
+	{
+		FrameBudget->RecordWork(NumEntitiesListened, FPlatformTime::Seconds() - StartTime);
+	}
 
 	if (EntityToBestSoundLocation.IsEmpty())
 	{
@@ -0,0 +1,398 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#include "MassBattlefieldClutterSubsystem.h"
+
+#include "MassEntityView.h"
+#include "MassEntityConfigAsset.h"
+#include "MassSpawnerSubsystem.h"
+#include "MassCommonFragments.h"
+#include "MassRepresentationFragments.h"
+#include "MassRepresentationSubsystem.h"
+#include "MassWorldContext.h"
+#include "MassGenericAnimationProcessor.h"
+#include "MassGenericUpdateISMVertexAnimationProcessor.h"
+#include "AnimToTextureInstancePlaybackHelpers.h"
+#include "Components/InstancedStaticMeshComponent.h"
+
+void UMassBattlefieldClutterSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	CellSize = FMath::Max(UMassBattlefieldClutterSubsystem_CellSize, 1.f);
+}
+
+void UMassBattlefieldClutterSubsystem::Deinitialize()
+{
+	Instances.Empty();
+	Cells.Empty();
+	Order.Empty();
+	Types.Empty();
+	EntityConfigTypeIndices.Empty();
+	ClutterActor = nullptr;
+
+	Super::Deinitialize();
+}
+
+bool UMassBattlefieldClutterSubsystem::AddEntity(const FMassEntityView& EntityView)
+{
+	const FTransformFragment* TransformFragment = EntityView.GetFragmentDataPtr<FTransformFragment>();
+	const FMassRepresentationFragment* RepresentationFragment = EntityView.GetFragmentDataPtr<FMassRepresentationFragment>();
+	if (!TransformFragment || !RepresentationFragment || RepresentationFragment->StaticMeshDescIndex == INDEX_NONE)
+	{
+		return false;
+	}
+
+	UMassRepresentationSubsystem* RepresentationSubsystem = EntityView.GetSharedFragmentData<FMassRepresentationSubsystemSharedFragment>().RepresentationSubsystem;
+	if (!RepresentationSubsystem)
+	{
+		return false;
+	}
+
+	// The entity's vertex animation state is kept as is. Non looping animations, like the death animations, then stay on their last frame.
+	TArray<float> CustomData;
+	if (const FGenericAnimationFragment* AnimationFragment = EntityView.GetFragmentDataPtr<FGenericAnimationFragment>())
+	{
+		const FAnimToTextureInstancePlaybackData InstanceData = UMassGenericUpdateISMVertexAnimationProcessor::MakeInstancePlaybackData(*AnimationFragment);
+		CustomData.Append(reinterpret_cast<const float*>(&InstanceData), sizeof(InstanceData) / sizeof(float));
+	}
+
+	const FStaticMeshInstanceVisualizationDesc& Desc = RepresentationSubsystem->GetMutableInstancedStaticMeshInfos()[RepresentationFragment->StaticMeshDescIndex].GetDesc();
+	const int32 TypeIndex = FindOrAddType(Desc, CustomData.Num());
+	if (TypeIndex == INDEX_NONE)
+	{
+		return false;
+	}
+
+	AddInstance(TypeIndex, TransformFragment->GetTransform(), CustomData);
+	return true;
+}
+
+bool UMassBattlefieldClutterSubsystem::AddEntityConfig(UMassEntityConfigAsset* EntityConfig, const FTransform& Transform)
+{
+	if (!EntityConfig)
+	{
+		return false;
+	}
+
+	int32* TypeIndex = EntityConfigTypeIndices.Find(EntityConfig);
+	if (!TypeIndex)
+	{
+		TypeIndex = &EntityConfigTypeIndices.Add(EntityConfig, INDEX_NONE);
+
+		UMassSpawnerSubsystem* SpawnerSystem = UWorld::GetSubsystem<UMassSpawnerSubsystem>(GetWorld());
+		if (SpawnerSystem)
+		{
+			const FMassEntityTemplate* EntityTemplate = EntityConfig->GetConfig().GetOrCreateEntityTemplate(GetMassWorldContextActor(*GetWorld()), *SpawnerSystem); // TODO: passing SpawnerSystem is a hack
+
+			const FMassRepresentationFragment* RepresentationFragment = nullptr;
+			for (const FInstancedStruct& InitialFragmentValue : EntityTemplate->GetInitialFragmentValues())
+			{
+				if (InitialFragmentValue.GetScriptStruct() == FMassRepresentationFragment::StaticStruct())
+				{
+					RepresentationFragment = &InitialFragmentValue.Get<FMassRepresentationFragment>();
+				}
+			}
+
+			UMassRepresentationSubsystem* RepresentationSubsystem = nullptr;
+			for (const FSharedStruct& SharedFragment : EntityTemplate->GetSharedFragmentValues().GetSharedFragments())
+			{
+				if (SharedFragment.GetScriptStruct() == FMassRepresentationSubsystemSharedFragment::StaticStruct())
+				{
+					RepresentationSubsystem = SharedFragment.Get<FMassRepresentationSubsystemSharedFragment>().RepresentationSubsystem;
+				}
+			}
+
+			if (RepresentationFragment && RepresentationFragment->StaticMeshDescIndex != INDEX_NONE && RepresentationSubsystem)
+			{
+				*TypeIndex = FindOrAddType(RepresentationSubsystem->GetMutableInstancedStaticMeshInfos()[RepresentationFragment->StaticMeshDescIndex].GetDesc(), 0);
+			}
+		}
+
+		if (*TypeIndex == INDEX_NONE)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("UMassBattlefieldClutterSubsystem: %s has no static mesh representation, it's spawned as an entity."), *EntityConfig->GetName());
+		}
+	}
+
+	if (*TypeIndex == INDEX_NONE)
+	{
+		return false;
+	}
+
+	AddInstance(*TypeIndex, Transform, TArray<float>());
+	return true;
+}
+
+int32 UMassBattlefieldClutterSubsystem::FindOrAddType(const FStaticMeshInstanceVisualizationDesc& Desc, const int32 NumCustomDataFloats)
+{
+	// Clutter doesn't change LOD, it uses the first and most detailed mesh of the representation.
+	if (Desc.Meshes.Num() == 0 || !Desc.Meshes[0].Mesh)
+	{
+		return INDEX_NONE;
+	}
+
+	const FStaticMeshInstanceVisualizationMeshDesc& MeshDesc = Desc.Meshes[0];
+	TArray<TObjectPtr<UMaterialInterface>> MaterialOverrides;
+	for (UMaterialInterface* MaterialOverride : MeshDesc.MaterialOverrides)
+	{
+		MaterialOverrides.Add(MaterialOverride);
+	}
+	return FindOrAddType(MeshDesc.Mesh, MaterialOverrides, MeshDesc.bCastShadows, NumCustomDataFloats);
+}
+
+int32 UMassBattlefieldClutterSubsystem::FindOrAddType(UStaticMesh* Mesh, TConstArrayView<TObjectPtr<UMaterialInterface>> MaterialOverrides, const bool bCastShadows, const int32 NumCustomDataFloats)
+{
+	const int32 ExistingTypeIndex = Types.IndexOfByPredicate([&](const FMassBattlefieldClutterType& Type)
+	{
+		if (Type.Mesh != Mesh || Type.bCastShadows != bCastShadows || Type.NumCustomDataFloats != NumCustomDataFloats || Type.MaterialOverrides.Num() != MaterialOverrides.Num())
+		{
+			return false;
+		}
+		for (int32 MaterialIndex = 0; MaterialIndex < MaterialOverrides.Num(); MaterialIndex++)
+		{
+			if (Type.MaterialOverrides[MaterialIndex] != MaterialOverrides[MaterialIndex])
+			{
+				return false;
+			}
+		}
+		return true;
+	});
+	if (ExistingTypeIndex != INDEX_NONE)
+	{
+		return ExistingTypeIndex;
+	}
+
+	UWorld* World = GetWorld();
+	if (!ClutterActor)
+	{
+		FActorSpawnParameters SpawnParameters;
+		SpawnParameters.ObjectFlags = RF_Transient;
+		ClutterActor = World->SpawnActor<AActor>(SpawnParameters);
+		USceneComponent* RootComponent = NewObject<USceneComponent>(ClutterActor, TEXT("Root"));
+		RootComponent->SetMobility(EComponentMobility::Movable);
+		ClutterActor->SetRootComponent(RootComponent);
+		RootComponent->RegisterComponent();
+	}
+
+	FMassBattlefieldClutterType& Type = Types.AddDefaulted_GetRef();
+	Type.Mesh = Mesh;
+	Type.MaterialOverrides.Append(MaterialOverrides.GetData(), MaterialOverrides.Num());
+	Type.bCastShadows = bCastShadows;
+	Type.NumCustomDataFloats = NumCustomDataFloats;
+
+	Type.Component = NewObject<UInstancedStaticMeshComponent>(ClutterActor);
+	Type.Component->SetMobility(EComponentMobility::Movable);
+	Type.Component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Type.Component->SetCanEverAffectNavigation(false);
+	Type.Component->SetCastShadow(bCastShadows);
+	Type.Component->NumCustomDataFloats = NumCustomDataFloats;
+	Type.Component->SetStaticMesh(Mesh);
+	for (int32 MaterialIndex = 0; MaterialIndex < MaterialOverrides.Num(); MaterialIndex++)
+	{
+		Type.Component->SetMaterial(MaterialIndex, MaterialOverrides[MaterialIndex]);
+	}
+	Type.Component->SetupAttachment(ClutterActor->GetRootComponent());
+	Type.Component->RegisterComponent();
+
+	return Types.Num() - 1;
+}
+
+void UMassBattlefieldClutterSubsystem::AddInstance(const int32 TypeIndex, const FTransform& Transform, const TArray<float>& CustomData)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UMassBattlefieldClutterSubsystem.AddInstance);
+	check(IsInGameThread());
+
+	if (UMassBattlefieldClutterSubsystem_MaxInstances <= 0 || UMassBattlefieldClutterSubsystem_MaxInstancesPerCell <= 0)
+	{
+		return;
+	}
+
+	const FIntPoint Cell = GetCell(Transform.GetLocation());
+	while (Instances.Num() >= UMassBattlefieldClutterSubsystem_MaxInstances)
+	{
+		RemoveOldestInstance();
+	}
+	while (const TArray<int32>* CellInstances = Cells.Find(Cell))
+	{
+		if (CellInstances->Num() < UMassBattlefieldClutterSubsystem_MaxInstancesPerCell)
+		{
+			break;
+		}
+		RemoveInstance((*CellInstances)[0]);
+	}
+
+	FMassBattlefieldClutterType& Type = Types[TypeIndex];
+	int32 InstanceIndex;
+	if (Type.FreeInstanceIndices.Num() > 0)
+	{
+		InstanceIndex = Type.FreeInstanceIndices.Pop(false);
+		Type.Component->UpdateInstanceTransform(InstanceIndex, Transform, true, true);
+	}
+	else
+	{
+		InstanceIndex = Type.Component->AddInstance(Transform, true);
+	}
+	if (Type.NumCustomDataFloats > 0 && ensure(CustomData.Num() == Type.NumCustomDataFloats))
+	{
+		Type.Component->SetCustomData(InstanceIndex, CustomData, true);
+	}
+
+	const uint32 Sequence = NextSequence++;
+	const int32 InstanceId = Instances.Add({ Transform, Cell, TypeIndex, InstanceIndex, Sequence });
+	Cells.FindOrAdd(Cell).Add(InstanceId);
+	Order.Add({ InstanceId, Sequence });
+	CompactOrder();
+}
+
+void UMassBattlefieldClutterSubsystem::RemoveInstance(const int32 InstanceId)
+{
+	const FMassBattlefieldClutterInstance& Instance = Instances[InstanceId];
+
+	TArray<int32>& CellInstances = Cells.FindChecked(Instance.Cell);
+	CellInstances.RemoveSingle(InstanceId);
+	if (CellInstances.Num() == 0)
+	{
+		Cells.Remove(Instance.Cell);
+	}
+
+	// Hidden by scaling it to nothing until another instance of the type reuses it.
+	FMassBattlefieldClutterType& Type = Types[Instance.TypeIndex];
+	Type.Component->UpdateInstanceTransform(Instance.InstanceIndex, FTransform(FQuat::Identity, Instance.Transform.GetLocation(), FVector::ZeroVector), true, true);
+	Type.FreeInstanceIndices.Add(Instance.InstanceIndex);
+
+	Instances.RemoveAt(InstanceId);
+}
+
+void UMassBattlefieldClutterSubsystem::RemoveOldestInstance()
+{
+	while (OldestIndex < Order.Num())
+	{
+		const FOrderEntry Entry = Order[OldestIndex++];
+		if (Instances.IsAllocated(Entry.InstanceId) && Instances[Entry.InstanceId].Sequence == Entry.Sequence)
+		{
+			RemoveInstance(Entry.InstanceId);
+			break;
+		}
+	}
+}
+
+void UMassBattlefieldClutterSubsystem::CompactOrder()
+{
+	// Instances evicted by the per-cell cap leave their entries behind, and when only that cap is hit RemoveOldestInstance never skips them.
+	if (Order.Num() <= 1024 || Order.Num() <= 2 * Instances.Num())
+	{
+		return;
+	}
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(UMassBattlefieldClutterSubsystem.CompactOrder);
+
+	int32 NumKept = 0;
+	for (int32 OrderIndex = OldestIndex; OrderIndex < Order.Num(); OrderIndex++)
+	{
+		const FOrderEntry& Entry = Order[OrderIndex];
+		if (Instances.IsAllocated(Entry.InstanceId) && Instances[Entry.InstanceId].Sequence == Entry.Sequence)
+		{
+			Order[NumKept++] = Entry;
+		}
+	}
+	Order.SetNum(NumKept, false);
+	OldestIndex = 0;
+}
+
+void UMassBattlefieldClutterSubsystem::Reset()
+{
+	for (FMassBattlefieldClutterType& Type : Types)
+	{
+		Type.Component->ClearInstances();
+		Type.FreeInstanceIndices.Reset();
+	}
+	Instances.Reset();
+	Cells.Reset();
+	Order.Reset();
+	OldestIndex = 0;
+}
+
+FIntPoint UMassBattlefieldClutterSubsystem::GetCell(const FVector& Location) const
+{
+	return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+}
+
+void UMassBattlefieldClutterSubsystem::SerializeSnapshot(FArchive& Ar)
+{
+	// Types are written by asset path, their indices depend on the order they were first used in.
+	int32 NumTypes = Types.Num();
+	Ar << NumTypes;
+	TArray<int32> TypeIndices;
+	for (int32 SnapshotTypeIndex = 0; SnapshotTypeIndex < NumTypes && !Ar.IsError(); SnapshotTypeIndex++)
+	{
+		FSoftObjectPath MeshPath;
+		TArray<FSoftObjectPath> MaterialOverridePaths;
+		bool bCastShadows = true;
+		int32 NumCustomDataFloats = 0;
+		if (Ar.IsSaving())
+		{
+			const FMassBattlefieldClutterType& Type = Types[SnapshotTypeIndex];
+			MeshPath = Type.Mesh.Get();
+			for (const TObjectPtr<UMaterialInterface>& MaterialOverride : Type.MaterialOverrides)
+			{
+				MaterialOverridePaths.Add(MaterialOverride.Get());
+			}
+			bCastShadows = Type.bCastShadows;
+			NumCustomDataFloats = Type.NumCustomDataFloats;
+		}
+		Ar << MeshPath << MaterialOverridePaths << bCastShadows << NumCustomDataFloats;
+
+		if (Ar.IsLoading())
+		{
+			UStaticMesh* Mesh = Cast<UStaticMesh>(MeshPath.TryLoad());
+			TArray<TObjectPtr<UMaterialInterface>> MaterialOverrides;
+			for (const FSoftObjectPath& MaterialOverridePath : MaterialOverridePaths)
+			{
+				MaterialOverrides.Add(Cast<UMaterialInterface>(MaterialOverridePath.TryLoad()));
+			}
+			TypeIndices.Add(Mesh ? FindOrAddType(Mesh, MaterialOverrides, bCastShadows, NumCustomDataFloats) : INDEX_NONE);
+		}
+	}
+
+	if (Ar.IsLoading())
+	{
+		Reset();
+	}
+
+	// Instances are written oldest first, so that they are evicted in the same order after loading.
+	int32 NumInstances = Instances.Num();
+	Ar << NumInstances;
+	if (Ar.IsSaving())
+	{
+		for (int32 OrderIndex = OldestIndex; OrderIndex < Order.Num(); OrderIndex++)
+		{
+			const FOrderEntry& Entry = Order[OrderIndex];
+			if (!Instances.IsAllocated(Entry.InstanceId) || Instances[Entry.InstanceId].Sequence != Entry.Sequence)
+			{
+				continue;
+			}
+
+			const FMassBattlefieldClutterInstance& Instance = Instances[Entry.InstanceId];
+			const FMassBattlefieldClutterType& Type = Types[Instance.TypeIndex];
+			int32 TypeIndex = Instance.TypeIndex;
+			FTransform Transform = Instance.Transform;
+			TArray<float> CustomData;
+			CustomData.Append(Type.Component->PerInstanceSMCustomData.GetData() + Instance.InstanceIndex * Type.NumCustomDataFloats, Type.NumCustomDataFloats);
+			Ar << TypeIndex << Transform << CustomData;
+		}
+	}
+	else
+	{
+		for (int32 InstanceIndex = 0; InstanceIndex < NumInstances && !Ar.IsError(); InstanceIndex++)
+		{
+			int32 TypeIndex = INDEX_NONE;
+			FTransform Transform;
+			TArray<float> CustomData;
+			Ar << TypeIndex << Transform << CustomData;
+			if (TypeIndices.IsValidIndex(TypeIndex) && TypeIndices[TypeIndex] != INDEX_NONE && CustomData.Num() == Types[TypeIndices[TypeIndex]].NumCustomDataFloats)
+			{
+				AddInstance(TypeIndices[TypeIndex], Transform, CustomData);
+			}
+		}
+	}
+}
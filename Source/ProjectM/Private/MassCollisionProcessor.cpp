@@ -7,6 +7,8 @@
 #include <MassCommonFragments.h>
 #include "MassEntityView.h"
 #include <MassLODTypes.h>
+#include "ProjectMStats.h"
+#include "MassDebugDrawRecorder.h"
 
 static const uint32 GUMassCollisionProcessor_MaxClosestEntitiesToFind = 3;
 typedef TArray<FMassNavigationObstacleItem, TFixedAllocator<GUMassCollisionProcessor_MaxClosestEntitiesToFind>> TCollisionItemArray;
@@ -182,8 +184,7 @@ float GetCapsuleHalfHeight(const FCapsule& Capsule)
 
 void DrawCapsule(const FCapsule& Capsule, const UWorld& World, const FLinearColor& Color, const bool bPersistentLines, float LifeTime)
 {
-	FQuat const CapsuleRot = FRotationMatrix::MakeFromZ(Capsule.b - Capsule.a).ToQuat();
-	DrawDebugCapsule(&World, GetCapsuleCenter(Capsule), GetCapsuleHalfHeight(Capsule), Capsule.r, CapsuleRot, Color.ToFColor(true), bPersistentLines, LifeTime);
+	UE::ProjectM::DebugDraw::Capsule(&World, Capsule.a, Capsule.b, Capsule.r, Color.ToFColor(true), bPersistentLines, LifeTime);
 }
 
 // TODO: DRY with other processors
@@ -295,8 +296,8 @@ void ProcessEntity(FMassExecutionContext& Context, FMassEntityHandle Entity, con
 				DrawCapsule(EntityCapsule, *EntitySubsystem.GetWorld());
 				DrawCapsule(OtherEntityCapsule, *EntitySubsystem.GetWorld(), FLinearColor::Yellow);
 
-				DrawDebugDirectionalArrow(EntitySubsystem.GetWorld(), Transform.GetLocation(), Transform.GetLocation() + NewForce, 30.f, FColor::Red, true);
-				DrawDebugDirectionalArrow(EntitySubsystem.GetWorld(), OtherLocation, OtherLocation + NewOtherForce, 30.f, FColor::Yellow, true);
+				UE::ProjectM::DebugDraw::Arrow(EntitySubsystem.GetWorld(), Transform.GetLocation(), Transform.GetLocation() + NewForce, 30.f, FColor::Red, true);
+				UE::ProjectM::DebugDraw::Arrow(EntitySubsystem.GetWorld(), OtherLocation, OtherLocation + NewOtherForce, 30.f, FColor::Yellow, true);
 			}
 		}
 	}
@@ -337,10 +338,13 @@ void UMassCollisionProcessor::Execute(UMassEntitySubsystem& EntitySubsystem, FMa
 
 		const FNavigationObstacleHashGrid2D& AvoidanceObstacleGrid = NavigationSubsystem->GetObstacleGridMutable();
 
+		int32 NumCollisionsTested = 0;
 		for (int32 EntityIndex = 0; EntityIndex < NumEntities; ++EntityIndex)
 		{
 			ProcessEntity(Context, Context.GetEntity(EntityIndex), TransformList[EntityIndex].GetTransform(), CloseEntities, RadiusList[EntityIndex].Radius, AvoidanceObstacleGrid, EntitySubsystem, CollisionCapsuleParametersList[EntityIndex], ForceList[EntityIndex], VelocityList[EntityIndex]);
+			NumCollisionsTested += CloseEntities.Num();
 		}
+		UE::ProjectM::Stats::Add(EProjectMStat::CollisionsTested, NumCollisionsTested);
 	};
 
 	if (UMassCollisionProcessor_UseParallelForEachEntityChunk)
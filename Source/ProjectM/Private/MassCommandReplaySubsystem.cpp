@@ -0,0 +1,490 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#include "MassCommandReplaySubsystem.h"
+
+#include "MassEntitySubsystem.h"
+#include "MassEntityQuery.h"
+#include "MassExecutionContext.h"
+#include "MassCommonFragments.h"
+#include "MassProjectileDamageProcessor.h"
+#include "MilitaryStructureSubsystem.h"
+#include "Character/CommanderCharacter.h"
+#include "EngineUtils.h"
+#include "Hash/CityHash.h"
+#include "Kismet/GameplayStatics.h"
+#include "Misc/App.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/BufferArchive.h"
+#include "Serialization/MemoryReader.h"
+
+FString UMassCommandReplaySubsystem_Record;
+FAutoConsoleVariableRef CVarUMassCommandReplaySubsystem_Record(TEXT("pm.UMassCommandReplaySubsystem_Record"), UMassCommandReplaySubsystem_Record, TEXT("Name of a command replay to record from begin play, e.g. from -ExecCmds. Saved to Saved/CommandReplays."));
+
+FString UMassCommandReplaySubsystem_Play;
+FAutoConsoleVariableRef CVarUMassCommandReplaySubsystem_Play(TEXT("pm.UMassCommandReplaySubsystem_Play"), UMassCommandReplaySubsystem_Play, TEXT("Name of a command replay to play from begin play, e.g. from -ExecCmds."));
+
+bool UMassCommandReplaySubsystem_ExitWhenDone = false;
+FAutoConsoleVariableRef CVarUMassCommandReplaySubsystem_ExitWhenDone(TEXT("pm.UMassCommandReplaySubsystem_ExitWhenDone"), UMassCommandReplaySubsystem_ExitWhenDone, TEXT("Exit once a played replay reaches its end, with exit code 1 if the simulation state differs from the recording."));
+
+int32 UMassCommandReplaySubsystem_Seed = 0;
+FAutoConsoleVariableRef CVarUMassCommandReplaySubsystem_Seed(TEXT("pm.UMassCommandReplaySubsystem_Seed"), UMassCommandReplaySubsystem_Seed, TEXT("Random seed to record with. 0 picks one."));
+
+float UMassCommandReplaySubsystem_FixedDeltaTime = 1.f / 30.f;
+FAutoConsoleVariableRef CVarUMassCommandReplaySubsystem_FixedDeltaTime(TEXT("pm.UMassCommandReplaySubsystem_FixedDeltaTime"), UMassCommandReplaySubsystem_FixedDeltaTime, TEXT("Fixed time step to record with, in seconds."));
+
+float UMassCommandReplaySubsystem_HashCellSize = 100.f;
+FAutoConsoleVariableRef CVarUMassCommandReplaySubsystem_HashCellSize(TEXT("pm.UMassCommandReplaySubsystem_HashCellSize"), UMassCommandReplaySubsystem_HashCellSize, TEXT("Size of the cells that positions are quantized to in simulation state hashes, in cm."));
+
+static constexpr uint32 GMassCommandReplayMagic = 0x52434D50; // "PMCR"
+
+enum class EMassCommandReplayVersion : int32
+{
+	Initial = 1,
+
+	VersionPlusOne,
+	LatestVersion = VersionPlusOne - 1
+};
+
+//----------------------------------------------------------------------//
+//  FMassSimulationStateHash
+//----------------------------------------------------------------------//
+void FMassSimulationStateHash::AddEntity(const FVector& Location, const int16 Health, const float CellSize)
+{
+	const int32 Cell[3] = { FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize), FMath::FloorToInt(Location.Z / CellSize) };
+
+	NumEntities++;
+	TotalHealth += Health;
+	// Wrapping addition is commutative, so the order entities are added in doesn't matter.
+	PositionsHash += CityHash64(reinterpret_cast<const char*>(Cell), sizeof(Cell));
+}
+
+FMassSimulationStateHash FMassSimulationStateHash::Compute(UMassEntitySubsystem& EntitySubsystem, const float CellSize)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FMassSimulationStateHash.Compute);
+
+	FMassSimulationStateHash StateHash;
+
+	FMassEntityQuery EntityQuery;
+	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FMassHealthFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddTagRequirement<FMassPlayerControllableCharacterTag>(EMassFragmentPresence::None);
+	FMassExecutionContext Context(0.0f);
+
+	EntityQuery.ForEachEntityChunk(EntitySubsystem, Context, [&StateHash, CellSize](FMassExecutionContext& Context)
+	{
+		const TConstArrayView<FTransformFragment> TransformList = Context.GetFragmentView<FTransformFragment>();
+		const TConstArrayView<FMassHealthFragment> HealthList = Context.GetFragmentView<FMassHealthFragment>();
+		for (int32 EntityIndex = 0; EntityIndex < Context.GetNumEntities(); ++EntityIndex)
+		{
+			StateHash.AddEntity(TransformList[EntityIndex].GetTransform().GetLocation(), HealthList[EntityIndex].Value, CellSize);
+		}
+	});
+
+	return StateHash;
+}
+
+FString FMassSimulationStateHash::ToString() const
+{
+	return FString::Printf(TEXT("Entities=%d TotalHealth=%lld Positions=%016llx"), NumEntities, TotalHealth, PositionsHash);
+}
+
+FArchive& operator<<(FArchive& Ar, FMassCommandReplayEvent& Event)
+{
+	uint8 Type = static_cast<uint8>(Event.Type);
+	Ar << Event.Frame << Type << Event.TeamIndex << Event.bHasMilitaryUnit << Event.MilitaryUnitPath << Event.Target;
+	Event.Type = static_cast<EMassCommandReplayEventType>(Type);
+	return Ar;
+}
+
+static void StopCommandReplayRecording(UWorld* World)
+{
+	UMassCommandReplaySubsystem* CommandReplaySubsystem = UWorld::GetSubsystem<UMassCommandReplaySubsystem>(World);
+	if (CommandReplaySubsystem && CommandReplaySubsystem->IsRecording())
+	{
+		CommandReplaySubsystem->StopRecording();
+	}
+}
+
+static FAutoConsoleCommandWithWorld StopCommandReplayRecordingCmd(
+	TEXT("pm.StopCommandReplayRecording"),
+	TEXT("Stop recording the command replay started with pm.UMassCommandReplaySubsystem_Record and save it with the current simulation state hash."),
+	FConsoleCommandWithWorldDelegate::CreateStatic(StopCommandReplayRecording)
+);
+
+static void PrintSimulationStateHash(UWorld* World)
+{
+	if (UMassEntitySubsystem* EntitySubsystem = UWorld::GetSubsystem<UMassEntitySubsystem>(World))
+	{
+		UE_LOG(LogTemp, Log, TEXT("Simulation state hash: %s"), *FMassSimulationStateHash::Compute(*EntitySubsystem, UMassCommandReplaySubsystem_HashCellSize).ToString());
+	}
+}
+
+static FAutoConsoleCommandWithWorld PrintSimulationStateHashCmd(
+	TEXT("pm.PrintSimulationStateHash"),
+	TEXT("Log the entity count, total health and quantized positions hash of the Mass simulation."),
+	FConsoleCommandWithWorldDelegate::CreateStatic(PrintSimulationStateHash)
+);
+
+//----------------------------------------------------------------------//
+//  UMassCommandReplaySubsystem
+//----------------------------------------------------------------------//
+void UMassCommandReplaySubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	// Runs before actors begin play, so the fixed time step and seed are in place before spawners start spawning.
+	if (!UMassCommandReplaySubsystem_Play.IsEmpty())
+	{
+		StartPlaying(UMassCommandReplaySubsystem_Play);
+	}
+	else if (!UMassCommandReplaySubsystem_Record.IsEmpty())
+	{
+		StartRecording(UMassCommandReplaySubsystem_Record);
+	}
+
+	if (bIsRecording || bIsPlaying)
+	{
+		WorldBeginTearDownHandle = FWorldDelegates::OnWorldBeginTearDown.AddLambda([this](UWorld* World)
+		{
+			// Frame has already advanced past the last simulated frame.
+			if (World == GetWorld() && bIsRecording)
+			{
+				SaveRecording(Frame > 0 ? Frame - 1 : 0);
+			}
+		});
+	}
+}
+
+void UMassCommandReplaySubsystem::Deinitialize()
+{
+	if (WorldBeginTearDownHandle.IsValid())
+	{
+		FWorldDelegates::OnWorldBeginTearDown.Remove(WorldBeginTearDownHandle);
+		WorldBeginTearDownHandle.Reset();
+	}
+
+	if (bIsPlaying)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UMassCommandReplaySubsystem: Replay %s ended at frame %u before reaching its end frame %u."), *CurrentReplayName, Frame, EndFrame);
+	}
+
+	RestoreTimeStep();
+
+	Super::Deinitialize();
+}
+
+TStatId UMassCommandReplaySubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UMassCommandReplaySubsystem, STATGROUP_Tickables);
+}
+
+FString UMassCommandReplaySubsystem::GetReplayFilePath(const FString& ReplayName) const
+{
+	const FString MapName = UGameplayStatics::GetCurrentLevelName(GetWorld(), true);
+	return FPaths::ProjectSavedDir() / TEXT("CommandReplays") / MapName + TEXT("_") + ReplayName + TEXT(".replay");
+}
+
+void UMassCommandReplaySubsystem::UseFixedTimeStep()
+{
+	if (!bDidOverrideTimeStep)
+	{
+		bDidOverrideTimeStep = true;
+		bPreviousUseFixedTimeStep = FApp::UseFixedTimeStep();
+		PreviousFixedDeltaTime = FApp::GetFixedDeltaTime();
+	}
+
+	FApp::SetUseFixedTimeStep(true);
+	FApp::SetFixedDeltaTime(FixedDeltaTime);
+}
+
+void UMassCommandReplaySubsystem::RestoreTimeStep()
+{
+	if (bDidOverrideTimeStep)
+	{
+		bDidOverrideTimeStep = false;
+		FApp::SetUseFixedTimeStep(bPreviousUseFixedTimeStep);
+		FApp::SetFixedDeltaTime(PreviousFixedDeltaTime);
+	}
+}
+
+void UMassCommandReplaySubsystem::SeedRandomForSpawning() const
+{
+	if (bIsRecording || bIsPlaying)
+	{
+		FMath::RandInit(RandomSeed);
+		FMath::SRandInit(RandomSeed);
+	}
+}
+
+void UMassCommandReplaySubsystem::StartRecording(const FString& ReplayName)
+{
+	bIsRecording = true;
+	CurrentReplayName = ReplayName;
+	Frame = 0;
+	Events.Reset();
+	RandomSeed = UMassCommandReplaySubsystem_Seed != 0 ? UMassCommandReplaySubsystem_Seed : static_cast<int32>(FPlatformTime::Cycles());
+	FixedDeltaTime = UMassCommandReplaySubsystem_FixedDeltaTime;
+
+	UseFixedTimeStep();
+
+	UE_LOG(LogTemp, Log, TEXT("UMassCommandReplaySubsystem: Recording replay %s with seed %d."), *ReplayName, RandomSeed);
+}
+
+void UMassCommandReplaySubsystem::StopRecording()
+{
+	// Console commands run at the start of a frame, the recording ends at the end of it, which is where playback checks the state.
+	bIsStopRecordingRequested = true;
+}
+
+void UMassCommandReplaySubsystem::SaveRecording(const uint32 LastFrame)
+{
+	bIsRecording = false;
+	bIsStopRecordingRequested = false;
+	RestoreTimeStep();
+
+	UMassEntitySubsystem* EntitySubsystem = UWorld::GetSubsystem<UMassEntitySubsystem>(GetWorld());
+	check(EntitySubsystem);
+	FMassSimulationStateHash StateHash = FMassSimulationStateHash::Compute(*EntitySubsystem, UMassCommandReplaySubsystem_HashCellSize);
+
+	FBufferArchive Writer;
+	uint32 Magic = GMassCommandReplayMagic;
+	int32 Version = static_cast<int32>(EMassCommandReplayVersion::LatestVersion);
+	FString MapName = UGameplayStatics::GetCurrentLevelName(GetWorld(), true);
+	float HashCellSize = UMassCommandReplaySubsystem_HashCellSize;
+	uint32 EndFrameToWrite = LastFrame;
+	Writer << Magic << Version << MapName << RandomSeed << FixedDeltaTime << HashCellSize << Events << EndFrameToWrite << StateHash;
+
+	const FString FilePath = GetReplayFilePath(CurrentReplayName);
+	if (FFileHelper::SaveArrayToFile(Writer, *FilePath))
+	{
+		UE_LOG(LogTemp, Log, TEXT("UMassCommandReplaySubsystem: Saved replay %s with %d events ending at frame %u, %s."), *FilePath, Events.Num(), LastFrame, *StateHash.ToString());
+	}
+	else
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UMassCommandReplaySubsystem: Failed to save replay to %s."), *FilePath);
+	}
+}
+
+bool UMassCommandReplaySubsystem::StartPlaying(const FString& ReplayName)
+{
+	const FString FilePath = GetReplayFilePath(ReplayName);
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *FilePath))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UMassCommandReplaySubsystem: Failed to read replay %s."), *FilePath);
+		return false;
+	}
+
+	FMemoryReader Reader(Bytes);
+	uint32 Magic = 0;
+	int32 Version = 0;
+	FString MapName;
+	float HashCellSize = 0.f;
+	Reader << Magic << Version;
+	if (Magic != GMassCommandReplayMagic || Version != static_cast<int32>(EMassCommandReplayVersion::LatestVersion))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UMassCommandReplaySubsystem: Replay %s is not valid or was saved with a different version."), *FilePath);
+		return false;
+	}
+
+	Reader << MapName << RandomSeed << FixedDeltaTime << HashCellSize << Events << EndFrame << ExpectedStateHash;
+	if (Reader.IsError())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UMassCommandReplaySubsystem: Replay %s is truncated."), *FilePath);
+		return false;
+	}
+
+	bIsPlaying = true;
+	CurrentReplayName = ReplayName;
+	Frame = 0;
+	NextEventIndex = 0;
+	UMassCommandReplaySubsystem_HashCellSize = HashCellSize;
+
+	UseFixedTimeStep();
+
+	UE_LOG(LogTemp, Log, TEXT("UMassCommandReplaySubsystem: Playing replay %s with %d events until frame %u."), *ReplayName, Events.Num(), EndFrame);
+	return true;
+}
+
+void UMassCommandReplaySubsystem::FinishPlaying()
+{
+	bIsPlaying = false;
+	RestoreTimeStep();
+
+	UMassEntitySubsystem* EntitySubsystem = UWorld::GetSubsystem<UMassEntitySubsystem>(GetWorld());
+	check(EntitySubsystem);
+
+	const FMassSimulationStateHash StateHash = FMassSimulationStateHash::Compute(*EntitySubsystem, UMassCommandReplaySubsystem_HashCellSize);
+	const bool bMatches = StateHash == ExpectedStateHash;
+	if (bMatches)
+	{
+		UE_LOG(LogTemp, Log, TEXT("UMassCommandReplaySubsystem: Replay %s matches the recording at frame %u, %s."), *CurrentReplayName, Frame, *StateHash.ToString());
+	}
+	else
+	{
+		UE_LOG(LogTemp, Error, TEXT("UMassCommandReplaySubsystem: Replay %s differs from the recording at frame %u. Expected %s, got %s."), *CurrentReplayName, Frame, *ExpectedStateHash.ToString(), *StateHash.ToString());
+	}
+
+	if (UMassCommandReplaySubsystem_ExitWhenDone)
+	{
+		FPlatformMisc::RequestExitWithStatus(false, bMatches ? 0 : 1);
+	}
+}
+
+void UMassCommandReplaySubsystem::Tick(float DeltaTime)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UMassCommandReplaySubsystem.Tick);
+
+	if (bIsRecording)
+	{
+		UMassMoveToCommandSubsystem* MoveToCommandSubsystem = UWorld::GetSubsystem<UMassMoveToCommandSubsystem>(GetWorld());
+		for (const FMoveToCommand& MoveToCommand : PendingMoveToCommands)
+		{
+			RecordEvent(EMassCommandReplayEventType::MoveToCommand, MoveToCommand.MilitaryUnit, MoveToCommand.TeamIndex, MoveToCommand.Target);
+			MoveToCommandSubsystem->EnqueueMoveToCommand(MoveToCommand.MilitaryUnit, MoveToCommand.Target, MoveToCommand.TeamIndex);
+		}
+		PendingMoveToCommands.Reset();
+
+		if (bIsStopRecordingRequested)
+		{
+			SaveRecording(Frame);
+		}
+	}
+
+	if (bIsPlaying)
+	{
+		while (Events.IsValidIndex(NextEventIndex) && Events[NextEventIndex].Frame <= Frame)
+		{
+			PlayEvent(Events[NextEventIndex++]);
+		}
+
+		if (Frame == EndFrame)
+		{
+			FinishPlaying();
+		}
+	}
+
+	Frame++;
+}
+
+void UMassCommandReplaySubsystem::SubmitMoveToCommand(const UMilitaryUnit* MilitaryUnit, const FVector Target, const uint8 TeamIndex)
+{
+	if (bIsPlaying)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UMassCommandReplaySubsystem: Ignoring player move to command while playing a replay."));
+		return;
+	}
+
+	if (bIsRecording)
+	{
+		PendingMoveToCommands.Emplace(MilitaryUnit, Target, TeamIndex);
+		return;
+	}
+
+	UMassMoveToCommandSubsystem* MoveToCommandSubsystem = UWorld::GetSubsystem<UMassMoveToCommandSubsystem>(GetWorld());
+	check(MoveToCommandSubsystem);
+	MoveToCommandSubsystem->EnqueueMoveToCommand(MilitaryUnit, Target, TeamIndex);
+}
+
+void UMassCommandReplaySubsystem::RecordPossessSoldier(const UMilitaryUnit* SoldierMilitaryUnit, const uint8 TeamIndex)
+{
+	if (bIsRecording)
+	{
+		RecordEvent(EMassCommandReplayEventType::PossessSoldier, SoldierMilitaryUnit, TeamIndex);
+	}
+}
+
+void UMassCommandReplaySubsystem::RecordReleaseSoldier(const UMilitaryUnit* SoldierMilitaryUnit, const uint8 TeamIndex)
+{
+	if (bIsRecording)
+	{
+		RecordEvent(EMassCommandReplayEventType::ReleaseSoldier, SoldierMilitaryUnit, TeamIndex);
+	}
+}
+
+void UMassCommandReplaySubsystem::RecordEvent(const EMassCommandReplayEventType Type, const UMilitaryUnit* MilitaryUnit, const uint8 TeamIndex, const FVector& Target)
+{
+	FMassCommandReplayEvent& Event = Events.AddDefaulted_GetRef();
+	Event.Frame = Frame;
+	Event.Type = Type;
+	Event.TeamIndex = TeamIndex;
+	Event.Target = Target;
+
+	if (!MilitaryUnit)
+	{
+		return;
+	}
+
+	const UMilitaryUnit* Unit = MilitaryUnit;
+	while (Unit->Parent)
+	{
+		Event.MilitaryUnitPath.Insert(Unit->Parent->SubUnits.IndexOfByKey(Unit), 0);
+		Unit = Unit->Parent;
+	}
+
+	UMilitaryStructureSubsystem* MilitaryStructureSubsystem = UWorld::GetSubsystem<UMilitaryStructureSubsystem>(GetWorld());
+	Event.bHasMilitaryUnit = Unit == MilitaryStructureSubsystem->GetRootUnitForTeam(TeamIndex);
+	if (!Event.bHasMilitaryUnit)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UMassCommandReplaySubsystem: Recorded military unit %s isn't in team %d's hierarchy."), *MilitaryUnit->Name.ToString(), TeamIndex);
+		Event.MilitaryUnitPath.Reset();
+	}
+}
+
+UMilitaryUnit* UMassCommandReplaySubsystem::FindMilitaryUnit(const FMassCommandReplayEvent& Event) const
+{
+	UMilitaryStructureSubsystem* MilitaryStructureSubsystem = UWorld::GetSubsystem<UMilitaryStructureSubsystem>(GetWorld());
+	UMilitaryUnit* Unit = MilitaryStructureSubsystem->GetRootUnitForTeam(Event.TeamIndex);
+	for (const int32 SubUnitIndex : Event.MilitaryUnitPath)
+	{
+		if (!Unit || !Unit->SubUnits.IsValidIndex(SubUnitIndex))
+		{
+			return nullptr;
+		}
+		Unit = Unit->SubUnits[SubUnitIndex];
+	}
+	return Unit;
+}
+
+void UMassCommandReplaySubsystem::PlayEvent(const FMassCommandReplayEvent& Event)
+{
+	UMilitaryUnit* MilitaryUnit = Event.bHasMilitaryUnit ? FindMilitaryUnit(Event) : nullptr;
+	if (Event.bHasMilitaryUnit && !MilitaryUnit)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UMassCommandReplaySubsystem: Replay diverged, can't find military unit of event at frame %u."), Event.Frame);
+		return;
+	}
+
+	if (Event.Type == EMassCommandReplayEventType::MoveToCommand)
+	{
+		UMassMoveToCommandSubsystem* MoveToCommandSubsystem = UWorld::GetSubsystem<UMassMoveToCommandSubsystem>(GetWorld());
+		MoveToCommandSubsystem->EnqueueMoveToCommand(MilitaryUnit, Event.Target, Event.TeamIndex);
+		return;
+	}
+
+	ACommanderCharacter* CommanderCharacter = nullptr;
+	for (TActorIterator<ACommanderCharacter> It(GetWorld()); It; ++It)
+	{
+		if (It->GetPlayerTeamIndex() == Event.TeamIndex)
+		{
+			CommanderCharacter = *It;
+			break;
+		}
+	}
+
+	if (!CommanderCharacter || !MilitaryUnit)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UMassCommandReplaySubsystem: Can't replay possession swap at frame %u without a player and soldier on team %d."), Event.Frame, Event.TeamIndex);
+		return;
+	}
+
+	if (Event.Type == EMassCommandReplayEventType::ReleaseSoldier)
+	{
+		CommanderCharacter->ChangePlayerToAISoldier();
+	}
+	else
+	{
+		CommanderCharacter->PossessMassSoldierForReplay(MilitaryUnit->GetMassEntityHandle());
+	}
+}
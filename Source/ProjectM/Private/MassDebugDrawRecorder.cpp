@@ -0,0 +1,207 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#include "MassDebugDrawRecorder.h"
+
+#if WITH_PROJECTM_DEBUG_DRAW
+
+#include "DrawDebugHelpers.h"
+#include "Engine/World.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+
+bool DebugDrawRecorder_Replay = true;
+FAutoConsoleVariableRef CVarDebugDrawRecorder_Replay(TEXT("pm.DebugDrawRecorder_Replay"), DebugDrawRecorder_Replay, TEXT("Draw recorded debug primitives at the end of every frame. Turn off to only dump them."));
+
+FString DebugDrawRecorder_DumpFile;
+FAutoConsoleVariableRef CVarDebugDrawRecorder_DumpFile(TEXT("pm.DebugDrawRecorder_DumpFile"), DebugDrawRecorder_DumpFile, TEXT("If set, append every recorded debug primitive to this file, relative to the Saved directory."));
+
+FString FDebugDrawPrimitive::ToString() const
+{
+	static const TCHAR* const TypeNames[] = { TEXT("Line"), TEXT("Arrow"), TEXT("Point"), TEXT("Capsule"), TEXT("String") };
+	const UWorld* WorldPtr = World.Get();
+	return FString::Printf(TEXT("%s World=%s A=(%s) B=(%s) Size=%.2f Color=(%s) Persistent=%d LifeTime=%.2f Text=\"%s\""),
+		TypeNames[static_cast<uint8>(Type)], WorldPtr ? *WorldPtr->GetName() : TEXT("None"), *A.ToCompactString(), *B.ToCompactString(), Size,
+		*Color.ToString(), bPersistent ? 1 : 0, LifeTime, *Text);
+}
+
+namespace UE::ProjectM::DebugDraw
+{
+	// Only the owning thread records into a buffer, the lock is only contended while the game thread flushes it.
+	struct FThreadBuffer
+	{
+		FCriticalSection Lock;
+		TArray<FDebugDrawPrimitive> Primitives;
+		TArray<TFunction<void()>> Commands;
+	};
+
+	static FCriticalSection GThreadBuffersLock;
+	static TArray<TUniquePtr<FThreadBuffer>> GThreadBuffers;
+	static thread_local FThreadBuffer* GThreadBuffer = nullptr;
+	static uint64 GDebugDrawFrameCounter = 0;
+
+	static FThreadBuffer& GetThreadBuffer()
+	{
+		if (!GThreadBuffer)
+		{
+			FScopeLock ScopeLock(&GThreadBuffersLock);
+			GThreadBuffer = GThreadBuffers.Add_GetRef(MakeUnique<FThreadBuffer>()).Get();
+		}
+		return *GThreadBuffer;
+	}
+
+	static void Record(FDebugDrawPrimitive&& Primitive)
+	{
+		FThreadBuffer& ThreadBuffer = GetThreadBuffer();
+		FScopeLock ScopeLock(&ThreadBuffer.Lock);
+		ThreadBuffer.Primitives.Add(MoveTemp(Primitive));
+	}
+
+	static FDebugDrawPrimitive MakePrimitive(const UWorld* World, const EDebugDrawPrimitiveType Type, const FVector& A, const FVector& B, const float Size, const FColor& Color, const bool bPersistent, const float LifeTime)
+	{
+		FDebugDrawPrimitive Primitive;
+		Primitive.World = World;
+		Primitive.Type = Type;
+		Primitive.A = A;
+		Primitive.B = B;
+		Primitive.Size = Size;
+		Primitive.Color = Color;
+		Primitive.bPersistent = bPersistent;
+		Primitive.LifeTime = LifeTime;
+		return Primitive;
+	}
+
+	static void Replay(const FDebugDrawPrimitive& Primitive)
+	{
+		const UWorld* World = Primitive.World.Get();
+		if (!World)
+		{
+			return;
+		}
+
+		switch (Primitive.Type)
+		{
+		case EDebugDrawPrimitiveType::Line:
+			DrawDebugLine(World, Primitive.A, Primitive.B, Primitive.Color, Primitive.bPersistent, Primitive.LifeTime);
+			break;
+		case EDebugDrawPrimitiveType::Arrow:
+			DrawDebugDirectionalArrow(World, Primitive.A, Primitive.B, Primitive.Size, Primitive.Color, Primitive.bPersistent, Primitive.LifeTime);
+			break;
+		case EDebugDrawPrimitiveType::Point:
+			DrawDebugPoint(World, Primitive.A, Primitive.Size, Primitive.Color, Primitive.bPersistent, Primitive.LifeTime);
+			break;
+		case EDebugDrawPrimitiveType::Capsule:
+		{
+			const FVector Center = (Primitive.A + Primitive.B) / 2.f;
+			const float HalfHeight = (Primitive.B - Primitive.A).Size() / 2.f;
+			const FQuat Rotation = FRotationMatrix::MakeFromZ(Primitive.B - Primitive.A).ToQuat();
+			DrawDebugCapsule(World, Center, HalfHeight, Primitive.Size, Rotation, Primitive.Color, Primitive.bPersistent, Primitive.LifeTime);
+			break;
+		}
+		case EDebugDrawPrimitiveType::String:
+			DrawDebugString(World, Primitive.A, Primitive.Text, nullptr, Primitive.Color, Primitive.LifeTime);
+			break;
+		}
+	}
+} // namespace UE::ProjectM::DebugDraw
+
+void UE::ProjectM::DebugDraw::Line(const UWorld* World, const FVector& Start, const FVector& End, const FColor& Color, const bool bPersistent, const float LifeTime)
+{
+	Record(MakePrimitive(World, EDebugDrawPrimitiveType::Line, Start, End, 0.f, Color, bPersistent, LifeTime));
+}
+
+void UE::ProjectM::DebugDraw::Arrow(const UWorld* World, const FVector& Start, const FVector& End, const float ArrowSize, const FColor& Color, const bool bPersistent, const float LifeTime)
+{
+	Record(MakePrimitive(World, EDebugDrawPrimitiveType::Arrow, Start, End, ArrowSize, Color, bPersistent, LifeTime));
+}
+
+void UE::ProjectM::DebugDraw::Point(const UWorld* World, const FVector& Location, const float PointSize, const FColor& Color, const bool bPersistent, const float LifeTime)
+{
+	Record(MakePrimitive(World, EDebugDrawPrimitiveType::Point, Location, Location, PointSize, Color, bPersistent, LifeTime));
+}
+
+void UE::ProjectM::DebugDraw::Capsule(const UWorld* World, const FVector& Start, const FVector& End, const float Radius, const FColor& Color, const bool bPersistent, const float LifeTime)
+{
+	Record(MakePrimitive(World, EDebugDrawPrimitiveType::Capsule, Start, End, Radius, Color, bPersistent, LifeTime));
+}
+
+void UE::ProjectM::DebugDraw::String(const UWorld* World, const FVector& Location, const FString& Text, const FColor& Color, const float LifeTime)
+{
+	FDebugDrawPrimitive Primitive = MakePrimitive(World, EDebugDrawPrimitiveType::String, Location, Location, 0.f, Color, false, LifeTime);
+	Primitive.Text = Text;
+	Record(MoveTemp(Primitive));
+}
+
+void UE::ProjectM::DebugDraw::Command(TFunction<void()>&& Command)
+{
+	FThreadBuffer& ThreadBuffer = GetThreadBuffer();
+	FScopeLock ScopeLock(&ThreadBuffer.Lock);
+	ThreadBuffer.Commands.Add(MoveTemp(Command));
+}
+
+void UE::ProjectM::DebugDraw::Flush(TArray<FDebugDrawPrimitive>& OutPrimitives)
+{
+	check(IsInGameThread());
+
+	FScopeLock ThreadBuffersScopeLock(&GThreadBuffersLock);
+	for (const TUniquePtr<FThreadBuffer>& ThreadBuffer : GThreadBuffers)
+	{
+		FScopeLock ScopeLock(&ThreadBuffer->Lock);
+		OutPrimitives.Append(MoveTemp(ThreadBuffer->Primitives));
+		ThreadBuffer->Primitives.Reset();
+	}
+}
+
+void UE::ProjectM::DebugDraw::EndFrame()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UE.ProjectM.DebugDraw.EndFrame);
+
+	GDebugDrawFrameCounter++;
+
+	TArray<TFunction<void()>> Commands;
+	{
+		FScopeLock ThreadBuffersScopeLock(&GThreadBuffersLock);
+		for (const TUniquePtr<FThreadBuffer>& ThreadBuffer : GThreadBuffers)
+		{
+			FScopeLock ScopeLock(&ThreadBuffer->Lock);
+			Commands.Append(MoveTemp(ThreadBuffer->Commands));
+			ThreadBuffer->Commands.Reset();
+		}
+	}
+	for (const TFunction<void()>& Command : Commands)
+	{
+		Command();
+	}
+
+	TArray<FDebugDrawPrimitive> Primitives;
+	Flush(Primitives);
+	if (Primitives.Num() == 0)
+	{
+		return;
+	}
+
+	if (DebugDrawRecorder_Replay)
+	{
+		for (const FDebugDrawPrimitive& Primitive : Primitives)
+		{
+			Replay(Primitive);
+		}
+	}
+
+	if (!DebugDrawRecorder_DumpFile.IsEmpty())
+	{
+		FString Dump;
+		for (const FDebugDrawPrimitive& Primitive : Primitives)
+		{
+			Dump += FString::Printf(TEXT("%llu %s\n"), GDebugDrawFrameCounter, *Primitive.ToString());
+		}
+
+		const FString FilePath = FPaths::ProjectSavedDir() / DebugDrawRecorder_DumpFile;
+		if (!FFileHelper::SaveStringToFile(Dump, *FilePath, FFileHelper::EEncodingOptions::AutoDetect, &IFileManager::Get(), FILEWRITE_Append))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("DebugDrawRecorder: Failed to append debug primitives to %s."), *FilePath);
+		}
+	}
+}
+
+#endif // WITH_PROJECTM_DEBUG_DRAW
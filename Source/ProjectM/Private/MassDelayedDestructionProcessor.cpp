@@ -2,6 +2,11 @@
 
 
 #include "MassDelayedDestructionProcessor.h"
+#include "MassCommonFragments.h"
+#include "MassVisualEffectsSubsystem.h"
+#include "MassDelayedDestructionSubsystem.h"
+#include "MassBattlefieldClutterSubsystem.h"
+#include "MassEntityView.h"
 
 //----------------------------------------------------------------------//
 //  UMassDelayedDestructionTrait
@@ -12,6 +17,44 @@ void UMassDelayedDestructionTrait::BuildTemplate(FMassEntityTemplateBuildContext
 	DelayedDestructionFragment.SecondsLeftTilDestruction = SecondsDelay;
 }
 
+//----------------------------------------------------------------------//
+//  UMassDelayedDestructionInitializer
+//----------------------------------------------------------------------//
+UMassDelayedDestructionInitializer::UMassDelayedDestructionInitializer()
+{
+	ObservedType = FMassDelayedDestructionFragment::StaticStruct();
+	Operation = EMassObservedOperation::Add;
+	ExecutionFlags = (int32)EProcessorExecutionFlags::All;
+}
+
+void UMassDelayedDestructionInitializer::ConfigureQueries()
+{
+	EntityQuery.AddRequirement<FMassDelayedDestructionFragment>(EMassFragmentAccess::ReadWrite);
+}
+
+void UMassDelayedDestructionInitializer::Initialize(UObject& Owner)
+{
+	Super::Initialize(Owner);
+
+	DelayedDestructionSubsystem = UWorld::GetSubsystem<UMassDelayedDestructionSubsystem>(Owner.GetWorld());
+}
+
+void UMassDelayedDestructionInitializer::Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context)
+{
+	check(DelayedDestructionSubsystem);
+
+	EntityQuery.ForEachEntityChunk(EntitySubsystem, Context, [this](FMassExecutionContext& Context)
+	{
+		const int32 NumEntities = Context.GetNumEntities();
+		const TArrayView<FMassDelayedDestructionFragment> DelayedDestructionList = Context.GetMutableFragmentView<FMassDelayedDestructionFragment>();
+
+		for (int32 EntityIndex = 0; EntityIndex < NumEntities; ++EntityIndex)
+		{
+			DelayedDestructionSubsystem->Schedule(Context.GetEntity(EntityIndex), DelayedDestructionList[EntityIndex]);
+		}
+	});
+}
+
 //----------------------------------------------------------------------//
 //  UMassDelayedDestructionProcessor
 //----------------------------------------------------------------------//
@@ -20,32 +63,72 @@ UMassDelayedDestructionProcessor::UMassDelayedDestructionProcessor()
 	bAutoRegisterWithProcessingPhases = true;
 	ExecutionFlags = (int32)EProcessorExecutionFlags::All;
 	ProcessingPhase = EMassProcessingPhase::PostPhysics;
+
+	// The timing wheel is also written by UMassDelayedDestructionInitializer and UMassVisualEffectsSubsystem on the game thread.
+	bRequiresGameThreadExecution = true;
 }
 
 void UMassDelayedDestructionProcessor::ConfigureQueries()
 {
-	EntityQuery.AddRequirement<FMassDelayedDestructionFragment>(EMassFragmentAccess::ReadWrite);
+}
+
+void UMassDelayedDestructionProcessor::Initialize(UObject& Owner)
+{
+	Super::Initialize(Owner);
+
+	VisualEffectsSubsystem = UWorld::GetSubsystem<UMassVisualEffectsSubsystem>(Owner.GetWorld());
+	DelayedDestructionSubsystem = UWorld::GetSubsystem<UMassDelayedDestructionSubsystem>(Owner.GetWorld());
+	BattlefieldClutterSubsystem = UWorld::GetSubsystem<UMassBattlefieldClutterSubsystem>(Owner.GetWorld());
 }
 
 void UMassDelayedDestructionProcessor::Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context)
 {
-	UWorld* World = EntitySubsystem.GetWorld();
-	float DeltaTimeSeconds = World->DeltaTimeSeconds;
+	TRACE_CPUPROFILER_EVENT_SCOPE(UMassDelayedDestructionProcessor);
 
-	EntityQuery.ForEachEntityChunk(EntitySubsystem, Context, [DeltaTimeSeconds](FMassExecutionContext& Context)
+	check(DelayedDestructionSubsystem);
+
+	ExpiredEntities.Reset();
+	DelayedDestructionSubsystem->Advance(EntitySubsystem.GetWorld()->DeltaTimeSeconds, ExpiredEntities);
+
+	EntitiesToDestroy.Reset();
+	const int64 CurrentTick = DelayedDestructionSubsystem->GetCurrentTick();
+	for (const FMassEntityHandle Entity : ExpiredEntities)
 	{
-		const int32 NumEntities = Context.GetNumEntities();
+		// Entities can already be destroyed by others (e.g. when a world snapshot is loaded) or rescheduled (pooled visual effects reused while
+		// their spawn time schedule was pending).
+		if (!EntitySubsystem.IsEntityValid(Entity))
+		{
+			continue;
+		}
 
-		const TArrayView<FMassDelayedDestructionFragment> DelayedDestructionList = Context.GetMutableFragmentView<FMassDelayedDestructionFragment>();
+		const FMassEntityView EntityView(EntitySubsystem, Entity);
+		const FMassDelayedDestructionFragment* DelayedDestructionFragment = EntityView.GetFragmentDataPtr<FMassDelayedDestructionFragment>();
+		FMassPooledVisualEffectFragment* PooledFragment = EntityView.GetFragmentDataPtr<FMassPooledVisualEffectFragment>();
+		if (!DelayedDestructionFragment || DelayedDestructionFragment->ExpirationTick > CurrentTick || (PooledFragment && PooledFragment->bIsDormant))
+		{
+			continue;
+		}
 
-		for (int32 EntityIndex = 0; EntityIndex < NumEntities; ++EntityIndex)
+		// Pooled visual effects go dormant and back to their pool instead of being destroyed.
+		FTransformFragment* TransformFragment = EntityView.GetFragmentDataPtr<FTransformFragment>();
+		if (VisualEffectsSubsystem && TransformFragment && PooledFragment)
 		{
-			FMassDelayedDestructionFragment& DelayedDestructionFragment = DelayedDestructionList[EntityIndex];
-			DelayedDestructionFragment.SecondsLeftTilDestruction -= DeltaTimeSeconds;
-			if (DelayedDestructionFragment.SecondsLeftTilDestruction <= 0.f)
+			TransformFragment->GetMutableTransform().SetLocation(UMassVisualEffectsSubsystem::DormantLocation);
+			PooledFragment->bIsDormant = true;
+			VisualEffectsSubsystem->ReleaseEntity(Entity);
+		}
+		else
+		{
+			if (BattlefieldClutterSubsystem && EntityView.HasTag<FMassBecomesClutterOnDestructionTag>())
 			{
-				Context.Defer().DestroyEntity(Context.GetEntity(EntityIndex));
+				BattlefieldClutterSubsystem->AddEntity(EntityView);
 			}
+			EntitiesToDestroy.Add(Entity);
 		}
-	});
+	}
+
+	if (EntitiesToDestroy.Num() > 0)
+	{
+		Context.Defer().DestroyEntities(EntitiesToDestroy);
+	}
 }
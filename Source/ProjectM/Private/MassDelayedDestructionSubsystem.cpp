@@ -0,0 +1,95 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#include "MassDelayedDestructionSubsystem.h"
+#include "MassDelayedDestructionProcessor.h"
+
+//----------------------------------------------------------------------//
+//  FMassTimingWheel
+//----------------------------------------------------------------------//
+FMassTimingWheel::FMassTimingWheel(const int32 InNumSlots, const float InTickDuration)
+	: TickDuration(InTickDuration)
+{
+	check(InNumSlots > 0 && InTickDuration > 0.f);
+	Slots.SetNum(InNumSlots);
+}
+
+int64 FMassTimingWheel::Schedule(const FMassEntityHandle Entity, const float Delay)
+{
+	const int64 NumTicks = FMath::Max(1ll, (int64)FMath::CeilToDouble((TimeSinceCurrentTick + Delay) / TickDuration));
+	const int64 Tick = CurrentTick + NumTicks;
+	if (NumTicks <= Slots.Num())
+	{
+		AddToSlot(Entity, Tick);
+	}
+	else
+	{
+		Overflow.Add({ Entity, Tick });
+	}
+	NumScheduled++;
+
+	return Tick;
+}
+
+void FMassTimingWheel::AddToSlot(const FMassEntityHandle Entity, const int64 Tick)
+{
+	Slots[(int32)(Tick % Slots.Num())].Add(Entity);
+}
+
+void FMassTimingWheel::Advance(const float DeltaTime, TArray<FMassEntityHandle>& OutExpiredEntities)
+{
+	TimeSinceCurrentTick += DeltaTime;
+	while (TimeSinceCurrentTick >= TickDuration)
+	{
+		TimeSinceCurrentTick -= TickDuration;
+		CurrentTick++;
+
+		const int32 SlotIndex = (int32)(CurrentTick % Slots.Num());
+		TArray<FMassEntityHandle>& Slot = Slots[SlotIndex];
+		OutExpiredEntities.Append(Slot);
+		NumScheduled -= Slot.Num();
+		Slot.Reset();
+
+		// Once per turn, overflow entries that expire within the next turn move into their slot. The current slot was drained first, as it now
+		// stands for the tick one turn ahead.
+		if (SlotIndex == 0)
+		{
+			for (int32 OverflowIndex = Overflow.Num() - 1; OverflowIndex >= 0; OverflowIndex--)
+			{
+				const FOverflowEntry& Entry = Overflow[OverflowIndex];
+				if (Entry.Tick - CurrentTick <= Slots.Num())
+				{
+					AddToSlot(Entry.Entity, Entry.Tick);
+					Overflow.RemoveAtSwap(OverflowIndex, 1, false);
+				}
+			}
+		}
+	}
+}
+
+void FMassTimingWheel::Reset()
+{
+	for (TArray<FMassEntityHandle>& Slot : Slots)
+	{
+		Slot.Reset();
+	}
+	Overflow.Reset();
+	TimeSinceCurrentTick = 0.f;
+	CurrentTick = 0;
+	NumScheduled = 0;
+}
+
+//----------------------------------------------------------------------//
+//  UMassDelayedDestructionSubsystem
+//----------------------------------------------------------------------//
+void UMassDelayedDestructionSubsystem::Schedule(const FMassEntityHandle Entity, FMassDelayedDestructionFragment& DelayedDestructionFragment)
+{
+	check(IsInGameThread());
+	DelayedDestructionFragment.ExpirationTick = TimingWheel.Schedule(Entity, DelayedDestructionFragment.SecondsLeftTilDestruction);
+}
+
+void UMassDelayedDestructionSubsystem::Deinitialize()
+{
+	TimingWheel.Reset();
+
+	Super::Deinitialize();
+}
@@ -8,13 +8,20 @@
 #include "MassLODTypes.h"
 #include "MassCommonFragments.h"
 #include "MassTrackTargetProcessor.h"
-#include "Kismet/KismetSystemLibrary.h"
 #include "MassProjectileDamageProcessor.h"
 #include <MassNavigationTypes.h>
 #include "MassMoveTargetForwardCompleteProcessor.h"
 #include "InvalidTargetFinderProcessor.h"
 #include "MassRepresentationTypes.h"
 #include "MassTargetGridProcessors.h"
+#include "MassStaticOccluderSubsystem.h"
+#include "MassTraceContextSubsystem.h"
+#include "MassTickTierTrait.h"
+#include "MassTrackedVehicleOrientationProcessor.h"
+#include "MassProcessorBudgetSubsystem.h"
+#include "ProjectMStats.h"
+#include "ProjectMCustomVersion.h"
+#include "MassDebugDrawRecorder.h"
 
 const FVector& GetEntityLocationViaTargetFinderSubsystem(const FMassEntityHandle& Entity, const UMassTargetFinderSubsystem& TargetFinderSubsystem)
 {
@@ -23,8 +30,8 @@ const FVector& GetEntityLocationViaTargetFinderSubsystem(const FMassEntityHandle
 
 struct FPotentialTargetSphereTraceData
 {
-	FPotentialTargetSphereTraceData(FMassEntityHandle InEntity, FMassEntityHandle InTargetEntity, FVector InTraceStart, FVector InTraceEnd, float InMinCaliberForDamage, FVector InLocation, bool bInIsSoldier)
-		: Entity(InEntity), TargetEntity(InTargetEntity), TraceStart(InTraceStart), TraceEnd(InTraceEnd), MinCaliberForDamage(InMinCaliberForDamage), Location(InLocation), bIsSoldier(bInIsSoldier)
+	FPotentialTargetSphereTraceData(FMassEntityHandle InEntity, FMassEntityHandle InTargetEntity, FVector InTraceStart, FVector InTraceEnd, float InMinCaliberForDamage, FVector InLocation, bool bInIsSoldier, uint32 InHostileTeamsMask, float InEntityMinCaliberForDamage)
+		: Entity(InEntity), TargetEntity(InTargetEntity), TraceStart(InTraceStart), TraceEnd(InTraceEnd), MinCaliberForDamage(InMinCaliberForDamage), Location(InLocation), bIsSoldier(bInIsSoldier), HostileTeamsMask(InHostileTeamsMask), EntityMinCaliberForDamage(InEntityMinCaliberForDamage)
 	{
 	}
 
@@ -37,15 +44,56 @@ struct FPotentialTargetSphereTraceData
 	float MinCaliberForDamage;
 	FVector Location;
 	bool bIsSoldier;
+
+	// Of the entity searching for a target, used to filter which other entities block the line of fire.
+	uint32 HostileTeamsMask;
+	float EntityMinCaliberForDamage;
 };
 
 //----------------------------------------------------------------------//
 //  UMassTeamMemberTrait
 //----------------------------------------------------------------------//
+uint32 GetHostileTeamsMask(const uint8 TeamIndex, const TArray<uint8>& AlliedTeamIndices)
+{
+	uint32 HostileTeamsMask = ~GetTeamMask(TeamIndex);
+	for (const uint8 AlliedTeamIndex : AlliedTeamIndices)
+	{
+		HostileTeamsMask &= ~GetTeamMask(AlliedTeamIndex);
+	}
+	return HostileTeamsMask;
+}
+
 void UMassTeamMemberTrait::BuildTemplate(FMassEntityTemplateBuildContext& BuildContext, UWorld& World) const
 {
 	FTeamMemberFragment& TeamMemberTemplate = BuildContext.AddFragment_GetRef<FTeamMemberFragment>();
-	TeamMemberTemplate.IsOnTeam1 = IsOnTeam1;
+	TeamMemberTemplate.TeamIndex = TeamIndex;
+
+	UMassEntitySubsystem* EntitySubsystem = UWorld::GetSubsystem<UMassEntitySubsystem>(&World);
+	check(EntitySubsystem);
+
+	FTeamHostilityParameters HostilityParameters;
+	HostilityParameters.TeamMask = GetTeamMask(TeamIndex);
+	HostilityParameters.HostileTeamsMask = GetHostileTeamsMask(TeamIndex, AlliedTeamIndices);
+	const FConstSharedStruct HostilityFragment = EntitySubsystem->GetOrCreateConstSharedFragment(UE::StructUtils::GetStructCrc32(FConstStructView::Make(HostilityParameters)), HostilityParameters);
+	BuildContext.AddConstSharedFragment(HostilityFragment);
+}
+
+void UMassTeamMemberTrait::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+
+	Ar.UsingCustomVersion(FProjectMCustomVersion::GUID);
+}
+
+void UMassTeamMemberTrait::PostLoad()
+{
+	Super::PostLoad();
+
+	// Assets saved before N-team support only stored whether the entity was on team 1 (defaulting to team 1).
+	if (GetLinkerCustomVersion(FProjectMCustomVersion::GUID) < FProjectMCustomVersion::TeamIndexReplacesTeam1Flag)
+	{
+		TeamIndex = IsOnTeam1_DEPRECATED ? 0 : 1;
+	}
 }
 
 //----------------------------------------------------------------------//
@@ -79,11 +127,17 @@ void UMassEnemyTargetFinderProcessor::ConfigureQueries()
 	BaseEntityQuery.AddTagRequirement<FMassNeedsEnemyTargetTag>(EMassFragmentPresence::All);
 
 	PreSphereTraceEntityQuery = BaseEntityQuery;
-	PreSphereTraceEntityQuery.AddRequirement<FTeamMemberFragment>(EMassFragmentAccess::ReadOnly);
+	PreSphereTraceEntityQuery.AddConstSharedRequirement<FTeamHostilityParameters>(EMassFragmentPresence::All);
+	PreSphereTraceEntityQuery.AddChunkRequirement<FMassTickTierChunkFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
+	PreSphereTraceEntityQuery.SetChunkFilter(&FMassTickTierChunkFragment::ShouldTickChunkThisFrame);
 
 	PostSphereTraceEntityQuery = BaseEntityQuery;
+	PostSphereTraceEntityQuery.AddRequirement<FMassTurretFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
 }
 
+float UMassEnemyTargetFinderProcessor_BudgetMs = 2.f;
+FAutoConsoleVariableRef CVarUMassEnemyTargetFinderProcessor_BudgetMs(TEXT("pm.UMassEnemyTargetFinderProcessor_BudgetMs"), UMassEnemyTargetFinderProcessor_BudgetMs, TEXT("Frame time budget for target searches and their sphere traces. Entities over budget search on a later frame. 0 disables the budget."));
+
 void UMassEnemyTargetFinderProcessor::Initialize(UObject& Owner)
 {
 	Super::Initialize(Owner);
@@ -108,100 +162,28 @@ FCapsule GetProjectileTraceCapsuleToTarget(const bool bIsEntitySoldier, const bo
 	return FCapsule(ProjectileSpawnLocation, ProjectileTargetLocation, ProjectileRadius);
 }
 
-void GetSearchPointsAlongTrace(const FCapsule& ProjectileTraceCapsule, TArray<FVector>& OutSearchPoints)
-{
-	static constexpr float DistanceBetweenPoints = 1000.f; // 10m
-
-	TRACE_CPUPROFILER_EVENT_SCOPE(UMassEnemyTargetFinderProcessor.GetSearchPointsAlongTrace);
-
-	const int32 NumPoints = FMath::CeilToInt((ProjectileTraceCapsule.b - ProjectileTraceCapsule.a).Size() / DistanceBetweenPoints) + 1;
-	OutSearchPoints.Reserve(NumPoints);
-
-	const FVector& NormalVector = (ProjectileTraceCapsule.b - ProjectileTraceCapsule.a).GetSafeNormal();
-
-	for (int32 i = 0; i < NumPoints; i++)
-	{
-		OutSearchPoints.Add(ProjectileTraceCapsule.a + NormalVector * i * DistanceBetweenPoints);
-	}
-}
-
-bool AreEntitiesBlockingTarget(const FCapsule& ProjectileTraceCapsule, const FMassEntityHandle& Entity, const FMassEntityHandle& TargetEntity, const UWorld& World, const UMassTargetFinderSubsystem& TargetFinderSubsystem)
+bool IsTargetEntityVisibleViaSphereTrace(const UWorld& World, const FVector& StartLocation, const FVector& EndLocation, const bool DrawTrace)
 {
-	TRACE_CPUPROFILER_EVENT_SCOPE(UMassEnemyTargetFinderProcessor.AreEntitiesBlockingTarget);
-
-	TArray<FVector> SearchPoints;
-	GetSearchPointsAlongTrace(ProjectileTraceCapsule, SearchPoints);
-
-	bool bDidAnyCapsulesCollide(false);
-	{
-		TRACE_CPUPROFILER_EVENT_SCOPE(UMassEnemyTargetFinderProcessor.AreEntitiesBlockingTarget.For);
-		for (int32 i = 0; i < SearchPoints.Num() - 1; i++)
-		{
-			TRACE_CPUPROFILER_EVENT_SCOPE(UMassEnemyTargetFinderProcessor.AreEntitiesBlockingTarget.ForBody);
-
-			const FVector& SearchBoxStart = SearchPoints[i];
-			const FVector& SearchBoxEnd = SearchPoints[i + 1];
-			const FBox SearchBounds(SearchBoxStart.ComponentMin(SearchBoxEnd), SearchBoxStart.ComponentMax(SearchBoxEnd));
-
-			TArray<FMassTargetGridItem> EntitiesInSearchBox;
-			EntitiesInSearchBox.Reserve(5);
-
-			{
-				TRACE_CPUPROFILER_EVENT_SCOPE(UMassEnemyTargetFinderProcessor.AreEntitiesBlockingTarget.ForBody.TargetGridQuery);
-				TargetFinderSubsystem.GetTargetGrid().Query(SearchBounds, EntitiesInSearchBox);
-			}
-
-			for (const FMassTargetGridItem& TargetGridItem : EntitiesInSearchBox)
-			{
-				if (TargetGridItem.Entity == Entity || TargetGridItem.Entity == TargetEntity)
-				{
-					continue;
-				}
-				const FCapsule& TargetGridItemCapsule = TargetFinderSubsystem.GetTargetDynamicData()[TargetGridItem.Entity].Capsule;
-				if (DidCapsulesCollide(ProjectileTraceCapsule, TargetGridItemCapsule, Entity, World))
-				{
-					bDidAnyCapsulesCollide = true;
-					break;
-				}
-			}
-
-			if (bDidAnyCapsulesCollide)
-			{
-				break;
-			}
-		}
-	}
+	TRACE_CPUPROFILER_EVENT_SCOPE(UMassEnemyTargetFinderProcessor_IsTargetEntityVisibleViaSphereTrace);
+	static constexpr float Radius = 20.f; // TODO: don't hard-code
 
-#if WITH_MASSGAMEPLAY_DEBUG
-	if (UE::Mass::Debug::IsDebuggingEntity(Entity) && bDidAnyCapsulesCollide)
+	const UMassStaticOccluderSubsystem* StaticOccluderSubsystem = World.GetSubsystem<UMassStaticOccluderSubsystem>();
+	const EStaticOcclusionResult StaticOcclusionResult = StaticOccluderSubsystem ? StaticOccluderSubsystem->Raycast(StartLocation, EndLocation, Radius) : EStaticOcclusionResult::Unknown;
+	// The field only knows static geometry, so a clear answer still needs the physics trace for movable blockers.
+	if (StaticOcclusionResult == EStaticOcclusionResult::Blocked && !DrawTrace)
 	{
-		AsyncTask(ENamedThreads::GameThread, [&World, TargetEntity]()
-		{
-			UMassEnemyTargetFinderProcessor_DebugEntityData.TargetEntitiesCulledDueToOtherEntityBlocking.Add(GetEntityLocationViaTargetFinderSubsystem(TargetEntity, *UWorld::GetSubsystem<UMassTargetFinderSubsystem>(&World)));
-		});
+		return false;
 	}
-#endif
 
-	return bDidAnyCapsulesCollide;
-}
-
-bool IsTargetEntityVisibleViaSphereTrace(const UWorld& World, const FVector& StartLocation, const FVector& EndLocation, const bool DrawTrace)
-{
-	TRACE_CPUPROFILER_EVENT_SCOPE(UMassEnemyTargetFinderProcessor_IsTargetEntityVisibleViaSphereTrace);
-	FHitResult Result;
-	static constexpr float Radius = 20.f; // TODO: don't hard-code
-	const bool bFoundBlockingHit = UKismetSystemLibrary::SphereTraceSingle(World.GetLevel(0)->Actors[0], StartLocation, EndLocation, Radius, TraceTypeQuery1, false, TArray<AActor*>(), EDrawDebugTrace::Type::None, Result, false);
+	const UMassTraceContextSubsystem* TraceContextSubsystem = World.GetSubsystem<UMassTraceContextSubsystem>();
+	check(TraceContextSubsystem);
+	const bool bFoundBlockingHit = TraceContextSubsystem->SphereTraceTest(World, StartLocation, EndLocation, Radius);
 
 #if WITH_MASSGAMEPLAY_DEBUG
-	// We can't use SphereTraceSingle's ability to draw trace because this function may run in a background thread which isn't allowed to draw. So we do it ourselves async.
+	// We can't use SphereTraceSingle's ability to draw trace because this function may run in a background thread which isn't allowed to draw. So we record it for the game thread.
 	if (DrawTrace)
 	{
-		AsyncTask(ENamedThreads::GameThread, [StartLocation, EndLocation, Radius = Radius, &World, bFoundBlockingHit]()
-		{
-			const FLinearColor& Color = bFoundBlockingHit ? FLinearColor::Red : FLinearColor::Green;
-			FCapsule Capsule(StartLocation, EndLocation, Radius);
-			DrawCapsule(Capsule, World, Color, false, 0.1f);
-		});
+		DrawCapsule(FCapsule(StartLocation, EndLocation, Radius), World, bFoundBlockingHit ? FLinearColor::Red : FLinearColor::Green, false, 0.1f);
 	}
 #endif
 
@@ -250,7 +232,7 @@ bool IsValidVector(const FVector& Vector)
 	return !bHasAnyInvalidComponents;
 }
 
-void GetPotentialTargetSphereTraces(const FMassEntityHandle& Entity, const UMassEntitySubsystem& EntitySubsystem, const UMassTargetFinderSubsystem& TargetFinderSubsystem, const FTransform& EntityTransform, const bool& IsEntityOnTeam1, const FTargetEntityFragment& TargetEntityFragment, const bool bIsEntitySoldier, TQueue<FPotentialTargetSphereTraceData, EQueueMode::Mpsc>& OutPotentialTargetsNeedingSphereTrace)
+void GetPotentialTargetSphereTraces(const FMassEntityHandle& Entity, const UMassEntitySubsystem& EntitySubsystem, const UMassTargetFinderSubsystem& TargetFinderSubsystem, const FTransform& EntityTransform, const uint32 HostileTeamsMask, const FTargetEntityFragment& TargetEntityFragment, const bool bIsEntitySoldier, TQueue<FPotentialTargetSphereTraceData, EQueueMode::Mpsc>& OutPotentialTargetsNeedingSphereTrace)
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(UMassEnemyTargetFinderProcessor.GetPotentialTargetSphereTraces);
 
@@ -273,6 +255,8 @@ void GetPotentialTargetSphereTraces(const FMassEntityHandle& Entity, const UMass
 		TRACE_CPUPROFILER_EVENT_SCOPE(UMassEnemyTargetFinderProcessor.GetPotentialTargetSphereTraces.TargetGridQuery);
 		TargetFinderSubsystem.GetTargetGrid().Query(SearchBounds, CloseEntities);
 	}
+	UE::ProjectM::Stats::Add(EProjectMStat::TargetGridQueries);
+	UE::ProjectM::Stats::Add(EProjectMStat::TargetGridQueryCandidates, CloseEntities.Num());
 
 	int32 NumPotentialTargetsNeedingSphereTraceEnqueued = 0;
 
@@ -299,8 +283,8 @@ void GetPotentialTargetSphereTraces(const FMassEntityHandle& Entity, const UMass
 				continue;
 			}
 
-			// Skip same team.
-			if (IsEntityOnTeam1 == OtherEntity.bIsOnTeam1) {
+			// Skip teams we're not hostile to.
+			if ((HostileTeamsMask & OtherEntity.TeamMask) == 0) {
 #if WITH_MASSGAMEPLAY_DEBUG
 				if (UE::Mass::Debug::IsDebuggingEntity(Entity))
 				{
@@ -338,7 +322,7 @@ void GetPotentialTargetSphereTraces(const FMassEntityHandle& Entity, const UMass
 
 			if (IsValidVector(ProjectileTraceCapsule.a) && IsValidVector(ProjectileTraceCapsule.b))
 			{
-				OutPotentialTargetsNeedingSphereTrace.Enqueue(FPotentialTargetSphereTraceData(Entity, OtherEntity.Entity, ProjectileTraceCapsule.a, ProjectileTraceCapsule.b, OtherEntity.MinCaliberForDamage, OtherEntityLocation, OtherEntity.bIsSoldier));
+				OutPotentialTargetsNeedingSphereTrace.Enqueue(FPotentialTargetSphereTraceData(Entity, OtherEntity.Entity, ProjectileTraceCapsule.a, ProjectileTraceCapsule.b, OtherEntity.MinCaliberForDamage, OtherEntityLocation, OtherEntity.bIsSoldier, HostileTeamsMask, TargetEntityFragment.TargetMinCaliberForDamage));
 				NumPotentialTargetsNeedingSphereTraceEnqueued++;
 			}
 			else
@@ -351,7 +335,7 @@ void GetPotentialTargetSphereTraces(const FMassEntityHandle& Entity, const UMass
 #if WITH_MASSGAMEPLAY_DEBUG
 	if (UE::Mass::Debug::IsDebuggingEntity(Entity))
 	{
-		AsyncTask(ENamedThreads::GameThread, [EntityLocation, SearchCenter, SearchExtent, World, NumCloseEntities = CloseEntities.Num(), NumPotentialTargetsNeedingSphereTraceEnqueued, TargetEntitiesCulledDueToSameTeam, TargetEntitiesCulledDueToImpenetrable, TargetEntitiesCulledDueToOutOfRange]()
+		UE::ProjectM::DebugDraw::Command([EntityLocation, SearchCenter, SearchExtent, World, NumCloseEntities = CloseEntities.Num(), NumPotentialTargetsNeedingSphereTraceEnqueued, TargetEntitiesCulledDueToSameTeam, TargetEntitiesCulledDueToImpenetrable, TargetEntitiesCulledDueToOutOfRange]()
 		{
 			UMassEnemyTargetFinderProcessor_DebugEntityData.IsEntitySearching = true;
 			UMassEnemyTargetFinderProcessor_DebugEntityData.EntityLocation = EntityLocation;
@@ -372,12 +356,12 @@ float GetProjectileInitialXYVelocityMagnitude(const bool bIsEntitySoldier)
 	return bIsEntitySoldier ? 90525.6f : 10000.f; // TODO: make this configurable in data asset and get from there?
 }
 
-void ProcessEntityForVisualTarget(FMassEntityHandle Entity, const UMassEntitySubsystem& EntitySubsystem, const FTransformFragment& TransformFragment, const FTargetEntityFragment& TargetEntityFragment, const bool IsEntityOnTeam1, const UMassTargetFinderSubsystem& TargetFinderSubsystem, const bool bIsEntitySoldier, TQueue<FPotentialTargetSphereTraceData, EQueueMode::Mpsc>& PotentialTargetsNeedingSphereTrace)
+void ProcessEntityForVisualTarget(FMassEntityHandle Entity, const UMassEntitySubsystem& EntitySubsystem, const FTransformFragment& TransformFragment, const FTargetEntityFragment& TargetEntityFragment, const uint32 HostileTeamsMask, const UMassTargetFinderSubsystem& TargetFinderSubsystem, const bool bIsEntitySoldier, TQueue<FPotentialTargetSphereTraceData, EQueueMode::Mpsc>& PotentialTargetsNeedingSphereTrace)
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(UMassEnemyTargetFinderProcessor.ProcessEntityForVisualTarget);
 
 	const FTransform& EntityTransform = TransformFragment.GetTransform();
-	GetPotentialTargetSphereTraces(Entity, EntitySubsystem, TargetFinderSubsystem, EntityTransform, IsEntityOnTeam1, TargetEntityFragment, bIsEntitySoldier, PotentialTargetsNeedingSphereTrace);
+	GetPotentialTargetSphereTraces(Entity, EntitySubsystem, TargetFinderSubsystem, EntityTransform, HostileTeamsMask, TargetEntityFragment, bIsEntitySoldier, PotentialTargetsNeedingSphereTrace);
 }
 
 bool UMassEnemyTargetFinderProcessor_UseParallelForEachEntityChunk = true;
@@ -388,8 +372,8 @@ FAutoConsoleVariableRef CVarUMassEnemyTargetFinderProcessor_SkipUpdatingTargetEn
 
 struct FProcessSphereTracesContext
 {
-	FProcessSphereTracesContext(TQueue<FPotentialTargetSphereTraceData, EQueueMode::Mpsc>& PotentialTargetsNeedingSphereTraceQueue, UWorld& World, TMap<FMassEntityHandle, TArray<FPotentialTarget>>& OutEntityToPotentialTargetEntities, const UMassTargetFinderSubsystem& TargetFinderSubsystem)
-		: PotentialTargetsNeedingSphereTraceQueue(PotentialTargetsNeedingSphereTraceQueue), World(World), EntityToPotentialTargetEntities(OutEntityToPotentialTargetEntities), TargetFinderSubsystem(TargetFinderSubsystem)
+	FProcessSphereTracesContext(TQueue<FPotentialTargetSphereTraceData, EQueueMode::Mpsc>& PotentialTargetsNeedingSphereTraceQueue, const UMassEntitySubsystem& EntitySubsystem, TMap<FMassEntityHandle, TArray<FPotentialTarget>>& OutEntityToPotentialTargetEntities, const UMassTargetFinderSubsystem& TargetFinderSubsystem)
+		: PotentialTargetsNeedingSphereTraceQueue(PotentialTargetsNeedingSphereTraceQueue), EntitySubsystem(EntitySubsystem), EntityToPotentialTargetEntities(OutEntityToPotentialTargetEntities), TargetFinderSubsystem(TargetFinderSubsystem)
 	{
 	}
 
@@ -423,27 +407,36 @@ private:
 
 		ParallelFor(PotentialTargetsNeedingSphereTrace.Num(), [&](const int32 JobIndex)
 		{
-			const FCapsule TraceCapsule(PotentialTargetsNeedingSphereTrace[JobIndex].TraceStart, PotentialTargetsNeedingSphereTrace[JobIndex].TraceEnd, 1.f);
-			const bool bAreEntitiesBlockingTarget = AreEntitiesBlockingTarget(TraceCapsule, PotentialTargetsNeedingSphereTrace[JobIndex].Entity, PotentialTargetsNeedingSphereTrace[JobIndex].TargetEntity, World, TargetFinderSubsystem);
-			if (!bAreEntitiesBlockingTarget)
+			const FPotentialTargetSphereTraceData& PotentialTarget = PotentialTargetsNeedingSphereTrace[JobIndex];
+
+			FLineOfFireQuery LineOfFireQuery;
+			LineOfFireQuery.Entity = PotentialTarget.Entity;
+			LineOfFireQuery.TargetEntity = PotentialTarget.TargetEntity;
+			LineOfFireQuery.ProjectileTraceCapsule = FCapsule(PotentialTarget.TraceStart, PotentialTarget.TraceEnd, ProjectileRadius);
+			LineOfFireQuery.HostileTeamsMask = PotentialTarget.HostileTeamsMask;
+			LineOfFireQuery.MinCaliberForDamage = PotentialTarget.EntityMinCaliberForDamage;
+
+			const ELineOfFireResult LineOfFireResult = TargetFinderSubsystem.QueryLineOfFire(LineOfFireQuery, EntitySubsystem);
+			if (LineOfFireResult == ELineOfFireResult::Clear)
 			{
-				if (IsTargetEntityVisibleViaSphereTrace(World, PotentialTargetsNeedingSphereTrace[JobIndex].TraceStart, PotentialTargetsNeedingSphereTrace[JobIndex].TraceEnd))
-				{
-					PotentialVisibleTargets.Enqueue(PotentialTargetsNeedingSphereTrace[JobIndex]);
-				}
+				PotentialVisibleTargets.Enqueue(PotentialTarget);
+			}
 #if WITH_MASSGAMEPLAY_DEBUG
-				else
+			else if (UE::Mass::Debug::IsDebuggingEntity(PotentialTarget.Entity))
+			{
+				UE::ProjectM::DebugDraw::Command([TargetEntityLocation = PotentialTarget.Location, LineOfFireResult]()
 				{
-					if (UE::Mass::Debug::IsDebuggingEntity(PotentialTargetsNeedingSphereTrace[JobIndex].Entity))
+					if (LineOfFireResult == ELineOfFireResult::BlockedByEntity)
 					{
-						AsyncTask(ENamedThreads::GameThread, [TargetEntityLocation = PotentialTargetsNeedingSphereTrace[JobIndex].Location]()
-						{
-							UMassEnemyTargetFinderProcessor_DebugEntityData.TargetEntitiesCulledDueToNoLineOfSight.Add(TargetEntityLocation);
-						});
+						UMassEnemyTargetFinderProcessor_DebugEntityData.TargetEntitiesCulledDueToOtherEntityBlocking.Add(TargetEntityLocation);
 					}
-				}
-#endif
+					else
+					{
+						UMassEnemyTargetFinderProcessor_DebugEntityData.TargetEntitiesCulledDueToNoLineOfSight.Add(TargetEntityLocation);
+					}
+				});
 			}
+#endif
 		});
 	}
 
@@ -465,7 +458,7 @@ private:
 	}
 
 	TQueue<FPotentialTargetSphereTraceData, EQueueMode::Mpsc>& PotentialTargetsNeedingSphereTraceQueue;
-	UWorld& World;
+	const UMassEntitySubsystem& EntitySubsystem;
 	TMap<FMassEntityHandle, TArray<FPotentialTarget>>& EntityToPotentialTargetEntities;
 	TArray<FPotentialTargetSphereTraceData> PotentialTargetsNeedingSphereTrace;
 	TQueue<FPotentialTargetSphereTraceData, EQueueMode::Mpsc> PotentialVisibleTargets;
@@ -474,8 +467,8 @@ private:
 
 struct FSelectBestTargetProcessEntityContext
 {
-	FSelectBestTargetProcessEntityContext(UMassEntitySubsystem& EntitySubsystem, TQueue<FMassEntityHandle, EQueueMode::Mpsc>& TargetFinderEntityQueue, const FMassEntityHandle& Entity, const FTransform& EntityTransform, FTargetEntityFragment& TargetEntityFragment, TArray<FPotentialTarget>& PotentialTargets, const bool bIsEntitySoldier)
-		: EntitySubsystem(EntitySubsystem), TargetFinderEntityQueue(TargetFinderEntityQueue), Entity(Entity), EntityLocation(EntityTransform.GetLocation()), EntityTransform(EntityTransform), bIsEntitySoldier(bIsEntitySoldier), TargetEntityFragment(TargetEntityFragment), PotentialTargets(PotentialTargets)
+	FSelectBestTargetProcessEntityContext(UMassEntitySubsystem& EntitySubsystem, TQueue<FMassEntityHandle, EQueueMode::Mpsc>& TargetFinderEntityQueue, const FMassEntityHandle& Entity, const FTransform& EntityTransform, FTargetEntityFragment& TargetEntityFragment, TArray<FPotentialTarget>& PotentialTargets, const bool bIsEntitySoldier, const FMassTurretFragment* TurretFragment)
+		: EntitySubsystem(EntitySubsystem), TargetFinderEntityQueue(TargetFinderEntityQueue), Entity(Entity), EntityLocation(EntityTransform.GetLocation()), EntityTransform(EntityTransform), bIsEntitySoldier(bIsEntitySoldier), TargetEntityFragment(TargetEntityFragment), PotentialTargets(PotentialTargets), TurretFragment(TurretFragment)
 	{
 	}
 
@@ -501,7 +494,7 @@ struct FSelectBestTargetProcessEntityContext
 #if WITH_MASSGAMEPLAY_DEBUG
 			if (UE::Mass::Debug::IsDebuggingEntity(Entity))
 			{
-				AsyncTask(ENamedThreads::GameThread, [World = EntitySubsystem.GetWorld(), EntityLocation = EntityLocation, TargetEntityLocation]()
+				UE::ProjectM::DebugDraw::Command([TargetEntityLocation]()
 				{
 					UMassEnemyTargetFinderProcessor_DebugEntityData.TargetEntityLocation = TargetEntityLocation;
 					UMassEnemyTargetFinderProcessor_DebugEntityData.HasTargetEntity = true;
@@ -539,7 +532,19 @@ struct FSelectBestTargetProcessEntityContext
 			return (OtherLocation - EntityLocation).SizeSquared();
 		};
 
-		PotentialTargetsWithBestCaliber.Sort([&DistanceSqFromEntityToLocation](const FPotentialTarget& A, const FPotentialTarget& B) { return DistanceSqFromEntityToLocation(A.Location) < DistanceSqFromEntityToLocation(B.Location); });
+		// Turrets prefer targets they can already fire at over closer ones they would have to turn to.
+		auto IsInFiringCone = [this](const FVector& OtherLocation) {
+			return TurretFragment == nullptr || TurretFragment->IsInFiringCone(EntityTransform, OtherLocation - EntityLocation);
+		};
+
+		PotentialTargetsWithBestCaliber.Sort([&DistanceSqFromEntityToLocation, &IsInFiringCone](const FPotentialTarget& A, const FPotentialTarget& B) {
+			const bool bIsAInFiringCone = IsInFiringCone(A.Location);
+			if (bIsAInFiringCone != IsInFiringCone(B.Location))
+			{
+				return bIsAInFiringCone;
+			}
+			return DistanceSqFromEntityToLocation(A.Location) < DistanceSqFromEntityToLocation(B.Location);
+		});
 
 		OutTargetEntity = PotentialTargetsWithBestCaliber[0].Entity;
 		OutTargetEntityLocation = PotentialTargetsWithBestCaliber[0].Location;
@@ -574,6 +579,7 @@ private:
 	const bool bIsEntitySoldier;
 	FTargetEntityFragment& TargetEntityFragment;
 	TArray<FPotentialTarget>& PotentialTargets;
+	const FMassTurretFragment* TurretFragment;
 };
 
 struct FSelectBestTargetContext
@@ -593,6 +599,7 @@ struct FSelectBestTargetContext
 
 			const TConstArrayView<FTransformFragment> LocationList = Context.GetFragmentView<FTransformFragment>();
 			const TArrayView<FTargetEntityFragment> TargetEntityList = Context.GetMutableFragmentView<FTargetEntityFragment>();
+			const TConstArrayView<FMassTurretFragment> TurretList = Context.GetFragmentView<FMassTurretFragment>();
 
 			for (int32 EntityIndex = 0; EntityIndex < NumEntities; ++EntityIndex)
 			{
@@ -600,7 +607,8 @@ struct FSelectBestTargetContext
 				if (EntityToPotentialTargetEntities.Contains(Entity))
 				{
 					const bool bIsEntitySoldier = Context.DoesArchetypeHaveTag<FMassProjectileDamagableSoldierTag>();
-					FSelectBestTargetProcessEntityContext(EntitySubsystem, TargetFinderEntityQueue, Entity, LocationList[EntityIndex].GetTransform(), TargetEntityList[EntityIndex], EntityToPotentialTargetEntities[Entity], bIsEntitySoldier).ProcessEntity();
+					const FMassTurretFragment* TurretFragment = TurretList.Num() > 0 ? &TurretList[EntityIndex] : nullptr;
+					FSelectBestTargetProcessEntityContext(EntitySubsystem, TargetFinderEntityQueue, Entity, LocationList[EntityIndex].GetTransform(), TargetEntityList[EntityIndex], EntityToPotentialTargetEntities[Entity], bIsEntitySoldier, TurretFragment).ProcessEntity();
 				}
 			}
 		});
@@ -623,23 +631,39 @@ void UMassEnemyTargetFinderProcessor::Execute(UMassEntitySubsystem& EntitySubsys
 		return;
 	}
 
+	FMassProcessorFrameBudget* FrameBudget = UMassProcessorBudgetSubsystem::FindOrAddBudget(GetWorld(), GetClass()->GetFName(), UMassEnemyTargetFinderProcessor_BudgetMs);
+	const double StartTime = FPlatformTime::Seconds();
+	std::atomic<int32> NumEntitiesSearched = 0;
+	if (FrameBudget)
+	{
+		FrameBudget->BeginEntitySelection(FMassProcessorFrameBudget::CountEntitiesThisFrame(PreSphereTraceEntityQuery, EntitySubsystem, Context));
+	}
+
 	TQueue<FPotentialTargetSphereTraceData, EQueueMode::Mpsc> PotentialTargetsNeedingSphereTrace;
 
-	auto ExecuteFunction = [&EntitySubsystem, &PotentialTargetsNeedingSphereTrace, TargetFinderSubsystem = TargetFinderSubsystem](FMassExecutionContext& Context)
+	auto ExecuteFunction = [&EntitySubsystem, &PotentialTargetsNeedingSphereTrace, &NumEntitiesSearched, TargetFinderSubsystem = TargetFinderSubsystem, FrameBudget = FrameBudget](FMassExecutionContext& Context)
 	{
 		TRACE_CPUPROFILER_EVENT_SCOPE(UMassEnemyTargetFinderProcessor.ForEachEntityChunk.Body);
 
 		const int32 NumEntities = Context.GetNumEntities();
 
 		const TConstArrayView<FTransformFragment> LocationList = Context.GetFragmentView<FTransformFragment>();
-		const TConstArrayView<FTeamMemberFragment> TeamMemberList = Context.GetFragmentView<FTeamMemberFragment>();
+		const FTeamHostilityParameters& HostilityParameters = Context.GetConstSharedFragment<FTeamHostilityParameters>();
 		const TArrayView<FTargetEntityFragment> TargetEntityList = Context.GetMutableFragmentView<FTargetEntityFragment>();
 
 		for (int32 EntityIndex = 0; EntityIndex < NumEntities; EntityIndex++)
 		{
 			const FMassEntityHandle& Entity = Context.GetEntity(EntityIndex);
+
+			// Entities over budget keep FMassNeedsEnemyTargetTag and search on a later frame.
+			if (FrameBudget && !FrameBudget->IsEntitySelected(Entity))
+			{
+				continue;
+			}
+			NumEntitiesSearched++;
+
 			const bool& bIsEntitySoldier = Context.DoesArchetypeHaveTag<FMassProjectileDamagableSoldierTag>();
-			ProcessEntityForVisualTarget(Entity, EntitySubsystem, LocationList[EntityIndex], TargetEntityList[EntityIndex], TeamMemberList[EntityIndex].IsOnTeam1, *TargetFinderSubsystem.Get(), bIsEntitySoldier, PotentialTargetsNeedingSphereTrace);
+			ProcessEntityForVisualTarget(Entity, EntitySubsystem, LocationList[EntityIndex], TargetEntityList[EntityIndex], HostilityParameters.HostileTeamsMask, *TargetFinderSubsystem.Get(), bIsEntitySoldier, PotentialTargetsNeedingSphereTrace);
 		}
 	};
 
@@ -654,12 +678,20 @@ void UMassEnemyTargetFinderProcessor::Execute(UMassEntitySubsystem& EntitySubsys
 
 	if (PotentialTargetsNeedingSphereTrace.IsEmpty())
 	{
+		if (FrameBudget)
+		{
+			FrameBudget->RecordWork(NumEntitiesSearched, FPlatformTime::Seconds() - StartTime);
+		}
 		return;
 	}
 
 	TMap<FMassEntityHandle, TArray<FPotentialTarget>> EntityToPotentialTargetEntities;
 	TQueue<FMassEntityHandle, EQueueMode::Mpsc> TargetFinderEntityQueue;
-	FProcessSphereTracesContext(PotentialTargetsNeedingSphereTrace, *EntitySubsystem.GetWorld(), EntityToPotentialTargetEntities, *TargetFinderSubsystem.Get()).Execute();
+	FProcessSphereTracesContext(PotentialTargetsNeedingSphereTrace, EntitySubsystem, EntityToPotentialTargetEntities, *TargetFinderSubsystem.Get()).Execute();
+	if (FrameBudget)
+	{
+		FrameBudget->RecordWork(NumEntitiesSearched, FPlatformTime::Seconds() - StartTime);
+	}
 	FSelectBestTargetContext(PostSphereTraceEntityQuery, EntitySubsystem, Context, EntityToPotentialTargetEntities, TargetFinderEntityQueue).Execute();
 
 	{
@@ -15,6 +15,11 @@
 #include "MassNavigationFragments.h"
 #include "MassNavigationUtils.h"
 #include "Engine/World.h"
+#include "MassFastAvoidanceSubsystem.h"
+#include "MassEntityHash.h"
+#include "Async/ParallelFor.h"
+#include "MassEnemyTargetFinderProcessor.h"
+#include "MassMoveToCommandProcessor.h"
 
 #define UNSAFE_FOR_MT 1
 
@@ -45,10 +50,13 @@ namespace UE::MassFastAvoidance
 	constexpr int32 MinTouchingCellCount = 4;
 	constexpr int32 MaxObstacleResults = MaxExpectedAgentsPerCell * MinTouchingCellCount;
 
+	typedef TArray<int32, TFixedAllocator<MaxObstacleResults>> FCloseObstacleSlotArray;
+
+	// Outputs obstacle grid item indices, which are also the FMassAvoidanceNeighborSnapshot slots.
 	static void FindCloseObstacles(const FVector& Center, const float SearchRadius, const FNavigationObstacleHashGrid2D& AvoidanceObstacleGrid,
-									TArray<FMassNavigationObstacleItem, TFixedAllocator<MaxObstacleResults>>& OutCloseEntities, const int32 MaxResults)
+									FCloseObstacleSlotArray& OutCloseSlots, const int32 MaxResults)
 	{
-		OutCloseEntities.Reset();
+		OutCloseSlots.Reset();
 		const FVector Extent(SearchRadius, SearchRadius, 0.f);
 		const FBox QueryBox = FBox(Center - Extent, Center + Extent);
 
@@ -94,8 +102,8 @@ namespace UE::MassFastAvoidance
 				const TSparseArray<FNavigationObstacleHashGrid2D::FItem>&  Items = AvoidanceObstacleGrid.GetItems();
 				for (int32 Idx = Cell->First; Idx != INDEX_NONE; Idx = Items[Idx].Next)
 				{
-					OutCloseEntities.Add(Items[Idx].ID);
-					if (OutCloseEntities.Num() >= MaxResults)
+					OutCloseSlots.Add(Idx);
+					if (OutCloseSlots.Num() >= MaxResults)
 					{
 						return;
 					}
@@ -151,6 +159,41 @@ namespace UE::MassFastAvoidance
 		return FMath::Clamp(T, 0.f, TimeHoriz);
 	}
 
+	static EMassLOD::Type GetAvoidanceLOD(const TConstArrayView<FMassSimulationLODFragment> SimulationLODList, const TConstArrayView<FTargetEntityFragment> TargetEntityList, const int32 EntityIndex)
+	{
+		// Entities in combat keep full fidelity regardless of distance.
+		if (TargetEntityList.Num() > 0 && TargetEntityList[EntityIndex].Entity.IsSet())
+		{
+			return EMassLOD::High;
+		}
+
+		// Off LOD entities are excluded by the queries.
+		return SimulationLODList.Num() > 0 ? FMath::Min(SimulationLODList[EntityIndex].LOD.GetValue(), EMassLOD::Low) : EMassLOD::High;
+	}
+
+	// Returns true if agent avoidance should be fully updated this frame, otherwise the held force should be reapplied.
+	static bool ShouldUpdateAvoidance(FMassFastAvoidanceLODFragment& LODFragment, const EMassLOD::Type LOD, const FMassFastAvoidanceLODSettings& LODSettings, const FMassMoveTargetFragment& MoveTarget, const FMassEntityHandle Entity, const float CurrentTime)
+	{
+		const bool bIsForced = LODFragment.LOD != LOD || LODFragment.ActionID != MoveTarget.GetCurrentActionID();
+		if (!bIsForced && CurrentTime < LODFragment.NextUpdateTime)
+		{
+			return false;
+		}
+
+		// Entities that changed LOD or action on the same frame, e.g. a squad given a move to command, next update at a per entity offset into
+		// the interval so that they don't keep updating on the same frames. After that every entity updates at the same interval.
+		LODFragment.NextUpdateTime = CurrentTime + LODSettings.UpdateInterval * (bIsForced ? GetEntityHashFraction(Entity) : 1.f);
+		LODFragment.ActionID = MoveTarget.GetCurrentActionID();
+		LODFragment.LOD = LOD;
+		return true;
+	}
+
+	// Fewer results are needed when fewer neighbours are avoided. Results come from the nearest cells first.
+	static int32 GetMaxObstacleResults(const int32 MaxNeighbors)
+	{
+		return FMath::Min(MaxNeighbors * MinTouchingCellCount, MaxObstacleResults);
+	}
+
 	static bool UseDrawDebugHelper()
 	{
 		return Tweakables::bUseDrawDebugHelpers;
@@ -342,6 +385,147 @@ namespace UE::MassFastAvoidance
 } // namespace UE::MassFastAvoidance
 
 
+//----------------------------------------------------------------------//
+//  UMassFastAvoidanceNeighborSnapshotProcessor
+//----------------------------------------------------------------------//
+UMassFastAvoidanceNeighborSnapshotProcessor::UMassFastAvoidanceNeighborSnapshotProcessor()
+{
+	bAutoRegisterWithProcessingPhases = true;
+	ExecutionFlags = (int32)EProcessorExecutionFlags::All;
+	ExecutionOrder.ExecuteInGroup = UE::Mass::ProcessorGroupNames::Avoidance;
+	ExecutionOrder.ExecuteAfter.Add(UE::Mass::ProcessorGroupNames::LOD);
+	// The snapshot is indexed by obstacle grid item, so it must be taken after the grid is updated for this frame.
+	ExecutionOrder.ExecuteAfter.Add(TEXT("MassNavigationObstacleGridProcessor"));
+	ExecutionOrder.ExecuteBefore.Add(TEXT("MassFastMovingAvoidanceProcessor"));
+	ExecutionOrder.ExecuteBefore.Add(TEXT("MassFastStandingAvoidanceProcessor"));
+}
+
+void UMassFastAvoidanceNeighborSnapshotProcessor::ConfigureQueries()
+{
+	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FMassNavigationObstacleGridCellLocationFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FMassVelocityFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
+	EntityQuery.AddRequirement<FAgentRadiusFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
+	EntityQuery.AddRequirement<FMassMoveTargetFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
+	EntityQuery.AddRequirement<FMassGhostLocationFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
+	EntityQuery.AddRequirement<FMassAvoidanceColliderFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
+}
+
+void UMassFastAvoidanceNeighborSnapshotProcessor::Initialize(UObject& Owner)
+{
+	Super::Initialize(Owner);
+
+	NavigationSubsystem = UWorld::GetSubsystem<UMassNavigationSubsystem>(Owner.GetWorld());
+	FastAvoidanceSubsystem = UWorld::GetSubsystem<UMassFastAvoidanceSubsystem>(Owner.GetWorld());
+}
+
+void UMassFastAvoidanceNeighborSnapshotProcessor::Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UMassFastAvoidanceNeighborSnapshotProcessor.Execute);
+
+	if (!NavigationSubsystem || !FastAvoidanceSubsystem)
+	{
+		return;
+	}
+
+	const TSparseArray<FNavigationObstacleHashGrid2D::FItem>& Items = NavigationSubsystem->GetObstacleGridMutable().GetItems();
+	FMassAvoidanceNeighborSnapshot& Snapshot = FastAvoidanceSubsystem->GetMutableNeighborSnapshot();
+	Snapshot.SetNum(Items.GetMaxIndex());
+
+	// Grid items don't know their entity's chunk, so map entity indices to slots and then fill the slots chunk by chunk.
+	int32 MaxEntityIndex = INDEX_NONE;
+	for (const FNavigationObstacleHashGrid2D::FItem& Item : Items)
+	{
+		MaxEntityIndex = FMath::Max(MaxEntityIndex, Item.ID.Entity.Index);
+	}
+	SlotsByEntityIndex.Reset();
+	SlotsByEntityIndex.Init(INDEX_NONE, MaxEntityIndex + 1);
+
+	ParallelFor(Snapshot.Num(), [&Items, &Snapshot, this](const int32 Slot)
+	{
+		Snapshot.Flags[Slot] = EMassAvoidanceNeighborFlags::None;
+		if (Items.IsAllocated(Slot))
+		{
+			const FMassEntityHandle Entity = Items[Slot].ID.Entity;
+			Snapshot.Entities[Slot] = Entity;
+			if (SlotsByEntityIndex.IsValidIndex(Entity.Index))
+			{
+				SlotsByEntityIndex[Entity.Index] = Slot;
+			}
+		}
+	});
+
+	// Slots of entities that were destroyed since they were added to the grid aren't visited and stay invalid.
+	EntityQuery.ParallelForEachEntityChunk(EntitySubsystem, Context, [&Items, &Snapshot, this](FMassExecutionContext& Context)
+	{
+		const TConstArrayView<FTransformFragment> TransformList = Context.GetFragmentView<FTransformFragment>();
+		const TConstArrayView<FMassVelocityFragment> VelocityList = Context.GetFragmentView<FMassVelocityFragment>();
+		const TConstArrayView<FAgentRadiusFragment> RadiusList = Context.GetFragmentView<FAgentRadiusFragment>();
+		const TConstArrayView<FMassMoveTargetFragment> MoveTargetList = Context.GetFragmentView<FMassMoveTargetFragment>();
+		const TConstArrayView<FMassGhostLocationFragment> GhostList = Context.GetFragmentView<FMassGhostLocationFragment>();
+		const TConstArrayView<FMassAvoidanceColliderFragment> ColliderList = Context.GetFragmentView<FMassAvoidanceColliderFragment>();
+
+		for (int32 EntityIndex = 0; EntityIndex < Context.GetNumEntities(); ++EntityIndex)
+		{
+			const FMassEntityHandle Entity = Context.GetEntity(EntityIndex);
+			const int32 Slot = SlotsByEntityIndex.IsValidIndex(Entity.Index) ? SlotsByEntityIndex[Entity.Index] : INDEX_NONE;
+			if (Slot == INDEX_NONE || Snapshot.Entities[Slot] != Entity)
+			{
+				continue;
+			}
+
+			const FTransform& Transform = TransformList[EntityIndex].GetTransform();
+			const FMassMoveTargetFragment* MoveTarget = MoveTargetList.Num() > 0 ? &MoveTargetList[EntityIndex] : nullptr;
+
+			EMassAvoidanceNeighborFlags& Flags = Snapshot.Flags[Slot];
+			Flags = EMassAvoidanceNeighborFlags::Valid;
+			Snapshot.Locations[Slot] = Transform.GetLocation();
+			Snapshot.Forwards[Slot] = Transform.GetRotation().GetForwardVector();
+			Snapshot.Velocities[Slot] = VelocityList.Num() > 0 ? VelocityList[EntityIndex].Value : FVector::ZeroVector;
+			Snapshot.Radii[Slot] = RadiusList.Num() > 0 ? RadiusList[EntityIndex].Radius : 0.f;
+
+			// Assume moving if other does not have move target.
+			if (!MoveTarget || MoveTarget->GetCurrentAction() == EMassMovementAction::Move)
+			{
+				Flags |= EMassAvoidanceNeighborFlags::Moving;
+			}
+
+			if (MoveTarget)
+			{
+				Flags |= EMassAvoidanceNeighborFlags::CanAvoid;
+
+				if (GhostList.Num() > 0 && MoveTarget->GetCurrentAction() == EMassMovementAction::Stand && GhostList[EntityIndex].IsValid(MoveTarget->GetCurrentActionID()))
+				{
+					Flags |= EMassAvoidanceNeighborFlags::HasStandingGhost;
+					Snapshot.GhostLocations[Slot] = GhostList[EntityIndex].Location;
+					Snapshot.MoveTargetCenters[Slot] = MoveTarget->Center;
+				}
+			}
+
+			if (EnumHasAnyFlags(Items[Slot].ID.ItemFlags, EMassNavigationObstacleFlags::HasColliderData))
+			{
+				Flags |= EMassAvoidanceNeighborFlags::HasColliderData;
+				if (ColliderList.Num() > 0)
+				{
+					const FMassAvoidanceColliderFragment& ColliderFragment = ColliderList[EntityIndex];
+					if (ColliderFragment.Type == EMassColliderType::Circle)
+					{
+						Flags |= EMassAvoidanceNeighborFlags::CircleCollider;
+						Snapshot.ColliderRadii[Slot] = ColliderFragment.GetCircleCollider().Radius;
+					}
+					else if (ColliderFragment.Type == EMassColliderType::Pill)
+					{
+						const FMassPillCollider Pill = ColliderFragment.GetPillCollider();
+						Flags |= EMassAvoidanceNeighborFlags::PillCollider;
+						Snapshot.ColliderRadii[Slot] = Pill.Radius;
+						Snapshot.PillHalfLengths[Slot] = Pill.HalfLength;
+					}
+				}
+			}
+		}
+	});
+}
+
 //----------------------------------------------------------------------//
 //  UMassFastMovingAvoidanceProcessor
 //----------------------------------------------------------------------//
@@ -361,8 +545,9 @@ void UMassFastMovingAvoidanceProcessor::ConfigureQueries()
 	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
 	EntityQuery.AddRequirement<FMassVelocityFragment>(EMassFragmentAccess::ReadOnly);
 	EntityQuery.AddRequirement<FAgentRadiusFragment>(EMassFragmentAccess::ReadOnly);
-	EntityQuery.AddTagRequirement<FMassMediumLODTag>(EMassFragmentPresence::None);
-	EntityQuery.AddTagRequirement<FMassLowLODTag>(EMassFragmentPresence::None);
+	EntityQuery.AddRequirement<FMassFastAvoidanceLODFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FMassSimulationLODFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
+	EntityQuery.AddRequirement<FTargetEntityFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
 	EntityQuery.AddTagRequirement<FMassOffLODTag>(EMassFragmentPresence::None);
 	EntityQuery.AddConstSharedRequirement<FMassFastMovingAvoidanceParameters>(EMassFragmentPresence::All);
 	EntityQuery.AddConstSharedRequirement<FMassMovementParameters>(EMassFragmentPresence::All);
@@ -374,18 +559,21 @@ void UMassFastMovingAvoidanceProcessor::Initialize(UObject& Owner)
 
 	World = Owner.GetWorld();
 	NavigationSubsystem = UWorld::GetSubsystem<UMassNavigationSubsystem>(Owner.GetWorld());
+	FastAvoidanceSubsystem = UWorld::GetSubsystem<UMassFastAvoidanceSubsystem>(Owner.GetWorld());
 }
 
 void UMassFastMovingAvoidanceProcessor::Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context)
 {
 	QUICK_SCOPE_CYCLE_COUNTER(UMassFastMovingAvoidanceProcessor);
 
-	if (!World || !NavigationSubsystem)
+	if (!World || !NavigationSubsystem || !FastAvoidanceSubsystem)
 	{
 		return;
 	}
 
-	EntityQuery.ParallelForEachEntityChunk(EntitySubsystem, Context, [this, &EntitySubsystem](FMassExecutionContext& Context)
+	const FMassAvoidanceNeighborSnapshot& Neighbors = FastAvoidanceSubsystem->GetNeighborSnapshot();
+
+	EntityQuery.ParallelForEachEntityChunk(EntitySubsystem, Context, [this, &Neighbors](FMassExecutionContext& Context)
 	{
 		const float DeltaTime = Context.GetDeltaTimeSeconds();
 		const float CurrentTime = World->GetTimeSeconds();
@@ -397,20 +585,21 @@ void UMassFastMovingAvoidanceProcessor::Execute(UMassEntitySubsystem& EntitySubs
 		const TConstArrayView<FMassVelocityFragment> VelocityList = Context.GetFragmentView<FMassVelocityFragment>();
 		const TConstArrayView<FAgentRadiusFragment> RadiusList = Context.GetFragmentView<FAgentRadiusFragment>();
 		const TConstArrayView<FMassMoveTargetFragment> MoveTargetList = Context.GetFragmentView<FMassMoveTargetFragment>();
+		const TArrayView<FMassFastAvoidanceLODFragment> AvoidanceLODList = Context.GetMutableFragmentView<FMassFastAvoidanceLODFragment>();
+		const TConstArrayView<FMassSimulationLODFragment> SimulationLODList = Context.GetFragmentView<FMassSimulationLODFragment>();
+		const TConstArrayView<FTargetEntityFragment> TargetEntityList = Context.GetFragmentView<FTargetEntityFragment>();
 		const FMassFastMovingAvoidanceParameters& MovingAvoidanceParams = Context.GetConstSharedFragment<FMassFastMovingAvoidanceParameters>();
 		const FMassMovementParameters& MovementParams = Context.GetConstSharedFragment<FMassMovementParameters>();
 
 		const float InvPredictiveAvoidanceTime = 1.0f / MovingAvoidanceParams.PredictiveAvoidanceTime;
 
 		// Arrays used to store close obstacles
-		TArray<FMassNavigationObstacleItem, TFixedAllocator<UE::MassFastAvoidance::MaxObstacleResults>> CloseEntities;
+		UE::MassFastAvoidance::FCloseObstacleSlotArray CloseSlots;
 
 		// Used for storing sorted list or nearest obstacles.
 		struct FSortedObstacle
 		{
-			FVector LocationCached;
-			FVector Forward;
-			FMassNavigationObstacleItem ObstacleItem;
+			int32 Slot;
 			float SqDist;
 		};
 		TArray<FSortedObstacle, TFixedAllocator<UE::MassFastAvoidance::MaxObstacleResults>> ClosestObstacles;
@@ -486,6 +675,13 @@ void UMassFastMovingAvoidanceProcessor::Execute(UMassEntitySubsystem& EntitySubs
 			
 			const float NearStartScaling = FMath::Lerp(MovingAvoidanceParams.StartOfPathAvoidanceScale, 1.0f, NearStartFade);
 			const float NearEndScaling = FMath::Lerp(MovingAvoidanceParams.EndOfPathAvoidanceScale, 1.0f, NearEndFade);
+
+			const EMassLOD::Type LOD = UE::MassFastAvoidance::GetAvoidanceLOD(SimulationLODList, TargetEntityList, EntityIndex);
+			const FMassFastAvoidanceLODSettings& LODSettings = MovingAvoidanceParams.LODSettings[LOD];
+			FMassFastAvoidanceLODFragment& AvoidanceLOD = AvoidanceLODList[EntityIndex];
+			// Environment avoidance depends on where the agent is now and is cheap next to agent avoidance, so it runs every frame and only
+			// the agent avoidance force is held between updates.
+			const bool bShouldUpdateAgentAvoidance = UE::MassFastAvoidance::ShouldUpdateAvoidance(AvoidanceLOD, LOD, LODSettings, MoveTarget, Entity, CurrentTime);
 			
 #if WITH_MASSGAMEPLAY_DEBUG && UNSAFE_FOR_MT
 			const UE::MassFastAvoidance::FDebugContext BaseDebugContext(this, LogAvoidance, World, Entity);
@@ -521,7 +717,7 @@ void UMassFastMovingAvoidanceProcessor::Execute(UMassEntitySubsystem& EntitySubs
 			// Environment avoidance.
 			//
 			
-			if (!MoveTarget.bOffBoundaries && UE::MassFastAvoidance::Tweakables::bEnableEnvironmentAvoidance)
+			if (!MoveTarget.bOffBoundaries && UE::MassFastAvoidance::Tweakables::bEnableEnvironmentAvoidance && LODSettings.bEnableEnvironmentAvoidance)
 			{
 				const FVector DesiredAcceleration = UE::MassNavigation::ClampVector(SteeringForce, MaxSteerAccel);
 				const FVector DesiredVelocity = UE::MassNavigation::ClampVector(AgentVelocity + DesiredAcceleration * DeltaTime, MaximumSpeed);
@@ -719,46 +915,45 @@ void UMassFastMovingAvoidanceProcessor::Execute(UMassEntitySubsystem& EntitySubs
 			//////////////////////////////////////////////////////////////////////////
 			// Avoid close agents
 
+			if (!bShouldUpdateAgentAvoidance)
+			{
+				Force.Value = UE::MassNavigation::ClampVector((SteeringForce + AvoidanceLOD.HeldForce) * NearStartScaling * NearEndScaling, MaxSteerAccel); // Assume unit mass
+				continue;
+			}
+			const FVector SteeringForceBeforeAgentAvoidance = SteeringForce;
+
 			// Update desired velocity based on avoidance so far.
 			const FVector DesAcc = UE::MassNavigation::ClampVector(SteeringForce, MaxSteerAccel);
 			const FVector DesVel = UE::MassNavigation::ClampVector(AgentVelocity + DesAcc * DeltaTime, MaximumSpeed);
 
 			// Find close obstacles
 			const FNavigationObstacleHashGrid2D& AvoidanceObstacleGrid = NavigationSubsystem->GetObstacleGridMutable();
-			UE::MassFastAvoidance::FindCloseObstacles(AgentLocation, MovingAvoidanceParams.ObstacleDetectionDistance, AvoidanceObstacleGrid, CloseEntities, UE::MassFastAvoidance::MaxObstacleResults);
+			CloseSlots.Reset();
+			if (LODSettings.MaxNeighbors > 0)
+			{
+				UE::MassFastAvoidance::FindCloseObstacles(AgentLocation, MovingAvoidanceParams.ObstacleDetectionDistance, AvoidanceObstacleGrid, CloseSlots, UE::MassFastAvoidance::GetMaxObstacleResults(LODSettings.MaxNeighbors));
+			}
 
-			// Remove unwanted and find the closests in the CloseEntities
+			// Remove unwanted and find the closests in the CloseSlots
 			const float DistanceCutOffSqr = FMath::Square(MovingAvoidanceParams.ObstacleDetectionDistance);
 			ClosestObstacles.Reset();
-			for (const FNavigationObstacleHashGrid2D::ItemIDType OtherEntity : CloseEntities)
+			for (const int32 Slot : CloseSlots)
 			{
-				// Skip self
-				if (OtherEntity.Entity == Entity)
+				// Skip invalid entities and self
+				if (!Neighbors.IsValidSlot(Slot) || Neighbors.Entities[Slot] == Entity)
 				{
 					continue;
 				}
-
-				// Skip invalid entities.
-				if (!EntitySubsystem.IsEntityValid(OtherEntity.Entity))
-				{
-					UE_LOG(LogAvoidanceObstacles, VeryVerbose, TEXT("Close entity is invalid, skipped."));
-					continue;
-				}
 				
 				// Skip too far
-				const FTransform& Transform = EntitySubsystem.GetFragmentDataChecked<FTransformFragment>(OtherEntity.Entity).GetTransform();
-				const FVector OtherLocation = Transform.GetLocation();
-				
-				const float SqDist = FVector::DistSquared(AgentLocation, OtherLocation);
+				const float SqDist = FVector::DistSquared(AgentLocation, Neighbors.Locations[Slot]);
 				if (SqDist > DistanceCutOffSqr)
 				{
 					continue;
 				}
 
 				FSortedObstacle Obstacle;
-				Obstacle.LocationCached = OtherLocation;
-				Obstacle.Forward = Transform.GetRotation().GetForwardVector();
-				Obstacle.ObstacleItem = OtherEntity;
+				Obstacle.Slot = Slot;
 				Obstacle.SqDist = SqDist;
 				ClosestObstacles.Add(Obstacle);
 			}
@@ -770,7 +965,7 @@ void UMassFastMovingAvoidanceProcessor::Execute(UMassEntitySubsystem& EntitySubs
 
 			// Fill collider list from close agents
 			Colliders.Reset();
-			constexpr int32 MaxColliders = 6;
+			const int32 MaxColliders = LODSettings.MaxNeighbors;
 			for (int32 Index = 0; Index < ClosestObstacles.Num(); Index++)
 			{
 				if (Colliders.Num() >= MaxColliders)
@@ -778,62 +973,53 @@ void UMassFastMovingAvoidanceProcessor::Execute(UMassEntitySubsystem& EntitySubs
 					break;
 				}
 
-				FSortedObstacle& Obstacle = ClosestObstacles[Index];
-				FMassEntityView OtherEntityView(EntitySubsystem, Obstacle.ObstacleItem.Entity);
-
-				const FMassVelocityFragment* OtherVelocityFragment = OtherEntityView.GetFragmentDataPtr<FMassVelocityFragment>();
-				const FVector OtherVelocity = OtherVelocityFragment != nullptr ? OtherVelocityFragment->Value : FVector::ZeroVector; // Get velocity from FAvoidanceComponent
-
-				// @todo: this is heavy fragment to access, see if we could handle this differently.
-				const FMassMoveTargetFragment* OtherMoveTarget = OtherEntityView.GetFragmentDataPtr<FMassMoveTargetFragment>();
-				const bool bCanAvoid = OtherMoveTarget != nullptr;
-				const bool bOtherIsMoving = OtherMoveTarget ? OtherMoveTarget->GetCurrentAction() == EMassMovementAction::Move : true; // Assume moving if other does not have move target.
+				const int32 Slot = ClosestObstacles[Index].Slot;
+				const EMassAvoidanceNeighborFlags OtherFlags = Neighbors.Flags[Slot];
+				const FVector& OtherLocation = Neighbors.Locations[Slot];
+				const FVector& OtherVelocity = Neighbors.Velocities[Slot];
+				const bool bCanAvoid = EnumHasAnyFlags(OtherFlags, EMassAvoidanceNeighborFlags::CanAvoid);
+				const bool bOtherIsMoving = EnumHasAnyFlags(OtherFlags, EMassAvoidanceNeighborFlags::Moving);
 				
 				// Check for colliders data
-				if (EnumHasAnyFlags(Obstacle.ObstacleItem.ItemFlags, EMassNavigationObstacleFlags::HasColliderData))
+				if (EnumHasAnyFlags(OtherFlags, EMassAvoidanceNeighborFlags::HasColliderData))
 				{
-					if (const FMassAvoidanceColliderFragment* ColliderFragment = OtherEntityView.GetFragmentDataPtr<FMassAvoidanceColliderFragment>())
+					if (EnumHasAnyFlags(OtherFlags, EMassAvoidanceNeighborFlags::CircleCollider))
 					{
-						if (ColliderFragment->Type == EMassColliderType::Circle)
-						{
-							const FMassCircleCollider Circle = ColliderFragment->GetCircleCollider();
-							
-							FCollider& Collider = Colliders.AddDefaulted_GetRef();
-							Collider.Velocity = OtherVelocity;
-							Collider.bCanAvoid = bCanAvoid;
-							Collider.bIsMoving = bOtherIsMoving;
-							Collider.Radius = Circle.Radius;
-							Collider.Location = Obstacle.LocationCached;
-						}
-						else if (ColliderFragment->Type == EMassColliderType::Pill)
-						{
-							const FMassPillCollider Pill = ColliderFragment->GetPillCollider(); 
+						FCollider& Collider = Colliders.AddDefaulted_GetRef();
+						Collider.Velocity = OtherVelocity;
+						Collider.bCanAvoid = bCanAvoid;
+						Collider.bIsMoving = bOtherIsMoving;
+						Collider.Radius = Neighbors.ColliderRadii[Slot];
+						Collider.Location = OtherLocation;
+					}
+					else if (EnumHasAnyFlags(OtherFlags, EMassAvoidanceNeighborFlags::PillCollider))
+					{
+						const FVector HalfLengthOffset = Neighbors.PillHalfLengths[Slot] * Neighbors.Forwards[Slot];
 
-							FCollider& Collider = Colliders.AddDefaulted_GetRef();
-							Collider.Velocity = OtherVelocity;
-							Collider.bCanAvoid = bCanAvoid;
-							Collider.bIsMoving = bOtherIsMoving;
-							Collider.Radius = Pill.Radius;
-							Collider.Location = Obstacle.LocationCached + (Pill.HalfLength * Obstacle.Forward);
+						FCollider& Collider = Colliders.AddDefaulted_GetRef();
+						Collider.Velocity = OtherVelocity;
+						Collider.bCanAvoid = bCanAvoid;
+						Collider.bIsMoving = bOtherIsMoving;
+						Collider.Radius = Neighbors.ColliderRadii[Slot];
+						Collider.Location = OtherLocation + HalfLengthOffset;
 
-							if (Colliders.Num() < MaxColliders)
-							{
-								FCollider& Collider2 = Colliders.AddDefaulted_GetRef();
-								Collider2.Velocity = OtherVelocity;
-								Collider2.bCanAvoid = bCanAvoid;
-								Collider2.bIsMoving = bOtherIsMoving;
-								Collider2.Radius = Pill.Radius;
-								Collider2.Location = Obstacle.LocationCached + (-Pill.HalfLength * Obstacle.Forward);
-							}
+						if (Colliders.Num() < MaxColliders)
+						{
+							FCollider& Collider2 = Colliders.AddDefaulted_GetRef();
+							Collider2.Velocity = OtherVelocity;
+							Collider2.bCanAvoid = bCanAvoid;
+							Collider2.bIsMoving = bOtherIsMoving;
+							Collider2.Radius = Neighbors.ColliderRadii[Slot];
+							Collider2.Location = OtherLocation - HalfLengthOffset;
 						}
 					}
 				}
 				else
 				{
 					FCollider& Collider = Colliders.AddDefaulted_GetRef();
-					Collider.Location = Obstacle.LocationCached;
+					Collider.Location = OtherLocation;
 					Collider.Velocity = OtherVelocity;
-					Collider.Radius = OtherEntityView.GetFragmentData<FAgentRadiusFragment>().Radius;
+					Collider.Radius = Neighbors.Radii[Slot];
 					Collider.bCanAvoid = bCanAvoid;
 					Collider.bIsMoving = bOtherIsMoving;
 				}
@@ -976,6 +1162,7 @@ void UMassFastMovingAvoidanceProcessor::Execute(UMassEntitySubsystem& EntitySubs
 #endif // WITH_MASSGAMEPLAY_DEBUG
 			} // close entities loop
 
+			AvoidanceLOD.HeldForce = SteeringForce - SteeringForceBeforeAgentAvoidance;
 			SteeringForce *= NearStartScaling * NearEndScaling;
 			
 			Force.Value = UE::MassNavigation::ClampVector(SteeringForce, MaxSteerAccel); // Assume unit mass
@@ -1023,8 +1210,10 @@ void UMassFastStandingAvoidanceProcessor::ConfigureQueries()
 	EntityQuery.AddRequirement<FMassMoveTargetFragment>(EMassFragmentAccess::ReadOnly);
 	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
 	EntityQuery.AddRequirement<FAgentRadiusFragment>(EMassFragmentAccess::ReadOnly);
-	EntityQuery.AddTagRequirement<FMassMediumLODTag>(EMassFragmentPresence::None);
-	EntityQuery.AddTagRequirement<FMassLowLODTag>(EMassFragmentPresence::None);
+	EntityQuery.AddRequirement<FMassFastAvoidanceLODFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FMassSimulationLODFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
+	EntityQuery.AddRequirement<FTargetEntityFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
+	EntityQuery.AddRequirement<FMassNavMeshMoveFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
 	EntityQuery.AddTagRequirement<FMassOffLODTag>(EMassFragmentPresence::None);
 	EntityQuery.AddConstSharedRequirement<FMassFastStandingAvoidanceParameters>(EMassFragmentPresence::All);
 }
@@ -1035,27 +1224,36 @@ void UMassFastStandingAvoidanceProcessor::Initialize(UObject& Owner)
 
 	World = Owner.GetWorld();
 	NavigationSubsystem = UWorld::GetSubsystem<UMassNavigationSubsystem>(Owner.GetWorld());
+	FastAvoidanceSubsystem = UWorld::GetSubsystem<UMassFastAvoidanceSubsystem>(Owner.GetWorld());
 }
 
 void UMassFastStandingAvoidanceProcessor::Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context)
 {
 	QUICK_SCOPE_CYCLE_COUNTER(UMassFastStandingAvoidanceProcessor);
 
-	if (!World || !NavigationSubsystem)
+	if (!World || !NavigationSubsystem || !FastAvoidanceSubsystem)
 	{
 		return;
 	}
 
+	// Other agents' ghosts come from the snapshot, so they are the ghosts from before this frame's update regardless of chunk order.
+	const FMassAvoidanceNeighborSnapshot& Neighbors = FastAvoidanceSubsystem->GetNeighborSnapshot();
+
 	// Avoidance while standing
-	EntityQuery.ParallelForEachEntityChunk(EntitySubsystem, Context, [this, &EntitySubsystem](FMassExecutionContext& Context)
+	EntityQuery.ParallelForEachEntityChunk(EntitySubsystem, Context, [this, &Neighbors](FMassExecutionContext& Context)
 	{
 		const int32 NumEntities = Context.GetNumEntities();
 		const float DeltaTime = Context.GetDeltaTimeSeconds();
+		const float CurrentTime = World->GetTimeSeconds();
 
 		const TArrayView<FMassGhostLocationFragment> GhostList = Context.GetMutableFragmentView<FMassGhostLocationFragment>();
 		const TConstArrayView<FTransformFragment> LocationList = Context.GetFragmentView<FTransformFragment>();
 		const TConstArrayView<FAgentRadiusFragment> RadiusList = Context.GetFragmentView<FAgentRadiusFragment>();
 		const TConstArrayView<FMassMoveTargetFragment> MoveTargetList = Context.GetFragmentView<FMassMoveTargetFragment>();
+		const TArrayView<FMassFastAvoidanceLODFragment> AvoidanceLODList = Context.GetMutableFragmentView<FMassFastAvoidanceLODFragment>();
+		const TConstArrayView<FMassSimulationLODFragment> SimulationLODList = Context.GetFragmentView<FMassSimulationLODFragment>();
+		const TConstArrayView<FTargetEntityFragment> TargetEntityList = Context.GetFragmentView<FTargetEntityFragment>();
+		const TConstArrayView<FMassNavMeshMoveFragment> NavMeshMoveList = Context.GetFragmentView<FMassNavMeshMoveFragment>();
 		const FMassFastStandingAvoidanceParameters& StandingParams = Context.GetConstSharedFragment<FMassFastStandingAvoidanceParameters>();
 
 		const float GhostSeparationDistance = StandingParams.GhostSeparationDistance;
@@ -1065,16 +1263,14 @@ void UMassFastStandingAvoidanceProcessor::Execute(UMassEntitySubsystem& EntitySu
 		const float MovingSeparationStiffness = StandingParams.GhostSeparationStiffness * StandingParams.MovingObstacleAvoidanceScale;
 
 		// Arrays used to store close agents
-		TArray<FMassNavigationObstacleItem, TFixedAllocator<UE::MassFastAvoidance::MaxObstacleResults>> CloseEntities;
+		UE::MassFastAvoidance::FCloseObstacleSlotArray CloseSlots;
 
 		struct FSortedObstacle
 		{
 			FSortedObstacle() = default;
-			FSortedObstacle(const FMassEntityHandle InEntity, const FVector InLocation, const FVector InForward, const float InDistSq) : Entity(InEntity), Location(InLocation), Forward(InForward), DistSq(InDistSq) {}
+			FSortedObstacle(const int32 InSlot, const float InDistSq) : Slot(InSlot), DistSq(InDistSq) {}
 			
-			FMassEntityHandle Entity;
-			FVector Location = FVector::ZeroVector;
-			FVector Forward = FVector::ForwardVector;
+			int32 Slot = INDEX_NONE;
 			float DistSq = 0.0f;
 		};
 		TArray<FSortedObstacle, TFixedAllocator<UE::MassFastAvoidance::MaxObstacleResults>> ClosestObstacles;
@@ -1120,109 +1316,115 @@ void UMassFastStandingAvoidanceProcessor::Execute(UMassEntitySubsystem& EntitySu
 			const FVector GhostDesiredVelocity = SteerDirection * StandingParams.GhostMaxSpeed * SpeedFade;
 			FVector GhostSteeringForce = SteerK * (GhostDesiredVelocity - Ghost.Velocity); // Goal force
 			
-			// Find close obstacles
-			// @todo: optimize FindCloseObstacles() and cache results. We're intentionally using agent location here, to allow to share the results with moving avoidance.
-			const FNavigationObstacleHashGrid2D& ObstacleGrid = NavigationSubsystem->GetObstacleGridMutable();
-			UE::MassFastAvoidance::FindCloseObstacles(AgentLocation, StandingParams.GhostObstacleDetectionDistance, ObstacleGrid, CloseEntities, UE::MassFastAvoidance::MaxObstacleResults);
-
-			// Remove unwanted and find the closest in the CloseEntities
-			const float DistanceCutOffSqr = FMath::Square(StandingParams.GhostObstacleDetectionDistance);
-			ClosestObstacles.Reset();
-			for (const FNavigationObstacleHashGrid2D::ItemIDType OtherEntity : CloseEntities)
+			// Separation from close agents is the expensive part, so at lower LODs it is only updated every so often.
+			const bool bIsIdleInFormation = NavMeshMoveList.Num() > 0 && NavMeshMoveList[EntityIndex].SquadMemberIndex >= 0;
+			EMassLOD::Type LOD = UE::MassFastAvoidance::GetAvoidanceLOD(SimulationLODList, TargetEntityList, EntityIndex);
+			if (bIsIdleInFormation && (TargetEntityList.Num() == 0 || !TargetEntityList[EntityIndex].Entity.IsSet()))
 			{
-				// Skip self
-				if (OtherEntity.Entity == Entity)
-				{
-					continue;
-				}
+				LOD = FMath::Max(LOD, StandingParams.IdleFormationLOD.GetValue());
+			}
+			const FMassFastAvoidanceLODSettings& LODSettings = StandingParams.LODSettings[LOD];
+			FMassFastAvoidanceLODFragment& AvoidanceLOD = AvoidanceLODList[EntityIndex];
+			if (UE::MassFastAvoidance::ShouldUpdateAvoidance(AvoidanceLOD, LOD, LODSettings, MoveTarget, Entity, CurrentTime))
+			{
+				FVector NeighborSeparationForce = FVector::ZeroVector;
 
-				// Skip invalid entities.
-				if (!EntitySubsystem.IsEntityValid(OtherEntity.Entity))
+				// Find close obstacles
+				// @todo: optimize FindCloseObstacles() and cache results. We're intentionally using agent location here, to allow to share the results with moving avoidance.
+				const FNavigationObstacleHashGrid2D& ObstacleGrid = NavigationSubsystem->GetObstacleGridMutable();
+				CloseSlots.Reset();
+				if (LODSettings.MaxNeighbors > 0)
 				{
-					UE_LOG(LogAvoidanceObstacles, VeryVerbose, TEXT("Close entity is invalid, skipped."));
-					continue;
+					UE::MassFastAvoidance::FindCloseObstacles(AgentLocation, StandingParams.GhostObstacleDetectionDistance, ObstacleGrid, CloseSlots, UE::MassFastAvoidance::GetMaxObstacleResults(LODSettings.MaxNeighbors));
 				}
 
-				// Skip too far
-				const FTransformFragment& OtherTransform = EntitySubsystem.GetFragmentDataChecked<FTransformFragment>(OtherEntity.Entity);
-				const FVector OtherLocation = OtherTransform.GetTransform().GetLocation();
-				const float DistSq = FVector::DistSquared(AgentLocation, OtherLocation);
-				if (DistSq > DistanceCutOffSqr)
+				// Remove unwanted and find the closest in the CloseSlots
+				const float DistanceCutOffSqr = FMath::Square(StandingParams.GhostObstacleDetectionDistance);
+				ClosestObstacles.Reset();
+				for (const int32 Slot : CloseSlots)
 				{
-					continue;
-				}
-
-				ClosestObstacles.Emplace(OtherEntity.Entity, OtherLocation, OtherTransform.GetTransform().GetRotation().GetForwardVector(), DistSq);
-			}
-			ClosestObstacles.Sort([](const FSortedObstacle& A, const FSortedObstacle& B) { return A.DistSq < B.DistSq; });
-
-			const float GhostRadius = AgentRadius * StandingParams.GhostSeparationRadiusScale;
-			
-			// Compute forces
-			constexpr int32 MaxCloseObstacleTreated = 6;
-			const int32 NumCloseObstacles = FMath::Min(ClosestObstacles.Num(), MaxCloseObstacleTreated);
-			for (int32 Index = 0; Index < NumCloseObstacles; Index++)
-			{
-				FSortedObstacle& OtherAgent = ClosestObstacles[Index];
-				FMassEntityView OtherEntityView(EntitySubsystem, OtherAgent.Entity);
-
-				const float OtherRadius = OtherEntityView.GetFragmentData<FAgentRadiusFragment>().Radius;
-				const float TotalRadius = GhostRadius + OtherRadius;
+					// Skip invalid entities and self
+					if (!Neighbors.IsValidSlot(Slot) || Neighbors.Entities[Slot] == Entity)
+					{
+						continue;
+					}
 
-				// @todo: this is heavy fragment to access, see if we could handle this differently.
-				const FMassMoveTargetFragment* OtherMoveTarget = OtherEntityView.GetFragmentDataPtr<FMassMoveTargetFragment>();
-				const FMassGhostLocationFragment* OtherGhost = OtherEntityView.GetFragmentDataPtr<FMassGhostLocationFragment>();
+					// Skip too far
+					const float DistSq = FVector::DistSquared(AgentLocation, Neighbors.Locations[Slot]);
+					if (DistSq > DistanceCutOffSqr)
+					{
+						continue;
+					}
 
-				const bool bOtherHasGhost = OtherMoveTarget != nullptr && OtherGhost != nullptr
-											&& OtherMoveTarget->GetCurrentAction() == EMassMovementAction::Stand
-											&& OtherGhost->IsValid(OtherMoveTarget->GetCurrentActionID());
+					ClosestObstacles.Emplace(Slot, DistSq);
+				}
+				ClosestObstacles.Sort([](const FSortedObstacle& A, const FSortedObstacle& B) { return A.DistSq < B.DistSq; });
 
-				// If other has ghost active, avoid that, else avoid the actual agent.
-				if (bOtherHasGhost)
+				const float GhostRadius = AgentRadius * StandingParams.GhostSeparationRadiusScale;
+			
+				// Compute forces
+				const int32 MaxCloseObstacleTreated = LODSettings.MaxNeighbors;
+				const int32 NumCloseObstacles = FMath::Min(ClosestObstacles.Num(), MaxCloseObstacleTreated);
+				for (int32 Index = 0; Index < NumCloseObstacles; Index++)
 				{
-					// Avoid the other agent more, when it is further away from it's goal location.
-					const float OtherDistanceToGoal = FVector::Distance(OtherGhost->Location, OtherMoveTarget->Center);
-					const float OtherSteerFade = FMath::Clamp(OtherDistanceToGoal / StandingParams.GhostToTargetMaxDeviation, 0.0f, 1.0f);
-					const float SeparationStiffness = FMath::Lerp(GhostSeparationStiffness, MovingSeparationStiffness, OtherSteerFade);
+					const int32 Slot = ClosestObstacles[Index].Slot;
+					const FVector& OtherAgentLocation = Neighbors.Locations[Slot];
+					const FVector& OtherAgentForward = Neighbors.Forwards[Slot];
 
-					// Ghost separation
-					FVector RelPos = Ghost.Location - OtherGhost->Location;
-					RelPos.Z = 0.f; // we assume we work on a flat plane for now
-					const float ConDist = RelPos.Size();
-					const FVector ConNorm = ConDist > 0.f ? RelPos / ConDist : FVector::ForwardVector;
-
-					// Separation force (stay away from obstacles if possible)
-					const float PenSep = (TotalRadius + GhostSeparationDistance) - ConDist;
-					const float SeparationMag = UE::MassNavigation::Smooth(FMath::Clamp(PenSep / GhostSeparationDistance, 0.f, 1.f));
-					const FVector SeparationForce = ConNorm * SeparationStiffness * SeparationMag;
+					const float OtherRadius = Neighbors.Radii[Slot];
+					const float TotalRadius = GhostRadius + OtherRadius;
 
-					GhostSteeringForce += SeparationForce;
-				}
-				else
-				{
-					// Avoid more when the avoidance other is in front,
-					const FVector DirToOther = (OtherAgent.Location - Ghost.Location).GetSafeNormal();
-					const float DirectionalFade = FMath::Square(FMath::Max(0.0f, FVector::DotProduct(MoveTarget.Forward, DirToOther)));
-					const float DirectionScale = FMath::Lerp(StandingParams.MovingObstacleDirectionalScale, 1.0f, DirectionalFade);
+					// If other has ghost active, avoid that, else avoid the actual agent.
+					if (EnumHasAnyFlags(Neighbors.Flags[Slot], EMassAvoidanceNeighborFlags::HasStandingGhost))
+					{
+						const FVector& OtherGhostLocation = Neighbors.GhostLocations[Slot];
 
-					// Treat the other agent as a 2D capsule protruding towards forward.
- 					const FVector OtherBasePosition = OtherAgent.Location;
-					const FVector OtherPersonalSpacePosition = OtherAgent.Location + OtherAgent.Forward * OtherRadius * StandingParams.MovingObstaclePersonalSpaceScale * DirectionScale;
-					const FVector OtherLocation = FMath::ClosestPointOnSegment(Ghost.Location, OtherBasePosition, OtherPersonalSpacePosition);
+						// Avoid the other agent more, when it is further away from it's goal location.
+						const float OtherDistanceToGoal = FVector::Distance(OtherGhostLocation, Neighbors.MoveTargetCenters[Slot]);
+						const float OtherSteerFade = FMath::Clamp(OtherDistanceToGoal / StandingParams.GhostToTargetMaxDeviation, 0.0f, 1.0f);
+						const float SeparationStiffness = FMath::Lerp(GhostSeparationStiffness, MovingSeparationStiffness, OtherSteerFade);
 
-					FVector RelPos = Ghost.Location - OtherLocation;
-					RelPos.Z = 0.f;
-					const float ConDist = RelPos.Size();
-					const FVector ConNorm = ConDist > 0.f ? RelPos / ConDist : FVector::ForwardVector;
+						// Ghost separation
+						FVector RelPos = Ghost.Location - OtherGhostLocation;
+						RelPos.Z = 0.f; // we assume we work on a flat plane for now
+						const float ConDist = RelPos.Size();
+						const FVector ConNorm = ConDist > 0.f ? RelPos / ConDist : FVector::ForwardVector;
 
-					// Separation force (stay away from obstacles if possible)
-					const float PenSep = (TotalRadius + MovingSeparationDistance) - ConDist;
-					const float SeparationMag = UE::MassNavigation::Smooth(FMath::Clamp(PenSep / MovingSeparationDistance, 0.f, 1.f));
-					const FVector SeparationForce = ConNorm * MovingSeparationStiffness * SeparationMag;
+						// Separation force (stay away from obstacles if possible)
+						const float PenSep = (TotalRadius + GhostSeparationDistance) - ConDist;
+						const float SeparationMag = UE::MassNavigation::Smooth(FMath::Clamp(PenSep / GhostSeparationDistance, 0.f, 1.f));
+						const FVector SeparationForce = ConNorm * SeparationStiffness * SeparationMag;
 
-					GhostSteeringForce += SeparationForce;
+						NeighborSeparationForce += SeparationForce;
+					}
+					else
+					{
+						// Avoid more when the avoidance other is in front,
+						const FVector DirToOther = (OtherAgentLocation - Ghost.Location).GetSafeNormal();
+						const float DirectionalFade = FMath::Square(FMath::Max(0.0f, FVector::DotProduct(MoveTarget.Forward, DirToOther)));
+						const float DirectionScale = FMath::Lerp(StandingParams.MovingObstacleDirectionalScale, 1.0f, DirectionalFade);
+
+						// Treat the other agent as a 2D capsule protruding towards forward.
+	 					const FVector OtherBasePosition = OtherAgentLocation;
+						const FVector OtherPersonalSpacePosition = OtherAgentLocation + OtherAgentForward * OtherRadius * StandingParams.MovingObstaclePersonalSpaceScale * DirectionScale;
+						const FVector OtherLocation = FMath::ClosestPointOnSegment(Ghost.Location, OtherBasePosition, OtherPersonalSpacePosition);
+
+						FVector RelPos = Ghost.Location - OtherLocation;
+						RelPos.Z = 0.f;
+						const float ConDist = RelPos.Size();
+						const FVector ConNorm = ConDist > 0.f ? RelPos / ConDist : FVector::ForwardVector;
+
+						// Separation force (stay away from obstacles if possible)
+						const float PenSep = (TotalRadius + MovingSeparationDistance) - ConDist;
+						const float SeparationMag = UE::MassNavigation::Smooth(FMath::Clamp(PenSep / MovingSeparationDistance, 0.f, 1.f));
+						const FVector SeparationForce = ConNorm * MovingSeparationStiffness * SeparationMag;
+
+						NeighborSeparationForce += SeparationForce;
+					}
 				}
+				AvoidanceLOD.HeldForce = NeighborSeparationForce;
 			}
+			GhostSteeringForce += AvoidanceLOD.HeldForce;
 
 			GhostSteeringForce.Z = 0.0f;
 			GhostSteeringForce = UE::MassNavigation::ClampVector(GhostSteeringForce, StandingParams.GhostMaxAcceleration); // Assume unit mass
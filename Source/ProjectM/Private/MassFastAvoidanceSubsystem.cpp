@@ -0,0 +1,18 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#include "MassFastAvoidanceSubsystem.h"
+
+void FMassAvoidanceNeighborSnapshot::SetNum(const int32 NumSlots)
+{
+	// Contents get fully overwritten every frame so there's no need to initialize.
+	Flags.SetNumUninitialized(NumSlots, false);
+	Entities.SetNumUninitialized(NumSlots, false);
+	Locations.SetNumUninitialized(NumSlots, false);
+	Forwards.SetNumUninitialized(NumSlots, false);
+	Velocities.SetNumUninitialized(NumSlots, false);
+	Radii.SetNumUninitialized(NumSlots, false);
+	ColliderRadii.SetNumUninitialized(NumSlots, false);
+	PillHalfLengths.SetNumUninitialized(NumSlots, false);
+	GhostLocations.SetNumUninitialized(NumSlots, false);
+	MoveTargetCenters.SetNumUninitialized(NumSlots, false);
+}
@@ -8,6 +8,26 @@
 #include "MassNavigationFragments.h"
 #include "Engine/World.h"
 
+static void SetDefaultAvoidanceLODSettings(FMassFastAvoidanceLODSettings (&LODSettings)[EMassLOD::Off])
+{
+	LODSettings[EMassLOD::Medium].MaxNeighbors = 4;
+	LODSettings[EMassLOD::Medium].UpdateInterval = 0.1f;
+
+	LODSettings[EMassLOD::Low].MaxNeighbors = 2;
+	LODSettings[EMassLOD::Low].UpdateInterval = 0.25f;
+	LODSettings[EMassLOD::Low].bEnableEnvironmentAvoidance = false;
+}
+
+FMassFastMovingAvoidanceParameters::FMassFastMovingAvoidanceParameters()
+{
+	SetDefaultAvoidanceLODSettings(LODSettings);
+}
+
+FMassFastStandingAvoidanceParameters::FMassFastStandingAvoidanceParameters()
+{
+	SetDefaultAvoidanceLODSettings(LODSettings);
+}
+
 void UMassFastObstacleAvoidanceTrait::BuildTemplate(FMassEntityTemplateBuildContext& BuildContext, UWorld& World) const
 {
 	UMassEntitySubsystem* EntitySubsystem = UWorld::GetSubsystem<UMassEntitySubsystem>(&World);
@@ -19,6 +39,7 @@ void UMassFastObstacleAvoidanceTrait::BuildTemplate(FMassEntityTemplateBuildCont
 	BuildContext.AddFragment<FMassVelocityFragment>();
 	BuildContext.AddFragment<FMassForceFragment>();
 	BuildContext.AddFragment<FMassMoveTargetFragment>();
+	BuildContext.AddFragment<FMassFastAvoidanceLODFragment>();
 
 	const FMassFastMovingAvoidanceParameters MovingValidated = MovingParameters.GetValidated();
 	const uint32 MovingHash = UE::StructUtils::GetStructCrc32(FConstStructView::Make(MovingValidated));
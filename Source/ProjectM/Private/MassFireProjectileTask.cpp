@@ -17,8 +17,13 @@
 #include "MassEnemyTargetFinderProcessor.h"
 #include "MassSoundPerceptionSubsystem.h"
 #include "MassEntityView.h"
+#include "MassWorldContext.h"
+#include "MassVertexAnimationMontageProcessor.h"
+#include "MassTrackedVehicleOrientationProcessor.h"
+#include "MassTargetFinderSubsystem.h"
+#include "MassTrackTargetProcessor.h"
 
-void SpawnProjectile(const UWorld* World, const FVector& SpawnLocation, const FQuat& SpawnRotation, const FVector& InitialVelocity, const FMassEntityConfig& EntityConfig, const bool& bIsProjectileFromTeam1)
+void SpawnProjectile(const UWorld* World, const FVector& SpawnLocation, const FQuat& SpawnRotation, const FVector& InitialVelocity, const FMassEntityConfig& EntityConfig, const uint8 SourceTeamIndex)
 {
 	UMassSpawnerSubsystem* SpawnerSystem = UWorld::GetSubsystem<UMassSpawnerSubsystem>(World);
 	if (SpawnerSystem == nullptr)
@@ -26,8 +31,7 @@ void SpawnProjectile(const UWorld* World, const FVector& SpawnLocation, const FQ
 		return;
 	}
 
-	// TODO: A bit hacky to get first actor here.
-	const FMassEntityTemplate* EntityTemplate = EntityConfig.GetOrCreateEntityTemplate(*World->GetLevel(0)->Actors[0], *SpawnerSystem); // TODO: passing SpawnerSystem is a hack
+	const FMassEntityTemplate* EntityTemplate = EntityConfig.GetOrCreateEntityTemplate(GetMassWorldContextActor(*World), *SpawnerSystem); // TODO: passing SpawnerSystem is a hack
 	if (!EntityTemplate->IsValid())
 	{
 		return;
@@ -69,7 +73,7 @@ void SpawnProjectile(const UWorld* World, const FVector& SpawnLocation, const FQ
 
 	UMassSoundPerceptionSubsystem* SoundPerceptionSubsystem = UWorld::GetSubsystem<UMassSoundPerceptionSubsystem>(World);
 	check(SoundPerceptionSubsystem);
-	SoundPerceptionSubsystem->AddSoundPerception(SpawnLocation, bIsProjectileFromTeam1);
+	SoundPerceptionSubsystem->AddSoundPerception(SpawnLocation, SourceTeamIndex);
 }
 
 bool FMassFireProjectileTask::Link(FStateTreeLinker& Linker)
@@ -78,6 +82,8 @@ bool FMassFireProjectileTask::Link(FStateTreeLinker& Linker)
 	Linker.LinkExternalData(EntityTransformHandle);
 	Linker.LinkExternalData(TargetEntityHandle);
 	Linker.LinkExternalData(TeamMemberHandle);
+	Linker.LinkExternalData(TurretHandle);
+	Linker.LinkExternalData(VertexAnimationMontageHandle);
 
 	Linker.LinkInstanceDataProperty(EntityConfigHandle, STATETREE_INSTANCEDATA_PROPERTY(FMassFireProjectileTaskInstanceData, EntityConfig));
 	Linker.LinkInstanceDataProperty(WeaponCoolDownSecondsHandle, STATETREE_INSTANCEDATA_PROPERTY(FMassFireProjectileTaskInstanceData, WeaponCoolDownSeconds));
@@ -109,26 +115,53 @@ EStateTreeRunStatus FMassFireProjectileTask::EnterState(FStateTreeExecutionConte
 	const FTransformFragment& StateTreeEntityTransformFragment = Context.GetExternalData(EntityTransformHandle);
 	const FTransform& StateTreeEntityTransform = StateTreeEntityTransformFragment.GetTransform();
 	const FVector StateTreeEntityLocation = StateTreeEntityTransform.GetLocation();
-	const FVector StateTreeEntityCurrentForward = StateTreeEntityTransform.GetRotation().GetForwardVector();
 
-	const FMassEntityConfig& EntityConfig = Context.GetInstanceData(EntityConfigHandle);
 	const bool bIsFromSoldier = StateTreeEntityView.HasTag< FMassProjectileDamagableSoldierTag>();
+
+	// Vehicles with a turret fire along it, and only once the target is inside its firing cone.
+	FTransform FiringTransform = StateTreeEntityTransform;
+	if (const FMassTurretFragment* TurretFragment = Context.GetExternalDataPtr(TurretHandle))
+	{
+		const UMassTargetFinderSubsystem* TargetFinderSubsystem = UWorld::GetSubsystem<UMassTargetFinderSubsystem>(World);
+		check(TargetFinderSubsystem);
+		const FMassTargetLocationStore& TargetLocationStore = TargetFinderSubsystem->GetTargetLocationStore();
+		const FTargetEntityFragment& TargetEntityFragment = Context.GetExternalData(TargetEntityHandle);
+
+		// Same aim point as the turret turns towards in UMassTrackedVehicleOrientationProcessor.
+		int32 TargetSlot = TargetEntityFragment.TargetLocationSlot;
+		const bool bHasTarget = TargetEntityFragment.Entity.IsSet() && TargetLocationStore.ResolveSlot(TargetSlot, TargetEntityFragment.Entity);
+		const float ProjectileXYSpeed = UMassTrackTargetProcessor_LeadTargets ? GetProjectileInitialXYVelocityMagnitude(bIsFromSoldier) : 0.f;
+		if (!bHasTarget || !TurretFragment->IsInFiringCone(StateTreeEntityTransform, TargetLocationStore.PredictLocation(TargetSlot, StateTreeEntityLocation, ProjectileXYSpeed) - StateTreeEntityLocation))
+		{
+			MassSignalSubsystem.DelaySignalEntity(UE::Mass::Signals::NewStateTreeTaskRequired, MassContext.GetEntity(), 0.25f);
+			return EStateTreeRunStatus::Running;
+		}
+		FiringTransform.SetRotation(TurretFragment->GetRotation(StateTreeEntityTransform));
+	}
+	const FVector StateTreeEntityCurrentForward = FiringTransform.GetRotation().GetForwardVector();
+
+	const FMassEntityConfig& EntityConfig = Context.GetInstanceData(EntityConfigHandle);
 	const float InitialVelocityMagnitude = GetProjectileInitialXYVelocityMagnitude(bIsFromSoldier);
 	const FTargetEntityFragment& StateTreeEntityTargetEntityFragment = Context.GetExternalData(TargetEntityHandle);
 	const float InitialVelocityZMagnitude = StateTreeEntityTargetEntityFragment.VerticalAimOffset;
 	const FVector InitialVelocity = (StateTreeEntityCurrentForward * InitialVelocityMagnitude) + FVector(0.f, 0.f, InitialVelocityZMagnitude);
 
-	const FVector SpawnLocation = StateTreeEntityLocation + UMassEnemyTargetFinderProcessor::GetProjectileSpawnLocationOffset(StateTreeEntityTransform, bIsFromSoldier);
-	const FQuat SpawnRotation = StateTreeEntityTransform.GetRotation();
+	const FVector SpawnLocation = StateTreeEntityLocation + UMassEnemyTargetFinderProcessor::GetProjectileSpawnLocationOffset(FiringTransform, bIsFromSoldier);
+	const FQuat SpawnRotation = FiringTransform.GetRotation();
 
 	const FTeamMemberFragment& StateTreeEntityTeamMemberFragment = Context.GetExternalData(TeamMemberHandle);
-	const bool& bIsProjectileSourceTeam1 = StateTreeEntityTeamMemberFragment.IsOnTeam1;
+	const uint8 ProjectileSourceTeamIndex = StateTreeEntityTeamMemberFragment.TeamIndex;
 
-	AsyncTask(ENamedThreads::GameThread, [EntityConfig, InitialVelocity, SpawnLocation, World, SpawnRotation, bIsProjectileSourceTeam1]()
+	AsyncTask(ENamedThreads::GameThread, [EntityConfig, InitialVelocity, SpawnLocation, World, SpawnRotation, ProjectileSourceTeamIndex]()
 	{
-		SpawnProjectile(World, SpawnLocation, SpawnRotation, InitialVelocity, EntityConfig, bIsProjectileSourceTeam1);
+		SpawnProjectile(World, SpawnLocation, SpawnRotation, InitialVelocity, EntityConfig, ProjectileSourceTeamIndex);
 	});
 
+	if (FMassVertexAnimationMontageFragment* VertexAnimationMontageFragment = Context.GetExternalDataPtr(VertexAnimationMontageHandle))
+	{
+		VertexAnimationMontageFragment->Play(FiringVertexAnimationMontage, World->GetTimeSeconds());
+	}
+
 	MassSignalSubsystem.DelaySignalEntity(UE::Mass::Signals::NewStateTreeTaskRequired, MassContext.GetEntity(), 1.0f); // TODO: needed?
 
 	LastWeaponFireTimeSeconds = WorldRealTimeSeconds;
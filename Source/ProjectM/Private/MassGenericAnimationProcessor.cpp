@@ -14,7 +14,6 @@
 #include "MassLODFragments.h"
 #include "MassRepresentationTypes.h"
 #include "MotionWarpingComponent.h"
-#include "MassEntityView.h"
 #include "MassAIBehaviorTypes.h"
 #include "MassNavigationFragments.h"
 #include "Steering/MassSteeringFragments.h"
@@ -28,6 +27,7 @@ void FMassGenericMontageFragment::Request(const UE::CrowdInteractionAnim::FReque
 {
 	InteractionRequest = InRequest;
 	SkippedTime = 0.0f;
+	PlayedOnActor.Reset();
 	MontageInstance.Initialize(InRequest.QueryResult.Animation.Get(), InteractionRequest.QueryResult.AnimStartTime);
 }
 
@@ -36,17 +36,53 @@ void FMassGenericMontageFragment::Clear()
 	*this = FMassGenericMontageFragment();
 }
 
+void FMassGenericActorComponents::Resolve(const AActor* InActor)
+{
+	check(IsInGameThread());
+
+	Reset();
+	if (!InActor)
+	{
+		return;
+	}
+
+	Actor = InActor;
+	if (const ACharacter* Character = Cast<ACharacter>(InActor))
+	{
+		Mesh = Character->GetMesh();
+	}
+	else
+	{
+		Mesh = InActor->FindComponentByClass<USkeletalMeshComponent>();
+	}
+	MotionWarpingComponent = InActor->FindComponentByClass<UMotionWarpingComponent>();
+
+	TArray<USkeletalMeshComponent*> SkeletalMeshComponents;
+	InActor->GetComponents<USkeletalMeshComponent>(SkeletalMeshComponents, true);
+	for (USkeletalMeshComponent* SkeletalMeshComponent : SkeletalMeshComponents)
+	{
+		if (SkeletalMeshComponent != Mesh.Get())
+		{
+			AttachedMeshes.Add(SkeletalMeshComponent);
+		}
+	}
+}
+
+UAnimInstance* FMassGenericActorComponents::GetAnimInstance() const
+{
+	const USkeletalMeshComponent* SkeletalMeshComponent = Mesh.Get();
+	return SkeletalMeshComponent ? SkeletalMeshComponent->GetAnimInstance() : nullptr;
+}
+
 UMassGenericAnimationProcessor::UMassGenericAnimationProcessor()
 {
 	ExecutionFlags = (int32)(EProcessorExecutionFlags::Client | EProcessorExecutionFlags::Standalone);
 	ExecutionOrder.ExecuteInGroup = UE::Mass::ProcessorGroupNames::Tasks;
 	ExecutionOrder.ExecuteAfter.Add(UE::Mass::ProcessorGroupNames::SyncWorldToMass);
 	ExecutionOrder.ExecuteAfter.Add(UE::Mass::ProcessorGroupNames::Representation);
-
-	bRequiresGameThreadExecution = true;
 }
 
-void UMassGenericAnimationProcessor::UpdateAnimationFragmentData(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context, float GlobalTime, TArray<FMassEntityHandle, TInlineAllocator<32>>& ActorEntities)
+void UMassGenericAnimationProcessor::UpdateAnimationFragmentData(FMassExecutionContext& Context, float GlobalTime, TQueue<FMassGenericActorAnimationRequest, EQueueMode::Mpsc>& ActorAnimationRequests)
 {
 	TArrayView<FGenericAnimationFragment> AnimationDataList = Context.GetMutableFragmentView<FGenericAnimationFragment>();
 	TConstArrayView<FMassGenericMontageFragment> MontageDataList = Context.GetFragmentView<FMassGenericMontageFragment>();
@@ -60,13 +96,20 @@ void UMassGenericAnimationProcessor::UpdateAnimationFragmentData(UMassEntitySubs
 		const FMassRepresentationFragment& Visualization = VisualizationList[EntityIdx];
 		const FMassActorFragment& ActorFragment = ActorInfoList[EntityIdx];
 
+		const bool bWasActor = (Visualization.PrevRepresentation == EMassRepresentationType::HighResSpawnedActor) || (Visualization.PrevRepresentation == EMassRepresentationType::LowResSpawnedActor);
+		const bool bIsActor = (Visualization.CurrentRepresentation == EMassRepresentationType::HighResSpawnedActor) || (Visualization.CurrentRepresentation == EMassRepresentationType::LowResSpawnedActor);
+
+		// The actor was released, its components are resolved again for the next actor.
+		if (!bIsActor && !AnimationData.ActorComponents.Actor.IsExplicitlyNull())
+		{
+			AnimationData.ActorComponents.Reset();
+		}
+
 		if (!ActorFragment.IsOwnedByMass())
 		{
 			continue;
 		}
 
-		const bool bWasActor = (Visualization.PrevRepresentation == EMassRepresentationType::HighResSpawnedActor) || (Visualization.PrevRepresentation == EMassRepresentationType::LowResSpawnedActor);
-		const bool bIsActor = (Visualization.CurrentRepresentation == EMassRepresentationType::HighResSpawnedActor) || (Visualization.CurrentRepresentation == EMassRepresentationType::LowResSpawnedActor);
 		AnimationData.bSwappedThisFrame = (bWasActor != bIsActor);
 
 		if (!MontageDataList.IsEmpty() && MontageDataList[EntityIdx].MontageInstance.SequenceChangedThisFrame())
@@ -74,22 +117,20 @@ void UMassGenericAnimationProcessor::UpdateAnimationFragmentData(UMassEntitySubs
 			AnimationData.GlobalStartTime = GlobalTime - MontageDataList[EntityIdx].MontageInstance.GetPositionInSection();
 		}
 
-		switch (Visualization.CurrentRepresentation)
-		{
-		case EMassRepresentationType::LowResSpawnedActor:
-		case EMassRepresentationType::HighResSpawnedActor:
+		// Only actors with a montage need the game thread, and only when the montage isn't playing on their current actor yet or they were just
+		// swapped to an actor and need their pose updated.
+		if (bIsActor && !MontageDataList.IsEmpty() && MontageDataList[EntityIdx].MontageInstance.GetMontage())
 		{
-			FMassEntityHandle Entity = Context.GetEntity(EntityIdx);
-			ActorEntities.Add(Entity);
-			break;
-		}
-		default:
-			break;
+			const bool bPlayedOnActor = MontageDataList[EntityIdx].PlayedOnActor == TWeakObjectPtr<const AActor>(ActorFragment.Get());
+			if (!bPlayedOnActor || AnimationData.bSwappedThisFrame)
+			{
+				ActorAnimationRequests.Enqueue({ Context.GetEntity(EntityIdx), AnimationData.bSwappedThisFrame });
+			}
 		}
 	}
 }
 
-void UMassGenericAnimationProcessor::UpdateVertexAnimationState(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context, float GlobalTime)
+void UMassGenericAnimationProcessor::UpdateVertexAnimationState(FMassExecutionContext& Context, float GlobalTime) const
 {
 	const int32 NumEntities = Context.GetNumEntities();
 	TArrayView<FGenericAnimationFragment> AnimationDataList = Context.GetMutableFragmentView<FGenericAnimationFragment>();
@@ -148,94 +189,6 @@ void UMassGenericAnimationProcessor::UpdateVertexAnimationState(UMassEntitySubsy
 	}
 }
 
-void UMassGenericAnimationProcessor::UpdateSkeletalAnimation(UMassEntitySubsystem& EntitySubsystem, float GlobalTime, TArrayView<FMassEntityHandle> ActorEntities)
-{
-	if (ActorEntities.Num() <= 0)
-	{
-		return;
-	}
-
-	for (FMassEntityHandle& Entity : ActorEntities)
-	{
-		FMassEntityView EntityView(EntitySubsystem, Entity);
-
-		FGenericAnimationFragment& AnimationData = EntityView.GetFragmentData<FGenericAnimationFragment>();
-		FTransformFragment& TransformFragment = EntityView.GetFragmentData<FTransformFragment>();
-		FMassRepresentationFragment& Visualization = EntityView.GetFragmentData<FMassRepresentationFragment>();
-
-		const FMassActorFragment& ActorFragment = EntityView.GetFragmentData<FMassActorFragment>();
-		const FMassLookAtFragment* LookAtFragment = EntityView.GetFragmentDataPtr<FMassLookAtFragment>();
-		const FMassMoveTargetFragment* MovementTargetFragment = EntityView.GetFragmentDataPtr<FMassMoveTargetFragment>();
-		const FMassSteeringFragment* SteeringFragment = EntityView.GetFragmentDataPtr<FMassSteeringFragment>();
-
-		const AActor* Actor = ActorFragment.Get();
-		UAnimInstance* AnimInstance = GetAnimInstanceFromActor(Actor);
-
-		const FMassGenericMontageFragment* MontageFragment = EntitySubsystem.GetFragmentDataPtr<FMassGenericMontageFragment>(Entity);
-		UAnimMontage* Montage = MontageFragment ? MontageFragment->MontageInstance.GetMontage() : nullptr;
-
-		if (Montage == nullptr)
-		{
-			continue;
-		}
-
-		if (AnimInstance && Actor)
-		{
-			// Don't play the montage again, even if it's blending out. UAnimInstance::GetCurrentActiveMontage and AnimInstance::Montage_IsPlaying return false if the montage is blending out.
-			bool bMontageAlreadyPlaying = false;
-			for (int32 InstanceIndex = 0; InstanceIndex < AnimInstance->MontageInstances.Num(); InstanceIndex++)
-			{
-				FAnimMontageInstance* MontageInstance = AnimInstance->MontageInstances[InstanceIndex];
-				if (MontageInstance && MontageInstance->Montage == Montage && MontageInstance->IsPlaying())
-				{
-					bMontageAlreadyPlaying = true;
-				}
-			}
-
-			if (!bMontageAlreadyPlaying)
-			{
-				UMotionWarpingComponent* MotionWarpingComponent = Actor->FindComponentByClass<UMotionWarpingComponent>();
-				if (MotionWarpingComponent && MontageFragment->InteractionRequest.AlignmentTrack != NAME_None)
-				{
-					const FName SyncPointName = MontageFragment->InteractionRequest.AlignmentTrack;
-					const FTransform& SyncTransform = MontageFragment->InteractionRequest.QueryResult.SyncTransform;
-					MotionWarpingComponent->AddOrUpdateWarpTargetFromTransform(SyncPointName, SyncTransform);
-				}
-
-				FAlphaBlendArgs BlendIn;
-				BlendIn = Montage->GetBlendInArgs();
-				// Instantly blend in if we swapped to skeletal mesh this frame to avoid pop
-				BlendIn.BlendTime = AnimationData.bSwappedThisFrame ? 0.0f : BlendIn.BlendTime;
-
-				AnimInstance->Montage_PlayWithBlendIn(Montage, BlendIn, 1.0f, EMontagePlayReturnType::MontageLength, MontageFragment->MontageInstance.GetPosition());
-			}
-
-			// Force an animation update if we swapped this frame to prevent t-posing
-			if (AnimationData.bSwappedThisFrame)
-			{
-				if (USkeletalMeshComponent* OwningComp = AnimInstance->GetOwningComponent())
-				{
-					TArray<USkeletalMeshComponent*> MeshComps;
-
-					// Tick main component and all attached parts to avoid a frame of t-posing
-					// We have to refresh bone transforms too because this can happen after the render state has been updated					
-
-					OwningComp->TickAnimation(0.0f, false);
-					OwningComp->RefreshBoneTransforms();
-
-					Actor->GetComponents<USkeletalMeshComponent>(MeshComps, true);
-					MeshComps.Remove(OwningComp);
-					for (USkeletalMeshComponent* MeshComp : MeshComps)
-					{
-						MeshComp->TickAnimation(0.0f, false);
-						MeshComp->RefreshBoneTransforms();
-					}
-				}
-			}
-		}
-	}
-}
-
 void UMassGenericAnimationProcessor::ConfigureQueries()
 {
 	AnimationEntityQuery_Conditional.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadWrite);
@@ -268,21 +221,21 @@ void UMassGenericAnimationProcessor::Initialize(UObject& Owner)
 
 	World = Owner.GetWorld();
 	check(World);
+	AnimationSubsystem = UWorld::GetSubsystem<UMassGenericAnimationSubsystem>(World);
 }
 
 void UMassGenericAnimationProcessor::Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context)
 {
-	check(World);
+	check(World && AnimationSubsystem);
 
 	QUICK_SCOPE_CYCLE_COUNTER(UMassGenericAnimationProcessor_Run);
 
 	const float GlobalTime = World->GetTimeSeconds();
 
-	TArray<FMassEntityHandle, TInlineAllocator<32>> ActorEntities;
-	
+	TQueue<FMassEntityHandle, EQueueMode::Mpsc> FinishedMontageEntities;
 	{
 		QUICK_SCOPE_CYCLE_COUNTER(UMassGenericAnimationProcessor_UpdateMontage);
-		MontageEntityQuery.ForEachEntityChunk(EntitySubsystem, Context, [this, GlobalTime, &ActorEntities, &EntitySubsystem](FMassExecutionContext& Context)
+		MontageEntityQuery.ParallelForEachEntityChunk(EntitySubsystem, Context, [GlobalTime, &FinishedMontageEntities](FMassExecutionContext& Context)
 		{
 			const int32 NumEntities = Context.GetNumEntities();
 			TArrayView<FMassGenericMontageFragment> MontageDataList = Context.GetMutableFragmentView<FMassGenericMontageFragment>();
@@ -317,7 +270,7 @@ void UMassGenericAnimationProcessor::Execute(UMassEntitySubsystem& EntitySubsyst
 					{
 						// If we've skipped over the remaining duration of the montage clear our fragment
 						MontageFragment.Clear();
-						Context.Defer().PushCommand(FCommandRemoveFragment(Context.GetEntity(EntityIdx), FMassGenericMontageFragment::StaticStruct()));
+						FinishedMontageEntities.Enqueue(Context.GetEntity(EntityIdx));
 					}
 					else
 					{
@@ -358,23 +311,18 @@ void UMassGenericAnimationProcessor::Execute(UMassEntitySubsystem& EntitySubsyst
 	}
 
 	{
-		QUICK_SCOPE_CYCLE_COUNTER(UMassGenericAnimationProcessor_UpdateAnimationFragmentData);
-		AnimationEntityQuery_Conditional.ForEachEntityChunk(EntitySubsystem, Context, [this, GlobalTime, &ActorEntities, &EntitySubsystem](FMassExecutionContext& Context)
-		{
-			UMassGenericAnimationProcessor::UpdateAnimationFragmentData(EntitySubsystem, Context, GlobalTime, ActorEntities);
-		});
-	}
-	{
-		QUICK_SCOPE_CYCLE_COUNTER(UMassGenericAnimationProcessor_UpdateVertexAnimationState);
-		AnimationEntityQuery_Conditional.ForEachEntityChunk(EntitySubsystem, Context, [this, GlobalTime, &EntitySubsystem](FMassExecutionContext& Context)
+		QUICK_SCOPE_CYCLE_COUNTER(UMassGenericAnimationProcessor_UpdateAnimationState);
+		TQueue<FMassGenericActorAnimationRequest, EQueueMode::Mpsc>& ActorAnimationRequests = AnimationSubsystem->GetActorAnimationRequests();
+		AnimationEntityQuery_Conditional.ParallelForEachEntityChunk(EntitySubsystem, Context, [this, GlobalTime, &ActorAnimationRequests](FMassExecutionContext& Context)
 		{
-			UMassGenericAnimationProcessor::UpdateVertexAnimationState(EntitySubsystem, Context, GlobalTime);
+			UpdateAnimationFragmentData(Context, GlobalTime, ActorAnimationRequests);
+			UpdateVertexAnimationState(Context, GlobalTime);
 		});
 	}
 
 	{
 		QUICK_SCOPE_CYCLE_COUNTER(UMassGenericAnimationProcessor_ConsumeRootMotion);
-		MontageEntityQuery_Conditional.ForEachEntityChunk(EntitySubsystem, Context, [this, &EntitySubsystem](FMassExecutionContext& Context)
+		MontageEntityQuery_Conditional.ParallelForEachEntityChunk(EntitySubsystem, Context, [](FMassExecutionContext& Context)
 		{
 			TArrayView<FTransformFragment> TransformList = Context.GetMutableFragmentView<FTransformFragment>();
 			TConstArrayView<FMassRepresentationFragment> VisualizationList = Context.GetFragmentView<FMassRepresentationFragment>();
@@ -461,31 +409,146 @@ void UMassGenericAnimationProcessor::Execute(UMassEntitySubsystem& EntitySubsyst
 		});
 	}
 
+	FMassEntityHandle FinishedMontageEntity;
+	while (FinishedMontageEntities.Dequeue(FinishedMontageEntity))
 	{
-		QUICK_SCOPE_CYCLE_COUNTER(UMassGenericAnimationProcessor_UpdateSkeletalAnimation);
-		// Pull out UAnimToTextureDataAsset from the inner loop to avoid the resolve cost, which is extremely high in PIE.
-		UMassGenericAnimationProcessor::UpdateSkeletalAnimation(EntitySubsystem, GlobalTime, MakeArrayView(ActorEntities));
+		Context.Defer().PushCommand(FCommandRemoveFragment(FinishedMontageEntity, FMassGenericMontageFragment::StaticStruct()));
 	}
 }
 
-class UAnimInstance* UMassGenericAnimationProcessor::GetAnimInstanceFromActor(const AActor* Actor)
+//----------------------------------------------------------------------//
+//  UMassGenericActorAnimationProcessor
+//----------------------------------------------------------------------//
+UMassGenericActorAnimationProcessor::UMassGenericActorAnimationProcessor()
+{
+	ExecutionFlags = (int32)(EProcessorExecutionFlags::Client | EProcessorExecutionFlags::Standalone);
+	ExecutionOrder.ExecuteInGroup = UE::Mass::ProcessorGroupNames::Tasks;
+	ExecutionOrder.ExecuteAfter.Add(TEXT("MassGenericAnimationProcessor"));
+
+	bRequiresGameThreadExecution = true;
+}
+
+void UMassGenericActorAnimationProcessor::ConfigureQueries()
+{
+	EntityQuery.AddRequirement<FMassActorFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FGenericAnimationFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FMassGenericMontageFragment>(EMassFragmentAccess::ReadWrite);
+}
+
+void UMassGenericActorAnimationProcessor::Initialize(UObject& Owner)
 {
-	const USkeletalMeshComponent* SkeletalMeshComponent = nullptr;
-	if (const ACharacter* Character = Cast<ACharacter>(Actor))
+	Super::Initialize(Owner);
+
+	AnimationSubsystem = UWorld::GetSubsystem<UMassGenericAnimationSubsystem>(Owner.GetWorld());
+}
+
+void UMassGenericActorAnimationProcessor::Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context)
+{
+	check(AnimationSubsystem);
+
+	QUICK_SCOPE_CYCLE_COUNTER(UMassGenericActorAnimationProcessor_Run);
+
+	TransientRequests.Reset();
+	FMassGenericActorAnimationRequest Request;
+	while (AnimationSubsystem->GetActorAnimationRequests().Dequeue(Request))
 	{
-		SkeletalMeshComponent = Character->GetMesh();
+		TransientRequests.Add(Request.Entity, Request.bSwappedThisFrame);
+	}
+
+	if (TransientRequests.Num() == 0)
+	{
+		return;
 	}
-	else if (Actor)
+
+	// Only entities with a montage match, so this doesn't visit every actor represented entity.
+	EntityQuery.ForEachEntityChunk(EntitySubsystem, Context, [this](FMassExecutionContext& Context)
+	{
+		const TConstArrayView<FMassActorFragment> ActorList = Context.GetFragmentView<FMassActorFragment>();
+		const TArrayView<FGenericAnimationFragment> AnimationDataList = Context.GetMutableFragmentView<FGenericAnimationFragment>();
+		const TArrayView<FMassGenericMontageFragment> MontageDataList = Context.GetMutableFragmentView<FMassGenericMontageFragment>();
+
+		const int32 NumEntities = Context.GetNumEntities();
+		for (int32 EntityIdx = 0; EntityIdx < NumEntities; EntityIdx++)
+		{
+			if (const bool* bSwappedThisFrame = TransientRequests.Find(Context.GetEntity(EntityIdx)))
+			{
+				UpdateSkeletalAnimation(ActorList[EntityIdx].Get(), MontageDataList[EntityIdx], AnimationDataList[EntityIdx], *bSwappedThisFrame);
+			}
+		}
+	});
+}
+
+void UMassGenericActorAnimationProcessor::UpdateSkeletalAnimation(const AActor* Actor, FMassGenericMontageFragment& MontageFragment, FGenericAnimationFragment& AnimationData, const bool bSwappedThisFrame)
+{
+	UAnimMontage* Montage = MontageFragment.MontageInstance.GetMontage();
+	if (Montage == nullptr)
 	{
-		SkeletalMeshComponent = Actor->FindComponentByClass<USkeletalMeshComponent>();
+		return;
 	}
 
-	if (SkeletalMeshComponent)
+	// Only a spawned or recycled actor has its components looked up.
+	FMassGenericActorComponents& ActorComponents = AnimationData.ActorComponents;
+	if (!ActorComponents.IsResolvedFor(Actor))
 	{
-		return SkeletalMeshComponent->GetAnimInstance();
+		ActorComponents.Resolve(Actor);
 	}
+	UAnimInstance* AnimInstance = ActorComponents.GetAnimInstance();
+
+	if (AnimInstance && Actor)
+	{
+		// Don't play the montage again, even if it's blending out, e.g. when the actor was swapped away and back. UAnimInstance::GetCurrentActiveMontage and AnimInstance::Montage_IsPlaying return false if the montage is blending out.
+		bool bMontageAlreadyPlaying = false;
+		for (int32 InstanceIndex = 0; InstanceIndex < AnimInstance->MontageInstances.Num(); InstanceIndex++)
+		{
+			FAnimMontageInstance* MontageInstance = AnimInstance->MontageInstances[InstanceIndex];
+			if (MontageInstance && MontageInstance->Montage == Montage && MontageInstance->IsPlaying())
+			{
+				bMontageAlreadyPlaying = true;
+			}
+		}
+
+		if (!bMontageAlreadyPlaying)
+		{
+			UMotionWarpingComponent* MotionWarpingComponent = ActorComponents.MotionWarpingComponent.Get();
+			if (MotionWarpingComponent && MontageFragment.InteractionRequest.AlignmentTrack != NAME_None)
+			{
+				const FName SyncPointName = MontageFragment.InteractionRequest.AlignmentTrack;
+				const FTransform& SyncTransform = MontageFragment.InteractionRequest.QueryResult.SyncTransform;
+				MotionWarpingComponent->AddOrUpdateWarpTargetFromTransform(SyncPointName, SyncTransform);
+			}
+
+			FAlphaBlendArgs BlendIn;
+			BlendIn = Montage->GetBlendInArgs();
+			// Instantly blend in if we swapped to skeletal mesh this frame to avoid pop
+			BlendIn.BlendTime = bSwappedThisFrame ? 0.0f : BlendIn.BlendTime;
+
+			AnimInstance->Montage_PlayWithBlendIn(Montage, BlendIn, 1.0f, EMontagePlayReturnType::MontageLength, MontageFragment.MontageInstance.GetPosition());
+		}
+		MontageFragment.PlayedOnActor = Actor;
+
+		// Force an animation update if we swapped this frame to prevent t-posing
+		if (bSwappedThisFrame)
+		{
+			if (USkeletalMeshComponent* OwningComp = AnimInstance->GetOwningComponent())
+			{
+				// Tick main component and all attached parts to avoid a frame of t-posing
+				// We have to refresh bone transforms too because this can happen after the render state has been updated					
+
+				OwningComp->TickAnimation(0.0f, false);
+				OwningComp->RefreshBoneTransforms();
 
-	return nullptr;
+				for (const TWeakObjectPtr<USkeletalMeshComponent>& AttachedMesh : ActorComponents.AttachedMeshes)
+				{
+					USkeletalMeshComponent* MeshComp = AttachedMesh.Get();
+					if (MeshComp && MeshComp != OwningComp)
+					{
+						MeshComp->TickAnimation(0.0f, false);
+						MeshComp->RefreshBoneTransforms();
+					}
+				}
+			}
+		}
+	}
 }
 
 UGenericAnimationFragmentInitializer::UGenericAnimationFragmentInitializer()
@@ -9,6 +9,9 @@
 #include "MassLODFragments.h"
 #include "AnimToTextureInstancePlaybackHelpers.h"
 #include "MassCommonTypes.h"
+#include "MassVisualEffectsSubsystem.h"
+#include "MassVertexAnimationMontageProcessor.h"
+#include "MassSquadProxyProcessor.h"
 
 //----------------------------------------------------------------------//
 //  UMassGenericUpdateISMVertexAnimationProcessor
@@ -24,6 +27,9 @@ void UMassGenericUpdateISMVertexAnimationProcessor::ConfigureQueries()
 	Super::ConfigureQueries();
 
 	EntityQuery.AddRequirement<FGenericAnimationFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FMassVertexAnimationMontageFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
+	EntityQuery.AddRequirement<FMassPooledVisualEffectFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
+	EntityQuery.AddTagRequirement<FMassAggregatedIntoSquadProxyTag>(EMassFragmentPresence::None);
 }
 
 void UMassGenericUpdateISMVertexAnimationProcessor::Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context)
@@ -38,10 +44,17 @@ void UMassGenericUpdateISMVertexAnimationProcessor::Execute(UMassEntitySubsystem
 		TArrayView<FMassRepresentationFragment> RepresentationList = Context.GetMutableFragmentView<FMassRepresentationFragment>();
 		TConstArrayView<FMassRepresentationLODFragment> RepresentationLODList = Context.GetFragmentView<FMassRepresentationLODFragment>();
 		TArrayView<FGenericAnimationFragment> AnimationDataList = Context.GetMutableFragmentView<FGenericAnimationFragment>();
+		TConstArrayView<FMassVertexAnimationMontageFragment> MontageList = Context.GetFragmentView<FMassVertexAnimationMontageFragment>();
+		TConstArrayView<FMassPooledVisualEffectFragment> PooledList = Context.GetFragmentView<FMassPooledVisualEffectFragment>();
 
 		const int32 NumEntities = Context.GetNumEntities();
 		for (int32 EntityIdx = 0; EntityIdx < NumEntities; EntityIdx++)
 		{
+			if (!PooledList.IsEmpty() && PooledList[EntityIdx].bIsDormant)
+			{
+				continue;
+			}
+
 			const FMassEntityHandle Entity = Context.GetEntity(EntityIdx);
 			const FTransformFragment& TransformFragment = TransformList[EntityIdx];
 			const FMassRepresentationLODFragment& RepresentationLOD = RepresentationLODList[EntityIdx];
@@ -51,7 +64,15 @@ void UMassGenericUpdateISMVertexAnimationProcessor::Execute(UMassEntitySubsystem
 			if (Representation.CurrentRepresentation == EMassRepresentationType::StaticMeshInstance)
 			{
 				UpdateISMTransform(GetTypeHash(Context.GetEntity(EntityIdx)), ISMInfo[Representation.StaticMeshDescIndex], TransformFragment.GetTransform(), Representation.PrevTransform, RepresentationLOD.LODSignificance, Representation.PrevLODSignificance);
-				UpdateISMVertexAnimation(ISMInfo[Representation.StaticMeshDescIndex], AnimationData, RepresentationLOD.LODSignificance, Representation.PrevLODSignificance);
+				if (MontageList.IsEmpty())
+				{
+					UpdateISMVertexAnimation(ISMInfo[Representation.StaticMeshDescIndex], AnimationData, RepresentationLOD.LODSignificance, Representation.PrevLODSignificance);
+				}
+				else
+				{
+					const FMassBlendedVertexAnimationInstanceData InstanceData = UMassVertexAnimationMontageProcessor::MakeInstancePlaybackData(AnimationData, MontageList[EntityIdx]);
+					ISMInfo[Representation.StaticMeshDescIndex].AddBatchedCustomData<FMassBlendedVertexAnimationInstanceData>(InstanceData, RepresentationLOD.LODSignificance, Representation.PrevLODSignificance);
+				}
 			}
 			Representation.PrevTransform = TransformFragment.GetTransform();
 			Representation.PrevLODSignificance = RepresentationLOD.LODSignificance;
@@ -60,10 +81,16 @@ void UMassGenericUpdateISMVertexAnimationProcessor::Execute(UMassEntitySubsystem
 }
 
 void UMassGenericUpdateISMVertexAnimationProcessor::UpdateISMVertexAnimation(FMassInstancedStaticMeshInfo& ISMInfo, FGenericAnimationFragment& AnimationData, const float LODSignificance, const float PrevLODSignificance, const int32 NumFloatsToPad /*= 0*/)
+{
+	const FAnimToTextureInstancePlaybackData InstanceData = MakeInstancePlaybackData(AnimationData);
+	ISMInfo.AddBatchedCustomData<FAnimToTextureInstancePlaybackData>(InstanceData, LODSignificance, PrevLODSignificance, NumFloatsToPad);
+}
+
+FAnimToTextureInstancePlaybackData UMassGenericUpdateISMVertexAnimationProcessor::MakeInstancePlaybackData(const FGenericAnimationFragment& AnimationData)
 {
 	FAnimToTextureInstancePlaybackData InstanceData;
 	UAnimToTextureInstancePlaybackLibrary::AnimStateFromDataAsset(AnimationData.AnimToTextureData.Get(), AnimationData.AnimationStateIndex, InstanceData.CurrentState);
 	InstanceData.CurrentState.GlobalStartTime = AnimationData.GlobalStartTime;
 	InstanceData.CurrentState.PlayRate = AnimationData.PlayRate;
-	ISMInfo.AddBatchedCustomData<FAnimToTextureInstancePlaybackData>(InstanceData, LODSignificance, PrevLODSignificance, NumFloatsToPad);
+	return InstanceData;
 }
@@ -32,6 +32,7 @@ void UMassMoveTargetForwardCompleteProcessor::ConfigureQueries()
 	EntityQuery.AddRequirement<FMassMoveTargetFragment>(EMassFragmentAccess::ReadWrite);
 	EntityQuery.AddRequirement<FMassMoveForwardCompleteSignalFragment>(EMassFragmentAccess::ReadOnly);
 	EntityQuery.AddRequirement<FMassNavMeshMoveFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FMassTurretFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
 	EntityQuery.AddTagRequirement<FMassNeedsMoveTargetForwardCompleteSignalTag>(EMassFragmentPresence::All);
 }
 
@@ -50,10 +51,13 @@ void UMassMoveTargetForwardCompleteProcessor::Execute(UMassEntitySubsystem& Enti
 		const TArrayView<FMassMoveTargetFragment> MoveTargetList = Context.GetMutableFragmentView<FMassMoveTargetFragment>();
 		const TConstArrayView<FMassStashedMoveTargetFragment> StashedMoveTargetList = Context.GetFragmentView<FMassStashedMoveTargetFragment>();
 		const TArrayView<FMassNavMeshMoveFragment> NavMeshMoveList = Context.GetMutableFragmentView<FMassNavMeshMoveFragment>();
+		const TConstArrayView<FMassTurretFragment> TurretList = Context.GetFragmentView<FMassTurretFragment>();
 
 		for (int32 EntityIndex = 0; EntityIndex < NumEntities; ++EntityIndex)
 		{
-			const bool& bAtMoveTargetForward = IsTransformFacingDirection(LocationList[EntityIndex].GetTransform(), MoveTargetList[EntityIndex].Forward);
+			// Looking at a target is done once the turret can fire at it, the hull keeps turning towards it meanwhile.
+			const bool bIsTurretLookingAtTarget = TurretList.Num() > 0 && MoveForwardCompleteSignalList[EntityIndex].SignalType == EMassMoveForwardCompleteSignalType::NewStateTreeTask;
+			const bool& bAtMoveTargetForward = bIsTurretLookingAtTarget ? TurretList[EntityIndex].IsInFiringCone(LocationList[EntityIndex].GetTransform(), MoveTargetList[EntityIndex].Forward) : IsTransformFacingDirection(LocationList[EntityIndex].GetTransform(), MoveTargetList[EntityIndex].Forward);
 
 			if (bAtMoveTargetForward) {
 				const FMassEntityHandle& Entity = Context.GetEntity(EntityIndex);
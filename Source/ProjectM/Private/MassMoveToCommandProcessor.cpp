@@ -10,6 +10,8 @@
 #include <MassNavMeshMoveProcessor.h>
 #include "MassEntityView.h"
 #include <MassNavigationUtils.h>
+#include "MassProcessorBudgetSubsystem.h"
+#include "ProjectMStats.h"
 
 //----------------------------------------------------------------------//
 //  UMassCommandableTrait
@@ -47,6 +49,9 @@ void UMassMoveToCommandProcessor::ConfigureQueries()
 	EntityQuery.AddConstSharedRequirement<FNavMeshParamsFragment>(EMassFragmentPresence::All);
 }
 
+float UMassMoveToCommandProcessor_BudgetMs = 2.f;
+FAutoConsoleVariableRef CVarUMassMoveToCommandProcessor_BudgetMs(TEXT("pm.UMassMoveToCommandProcessor_BudgetMs"), UMassMoveToCommandProcessor_BudgetMs, TEXT("Frame time budget for finding paths of a move to command. Entities over budget get their path on a later frame. 0 disables the budget."));
+
 void UMassMoveToCommandProcessor::Initialize(UObject& Owner)
 {
 	Super::Initialize(Owner);
@@ -164,7 +169,7 @@ enum class EMoveToCommandProcessEntityResult : uint8
 	SkippedDueToSquadMember,
 };
 
-EMoveToCommandProcessEntityResult ProcessEntity(const UMassMoveToCommandProcessor* Processor, const FTeamMemberFragment& TeamMemberFragment, const bool& IsLastMoveToCommandForTeam1, const FVector& LastMoveToCommandTarget, const FTransform& EntityTransform, const FMassEntityHandle &Entity, UNavigationSystemV1* NavSys, FMassNavMeshMoveFragment& NavMeshMoveFragment, const FMassExecutionContext& Context, const UMilitaryUnit* LastMoveToCommandMilitaryUnit, const UWorld* World, const float& NavMeshRadius, const UMassEntitySubsystem& EntitySubsystem)
+EMoveToCommandProcessEntityResult ProcessEntity(const UMassMoveToCommandProcessor* Processor, const FTeamMemberFragment& TeamMemberFragment, const uint8 LastMoveToCommandTeamIndex, const FVector& LastMoveToCommandTarget, const FTransform& EntityTransform, const FMassEntityHandle &Entity, UNavigationSystemV1* NavSys, FMassNavMeshMoveFragment& NavMeshMoveFragment, const FMassExecutionContext& Context, const UMilitaryUnit* LastMoveToCommandMilitaryUnit, const UWorld* World, const float& NavMeshRadius, const UMassEntitySubsystem& EntitySubsystem)
 {
 	UMilitaryStructureSubsystem* MilitaryStructureSubsystem = UWorld::GetSubsystem<UMilitaryStructureSubsystem>(World);
 	check(MilitaryStructureSubsystem);
@@ -223,6 +228,7 @@ EMoveToCommandProcessEntityResult ProcessEntity(const UMassMoveToCommandProcesso
 
 	const FPathFindingQuery Query(Processor, *NavData, EntityLocation, CommandTarget);
 	const FPathFindingResult Result = NavSys->FindPathSync(Query);
+	UE::ProjectM::Stats::Add(EProjectMStat::PathsRequested);
 
 	if (!Result.IsSuccessful())
 	{
@@ -245,6 +251,41 @@ EMoveToCommandProcessEntityResult ProcessEntity(const UMassMoveToCommandProcesso
 	return EMoveToCommandProcessEntityResult::Success;
 }
 
+void UMassMoveToCommandProcessor::BeginMoveToCommand(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context, const FMoveToCommand& MoveToCommand)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UMassMoveToCommandProcessor.BeginMoveToCommand);
+
+	PendingMoveToCommandMilitaryUnit = MoveToCommand.MilitaryUnit;
+	PendingMoveToCommandTarget = MoveToCommand.Target;
+	PendingMoveToCommandTeamIndex = MoveToCommand.TeamIndex;
+	PendingPathEntities.Reset();
+	NextPendingPathEntityIndex = 0;
+	NumEntitiesSetMoveTarget = 0;
+	NumEntitiesAttemptedSetMoveTarget = 0;
+
+	EntityQuery.ForEachEntityChunk(EntitySubsystem, Context, [this, &MoveToCommand](FMassExecutionContext& Context)
+	{
+		const int32 NumEntities = Context.GetNumEntities();
+		const TConstArrayView<FTeamMemberFragment> TeamMemberList = Context.GetFragmentView<FTeamMemberFragment>();
+
+		for (int32 i = 0; i < NumEntities; ++i)
+		{
+			if (TeamMemberList[i].TeamIndex != MoveToCommand.TeamIndex)
+			{
+				continue;
+			}
+
+			const FMassEntityHandle& Entity = Context.GetEntity(i);
+			if (!IsEntityCommandableByUnit(Entity, MoveToCommand.MilitaryUnit, GetWorld()))
+			{
+				continue;
+			}
+
+			PendingPathEntities.Add(Entity);
+		}
+	});
+}
+
 void UMassMoveToCommandProcessor::Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context)
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(UMassMoveToCommandProcessor.Execute);
@@ -254,59 +295,74 @@ void UMassMoveToCommandProcessor::Execute(UMassEntitySubsystem& EntitySubsystem,
 		return;
 	}
 
-	FMoveToCommand MoveToCommand;
-	if (!MoveToCommandSubsystem->DequeueMoveToCommand(MoveToCommand))
+	FMassProcessorFrameBudget* FrameBudget = UMassProcessorBudgetSubsystem::FindOrAddBudget(GetWorld(), GetClass()->GetFName(), UMassMoveToCommandProcessor_BudgetMs);
+
+	if (NextPendingPathEntityIndex >= PendingPathEntities.Num())
+	{
+		FMoveToCommand MoveToCommand;
+		if (!MoveToCommandSubsystem->DequeueMoveToCommand(MoveToCommand))
+		{
+			return;
+		}
+		BeginMoveToCommand(EntitySubsystem, Context, MoveToCommand);
+	}
+	else if (PendingMoveToCommandMilitaryUnit.IsStale())
 	{
+		// A null unit commands the whole team, but a destroyed one must not, so the rest of its entities are dropped.
+		UE_LOG(LogTemp, Log, TEXT("UMassMoveToCommandProcessor: Unit of move to command was destroyed, skipping %d entities."), PendingPathEntities.Num() - NextPendingPathEntityIndex);
+		PendingPathEntities.Reset();
+		NextPendingPathEntityIndex = 0;
 		return;
 	}
 
-	int32 NumEntitiesSetMoveTarget = 0;
-	int32 NumEntitiesAttemptedSetMoveTarget = 0;
+	const double StartTime = FPlatformTime::Seconds();
+	const int32 NumPendingPathEntities = PendingPathEntities.Num() - NextPendingPathEntityIndex;
+	const int32 Quota = FrameBudget ? FrameBudget->GetWorkQuota(NumPendingPathEntities) : NumPendingPathEntities;
+	const int32 EndPendingPathEntityIndex = NextPendingPathEntityIndex + Quota;
 
-	const bool IsLastMoveToCommandForTeam1 = MoveToCommand.bIsOnTeam1;
-	const UMilitaryUnit* LastMoveToCommandMilitaryUnit = MoveToCommand.MilitaryUnit;
-	const FVector LastMoveToCommandTarget = MoveToCommand.Target;
+	const uint8 LastMoveToCommandTeamIndex = PendingMoveToCommandTeamIndex;
+	const UMilitaryUnit* LastMoveToCommandMilitaryUnit = PendingMoveToCommandMilitaryUnit.Get();
+	const FVector LastMoveToCommandTarget = PendingMoveToCommandTarget;
+	const UWorld* World = GetWorld();
 
-	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(World);
 
-	EntityQuery.ForEachEntityChunk(EntitySubsystem, Context, [this, &IsLastMoveToCommandForTeam1, LastMoveToCommandTarget, NavSys, LastMoveToCommandMilitaryUnit, &NumEntitiesSetMoveTarget, &NumEntitiesAttemptedSetMoveTarget , &EntitySubsystem](FMassExecutionContext& Context)
+	// Entities over budget keep their current move and get their path on a later frame.
+	for (; NextPendingPathEntityIndex < EndPendingPathEntityIndex; NextPendingPathEntityIndex++)
 	{
-		const int32 NumEntities = Context.GetNumEntities();
-		const TConstArrayView<FTeamMemberFragment> TeamMemberList = Context.GetFragmentView<FTeamMemberFragment>();
-		const TConstArrayView<FTransformFragment> TransformList = Context.GetFragmentView<FTransformFragment>();
-		const TArrayView<FMassNavMeshMoveFragment> NavMeshMoveList = Context.GetMutableFragmentView<FMassNavMeshMoveFragment>();
-		const FNavMeshParamsFragment& NavMeshParams = Context.GetConstSharedFragment<FNavMeshParamsFragment>();
-
-		for (int32 i = 0; i < NumEntities; ++i)
+		const FMassEntityHandle& Entity = PendingPathEntities[NextPendingPathEntityIndex];
+		if (!EntitySubsystem.IsEntityValid(Entity))
 		{
-			// Change move to command target Z to make current entity's Z value since we don't know ground height.
-			const FVector& EntityLocation = TransformList[i].GetTransform().GetLocation();
-			FVector MoveToCommandTarget = LastMoveToCommandTarget;
-			MoveToCommandTarget.Z = EntityLocation.Z;
+			continue;
+		}
 
-			const FTeamMemberFragment& TeamMemberFragment = TeamMemberList[i];
-			if (TeamMemberFragment.IsOnTeam1 != IsLastMoveToCommandForTeam1)
-			{
-				continue;
-			}
+		const FMassEntityView EntityView(EntitySubsystem, Entity);
+		const FTransform& EntityTransform = EntityView.GetFragmentData<FTransformFragment>().GetTransform();
+		FMassNavMeshMoveFragment& NavMeshMoveFragment = EntityView.GetFragmentData<FMassNavMeshMoveFragment>();
+		const FNavMeshParamsFragment& NavMeshParams = EntityView.GetConstSharedFragmentData<FNavMeshParamsFragment>();
 
-			const FMassEntityHandle& Entity = Context.GetEntity(i);
-			const UWorld* World = GetWorld();
-			if (!IsEntityCommandableByUnit(Entity, LastMoveToCommandMilitaryUnit, World))
-			{
-				continue;
-			}
+		// Change move to command target Z to make current entity's Z value since we don't know ground height.
+		FVector MoveToCommandTarget = LastMoveToCommandTarget;
+		MoveToCommandTarget.Z = EntityTransform.GetLocation().Z;
 
-			FMassNavMeshMoveFragment& NavMeshMoveFragment = NavMeshMoveList[i];
-			const EMoveToCommandProcessEntityResult Result = ProcessEntity(this, TeamMemberList[i], IsLastMoveToCommandForTeam1, MoveToCommandTarget, TransformList[i].GetTransform(), Entity, NavSys, NavMeshMoveFragment, Context, LastMoveToCommandMilitaryUnit, World, NavMeshParams.NavMeshRadius, EntitySubsystem);
+		const EMoveToCommandProcessEntityResult Result = ProcessEntity(this, EntityView.GetFragmentData<FTeamMemberFragment>(), LastMoveToCommandTeamIndex, MoveToCommandTarget, EntityTransform, Entity, NavSys, NavMeshMoveFragment, Context, LastMoveToCommandMilitaryUnit, World, NavMeshParams.NavMeshRadius, EntitySubsystem);
 
-			NumEntitiesAttemptedSetMoveTarget++;
-			if (Result != EMoveToCommandProcessEntityResult::Error)
-			{
-				NumEntitiesSetMoveTarget++;
-			}
+		NumEntitiesAttemptedSetMoveTarget++;
+		if (Result != EMoveToCommandProcessEntityResult::Error)
+		{
+			NumEntitiesSetMoveTarget++;
 		}
-	});
+	}
+
+	if (FrameBudget)
+	{
+		FrameBudget->RecordWork(Quota, FPlatformTime::Seconds() - StartTime);
+	}
 
-	UE_LOG(LogTemp, Log, TEXT("UMassMoveToCommandProcessor: Set move target to %d/%d entities to %s."), NumEntitiesSetMoveTarget, NumEntitiesAttemptedSetMoveTarget, *LastMoveToCommandTarget.ToCompactString());
+	if (NextPendingPathEntityIndex >= PendingPathEntities.Num())
+	{
+		UE_LOG(LogTemp, Log, TEXT("UMassMoveToCommandProcessor: Set move target to %d/%d entities to %s."), NumEntitiesSetMoveTarget, NumEntitiesAttemptedSetMoveTarget, *LastMoveToCommandTarget.ToCompactString());
+		PendingPathEntities.Reset();
+		NextPendingPathEntityIndex = 0;
+	}
 }
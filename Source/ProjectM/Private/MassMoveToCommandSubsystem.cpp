@@ -5,9 +5,9 @@
 
 #include <MilitaryStructureSubsystem.h>
 
-void UMassMoveToCommandSubsystem::EnqueueMoveToCommand(const UMilitaryUnit* MilitaryUnit, const FVector Target, const bool bIsOnTeam1)
+void UMassMoveToCommandSubsystem::EnqueueMoveToCommand(const UMilitaryUnit* MilitaryUnit, const FVector Target, const uint8 TeamIndex)
 {
-	MoveToCommandQueue.Enqueue(FMoveToCommand(MilitaryUnit, Target, bIsOnTeam1));
+	MoveToCommandQueue.Enqueue(FMoveToCommand(MilitaryUnit, Target, TeamIndex));
 }
 
 bool UMassMoveToCommandSubsystem::DequeueMoveToCommand(FMoveToCommand& OutMoveToCommand)
@@ -21,3 +21,8 @@ bool UMassMoveToCommandSubsystem::DequeueMoveToCommand(FMoveToCommand& OutMoveTo
 	check(bDidDequeue);
 	return true;
 }
+
+void UMassMoveToCommandSubsystem::ResetMoveToCommands()
+{
+	MoveToCommandQueue.Empty();
+}
@@ -11,6 +11,7 @@
 #include <MassTrackedVehicleOrientationProcessor.h>
 #include "MassEntityView.h"
 #include "MassMoveToCommandSubsystem.h"
+#include "MassTickTierTrait.h"
 
 UMassNavMeshMoveProcessor::UMassNavMeshMoveProcessor()
 {
@@ -28,6 +29,8 @@ void UMassNavMeshMoveProcessor::ConfigureQueries()
 	EntityQuery.AddRequirement<FAgentRadiusFragment>(EMassFragmentAccess::ReadOnly);
 	EntityQuery.AddRequirement<FTeamMemberFragment>(EMassFragmentAccess::ReadOnly);
 	EntityQuery.AddTagRequirement<FMassNeedsNavMeshMoveTag>(EMassFragmentPresence::All);
+	EntityQuery.AddChunkRequirement<FMassTickTierChunkFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
+	EntityQuery.SetChunkFilter(&FMassTickTierChunkFragment::ShouldTickChunkThisFrame);
 }
 
 bool DoesSoldierHaveSameActionsRemaining(int32 ActionsRemaining, const UMilitaryUnit* SoldierMilitaryUnit, const UMassEntitySubsystem& EntitySubsystem)
@@ -101,10 +104,10 @@ void CompleteNavMeshMoveForAllSquadMembers(const UMilitaryUnit* MilitaryUnit, co
 	}
 }
 
-void EnqueueNewMoveToCommand(const UMilitaryUnit* MilitaryUnit, UWorld* World, const FVector& Target, const bool bIsOnTeam1)
+void EnqueueNewMoveToCommand(const UMilitaryUnit* MilitaryUnit, UWorld* World, const FVector& Target, const uint8 TeamIndex)
 {
 	UMassMoveToCommandSubsystem* MoveToCommandSubsystem = UWorld::GetSubsystem<UMassMoveToCommandSubsystem>(World);
-	MoveToCommandSubsystem->EnqueueMoveToCommand(MilitaryUnit, Target, bIsOnTeam1);
+	MoveToCommandSubsystem->EnqueueMoveToCommand(MilitaryUnit, Target, TeamIndex);
 }
 
 void ProcessEntity(FMassMoveTargetFragment& MoveTargetFragment, UWorld* World, const FTransform& EntityTransform, const FMassExecutionContext& Context, FMassStashedMoveTargetFragment& StashedMoveTargetFragment, const FMassEntityHandle& Entity, FMassNavMeshMoveFragment& NavMeshMoveFragment, const float MovementSpeed, const float AgentRadius, const UMassEntitySubsystem& EntitySubsystem, const FTeamMemberFragment& TeamMemberFragment)
@@ -151,12 +154,12 @@ void ProcessEntity(FMassMoveTargetFragment& MoveTargetFragment, UWorld* World, c
 					const FVector& SoldierOffsetFromSquadLeader = UMassMoveToCommandProcessor::GetSoldierOffsetFromSquadLeader(NavMeshMoveFragment.SquadMemberIndex, FVector::ZeroVector, Actions.Last().Forward);
 					// We have to negate below because we're calculating squad leader's target, not soldier's.
 					const FVector& SquadLeaderNavMeshFinalTarget = Actions.Last().TargetLocation - SoldierOffsetFromSquadLeader;
-					EnqueueNewMoveToCommand(EntityUnit->SquadMilitaryUnit, World, SquadLeaderNavMeshFinalTarget, TeamMemberFragment.IsOnTeam1);
+					EnqueueNewMoveToCommand(EntityUnit->SquadMilitaryUnit, World, SquadLeaderNavMeshFinalTarget, TeamMemberFragment.TeamIndex);
 				}
 				else
 				{
 					CompleteNavMeshMove(MoveTargetFragmentToModify, World, Context, Entity, bUseStashedMoveTarget);
-					EnqueueNewMoveToCommand(EntityUnit, World, Actions.Last().TargetLocation, TeamMemberFragment.IsOnTeam1);
+					EnqueueNewMoveToCommand(EntityUnit, World, Actions.Last().TargetLocation, TeamMemberFragment.TeamIndex);
 				}
 				return;
 			}
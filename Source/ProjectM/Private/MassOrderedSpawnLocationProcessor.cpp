@@ -5,6 +5,7 @@
 #include "MassEntitySubsystem.h"
 #include "MassSpawnerTypes.h"
 #include "Engine/World.h"
+#include "Async/ParallelFor.h"
 #include "VisualLogger/VisualLogger.h"
 
 //----------------------------------------------------------------------//
@@ -66,14 +67,26 @@ void UMassOrderedSpawnLocationProcessor::Execute(UMassEntitySubsystem& EntitySub
 			}
 		}
 
+		// Transforms are assigned in chunk order, so find where each chunk starts first, then fill the chunks in parallel.
+		struct FChunkTransforms
+		{
+			TArrayView<FTransformFragment> LocationList;
+			int32 FirstTransformIndex;
+		};
+		TArray<FChunkTransforms> ChunkTransformsList;
 		int32 TransformIndex = 0;
-		EntityQuery.ForEachEntityChunk(EntitySubsystem, Context, [&Transforms, this, &TransformIndex](FMassExecutionContext& Context)
+		EntityQuery.ForEachEntityChunk(EntitySubsystem, Context, [&ChunkTransformsList, &TransformIndex](FMassExecutionContext& Context)
+		{
+			ChunkTransformsList.Add({ Context.GetMutableFragmentView<FTransformFragment>(), TransformIndex });
+			TransformIndex += Context.GetNumEntities();
+		});
+
+		ParallelFor(ChunkTransformsList.Num(), [&ChunkTransformsList, &Transforms](const int32 ChunkIndex)
 		{
-			const TArrayView<FTransformFragment> LocationList = Context.GetMutableFragmentView<FTransformFragment>();
-			const int32 NumEntities = Context.GetNumEntities();
-			for (int32 i = 0; i < NumEntities; ++i)
+			const FChunkTransforms& ChunkTransforms = ChunkTransformsList[ChunkIndex];
+			for (int32 i = 0; i < ChunkTransforms.LocationList.Num(); ++i)
 			{
-				LocationList[i].GetMutableTransform() = Transforms[TransformIndex++];
+				ChunkTransforms.LocationList[i].GetMutableTransform() = Transforms[ChunkTransforms.FirstTransformIndex + i];
 			}
 		});
 	}
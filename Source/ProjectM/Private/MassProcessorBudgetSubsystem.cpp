@@ -0,0 +1,132 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#include "MassProcessorBudgetSubsystem.h"
+
+#include "MassEntityHash.h"
+#include "MassEntityQuery.h"
+#include "MassExecutionContext.h"
+
+FMassProcessorFrameBudget::FMassProcessorFrameBudget(const FName InName, const float& InBudgetMilliseconds)
+	: Name(InName), BudgetMilliseconds(InBudgetMilliseconds)
+{
+}
+
+int32 FMassProcessorFrameBudget::GetWorkQuota(const int32 NumPendingItems) const
+{
+	LastNumPendingItems = NumPendingItems;
+	LastQuota = NumPendingItems;
+
+	if (BudgetMilliseconds <= 0.f || TotalWindowItems == 0 || TotalWindowSeconds <= 0.)
+	{
+		return LastQuota;
+	}
+
+	const double AverageSecondsPerItem = TotalWindowSeconds / TotalWindowItems;
+	const double AffordableItems = BudgetMilliseconds / 1000. / AverageSecondsPerItem;
+	LastQuota = FMath::Clamp(static_cast<int32>(FMath::Min(AffordableItems, static_cast<double>(MAX_int32))), FMath::Min(MinItemsPerFrame, NumPendingItems), NumPendingItems);
+	return LastQuota;
+}
+
+void FMassProcessorFrameBudget::BeginEntitySelection(const int32 NumPendingEntities)
+{
+	// Move on by the golden ratio of the previous frame's selection instead of continuing exactly where it ended. With contiguous windows, entities
+	// of tick tiers that only tick every 2, 4 or 8 frames would always see the selection at the same few positions and could be starved.
+	SelectionPhase = FMath::Frac(SelectionPhase + SelectionFraction * UE_GOLDEN_RATIO);
+
+	const int32 Quota = GetWorkQuota(NumPendingEntities);
+	SelectionFraction = NumPendingEntities > 0 ? static_cast<float>(Quota) / NumPendingEntities : 1.f;
+}
+
+int32 FMassProcessorFrameBudget::CountEntitiesThisFrame(FMassEntityQuery& EntityQuery, UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context)
+{
+	int32 NumEntities = 0;
+	EntityQuery.ForEachEntityChunk(EntitySubsystem, Context, [&NumEntities](FMassExecutionContext& Context)
+	{
+		NumEntities += Context.GetNumEntities();
+	});
+	return NumEntities;
+}
+
+bool FMassProcessorFrameBudget::IsEntitySelected(const FMassEntityHandle& Entity) const
+{
+	if (SelectionFraction >= 1.f)
+	{
+		return true;
+	}
+
+	// Entities are hashed evenly over [0, 1), and the selection is a window of that range that moves every frame.
+	const float EntityKey = GetEntityHashFraction(Entity);
+	return FMath::Frac(EntityKey - SelectionPhase) < SelectionFraction;
+}
+
+void FMassProcessorFrameBudget::RecordWork(const int32 NumItems, const double Seconds)
+{
+	if (NumWindowFrames == WindowSize)
+	{
+		TotalWindowSeconds -= WindowSeconds[WindowIndex];
+		TotalWindowItems -= WindowItems[WindowIndex];
+	}
+	else
+	{
+		NumWindowFrames++;
+	}
+
+	WindowSeconds[WindowIndex] = Seconds;
+	WindowItems[WindowIndex] = NumItems;
+	TotalWindowSeconds += Seconds;
+	TotalWindowItems += NumItems;
+	WindowIndex = (WindowIndex + 1) % WindowSize;
+}
+
+double FMassProcessorFrameBudget::GetAverageMilliseconds() const
+{
+	return NumWindowFrames > 0 ? TotalWindowSeconds * 1000. / NumWindowFrames : 0.;
+}
+
+void UMassProcessorBudgetSubsystem::Deinitialize()
+{
+	Budgets.Reset();
+
+	Super::Deinitialize();
+}
+
+FMassProcessorFrameBudget& UMassProcessorBudgetSubsystem::FindOrAddBudget(const FName Name, const float& BudgetMilliseconds)
+{
+	check(IsInGameThread());
+
+	TUniquePtr<FMassProcessorFrameBudget>& Budget = Budgets.FindOrAdd(Name);
+	if (!Budget)
+	{
+		Budget = MakeUnique<FMassProcessorFrameBudget>(Name, BudgetMilliseconds);
+	}
+	return *Budget;
+}
+
+FMassProcessorFrameBudget* UMassProcessorBudgetSubsystem::FindOrAddBudget(const UWorld* World, const FName Name, const float& BudgetMilliseconds)
+{
+	UMassProcessorBudgetSubsystem* ProcessorBudgetSubsystem = UWorld::GetSubsystem<UMassProcessorBudgetSubsystem>(World);
+	return ProcessorBudgetSubsystem ? &ProcessorBudgetSubsystem->FindOrAddBudget(Name, BudgetMilliseconds) : nullptr;
+}
+
+void UMassProcessorBudgetSubsystem::DumpBudgets() const
+{
+	for (const TPair<FName, TUniquePtr<FMassProcessorFrameBudget>>& Pair : Budgets)
+	{
+		const FMassProcessorFrameBudget& Budget = *Pair.Value;
+		UE_LOG(LogTemp, Log, TEXT("%s: %.2f ms average over last %d frames, budget %.2f ms, last quota %d/%d."), *Budget.GetName().ToString(), Budget.GetAverageMilliseconds(), FMassProcessorFrameBudget::WindowSize, Budget.GetBudgetMilliseconds(), Budget.GetLastQuota(), Budget.GetLastNumPendingItems());
+	}
+}
+
+static void DumpProcessorFrameBudgets(UWorld* World)
+{
+	if (const UMassProcessorBudgetSubsystem* ProcessorBudgetSubsystem = UWorld::GetSubsystem<UMassProcessorBudgetSubsystem>(World))
+	{
+		ProcessorBudgetSubsystem->DumpBudgets();
+	}
+}
+
+static FAutoConsoleCommandWithWorld DumpProcessorFrameBudgetsCmd(
+	TEXT("pm.DumpProcessorFrameBudgets"),
+	TEXT("Log measured time of budgeted ProjectM processors against their frame budgets."),
+	FConsoleCommandWithWorldDelegate::CreateStatic(DumpProcessorFrameBudgets)
+);
@@ -12,6 +12,7 @@
 #include <MassEnemyTargetFinderProcessor.h>
 #include <MassSoundPerceptionSubsystem.h>
 #include <MassDelayedDestructionProcessor.h>
+#include "MassBattlefieldClutterSubsystem.h"
 #include <MassTargetGridProcessors.h>
 #include <MassActorSubsystem.h>
 #include "Character/MassCharacter.h"
@@ -19,7 +20,11 @@
 #include <MassNavMeshMoveProcessor.h>
 #include <MassMoveToCommandProcessor.h>
 #include "MassSignalSubsystem.h"
+#include "MassStaticOccluderSubsystem.h"
+#include "MassTraceContextSubsystem.h"
 #include <MassStateTreeTypes.h>
+#include "ProjectMStats.h"
+#include "MassDebugDrawRecorder.h"
 
 static constexpr uint32 GUMassProjectileWithDamageTrait_MaxClosestEntitiesToFind = 20;
 typedef TArray<FMassNavigationObstacleItem, TFixedAllocator<GUMassProjectileWithDamageTrait_MaxClosestEntitiesToFind>> TProjectileDamageObstacleItemArray;
@@ -194,28 +199,35 @@ bool DidCollideViaLineTrace(const UWorld &World, const FVector& StartLocation, c
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(UMassProjectileDamageProcessor.DidCollideViaLineTrace);
 
+	if (!DrawLineTraces)
+	{
+		const UMassStaticOccluderSubsystem* StaticOccluderSubsystem = World.GetSubsystem<UMassStaticOccluderSubsystem>();
+		// The field only knows static geometry, so a clear answer still needs the physics trace for movable blockers.
+		if (StaticOccluderSubsystem && StaticOccluderSubsystem->Raycast(StartLocation, EndLocation) == EStaticOcclusionResult::Blocked)
+		{
+			return true;
+		}
+	}
+
+	const UMassTraceContextSubsystem* TraceContextSubsystem = World.GetSubsystem<UMassTraceContextSubsystem>();
+	check(TraceContextSubsystem);
+
 	FHitResult HitResult;
-	bool const bSuccess = World.LineTraceSingleByChannel(HitResult, StartLocation, EndLocation, ECollisionChannel::ECC_Visibility);
+	bool const bSuccess = TraceContextSubsystem->LineTraceSingle(World, HitResult, StartLocation, EndLocation);
 	if (DrawLineTraces)
 	{
-		AsyncTask(ENamedThreads::GameThread, [HitResult, &World]()
+		if (HitResult.bBlockingHit)
 		{
-			static const FLinearColor TraceColor = FLinearColor::Red;
-			static const FLinearColor TraceHitColor = FLinearColor::Green;
-
-			if (HitResult.bBlockingHit)
-			{
-				// Red up to the blocking hit, green thereafter
-				::DrawDebugLine(&World, HitResult.TraceStart, HitResult.ImpactPoint, TraceColor.ToFColor(true), true);
-				::DrawDebugLine(&World, HitResult.ImpactPoint, HitResult.TraceEnd, TraceHitColor.ToFColor(true), true);
-				::DrawDebugPoint(&World, HitResult.ImpactPoint, 16.f, TraceColor.ToFColor(true), true);
-			}
-			else
-			{
-				// no hit means all red
-				::DrawDebugLine(&World, HitResult.TraceStart, HitResult.TraceEnd, TraceColor.ToFColor(true), true);
-			}
-		});
+			// Red up to the blocking hit, green thereafter
+			UE::ProjectM::DebugDraw::Line(&World, HitResult.TraceStart, HitResult.ImpactPoint, FColor::Red, true);
+			UE::ProjectM::DebugDraw::Line(&World, HitResult.ImpactPoint, HitResult.TraceEnd, FColor::Green, true);
+			UE::ProjectM::DebugDraw::Point(&World, HitResult.ImpactPoint, 16.f, FColor::Red, true);
+		}
+		else
+		{
+			// no hit means all red
+			UE::ProjectM::DebugDraw::Line(&World, HitResult.TraceStart, HitResult.TraceEnd, FColor::Red, true);
+		}
 	}
 
 	return bSuccess;
@@ -234,12 +246,9 @@ bool DidCollideWithEntity(const FVector& StartLocation, const FVector& EndLocati
 
 	if (DrawCapsules || UMassProjectileDamageProcessor_DrawCapsules)
 	{
-		AsyncTask(ENamedThreads::GameThread, [&World, bDidCollide, ProjectileCapsule, OtherEntityCapsule]()
-		{
-			const auto& CapsuleColor = bDidCollide ? FLinearColor::Green : FLinearColor::Red;
-			DrawCapsule(ProjectileCapsule, World, CapsuleColor);
-			DrawCapsule(OtherEntityCapsule, World, CapsuleColor);
-		});
+		const auto& CapsuleColor = bDidCollide ? FLinearColor::Green : FLinearColor::Red;
+		DrawCapsule(ProjectileCapsule, World, CapsuleColor);
+		DrawCapsule(OtherEntityCapsule, World, CapsuleColor);
 	}
 
 	return bDidCollide;
@@ -330,17 +339,14 @@ void DealDamage(const FVector& ImpactLocation, const FMassEntityView EntityToDea
 
 	if (UMassProjectileDamageProcessor_DrawDamageDealt)
 	{
-		AsyncTask(ENamedThreads::GameThread, [World, DamageToDeal, EntityToDealDamageToLocation]()
-		{
-			DrawDebugString(World, EntityToDealDamageToLocation, FString::FromInt(DamageToDeal), nullptr, FColor::Red, 5.f);
-		});
+		UE::ProjectM::DebugDraw::String(World, EntityToDealDamageToLocation, FString::FromInt(DamageToDeal), FColor::Red, 5.f);
 	}
 }
 
 void HandleProjectImpactSoundPerception(UWorld* World, const FVector& Location, const FMassEntityHandle& CollidedEntity, const UMassEntitySubsystem& EntitySubsystem)
 {
 	const bool& bHasCollidedEntity = CollidedEntity.IsSet();
-	bool bIsCollidedEntityOnTeam1;
+	uint8 CollidedEntityTeamIndex = 0;
 
 	if (bHasCollidedEntity)
 	{
@@ -348,7 +354,7 @@ void HandleProjectImpactSoundPerception(UWorld* World, const FVector& Location,
 		const FTeamMemberFragment* CollidedEntityTeamMemberFragment = CollidedEntityView.GetFragmentDataPtr<FTeamMemberFragment>();
 		if (CollidedEntityTeamMemberFragment)
 		{
-			bIsCollidedEntityOnTeam1 = CollidedEntityTeamMemberFragment->IsOnTeam1;
+			CollidedEntityTeamIndex = CollidedEntityTeamMemberFragment->TeamIndex;
 		}
 		else
 		{
@@ -356,13 +362,13 @@ void HandleProjectImpactSoundPerception(UWorld* World, const FVector& Location,
 		}
 	}
 
-	AsyncTask(ENamedThreads::GameThread, [World, Location = Location, bHasCollidedEntity, bIsCollidedEntityOnTeam1]()
+	AsyncTask(ENamedThreads::GameThread, [World, Location = Location, bHasCollidedEntity, CollidedEntityTeamIndex]()
 	{
 		UMassSoundPerceptionSubsystem* SoundPerceptionSubsystem = UWorld::GetSubsystem<UMassSoundPerceptionSubsystem>(World);
 		check(SoundPerceptionSubsystem);
 		if (bHasCollidedEntity)
 		{
-			SoundPerceptionSubsystem->AddSoundPerception(Location, bIsCollidedEntityOnTeam1);
+			SoundPerceptionSubsystem->AddSoundPerception(Location, CollidedEntityTeamIndex);
 		}
 		else
 		{
@@ -382,11 +388,8 @@ void HandleProjectileImpact(TQueue<FMassEntityHandle, EQueueMode::Mpsc>& Project
 		UMassVisualEffectsSubsystem* MassVisualEffectsSubsystem = UWorld::GetSubsystem<UMassVisualEffectsSubsystem>(World);
 		check(MassVisualEffectsSubsystem);
 
-		// Must be done async because we can't spawn Mass entities in the middle of a Mass processor's Execute method.
-		AsyncTask(ENamedThreads::GameThread, [MassVisualEffectsSubsystem, ExplosionEntityConfigIndex = ProjectileDamageFragment.ExplosionEntityConfigIndex, Location]()
-		{
-			MassVisualEffectsSubsystem->SpawnEntity(ExplosionEntityConfigIndex, Location);
-		});
+		// Queued because we can't spawn Mass entities in the middle of a Mass processor's Execute method.
+		MassVisualEffectsSubsystem->RequestEffect(ProjectileDamageFragment.ExplosionEntityConfigIndex, Location);
 	}
 
 	if (UMassProjectileDamageProcessor_SkipDealingDamage)
@@ -435,7 +438,7 @@ void HandleProjectileImpact(TQueue<FMassEntityHandle, EQueueMode::Mpsc>& Project
 	}
 }
 
-void ProcessProjectileDamageEntity(FMassExecutionContext& Context, FMassEntityHandle Entity, const UMassEntitySubsystem& EntitySubsystem, const FNavigationObstacleHashGrid2D& AvoidanceObstacleGrid, const FTransformFragment& Location, const FAgentRadiusFragment& Radius, const FProjectileDamageFragment& ProjectileDamageFragment, TProjectileDamageObstacleItemArray& OutCloseEntities, const FMassPreviousLocationFragment& PreviousLocationFragment, const bool& DrawLineTraces, TQueue<FMassEntityHandle, EQueueMode::Mpsc>& ProjectilesToDestroy, TQueue<FMassEntityHandle, EQueueMode::Mpsc>& SoldiersThatHaveDied, TQueue<FMassEntityHandle, EQueueMode::Mpsc>& PlayersToDestroy)
+void ProcessProjectileDamageEntity(FMassExecutionContext& Context, FMassEntityHandle Entity, const UMassEntitySubsystem& EntitySubsystem, const FNavigationObstacleHashGrid2D& AvoidanceObstacleGrid, const FTransformFragment& Location, const FAgentRadiusFragment& Radius, const FProjectileDamageFragment& ProjectileDamageFragment, TProjectileDamageObstacleItemArray& OutCloseEntities, const FMassPreviousLocationFragment& PreviousLocationFragment, const bool& DrawLineTraces, TQueue<FMassEntityHandle, EQueueMode::Mpsc>& ProjectilesToDestroy, TQueue<FMassEntityHandle, EQueueMode::Mpsc>& SoldiersThatHaveDied, TQueue<FMassEntityHandle, EQueueMode::Mpsc>& PlayersToDestroy, int32& NumCollisionsTested)
 {
 	UWorld* World = EntitySubsystem.GetWorld();
 
@@ -467,6 +470,7 @@ void ProcessProjectileDamageEntity(FMassExecutionContext& Context, FMassEntityHa
 			continue;
 		}
 
+		NumCollisionsTested++;
 		if (!DidCollideWithEntity(PreviousLocationFragment.Location, CurrentLocation, Radius.Radius, DrawLineTraces, *World, OtherEntityView))
 		{
 			continue;
@@ -501,6 +505,7 @@ void ProcessQueues(TQueue<FMassEntityHandle, EQueueMode::Mpsc>& ProjectilesToDes
 	UMilitaryStructureSubsystem* MilitaryStructureSubsystem = UWorld::GetSubsystem<UMilitaryStructureSubsystem>(World);
 	check(MilitaryStructureSubsystem);
 	TArray<FMassEntityHandle> EntitiesToSignalDeath;
+	int32 NumDeathsResolved = 0;
 	while (!SoldiersThatHaveDied.IsEmpty())
 	{
 		FMassEntityHandle SoldierEntityThatHasDied;
@@ -523,10 +528,12 @@ void ProcessQueues(TQueue<FMassEntityHandle, EQueueMode::Mpsc>& ProjectilesToDes
 		FMassDelayedDestructionFragment DelayedDestructionFragment;
 		DelayedDestructionFragment.SecondsLeftTilDestruction = 2.1f; // TODO: Make this configurable via ProjectileDamagable Trait?
 		Context.Defer().PushCommand(FCommandAddFragmentInstance(SoldierEntityThatHasDied, FConstStructView::Make(DelayedDestructionFragment)));
+		Context.Defer().AddTag<FMassBecomesClutterOnDestructionTag>(SoldierEntityThatHasDied); // Leave a corpse behind.
 		
 		EntitiesToSignalDeath.Add(SoldierEntityThatHasDied); // Required for soldier to start playing death animation.
 
 		MilitaryStructureSubsystem->DestroyEntity(SoldierEntityThatHasDied);
+		NumDeathsResolved++;
 	}
 
 	if (EntitiesToSignalDeath.Num())
@@ -549,7 +556,10 @@ void ProcessQueues(TQueue<FMassEntityHandle, EQueueMode::Mpsc>& ProjectilesToDes
 		{
 			Character->DidDie();
 		});
+		NumDeathsResolved++;
 	}
+
+	UE::ProjectM::Stats::Add(EProjectMStat::DeathsResolved, NumDeathsResolved);
 }
 
 void UMassProjectileDamageProcessor::Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context)
@@ -589,11 +599,13 @@ void UMassProjectileDamageProcessor::Execute(UMassEntitySubsystem& EntitySubsyst
 		// TODO: We're incorrectly assuming all obstacles can get damaged by projectile.
 		const FNavigationObstacleHashGrid2D& AvoidanceObstacleGrid = NavigationSubsystem->GetObstacleGridMutable();
 
+		int32 NumCollisionsTested = 0;
 		for (int32 EntityIndex = 0; EntityIndex < NumEntities; ++EntityIndex)
 		{
-			ProcessProjectileDamageEntity(Context, Context.GetEntity(EntityIndex), EntitySubsystem, AvoidanceObstacleGrid, LocationList[EntityIndex], RadiusList[EntityIndex], ProjectileDamageList[EntityIndex], CloseEntities, PreviousLocationList[EntityIndex], DebugParameters.DrawLineTraces, ProjectilesToDestroy, SoldiersThatHaveDied, PlayersToDestroy);
+			ProcessProjectileDamageEntity(Context, Context.GetEntity(EntityIndex), EntitySubsystem, AvoidanceObstacleGrid, LocationList[EntityIndex], RadiusList[EntityIndex], ProjectileDamageList[EntityIndex], CloseEntities, PreviousLocationList[EntityIndex], DebugParameters.DrawLineTraces, ProjectilesToDestroy, SoldiersThatHaveDied, PlayersToDestroy, NumCollisionsTested);
 			PreviousLocationList[EntityIndex].Location = LocationList[EntityIndex].GetTransform().GetLocation();
 		}
+		UE::ProjectM::Stats::Add(EProjectMStat::CollisionsTested, NumCollisionsTested);
 	};
 
 	if (UMassProjectileDamageProcessor_UseParallelForEachEntityChunk)
@@ -605,5 +617,7 @@ void UMassProjectileDamageProcessor::Execute(UMassEntitySubsystem& EntitySubsyst
 		EntityQuery.ForEachEntityChunk(EntitySubsystem, Context, ExecuteFunction);
 	}
 
+	UE::ProjectM::Stats::Set(EProjectMStat::ProjectilesAlive, EntityQuery.GetNumMatchingEntities(EntitySubsystem));
+
 	ProcessQueues(ProjectilesToDestroy, SoldiersThatHaveDied, PlayersToDestroy, EntitySubsystem, Context, SignalSubsystem);
 }
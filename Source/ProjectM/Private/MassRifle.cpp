@@ -10,9 +10,9 @@ AMassRifle::AMassRifle()
 	PrimaryActorTick.bCanEverTick = false;
 }
 
-void AMassRifle::SpawnProjectile(const FTransform SpawnTransform, const bool bIsPlayerTeam1) const
+void AMassRifle::SpawnProjectile(const FTransform SpawnTransform, const uint8 PlayerTeamIndex) const
 {
 	const UWorld* World = GetWorld();
 	const FVector InitialVelocity = SpawnTransform.GetRotation().Vector() * GetProjectileInitialXYVelocityMagnitude(true);
-	::SpawnProjectile(World, SpawnTransform.GetLocation(), SpawnTransform.GetRotation(), InitialVelocity, ProjectileEntityConfig, bIsPlayerTeam1);
+	::SpawnProjectile(World, SpawnTransform.GetLocation(), SpawnTransform.GetRotation(), InitialVelocity, ProjectileEntityConfig, PlayerTeamIndex);
 }
@@ -2,6 +2,11 @@
 
 
 #include "MassSimpleUpdateISMProcessor.h"
+#include "MassVisualEffectsSubsystem.h"
+#include "MassRepresentationSubsystem.h"
+#include "MassRepresentationFragments.h"
+#include "MassCommonFragments.h"
+#include "MassLODFragments.h"
 
 bool UMassSimpleUpdateISMProcessor_SkipRendering = false;
 FAutoConsoleVariableRef CVarUMassSimpleUpdateISMProcessor_SkipRendering(TEXT("pm.UMassSimpleUpdateISMProcessor_SkipRendering"), UMassSimpleUpdateISMProcessor_SkipRendering, TEXT("UMassSimpleUpdateISMProcessor: Skip Rendering"));
@@ -30,4 +35,40 @@ void UMassSimpleUpdateISMProcessor::ConfigureQueries()
   Super::ConfigureQueries();
 
   EntityQuery.AddTagRequirement<FMassSimpleUpdateISMTag>(EMassFragmentPresence::All);
+  EntityQuery.AddRequirement<FMassPooledVisualEffectFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
+}
+
+// Same as UMassUpdateISMProcessor::Execute, but skips dormant pooled visual effects.
+void UMassSimpleUpdateISMProcessor::Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context)
+{
+  EntityQuery.ForEachEntityChunk(EntitySubsystem, Context, [](FMassExecutionContext& Context)
+  {
+    UMassRepresentationSubsystem* RepresentationSubsystem = Context.GetSharedFragment<FMassRepresentationSubsystemSharedFragment>().RepresentationSubsystem;
+    check(RepresentationSubsystem);
+    FMassInstancedStaticMeshInfoArrayView ISMInfo = RepresentationSubsystem->GetMutableInstancedStaticMeshInfos();
+
+    TConstArrayView<FTransformFragment> TransformList = Context.GetFragmentView<FTransformFragment>();
+    TArrayView<FMassRepresentationFragment> RepresentationList = Context.GetMutableFragmentView<FMassRepresentationFragment>();
+    TConstArrayView<FMassRepresentationLODFragment> RepresentationLODList = Context.GetFragmentView<FMassRepresentationLODFragment>();
+    TConstArrayView<FMassPooledVisualEffectFragment> PooledList = Context.GetFragmentView<FMassPooledVisualEffectFragment>();
+
+    const int32 NumEntities = Context.GetNumEntities();
+    for (int32 EntityIdx = 0; EntityIdx < NumEntities; EntityIdx++)
+    {
+      if (!PooledList.IsEmpty() && PooledList[EntityIdx].bIsDormant)
+      {
+        continue;
+      }
+
+      const FTransformFragment& TransformFragment = TransformList[EntityIdx];
+      const FMassRepresentationLODFragment& RepresentationLOD = RepresentationLODList[EntityIdx];
+      FMassRepresentationFragment& Representation = RepresentationList[EntityIdx];
+      if (Representation.CurrentRepresentation == EMassRepresentationType::StaticMeshInstance)
+      {
+        UpdateISMTransform(GetTypeHash(Context.GetEntity(EntityIdx)), ISMInfo[Representation.StaticMeshDescIndex], TransformFragment.GetTransform(), Representation.PrevTransform, RepresentationLOD.LODSignificance, Representation.PrevLODSignificance);
+      }
+      Representation.PrevTransform = TransformFragment.GetTransform();
+      Representation.PrevLODSignificance = RepresentationLOD.LODSignificance;
+    }
+  });
 }
\ No newline at end of file
@@ -3,13 +3,21 @@
 #include "HAL/IConsoleManager.h"
 #include "DrawDebugHelpers.h"
 #include <MassEnemyTargetFinderProcessor.h>
+#include "ProjectMStats.h"
 
 static int32 GMassSoundPerceptionSubsystemCounter = 0;
 static constexpr float GUMassSoundPerceptionSubsystem_GridCellSize = 100000.f; // TODO: value here may not be optimal for performance.
+static constexpr int32 GEnvironmentSoundPerceptionGridIndex = GMaxTeams; // Sounds not specific to a team get their own grid after the team grids.
+static constexpr int32 GNumSoundPerceptionGrids = GMaxTeams + 1;
 
 UMassSoundPerceptionSubsystem::UMassSoundPerceptionSubsystem()
-	: SoundPerceptionGridForTeam1(GUMassSoundPerceptionSubsystem_GridCellSize), SoundPerceptionGridForTeam2(GUMassSoundPerceptionSubsystem_GridCellSize)
 {
+	SoundPerceptionGrids.Reserve(GNumSoundPerceptionGrids);
+	for (int32 GridIndex = 0; GridIndex < GNumSoundPerceptionGrids; GridIndex++)
+	{
+		SoundPerceptionGrids.Emplace(GUMassSoundPerceptionSubsystem_GridCellSize);
+	}
+	IdsToMetaData.SetNum(GNumSoundPerceptionGrids);
 }
 
 void UMassSoundPerceptionSubsystem::Initialize(FSubsystemCollectionBase& Collection)
@@ -20,27 +28,28 @@ void UMassSoundPerceptionSubsystem::Initialize(FSubsystemCollectionBase& Collect
 
 void UMassSoundPerceptionSubsystem::Tick(float DeltaTime)
 {
-	TArray<uint32> ItemsToRemove;
-	for (const auto& Item : SoundPerceptionGridForTeam1.GetItems())
+	int32 NumSoundsAlive = 0;
+	for (int32 GridIndex = 0; GridIndex < GNumSoundPerceptionGrids; GridIndex++)
 	{
-		uint8& TicksLeftTilDestruction = IdsToMetaDataForTeam1[Item.ID].TicksLeftTilDestruction;
-		TicksLeftTilDestruction--;
-		if (TicksLeftTilDestruction <= 0)
-		{
-			ItemsToRemove.Add(Item.ID);
-		}
+		TickGrid(GridIndex);
+		NumSoundsAlive += IdsToMetaData[GridIndex].Num();
 	}
-	for (const int32& ItemID : ItemsToRemove)
+	UE::ProjectM::Stats::Set(EProjectMStat::SoundsAlive, NumSoundsAlive);
+}
+
+void UMassSoundPerceptionSubsystem::TickGrid(const int32 GridIndex)
+{
+	FSoundPerceptionHashGrid2D& SoundPerceptionGrid = SoundPerceptionGrids[GridIndex];
+	TMap<uint32, FMassSoundPerceptionItemMetaData>& GridIdsToMetaData = IdsToMetaData[GridIndex];
+	if (GridIdsToMetaData.IsEmpty())
 	{
-		SoundPerceptionGridForTeam1.Remove(ItemID, IdsToMetaDataForTeam1[ItemID].CellLocation);
-		IdsToMetaDataForTeam1.Remove(ItemID);
+		return;
 	}
 
-	ItemsToRemove.Reset();
-
-	for (const auto& Item : SoundPerceptionGridForTeam2.GetItems())
+	TArray<uint32> ItemsToRemove;
+	for (const auto& Item : SoundPerceptionGrid.GetItems())
 	{
-		uint8& TicksLeftTilDestruction = IdsToMetaDataForTeam2[Item.ID].TicksLeftTilDestruction;
+		uint8& TicksLeftTilDestruction = GridIdsToMetaData[Item.ID].TicksLeftTilDestruction;
 		TicksLeftTilDestruction--;
 		if (TicksLeftTilDestruction <= 0)
 		{
@@ -49,30 +58,34 @@ void UMassSoundPerceptionSubsystem::Tick(float DeltaTime)
 	}
 	for (const int32& ItemID : ItemsToRemove)
 	{
-		SoundPerceptionGridForTeam2.Remove(ItemID, IdsToMetaDataForTeam2[ItemID].CellLocation);
-		IdsToMetaDataForTeam2.Remove(ItemID);
+		SoundPerceptionGrid.Remove(ItemID, GridIdsToMetaData[ItemID].CellLocation);
+		GridIdsToMetaData.Remove(ItemID);
 	}
 }
 
 bool UMassSoundPerceptionSubsystem_DrawOnAddSoundPerception = false;
 FAutoConsoleVariableRef CVarUMassSoundPerceptionSubsystem_DrawOnAddSoundPerception(TEXT("pm.UMassSoundPerceptionSubsystem_DrawOnAddSoundPerception"), UMassSoundPerceptionSubsystem_DrawOnAddSoundPerception, TEXT("UMassSoundPerceptionSubsystem: Draw On AddSoundPerception"));
 
-void UMassSoundPerceptionSubsystem::AddSoundPerception(const FVector Location, const bool& bIsSourceFromTeam1, const bool SkipDebugDraw)
+void UMassSoundPerceptionSubsystem::AddSoundPerceptionToGrid(const FVector& Location, const int32 GridIndex, const uint8 TicksLeftTilDestruction)
 {
-	auto& SoundPerceptionGrid = bIsSourceFromTeam1 ? SoundPerceptionGridForTeam1 : SoundPerceptionGridForTeam2;
+	FSoundPerceptionHashGrid2D& SoundPerceptionGrid = SoundPerceptionGrids[GridIndex];
 	uint32 ItemID = GMassSoundPerceptionSubsystemCounter++;
 	static const float Extent = 3.f;
 	const FBox Bounds(Location - FVector(Extent, Extent, 0.f), Location + FVector(Extent, Extent, 0.f));
 	const FSoundPerceptionHashGrid2D::FCellLocation& CellLocation = SoundPerceptionGrid.Add(ItemID, Bounds);
 
+	const FMassSoundPerceptionItemMetaData ItemMetaData(TicksLeftTilDestruction, CellLocation, Location);
+	IdsToMetaData[GridIndex].Add(ItemID, ItemMetaData);
+}
 
-  const FMassSoundPerceptionItemMetaData ItemMetaData(FramesUntilSoundPerceptionDestruction, CellLocation, Location);
-	auto& IdsToMetaData = bIsSourceFromTeam1 ? IdsToMetaDataForTeam1 : IdsToMetaDataForTeam2;
-	IdsToMetaData.Add(ItemID, ItemMetaData);
+void UMassSoundPerceptionSubsystem::AddSoundPerception(const FVector Location, const uint8 SourceTeamIndex, const bool SkipDebugDraw)
+{
+	check(SourceTeamIndex < GMaxTeams);
+	AddSoundPerceptionToGrid(Location, SourceTeamIndex);
 
 	if (UMassSoundPerceptionSubsystem_DrawOnAddSoundPerception && !SkipDebugDraw)
 	{
-		::DrawDebugSphere(GetWorld(), Location, 200.f, 10, bIsSourceFromTeam1 ? FColor::Red : FColor::Blue, false, 0.1f);
+		::DrawDebugSphere(GetWorld(), Location, 200.f, 10, SourceTeamIndex == 0 ? FColor::Red : FColor::Blue, false, 0.1f);
 	}
 }
 
@@ -87,8 +100,7 @@ void UMassSoundPerceptionSubsystem::AddSoundPerception(const FVector Location)
 		return;
 	}
 
-	AddSoundPerception(Location, true, true);
-	AddSoundPerception(Location, false, true);
+	AddSoundPerceptionToGrid(Location, GEnvironmentSoundPerceptionGridIndex);
 
 	if (UMassSoundPerceptionSubsystem_DrawOnAddSoundPerception)
 	{
@@ -101,24 +113,80 @@ TStatId UMassSoundPerceptionSubsystem::GetStatId() const
 	RETURN_QUICK_DECLARE_CYCLE_STAT(UMassSoundPerceptionSubsystem, STATGROUP_Tickables);
 }
 
-bool UMassSoundPerceptionSubsystem::GetSoundsNearLocation(const FVector& Location, TArray<FVector>& OutCloseSounds, const bool bFilterToTeam1)
+void UMassSoundPerceptionSubsystem::QueryGrid(const FBox& QueryBox, const int32 GridIndex, TArray<FVector>& OutCloseSounds) const
 {
-	TRACE_CPUPROFILER_EVENT_SCOPE_STR("UMassSoundPerceptionSubsystem.GetSoundsNearLocation");
+	const TMap<uint32, FMassSoundPerceptionItemMetaData>& GridIdsToMetaData = IdsToMetaData[GridIndex];
+	if (GridIdsToMetaData.IsEmpty())
+	{
+		return;
+	}
 
-  const auto& SoundPerceptionGrid = bFilterToTeam1 ? SoundPerceptionGridForTeam1 : SoundPerceptionGridForTeam2;
 	TArray<FSoundPerceptionHashGrid2D::ItemIDType> NearbySounds;
+	SoundPerceptionGrids[GridIndex].Query(QueryBox, NearbySounds);
+
+	for (const FSoundPerceptionHashGrid2D::ItemIDType& SoundID : NearbySounds)
+	{
+		OutCloseSounds.Add(GridIdsToMetaData[SoundID].SoundSource);
+	};
+}
+
+bool UMassSoundPerceptionSubsystem::GetSoundsNearLocation(const FVector& Location, TArray<FVector>& OutCloseSounds, const uint32 SourceTeamsMask)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("UMassSoundPerceptionSubsystem.GetSoundsNearLocation");
+
 	static constexpr float QueryRadius = GUMassSoundPerceptionSubsystem_GridCellSize / 2.f;
 	const FVector Extent(QueryRadius, QueryRadius, QueryRadius);
 	const FBox QueryBox = FBox(Location - Extent, Location + Extent);
 
-	SoundPerceptionGrid.Query(QueryBox, NearbySounds);
+	// Only visit the grids of teams in the mask.
+	uint32 RemainingTeamsMask = SourceTeamsMask;
+	while (RemainingTeamsMask != 0)
+	{
+		const int32 TeamIndex = FMath::CountTrailingZeros(RemainingTeamsMask);
+		RemainingTeamsMask &= RemainingTeamsMask - 1;
+		QueryGrid(QueryBox, TeamIndex, OutCloseSounds);
+	}
 
-	auto& IdsToMetaData = bFilterToTeam1 ? IdsToMetaDataForTeam1 : IdsToMetaDataForTeam2;
+	QueryGrid(QueryBox, GEnvironmentSoundPerceptionGridIndex, OutCloseSounds);
 
-	for (const FSoundPerceptionHashGrid2D::ItemIDType& SoundID : NearbySounds)
+	return !OutCloseSounds.IsEmpty();
+}
+
+void UMassSoundPerceptionSubsystem::SerializeSnapshot(FArchive& Ar)
+{
+	int32 NumGrids = GNumSoundPerceptionGrids;
+	Ar << NumGrids;
+	if (Ar.IsLoading() && NumGrids != GNumSoundPerceptionGrids)
 	{
-		OutCloseSounds.Add(IdsToMetaData[SoundID].SoundSource);
-	};
+		Ar.SetError();
+		return;
+	}
 
-	return !OutCloseSounds.IsEmpty();
+	for (int32 GridIndex = 0; GridIndex < GNumSoundPerceptionGrids && !Ar.IsError(); GridIndex++)
+	{
+		TMap<uint32, FMassSoundPerceptionItemMetaData>& GridIdsToMetaData = IdsToMetaData[GridIndex];
+		int32 NumSounds = GridIdsToMetaData.Num();
+		Ar << NumSounds;
+		if (Ar.IsSaving())
+		{
+			for (const TPair<uint32, FMassSoundPerceptionItemMetaData>& Item : GridIdsToMetaData)
+			{
+				FVector SoundSource = Item.Value.SoundSource;
+				uint8 TicksLeftTilDestruction = Item.Value.TicksLeftTilDestruction;
+				Ar << SoundSource << TicksLeftTilDestruction;
+			}
+		}
+		else
+		{
+			SoundPerceptionGrids[GridIndex] = FSoundPerceptionHashGrid2D(GUMassSoundPerceptionSubsystem_GridCellSize);
+			GridIdsToMetaData.Reset();
+			for (int32 SoundIndex = 0; SoundIndex < NumSounds && !Ar.IsError(); SoundIndex++)
+			{
+				FVector SoundSource;
+				uint8 TicksLeftTilDestruction = 0;
+				Ar << SoundSource << TicksLeftTilDestruction;
+				AddSoundPerceptionToGrid(SoundSource, GridIndex, TicksLeftTilDestruction);
+			}
+		}
+	}
 }
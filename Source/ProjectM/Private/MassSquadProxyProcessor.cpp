@@ -0,0 +1,317 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#include "MassSquadProxyProcessor.h"
+
+#include "MassCommonFragments.h"
+#include "MassEntityTemplateRegistry.h"
+#include "MassEntityView.h"
+#include "MassExecutionContext.h"
+#include "MassLODSubsystem.h"
+#include "MassRepresentationFragments.h"
+#include "MassProjectileDamageProcessor.h"
+#include "MilitaryStructureSubsystem.h"
+
+// Aggregating and restoring moves every member to another archetype, so require moving a bit further out before aggregating.
+static constexpr float GSquadProxyHysteresis = 1.1f;
+
+void UMassSquadProxyTrait::BuildTemplate(FMassEntityTemplateBuildContext& BuildContext, UWorld& World) const
+{
+	UMassEntitySubsystem* EntitySubsystem = UWorld::GetSubsystem<UMassEntitySubsystem>(&World);
+	check(EntitySubsystem);
+
+	BuildContext.AddTag<FMassSquadProxyCandidateTag>();
+
+	const FConstSharedStruct ProxyFragment = EntitySubsystem->GetOrCreateConstSharedFragment(UE::StructUtils::GetStructCrc32(FConstStructView::Make(Proxy)), Proxy);
+	BuildContext.AddConstSharedFragment(ProxyFragment);
+}
+
+UMassSquadProxyProcessor::UMassSquadProxyProcessor()
+{
+	bAutoRegisterWithProcessingPhases = true;
+	ExecutionFlags = (int32)(EProcessorExecutionFlags::Client | EProcessorExecutionFlags::Standalone);
+	ExecutionOrder.ExecuteInGroup = UE::Mass::ProcessorGroupNames::LOD;
+	ExecutionOrder.ExecuteAfter.Add(UE::Mass::ProcessorGroupNames::LODCollector);
+
+	bRequiresGameThreadExecution = true;
+}
+
+void UMassSquadProxyProcessor::ConfigureQueries()
+{
+}
+
+void UMassSquadProxyProcessor::Initialize(UObject& Owner)
+{
+	Super::Initialize(Owner);
+
+	LODSubsystem = UWorld::GetSubsystem<UMassLODSubsystem>(Owner.GetWorld());
+	MilitaryStructureSubsystem = UWorld::GetSubsystem<UMilitaryStructureSubsystem>(Owner.GetWorld());
+	SquadProxySubsystem = UWorld::GetSubsystem<UMassSquadProxySubsystem>(Owner.GetWorld());
+}
+
+void UMassSquadProxyProcessor::Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context)
+{
+	check(MilitaryStructureSubsystem && SquadProxySubsystem);
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(UMassSquadProxyProcessor.Execute);
+
+	if (!UMassSquadProxyProcessor_Enabled)
+	{
+		for (TPair<TObjectKey<UMilitaryUnit>, FSquadProxy>& Pair : SquadProxies)
+		{
+			RestoreSquad(EntitySubsystem, Context, Pair.Value);
+		}
+		SquadProxies.Reset();
+		SquadProxySubsystem->FlushProxies();
+		return;
+	}
+
+	TimeUntilUpdate -= Context.GetDeltaTimeSeconds();
+	if (TimeUntilUpdate <= 0.f)
+	{
+		TimeUntilUpdate = UMassSquadProxyProcessor_UpdateInterval;
+		UpdateSquads(EntitySubsystem, Context);
+	}
+
+	UpdateProxyTransforms(EntitySubsystem, Context);
+	SquadProxySubsystem->FlushProxies();
+}
+
+void UMassSquadProxyProcessor::UpdateSquads(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UMassSquadProxyProcessor.UpdateSquads);
+
+	TArray<FVector, TInlineAllocator<4>> ViewerLocations;
+	if (LODSubsystem)
+	{
+		for (const FViewerInfo& Viewer : LODSubsystem->GetViewers())
+		{
+			if (Viewer.Handle.IsValid())
+			{
+				ViewerLocations.Add(Viewer.Location);
+			}
+		}
+	}
+
+	for (TPair<TObjectKey<UMilitaryUnit>, FSquadProxy>& Pair : SquadProxies)
+	{
+		Pair.Value.bSeen = false;
+	}
+
+	TArray<UMilitaryUnit*> Squads;
+	MilitaryStructureSubsystem->GetSquads(Squads);
+
+	TArray<FMassEntityHandle> Members;
+	for (const UMilitaryUnit* Squad : Squads)
+	{
+		FSquadProxy* SquadProxy = SquadProxies.Find(Squad);
+
+		// Aggregating a single soldier wouldn't save anything.
+		Members.Reset();
+		FTransform ProxyTransform;
+		bool bAggregate = ViewerLocations.Num() > 0 && GetMembersToAggregate(EntitySubsystem, Squad, Members) && Members.Num() > 1 && GetProxyTransform(EntitySubsystem, Members, ProxyTransform);
+		if (bAggregate)
+		{
+			float ClosestViewerDistanceSq = MAX_flt;
+			for (const FVector& ViewerLocation : ViewerLocations)
+			{
+				ClosestViewerDistanceSq = FMath::Min(ClosestViewerDistanceSq, FVector::DistSquared(ProxyTransform.GetLocation(), ViewerLocation));
+			}
+			const float Distance = UMassSquadProxyProcessor_Distance * (SquadProxy ? 1.f : GSquadProxyHysteresis);
+			bAggregate = ClosestViewerDistanceSq >= FMath::Square(Distance);
+		}
+
+		// Squads that are no longer aggregated are restored below, together with the ones that no longer exist.
+		if (!bAggregate)
+		{
+			continue;
+		}
+
+		if (!SquadProxy)
+		{
+			const FMassEntityView LeaderView(EntitySubsystem, Members[0]);
+			const int32 ProxyId = SquadProxySubsystem->AddProxy(LeaderView.GetConstSharedFragmentData<FMassSquadProxyParameters>(), ProxyTransform);
+			if (ProxyId == INDEX_NONE)
+			{
+				continue;
+			}
+			SquadProxy = &SquadProxies.Add(Squad);
+			SquadProxy->ProxyId = ProxyId;
+		}
+		AggregateMembers(EntitySubsystem, Context, *SquadProxy, Members);
+		SquadProxy->bSeen = true;
+	}
+
+	for (auto It = SquadProxies.CreateIterator(); It; ++It)
+	{
+		if (!It.Value().bSeen)
+		{
+			RestoreSquad(EntitySubsystem, Context, It.Value());
+			It.RemoveCurrent();
+		}
+	}
+}
+
+void UMassSquadProxyProcessor::UpdateProxyTransforms(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UMassSquadProxyProcessor.UpdateProxyTransforms);
+
+	for (auto It = SquadProxies.CreateIterator(); It; ++It)
+	{
+		FSquadProxy& SquadProxy = It.Value();
+
+		// Only destroyed members are dropped every frame. Dying ones are left out of the members gathered by UpdateSquads, which restores them.
+		for (int32 MemberIndex = SquadProxy.Members.Num() - 1; MemberIndex >= 0; MemberIndex--)
+		{
+			if (!EntitySubsystem.IsEntityValid(SquadProxy.Members[MemberIndex]))
+			{
+				SquadProxy.Members.RemoveAt(MemberIndex, 1, false);
+			}
+		}
+
+		FTransform ProxyTransform;
+		if (!GetProxyTransform(EntitySubsystem, SquadProxy.Members, ProxyTransform))
+		{
+			RestoreSquad(EntitySubsystem, Context, SquadProxy);
+			It.RemoveCurrent();
+			continue;
+		}
+		SquadProxySubsystem->UpdateProxy(SquadProxy.ProxyId, ProxyTransform);
+	}
+}
+
+void UMassSquadProxyProcessor::AggregateMembers(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context, FSquadProxy& SquadProxy, const TArray<FMassEntityHandle>& Members)
+{
+	for (const FMassEntityHandle Entity : SquadProxy.Members)
+	{
+		if (!Members.Contains(Entity))
+		{
+			RestoreMember(EntitySubsystem, Context, Entity);
+		}
+	}
+
+	for (const FMassEntityHandle Entity : Members)
+	{
+		if (!SquadProxy.Members.Contains(Entity))
+		{
+			Context.Defer().AddTag<FMassAggregatedIntoSquadProxyTag>(Entity);
+		}
+	}
+
+	SquadProxy.Members = Members;
+}
+
+void UMassSquadProxyProcessor::RestoreMember(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context, const FMassEntityHandle Entity)
+{
+	if (!EntitySubsystem.IsEntityValid(Entity))
+	{
+		return;
+	}
+
+	// The soldier's instance wasn't updated while it was aggregated, so don't let it interpolate from where it was left.
+	const FMassEntityView EntityView(EntitySubsystem, Entity);
+	FMassRepresentationFragment* RepresentationFragment = EntityView.GetFragmentDataPtr<FMassRepresentationFragment>();
+	const FTransformFragment* TransformFragment = EntityView.GetFragmentDataPtr<FTransformFragment>();
+	if (RepresentationFragment && TransformFragment)
+	{
+		RepresentationFragment->PrevTransform = TransformFragment->GetTransform();
+	}
+
+	Context.Defer().RemoveTag<FMassAggregatedIntoSquadProxyTag>(Entity);
+}
+
+void UMassSquadProxyProcessor::RestoreSquad(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context, FSquadProxy& SquadProxy)
+{
+	for (const FMassEntityHandle Entity : SquadProxy.Members)
+	{
+		RestoreMember(EntitySubsystem, Context, Entity);
+	}
+	SquadProxy.Members.Reset();
+
+	SquadProxySubsystem->RemoveProxy(SquadProxy.ProxyId);
+	SquadProxy.ProxyId = INDEX_NONE;
+}
+
+static bool RecursivelyGetMembersToAggregate(const UMassEntitySubsystem& EntitySubsystem, const UMilitaryUnit* Unit, TArray<FMassEntityHandle>& OutMembers)
+{
+	if (Unit->bIsPlayer)
+	{
+		return false;
+	}
+
+	if (Unit->bIsSoldier)
+	{
+		const FMassEntityHandle Entity = Unit->GetMassEntityHandle();
+		if (!EntitySubsystem.IsEntityValid(Entity))
+		{
+			return true;
+		}
+
+		const FMassEntityView EntityView(EntitySubsystem, Entity);
+		if (EntityView.HasTag<FMassSoldierIsDyingTag>())
+		{
+			return true;
+		}
+
+		const FMassRepresentationFragment* RepresentationFragment = EntityView.GetFragmentDataPtr<FMassRepresentationFragment>();
+		if (!EntityView.HasTag<FMassSquadProxyCandidateTag>() || !RepresentationFragment || RepresentationFragment->CurrentRepresentation != EMassRepresentationType::StaticMeshInstance)
+		{
+			return false;
+		}
+
+		OutMembers.Add(Entity);
+	}
+
+	for (const UMilitaryUnit* SubUnit : Unit->SubUnits)
+	{
+		if (!RecursivelyGetMembersToAggregate(EntitySubsystem, SubUnit, OutMembers))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool UMassSquadProxyProcessor::GetMembersToAggregate(const UMassEntitySubsystem& EntitySubsystem, const UMilitaryUnit* SquadUnit, TArray<FMassEntityHandle>& OutMembers)
+{
+	if (!RecursivelyGetMembersToAggregate(EntitySubsystem, SquadUnit, OutMembers))
+	{
+		return false;
+	}
+
+	// The squad leader goes first, as the proxy takes its rotation.
+	const int32 LeaderIndex = SquadUnit->Commander ? OutMembers.IndexOfByKey(SquadUnit->Commander->GetMassEntityHandle()) : INDEX_NONE;
+	if (LeaderIndex > 0)
+	{
+		OutMembers.Swap(0, LeaderIndex);
+	}
+
+	return true;
+}
+
+bool UMassSquadProxyProcessor::GetProxyTransform(const UMassEntitySubsystem& EntitySubsystem, const TArray<FMassEntityHandle>& Members, FTransform& OutTransform)
+{
+	FVector LocationSum = FVector::ZeroVector;
+	int32 NumLocations = 0;
+	for (const FMassEntityHandle Entity : Members)
+	{
+		if (const FTransformFragment* TransformFragment = EntitySubsystem.GetFragmentDataPtr<FTransformFragment>(Entity))
+		{
+			if (NumLocations == 0)
+			{
+				OutTransform.SetRotation(TransformFragment->GetTransform().GetRotation());
+			}
+			LocationSum += TransformFragment->GetTransform().GetLocation();
+			NumLocations++;
+		}
+	}
+
+	if (NumLocations == 0)
+	{
+		return false;
+	}
+
+	OutTransform.SetLocation(LocationSum / NumLocations);
+	OutTransform.SetScale3D(FVector::OneVector);
+	return true;
+}
@@ -0,0 +1,114 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#include "MassSquadProxySubsystem.h"
+
+#include "Components/InstancedStaticMeshComponent.h"
+
+void UMassSquadProxySubsystem::Deinitialize()
+{
+	Proxies.Empty();
+	Types.Empty();
+	ProxyActor = nullptr;
+
+	Super::Deinitialize();
+}
+
+int32 UMassSquadProxySubsystem::FindOrAddType(const FMassSquadProxyParameters& Parameters)
+{
+	const int32 ExistingTypeIndex = Types.IndexOfByPredicate([&Parameters](const FMassSquadProxyType& Type)
+	{
+		return Type.Parameters.Mesh == Parameters.Mesh && Type.Parameters.bCastShadows == Parameters.bCastShadows && Type.Parameters.MaterialOverrides == Parameters.MaterialOverrides;
+	});
+	if (ExistingTypeIndex != INDEX_NONE)
+	{
+		return ExistingTypeIndex;
+	}
+
+	UWorld* World = GetWorld();
+	if (!ProxyActor)
+	{
+		FActorSpawnParameters SpawnParameters;
+		SpawnParameters.ObjectFlags = RF_Transient;
+		ProxyActor = World->SpawnActor<AActor>(SpawnParameters);
+		USceneComponent* RootComponent = NewObject<USceneComponent>(ProxyActor, TEXT("Root"));
+		ProxyActor->SetRootComponent(RootComponent);
+		RootComponent->RegisterComponent();
+	}
+
+	FMassSquadProxyType& Type = Types.AddDefaulted_GetRef();
+	Type.Parameters = Parameters;
+
+	Type.Component = NewObject<UInstancedStaticMeshComponent>(ProxyActor);
+	Type.Component->SetMobility(EComponentMobility::Movable);
+	Type.Component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Type.Component->SetCanEverAffectNavigation(false);
+	Type.Component->SetCastShadow(Parameters.bCastShadows);
+	Type.Component->SetStaticMesh(Parameters.Mesh);
+	for (int32 MaterialIndex = 0; MaterialIndex < Parameters.MaterialOverrides.Num(); MaterialIndex++)
+	{
+		Type.Component->SetMaterial(MaterialIndex, Parameters.MaterialOverrides[MaterialIndex]);
+	}
+	Type.Component->SetupAttachment(ProxyActor->GetRootComponent());
+	Type.Component->RegisterComponent();
+
+	return Types.Num() - 1;
+}
+
+int32 UMassSquadProxySubsystem::AddProxy(const FMassSquadProxyParameters& Parameters, const FTransform& Transform)
+{
+	check(IsInGameThread());
+
+	if (!Parameters.Mesh)
+	{
+		return INDEX_NONE;
+	}
+
+	const int32 TypeIndex = FindOrAddType(Parameters);
+	FMassSquadProxyType& Type = Types[TypeIndex];
+	int32 InstanceIndex;
+	if (Type.FreeInstanceIndices.Num() > 0)
+	{
+		InstanceIndex = Type.FreeInstanceIndices.Pop(false);
+		Type.Component->UpdateInstanceTransform(InstanceIndex, Transform, true, false, true);
+		Type.bRenderStateDirty = true;
+	}
+	else
+	{
+		InstanceIndex = Type.Component->AddInstance(Transform, true);
+	}
+
+	return Proxies.Add({ TypeIndex, InstanceIndex });
+}
+
+void UMassSquadProxySubsystem::UpdateProxy(const int32 ProxyId, const FTransform& Transform)
+{
+	const FProxy& Proxy = Proxies[ProxyId];
+	FMassSquadProxyType& Type = Types[Proxy.TypeIndex];
+	Type.Component->UpdateInstanceTransform(Proxy.InstanceIndex, Transform, true, false, false);
+	Type.bRenderStateDirty = true;
+}
+
+void UMassSquadProxySubsystem::RemoveProxy(const int32 ProxyId)
+{
+	const FProxy& Proxy = Proxies[ProxyId];
+
+	// Hidden by scaling it to nothing until another proxy of the type reuses it.
+	FMassSquadProxyType& Type = Types[Proxy.TypeIndex];
+	Type.Component->UpdateInstanceTransform(Proxy.InstanceIndex, FTransform(FQuat::Identity, FVector::ZeroVector, FVector::ZeroVector), true, false, true);
+	Type.FreeInstanceIndices.Add(Proxy.InstanceIndex);
+	Type.bRenderStateDirty = true;
+
+	Proxies.RemoveAt(ProxyId);
+}
+
+void UMassSquadProxySubsystem::FlushProxies()
+{
+	for (FMassSquadProxyType& Type : Types)
+	{
+		if (Type.bRenderStateDirty)
+		{
+			Type.Component->MarkRenderStateDirty();
+			Type.bRenderStateDirty = false;
+		}
+	}
+}
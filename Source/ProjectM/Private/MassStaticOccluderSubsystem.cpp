@@ -0,0 +1,377 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#include "MassStaticOccluderSubsystem.h"
+
+#include "MassTraceContextSubsystem.h"
+#include "ProjectMWorldInfo.h"
+#include "Components/BoxComponent.h"
+#include "Kismet/GameplayStatics.h"
+#include "LandscapeProxy.h"
+#include "LandscapeHeightfieldCollisionComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "EngineUtils.h"
+#include "PhysicsEngine/BodySetup.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/BufferArchive.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+
+bool UMassStaticOccluderSubsystem_Enabled = true;
+FAutoConsoleVariableRef CVarUMassStaticOccluderSubsystem_Enabled(TEXT("pm.UMassStaticOccluderSubsystem_Enabled"), UMassStaticOccluderSubsystem_Enabled, TEXT("Answer visibility traces from the static occluder field when possible instead of always tracing against physics."));
+
+float UMassStaticOccluderSubsystem_CellSize = 1000.f;
+FAutoConsoleVariableRef CVarUMassStaticOccluderSubsystem_CellSize(TEXT("pm.UMassStaticOccluderSubsystem_CellSize"), UMassStaticOccluderSubsystem_CellSize, TEXT("XY size of static occluder field cells. Takes effect when the field is next built."));
+
+static constexpr int32 GMaxStaticOccluderFieldCellsPerAxis = 2048;
+
+// Written before the field so that files of other versions are rebuilt.
+static constexpr int32 GStaticOccluderFieldFileVersion = 1;
+
+struct UMassStaticOccluderSubsystem::FFieldBuild
+{
+	FStaticOccluderField Field;
+	FBox Bounds;
+	uint32 ContentHash = 0;
+	// Copied because the subsystem's trace context can be replaced on the game thread while the field is built.
+	FMassTraceContext TraceContext;
+	double StartTime = 0.0;
+	std::atomic<bool> bCancelled = false;
+};
+
+static float CalculateStaticOccluderFieldCellSize(const FBox& Bounds)
+{
+	const FVector Size = Bounds.GetSize();
+	return FMath::Max3(UMassStaticOccluderSubsystem_CellSize, Size.X / GMaxStaticOccluderFieldCellsPerAxis, Size.Y / GMaxStaticOccluderFieldCellsPerAxis);
+}
+
+void UMassStaticOccluderSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	TraceContextSubsystem = Collection.InitializeDependency<UMassTraceContextSubsystem>();
+}
+
+void UMassStaticOccluderSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(UMassStaticOccluderSubsystem.OnWorldBeginPlay);
+
+	const AProjectMWorldInfo* const WorldInfo = Cast<AProjectMWorldInfo>(UGameplayStatics::GetActorOfClass(&InWorld, AProjectMWorldInfo::StaticClass()));
+	const UBoxComponent* const WorldBounds = WorldInfo ? WorldInfo->GetWorldMapBounds() : nullptr;
+	if (!WorldBounds)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UMassStaticOccluderSubsystem: No AProjectMWorldInfo with world map bounds in level, visibility traces will always use physics."));
+		return;
+	}
+
+	const FVector& Center = WorldBounds->GetComponentLocation();
+	const FVector& Extents = WorldBounds->GetScaledBoxExtent();
+	const FBox Bounds(Center - Extents, Center + Extents);
+
+	if (!LoadField(Bounds, CalculateContentHash(Bounds)))
+	{
+		BuildField(Bounds);
+	}
+}
+
+void UMassStaticOccluderSubsystem::Deinitialize()
+{
+	if (PendingBuild)
+	{
+		PendingBuild->bCancelled = true;
+		PendingBuildTask.Wait();
+		PendingBuild.Reset();
+	}
+	Field.Reset();
+
+	Super::Deinitialize();
+}
+
+EStaticOcclusionResult UMassStaticOccluderSubsystem::Raycast(const FVector& Start, const FVector& End, const float Radius) const
+{
+	if (!UMassStaticOccluderSubsystem_Enabled)
+	{
+		return EStaticOcclusionResult::Unknown;
+	}
+
+	return Field.Raycast(Start, End, Radius);
+}
+
+void UMassStaticOccluderSubsystem::BuildField(const FBox& Bounds)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UMassStaticOccluderSubsystem.BuildField);
+	check(IsInGameThread());
+
+	if (PendingBuild)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UMassStaticOccluderSubsystem: Static occluder field is already being built."));
+		return;
+	}
+
+	const FVector Size = Bounds.GetSize();
+	const float CellSize = CalculateStaticOccluderFieldCellSize(Bounds);
+	const int32 NumX = FMath::Max(1, FMath::CeilToInt(Size.X / CellSize));
+	const int32 NumY = FMath::Max(1, FMath::CeilToInt(Size.Y / CellSize));
+	const float VoxelHeight = FMath::Max(Size.Z / FStaticOccluderField::NumVoxelsPerColumn, 1.f);
+
+	PendingBuild = MakeShared<FFieldBuild>();
+	PendingBuild->Field.Initialize(Bounds.Min, CellSize, NumX, NumY, VoxelHeight);
+	PendingBuild->Bounds = Bounds;
+	PendingBuild->ContentHash = CalculateContentHash(Bounds);
+	PendingBuild->TraceContext = TraceContextSubsystem->GetTraceContext();
+	PendingBuild->StartTime = FPlatformTime::Seconds();
+
+	// Deinitialize waits for the task, so the subsystem outlives it.
+	PendingBuildTask = Async(EAsyncExecution::ThreadPool, [this, FieldBuild = PendingBuild, NumX, NumY]()
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(UMassStaticOccluderSubsystem.BuildFieldTask);
+
+		// Physics scene queries are thread-safe and the field's columns are independent.
+		ParallelFor(NumY, [this, &Build = *FieldBuild, NumX](const int32 Y)
+		{
+			for (int32 X = 0; X < NumX && !Build.bCancelled; X++)
+			{
+				const float GroundHeight = CalculateGroundHeight(Build, Build.Field.GetColumnBounds(X, Y));
+				Build.Field.SetColumn(X, Y, GroundHeight, CalculateOccupiedVoxels(Build, X, Y, GroundHeight));
+			}
+		});
+	});
+}
+
+void UMassStaticOccluderSubsystem::Tick(float DeltaTime)
+{
+	// Swapped in at the end of the frame, when no processor is tracing against the field.
+	if (PendingBuild && PendingBuildTask.IsReady())
+	{
+		FinishBuildField();
+	}
+}
+
+TStatId UMassStaticOccluderSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UMassStaticOccluderSubsystem, STATGROUP_Tickables);
+}
+
+void UMassStaticOccluderSubsystem::FinishBuildField()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UMassStaticOccluderSubsystem.FinishBuildField);
+
+	Field = MoveTemp(PendingBuild->Field);
+	SourceBounds = PendingBuild->Bounds;
+	SourceContentHash = PendingBuild->ContentHash;
+
+	UE_LOG(LogTemp, Log, TEXT("UMassStaticOccluderSubsystem: Built %dx%d static occluder field in %.2f seconds."), Field.GetNumX(), Field.GetNumY(), FPlatformTime::Seconds() - PendingBuild->StartTime);
+
+	PendingBuild.Reset();
+	PendingBuildTask.Reset();
+	SaveField();
+}
+
+float UMassStaticOccluderSubsystem::CalculateGroundHeight(const FFieldBuild& Build, const FBox& ColumnBounds) const
+{
+	const UWorld* World = GetWorld();
+	const FMassTraceContext& TraceContext = Build.TraceContext;
+
+	const FVector Center = ColumnBounds.GetCenter();
+	const FVector Extent = ColumnBounds.GetExtent();
+	const FVector2D SamplePoints[] = {
+		FVector2D(Center.X, Center.Y),
+		FVector2D(Center.X - Extent.X, Center.Y - Extent.Y),
+		FVector2D(Center.X + Extent.X, Center.Y - Extent.Y),
+		FVector2D(Center.X - Extent.X, Center.Y + Extent.Y),
+		FVector2D(Center.X + Extent.X, Center.Y + Extent.Y),
+	};
+
+	float MinGroundHeight = MAX_flt;
+	float MaxGroundHeight = -MAX_flt;
+	for (const FVector2D& SamplePoint : SamplePoints)
+	{
+		FHitResult HitResult;
+		const FVector TraceStart(SamplePoint, ColumnBounds.Max.Z);
+		const FVector TraceEnd(SamplePoint, ColumnBounds.Min.Z);
+		if (!World->LineTraceSingleByChannel(HitResult, TraceStart, TraceEnd, TraceContext.VisibilityChannel, TraceContext.StaticVisibilityQueryParams, TraceContext.ResponseParams) || !Cast<ALandscapeProxy>(HitResult.GetActor()))
+		{
+			// Only landscape is known to be solid below its surface.
+			return -MAX_flt;
+		}
+		MinGroundHeight = FMath::Min(MinGroundHeight, HitResult.ImpactPoint.Z);
+		MaxGroundHeight = FMath::Max(MaxGroundHeight, HitResult.ImpactPoint.Z);
+	}
+
+	// On slopes and rough terrain the landscape between the samples can dip below all of them, so traces there would be wrongly reported as
+	// blocked. Only cells that are flat to within a voxel get a ground height.
+	if (MaxGroundHeight - MinGroundHeight > Build.Field.GetVoxelHeight())
+	{
+		return -MAX_flt;
+	}
+
+	return MinGroundHeight;
+}
+
+uint64 UMassStaticOccluderSubsystem::CalculateOccupiedVoxels(const FFieldBuild& Build, const int32 X, const int32 Y, const float GroundHeight) const
+{
+	// Voxels entirely below ground are occupied without having to test them.
+	int32 FirstVoxelAboveGround = 0;
+	while (FirstVoxelAboveGround < FStaticOccluderField::NumVoxelsPerColumn && Build.Field.GetVoxelRangeBounds(X, Y, FirstVoxelAboveGround, FirstVoxelAboveGround).Max.Z <= GroundHeight)
+	{
+		FirstVoxelAboveGround++;
+	}
+
+	uint64 OccupiedVoxels = FirstVoxelAboveGround > 0 ? FStaticOccluderField::MakeVoxelMask(0, FirstVoxelAboveGround - 1) : 0ull;
+	if (FirstVoxelAboveGround < FStaticOccluderField::NumVoxelsPerColumn)
+	{
+		CalculateOccupiedVoxelRange(Build, X, Y, FirstVoxelAboveGround, FStaticOccluderField::NumVoxelsPerColumn - 1, OccupiedVoxels);
+	}
+	return OccupiedVoxels;
+}
+
+void UMassStaticOccluderSubsystem::CalculateOccupiedVoxelRange(const FFieldBuild& Build, const int32 X, const int32 Y, const int32 FirstVoxel, const int32 LastVoxel, uint64& OutOccupiedVoxels) const
+{
+	const FBox RangeBounds = Build.Field.GetVoxelRangeBounds(X, Y, FirstVoxel, LastVoxel);
+	const FCollisionShape Box = FCollisionShape::MakeBox(RangeBounds.GetExtent());
+	const FMassTraceContext& TraceContext = Build.TraceContext;
+	if (!GetWorld()->OverlapBlockingTestByChannel(RangeBounds.GetCenter(), FQuat::Identity, TraceContext.VisibilityChannel, Box, TraceContext.StaticVisibilityQueryParams, TraceContext.ResponseParams))
+	{
+		return;
+	}
+
+	if (FirstVoxel == LastVoxel)
+	{
+		OutOccupiedVoxels |= FStaticOccluderField::MakeVoxelMask(FirstVoxel, LastVoxel);
+		return;
+	}
+
+	// Subdivide so that mostly empty columns only need a few overlap tests.
+	const int32 MiddleVoxel = (FirstVoxel + LastVoxel) / 2;
+	CalculateOccupiedVoxelRange(Build, X, Y, FirstVoxel, MiddleVoxel, OutOccupiedVoxels);
+	CalculateOccupiedVoxelRange(Build, X, Y, MiddleVoxel + 1, LastVoxel, OutOccupiedVoxels);
+}
+
+FString UMassStaticOccluderSubsystem::GetFieldFilePath() const
+{
+	const FString MapName = UGameplayStatics::GetCurrentLevelName(GetWorld(), true);
+	return FPaths::ProjectSavedDir() / TEXT("StaticOccluders") / MapName + TEXT(".bin");
+}
+
+uint32 UMassStaticOccluderSubsystem::CalculateContentHash(const FBox& Bounds) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UMassStaticOccluderSubsystem.CalculateContentHash);
+
+	const FMassTraceContext& TraceContext = TraceContextSubsystem->GetTraceContext();
+
+	// Actors aren't iterated in a stable order, so the components' hashes are sorted before being combined.
+	TArray<uint32> ComponentHashes;
+	for (TActorIterator<AActor> It(GetWorld()); It; ++It)
+	{
+		It->ForEachComponent<UPrimitiveComponent>(false, [&](const UPrimitiveComponent* Component)
+		{
+			if (!Component->IsRegistered() || Component->Mobility != EComponentMobility::Static || !Component->IsQueryCollisionEnabled() ||
+				Component->GetCollisionResponseToChannel(TraceContext.VisibilityChannel) != ECR_Block || !Bounds.Intersect(Component->Bounds.GetBox()))
+			{
+				return;
+			}
+
+			uint32 ComponentHash = GetTypeHash(Component->GetPathName());
+			ComponentHash = HashCombine(ComponentHash, GetTypeHash(FIntVector(Component->Bounds.Origin)));
+			ComponentHash = HashCombine(ComponentHash, GetTypeHash(FIntVector(Component->Bounds.BoxExtent)));
+
+			// Collision can change without the bounds changing, e.g. when a mesh's collision or the landscape's height is edited.
+			if (const UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(Component))
+			{
+				const UStaticMesh* StaticMesh = StaticMeshComponent->GetStaticMesh();
+				if (StaticMesh && StaticMesh->GetBodySetup())
+				{
+					ComponentHash = HashCombine(ComponentHash, GetTypeHash(StaticMesh->GetBodySetup()->BodySetupGuid));
+				}
+			}
+			else if (const ULandscapeHeightfieldCollisionComponent* HeightfieldComponent = Cast<ULandscapeHeightfieldCollisionComponent>(Component))
+			{
+				ComponentHash = HashCombine(ComponentHash, GetTypeHash(HeightfieldComponent->HeightfieldGuid));
+			}
+
+			ComponentHashes.Add(ComponentHash);
+		});
+	}
+
+	ComponentHashes.Sort();
+	uint32 ContentHash = GetTypeHash(ComponentHashes.Num());
+	for (const uint32 ComponentHash : ComponentHashes)
+	{
+		ContentHash = HashCombine(ContentHash, ComponentHash);
+	}
+	return ContentHash;
+}
+
+bool UMassStaticOccluderSubsystem::LoadField(const FBox& ExpectedBounds, const uint32 ExpectedContentHash)
+{
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *GetFieldFilePath(), FILEREAD_Silent))
+	{
+		return false;
+	}
+
+	FMemoryReader Reader(Bytes);
+	int32 FileVersion = 0;
+	FBox SavedBounds(ForceInit);
+	uint32 SavedContentHash = 0;
+	Reader << FileVersion;
+	if (FileVersion == GStaticOccluderFieldFileVersion)
+	{
+		Reader << SavedBounds << SavedContentHash;
+	}
+	if (Reader.IsError() || FileVersion != GStaticOccluderFieldFileVersion || !SavedBounds.Min.Equals(ExpectedBounds.Min, 1.f) || !SavedBounds.Max.Equals(ExpectedBounds.Max, 1.f) || SavedContentHash != ExpectedContentHash)
+	{
+		UE_LOG(LogTemp, Log, TEXT("UMassStaticOccluderSubsystem: Saved static occluder field is stale, rebuilding."));
+		return false;
+	}
+
+	Reader << Field;
+	if (Reader.IsError() || !Field.IsInitialized() || !FMath::IsNearlyEqual(Field.GetCellSize(), CalculateStaticOccluderFieldCellSize(ExpectedBounds), 1.f))
+	{
+		UE_LOG(LogTemp, Log, TEXT("UMassStaticOccluderSubsystem: Saved static occluder field is stale, rebuilding."));
+		Field.Reset();
+		return false;
+	}
+
+	SourceBounds = SavedBounds;
+	SourceContentHash = SavedContentHash;
+	return true;
+}
+
+bool UMassStaticOccluderSubsystem::SaveField()
+{
+	if (!Field.IsInitialized())
+	{
+		return false;
+	}
+
+	FBufferArchive Writer;
+	int32 FileVersion = GStaticOccluderFieldFileVersion;
+	Writer << FileVersion << SourceBounds << SourceContentHash << Field;
+	const bool bSuccess = FFileHelper::SaveArrayToFile(Writer, *GetFieldFilePath());
+	if (!bSuccess)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UMassStaticOccluderSubsystem: Failed to save static occluder field to %s."), *GetFieldFilePath());
+	}
+	return bSuccess;
+}
+
+static void RebuildStaticOccluderField(UWorld* World)
+{
+	UMassStaticOccluderSubsystem* StaticOccluderSubsystem = UWorld::GetSubsystem<UMassStaticOccluderSubsystem>(World);
+	if (!StaticOccluderSubsystem || !StaticOccluderSubsystem->GetField().IsInitialized())
+	{
+		return;
+	}
+
+	StaticOccluderSubsystem->BuildField(StaticOccluderSubsystem->GetSourceBounds());
+}
+
+static FAutoConsoleCommandWithWorld RebuildStaticOccluderFieldCmd(
+	TEXT("pm.RebuildStaticOccluderField"),
+	TEXT("Rebuild the static occluder field from the level's static collision in the background and save it."),
+	FConsoleCommandWithWorldDelegate::CreateStatic(RebuildStaticOccluderField)
+);
@@ -2,6 +2,8 @@
 
 #include <MassVisualEffectsSubsystem.h>
 #include <MassCommonFragments.h>
+#include "MassBattlefieldClutterSubsystem.h"
+#include "MassRepresentationFragments.h"
 
 //----------------------------------------------------------------------//
 //  UMassSwapEntityOnDestructionTrait
@@ -13,6 +15,7 @@ void UMassSwapEntityOnDestructionTrait::BuildTemplate(FMassEntityTemplateBuildCo
 		FMassSwapEntityOnDestructionFragment& SwapEntityOnDestructionFragment = BuildContext.AddFragment_GetRef<FMassSwapEntityOnDestructionFragment>();
 		UMassVisualEffectsSubsystem* MassVisualEffectsSubsystem = UWorld::GetSubsystem<UMassVisualEffectsSubsystem>(&World);
 		SwapEntityOnDestructionFragment.SwappedEntityConfigIndex = MassVisualEffectsSubsystem->FindOrAddEntityConfig(SwappedEntityConfig);
+		SwapEntityOnDestructionFragment.bSwapToClutter = bSwapToClutter;
 	}
 }
 
@@ -30,32 +33,54 @@ void UMassSwapEntityOnDestructionProcessor::ConfigureQueries()
 {
 	EntityQuery.AddRequirement<FMassSwapEntityOnDestructionFragment>(EMassFragmentAccess::ReadOnly);
 	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FMassRepresentationLODFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
+}
+
+void UMassSwapEntityOnDestructionProcessor::Initialize(UObject& Owner)
+{
+	Super::Initialize(Owner);
+
+	VisualEffectsSubsystem = UWorld::GetSubsystem<UMassVisualEffectsSubsystem>(Owner.GetWorld());
+	BattlefieldClutterSubsystem = UWorld::GetSubsystem<UMassBattlefieldClutterSubsystem>(Owner.GetWorld());
 }
 
 void UMassSwapEntityOnDestructionProcessor::Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context)
 {
-	EntityQuery.ForEachEntityChunk(EntitySubsystem, Context, [this, &EntitySubsystem](FMassExecutionContext& Context)
+	check(VisualEffectsSubsystem);
+
+	SwapRequests.Reset();
+	EntityQuery.ForEachEntityChunk(EntitySubsystem, Context, [this](FMassExecutionContext& Context)
 	{
 		const int32 NumEntities = Context.GetNumEntities();
 		TConstArrayView<FMassSwapEntityOnDestructionFragment> SwapEntityOnDestructionList = Context.GetFragmentView<FMassSwapEntityOnDestructionFragment>();
 		TConstArrayView<FTransformFragment> TransformList = Context.GetFragmentView<FTransformFragment>();
+		TConstArrayView<FMassRepresentationLODFragment> RepresentationLODList = Context.GetFragmentView<FMassRepresentationLODFragment>();
 
 		for (int32 i = 0; i < NumEntities; ++i)
 		{
 			const int16 SwappedEntityConfigIndex = SwapEntityOnDestructionList[i].SwappedEntityConfigIndex;
-			if (SwappedEntityConfigIndex >= 0)
+			if (SwappedEntityConfigIndex < 0)
 			{
-				UMassVisualEffectsSubsystem* MassVisualEffectsSubsystem = UWorld::GetSubsystem<UMassVisualEffectsSubsystem>(EntitySubsystem.GetWorld());
-				check(MassVisualEffectsSubsystem);
-
-				const FTransform& EntityTransform = TransformList[i].GetTransform();
+				continue;
+			}
 
-				// Must be done async because we can't spawn Mass entities in the middle of a Mass processor's Execute method.
-				AsyncTask(ENamedThreads::GameThread, [MassVisualEffectsSubsystem, SwappedEntityConfigIndex = SwappedEntityConfigIndex, EntityTransform]()
-				{
-					MassVisualEffectsSubsystem->SpawnEntity(SwappedEntityConfigIndex, EntityTransform);
-				});
+			const FTransform& EntityTransform = TransformList[i].GetTransform();
+			if (SwapEntityOnDestructionList[i].bSwapToClutter && BattlefieldClutterSubsystem && BattlefieldClutterSubsystem->AddEntityConfig(VisualEffectsSubsystem->GetEntityConfig(SwappedEntityConfigIndex), EntityTransform))
+			{
+				continue;
 			}
+
+			// The replacement takes over the destroyed entity's representation, so that its first frame doesn't blend from the origin or pop in LOD.
+			FMassVisualEffectRequest& SwapRequest = SwapRequests.Add_GetRef({ SwappedEntityConfigIndex, EntityTransform });
+			SwapRequest.bReplacesSourceEntity = true;
+			SwapRequest.SourceLODSignificance = RepresentationLODList.Num() > 0 ? RepresentationLODList[i].LODSignificance : -1.f;
 		}
 	});
+
+	// Queued because we can't spawn Mass entities in the middle of a Mass processor's Execute method. The whole frame's swaps are spawned in one
+	// batch per replacement type.
+	if (SwapRequests.Num() > 0)
+	{
+		VisualEffectsSubsystem->RequestEffects(SwapRequests);
+	}
 }
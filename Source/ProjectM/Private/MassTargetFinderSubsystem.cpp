@@ -1,10 +1,63 @@
 #include "MassTargetFinderSubsystem.h"
 
 #include "MassSimulationSubsystem.h"
+#include "MassEntitySubsystem.h"
+#include "MassEnemyTargetFinderProcessor.h"
+#include "InvalidTargetFinderProcessor.h"
+#include "ProjectMStats.h"
+
+float UMassTargetFinderSubsystem_LineOfFireCacheLifetime = 0.25f;
+FAutoConsoleVariableRef CVarUMassTargetFinderSubsystem_LineOfFireCacheLifetime(TEXT("pm.UMassTargetFinderSubsystem_LineOfFireCacheLifetime"), UMassTargetFinderSubsystem_LineOfFireCacheLifetime, TEXT("Seconds a line of fire query result can be reused for the same entity and target. 0 disables the cache."));
+
+float UMassTargetFinderSubsystem_LineOfFireCacheTolerance = 50.f;
+FAutoConsoleVariableRef CVarUMassTargetFinderSubsystem_LineOfFireCacheTolerance(TEXT("pm.UMassTargetFinderSubsystem_LineOfFireCacheTolerance"), UMassTargetFinderSubsystem_LineOfFireCacheTolerance, TEXT("How far the trace start or end can move before a cached line of fire query result is no longer reused."));
+
+int32 FMassTargetLocationStore::Add(const FMassEntityHandle Entity, const FVector& Location)
+{
+	int32 Slot;
+	if (FreeSlots.Num() > 0)
+	{
+		Slot = FreeSlots.Pop(false);
+		Entities[Slot] = Entity;
+		Locations[Slot] = Location;
+		Velocities[Slot] = FVector::ZeroVector;
+	}
+	else
+	{
+		Slot = Entities.Add(Entity);
+		Locations.Add(Location);
+		Velocities.Add(FVector::ZeroVector);
+	}
+
+	EntityToSlot.Add(Entity, Slot);
+	return Slot;
+}
+
+void FMassTargetLocationStore::Remove(const int32 Slot)
+{
+	if (!Entities.IsValidIndex(Slot) || !Entities[Slot].IsSet())
+	{
+		return;
+	}
+
+	EntityToSlot.Remove(Entities[Slot]);
+	Entities[Slot].Reset();
+	FreeSlots.Add(Slot);
+}
+
+void FMassTargetLocationStore::Update(const int32 Slot, const FVector& Location, const float DeltaTime)
+{
+	if (DeltaTime > 0.f)
+	{
+		Velocities[Slot] = (Location - Locations[Slot]) / DeltaTime;
+	}
+	Locations[Slot] = Location;
+}
 
 UMassTargetFinderSubsystem::UMassTargetFinderSubsystem()
 	// TODO: Constant here may not be optimal for performance.
 	: TargetGrid(UMassEnemyTargetFinder_FinestCellSize)
+	, TargetGridCellSize(UMassEnemyTargetFinder_FinestCellSize)
 {
 }
 
@@ -13,3 +66,133 @@ void UMassTargetFinderSubsystem::Initialize(FSubsystemCollectionBase& Collection
 	Super::Initialize(Collection);
 	Collection.InitializeDependency<UMassSimulationSubsystem>();
 }
+
+bool UMassTargetFinderSubsystem::AreEntitiesBlockingLineOfFire(const FLineOfFireQuery& Query, const UMassEntitySubsystem& EntitySubsystem) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UMassTargetFinderSubsystem.AreEntitiesBlockingLineOfFire);
+
+	const FCapsule& TraceCapsule = Query.ProjectileTraceCapsule;
+	const FVector Buffer(TraceCapsule.r + 10.f); // We keep a buffer in case piece start and end are same value on any axis.
+
+	// Coarser grid levels return the same items for consecutive cells, so make sure each entity is only tested once.
+	TSet<FMassEntityHandle, DefaultKeyFuncs<FMassEntityHandle>, TInlineSetAllocator<32>> TestedEntities;
+	TArray<FMassTargetGridItem> EntitiesInCell;
+	bool bIsBlocked = false;
+	int32 NumGridQueries = 0;
+	int32 NumGridQueryCandidates = 0;
+	int32 NumCollisionsTested = 0;
+
+	const bool bIsTruncated = ForEachGridCellAlongSegment(TraceCapsule.a, TraceCapsule.b, TargetGridCellSize, [&](const FVector& PieceStart, const FVector& PieceEnd)
+	{
+		const FBox PieceBounds(PieceStart.ComponentMin(PieceEnd) - Buffer, PieceStart.ComponentMax(PieceEnd) + Buffer);
+		EntitiesInCell.Reset();
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE(UMassTargetFinderSubsystem.AreEntitiesBlockingLineOfFire.TargetGridQuery);
+			TargetGrid.Query(PieceBounds, EntitiesInCell);
+		}
+		NumGridQueries++;
+		NumGridQueryCandidates += EntitiesInCell.Num();
+
+		for (const FMassTargetGridItem& OtherEntity : EntitiesInCell)
+		{
+			if (OtherEntity.Entity == Query.Entity || OtherEntity.Entity == Query.TargetEntity)
+			{
+				continue;
+			}
+
+			// Hitting a hostile entity that we can damage instead of the target is fine.
+			if ((Query.HostileTeamsMask & OtherEntity.TeamMask) != 0 && CanEntityDamageTargetEntity(Query.MinCaliberForDamage, OtherEntity.MinCaliberForDamage))
+			{
+				continue;
+			}
+
+			bool bIsAlreadyTested = false;
+			TestedEntities.Add(OtherEntity.Entity, &bIsAlreadyTested);
+			if (bIsAlreadyTested)
+			{
+				continue;
+			}
+
+			if (!EntitySubsystem.IsEntityValid(OtherEntity.Entity))
+			{
+				continue;
+			}
+
+			const FMassTargetGridItemDynamicData* OtherEntityDynamicData = TargetDynamicData.Find(OtherEntity.Entity);
+			NumCollisionsTested += OtherEntityDynamicData ? 1 : 0;
+			if (OtherEntityDynamicData && DidCapsulesCollide(TraceCapsule, OtherEntityDynamicData->Capsule, Query.Entity, *EntitySubsystem.GetWorld()))
+			{
+				bIsBlocked = true;
+				return false;
+			}
+		}
+
+		return true;
+	});
+
+	UE::ProjectM::Stats::Add(EProjectMStat::TargetGridQueries, NumGridQueries);
+	UE::ProjectM::Stats::Add(EProjectMStat::TargetGridQueryCandidates, NumGridQueryCandidates);
+	UE::ProjectM::Stats::Add(EProjectMStat::CollisionsTested, NumCollisionsTested);
+
+	// Entities on the part of the segment that wasn't walked weren't tested, so the line of fire isn't known to be clear.
+	return bIsBlocked || bIsTruncated;
+}
+
+ELineOfFireResult UMassTargetFinderSubsystem::QueryLineOfFire(const FLineOfFireQuery& Query, const UMassEntitySubsystem& EntitySubsystem) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UMassTargetFinderSubsystem.QueryLineOfFire);
+
+	const UWorld& World = *EntitySubsystem.GetWorld();
+	const float CurrentTime = World.GetTimeSeconds();
+	const FVector& TraceStart = Query.ProjectileTraceCapsule.a;
+	const FVector& TraceEnd = Query.ProjectileTraceCapsule.b;
+
+	const TPair<FMassEntityHandle, FMassEntityHandle> CacheKey(Query.Entity, Query.TargetEntity);
+	FLineOfFireCacheShard& Shard = LineOfFireCacheShards[GetTypeHash(CacheKey) % NumLineOfFireCacheShards];
+	{
+		FReadScopeLock ReadLock(Shard.Lock);
+		if (const FLineOfFireCacheEntry* Entry = Shard.Entries.Find(CacheKey))
+		{
+			const float ToleranceSquared = FMath::Square(UMassTargetFinderSubsystem_LineOfFireCacheTolerance);
+			if (CurrentTime - Entry->Time <= UMassTargetFinderSubsystem_LineOfFireCacheLifetime && FVector::DistSquared(Entry->TraceStart, TraceStart) <= ToleranceSquared && FVector::DistSquared(Entry->TraceEnd, TraceEnd) <= ToleranceSquared)
+			{
+				return Entry->Result;
+			}
+		}
+	}
+
+	ELineOfFireResult Result = ELineOfFireResult::Clear;
+	if (AreEntitiesBlockingLineOfFire(Query, EntitySubsystem))
+	{
+		Result = ELineOfFireResult::BlockedByEntity;
+	}
+	else if (!IsTargetEntityVisibleViaSphereTrace(World, TraceStart, TraceEnd))
+	{
+		Result = ELineOfFireResult::BlockedByWorld;
+	}
+
+	if (UMassTargetFinderSubsystem_LineOfFireCacheLifetime > 0.f)
+	{
+		FWriteScopeLock WriteLock(Shard.Lock);
+		Shard.Entries.Add(CacheKey, { TraceStart, TraceEnd, CurrentTime, Result });
+	}
+
+	return Result;
+}
+
+void UMassTargetFinderSubsystem::PruneLineOfFireCache(const float CurrentTime)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UMassTargetFinderSubsystem.PruneLineOfFireCache);
+
+	for (FLineOfFireCacheShard& Shard : LineOfFireCacheShards)
+	{
+		FWriteScopeLock WriteLock(Shard.Lock);
+		for (auto It = Shard.Entries.CreateIterator(); It; ++It)
+		{
+			if (CurrentTime - It.Value().Time > UMassTargetFinderSubsystem_LineOfFireCacheLifetime)
+			{
+				It.RemoveCurrent();
+			}
+		}
+	}
+}
@@ -7,6 +7,7 @@
 #include "MassMovementTypes.h"
 #include "MassMovementFragments.h"
 #include "MassEntityView.h"
+#include "MassEnemyTargetFinderProcessor.h"
 #include "Engine/World.h"
 
 //----------------------------------------------------------------------//
@@ -26,7 +27,7 @@ void UMassTargetGridProcessor::ConfigureQueries()
 	BaseEntityQuery.AddRequirement<FMassTargetGridCellLocationFragment>(EMassFragmentAccess::ReadWrite);
 	BaseEntityQuery.AddRequirement<FCollisionCapsuleParametersFragment>(EMassFragmentAccess::ReadOnly);
 	BaseEntityQuery.AddRequirement<FProjectileDamagableFragment>(EMassFragmentAccess::ReadOnly);
-	BaseEntityQuery.AddRequirement<FTeamMemberFragment>(EMassFragmentAccess::ReadOnly);
+	BaseEntityQuery.AddConstSharedRequirement<FTeamHostilityParameters>(EMassFragmentPresence::All);
 
 	AddToGridEntityQuery = BaseEntityQuery;
 	AddToGridEntityQuery.AddTagRequirement<FMassInTargetGridTag>(EMassFragmentPresence::None);
@@ -49,6 +50,8 @@ void UMassTargetGridProcessor::Execute(UMassEntitySubsystem& EntitySubsystem, FM
 		return;
 	}
 
+	TargetFinderSubsystem->PruneLineOfFireCache(EntitySubsystem.GetWorld()->GetTimeSeconds());
+
 	// can't be ParallelFor due to GetTargetGridMutable().Add() not being thread-safe
 	AddToGridEntityQuery.ForEachEntityChunk(EntitySubsystem, Context, [this, &EntitySubsystem](FMassExecutionContext& Context)
 	{
@@ -57,7 +60,7 @@ void UMassTargetGridProcessor::Execute(UMassEntitySubsystem& EntitySubsystem, FM
 		TConstArrayView<FTransformFragment> LocationList = Context.GetFragmentView<FTransformFragment>();
 		TConstArrayView<FAgentRadiusFragment> RadiiList = Context.GetFragmentView<FAgentRadiusFragment>();
 		TArrayView<FMassTargetGridCellLocationFragment> TargetGridCellLocationList = Context.GetMutableFragmentView<FMassTargetGridCellLocationFragment>();
-		const TConstArrayView<FTeamMemberFragment> TeamMemberList = Context.GetFragmentView<FTeamMemberFragment>();
+		const FTeamHostilityParameters& HostilityParameters = Context.GetConstSharedFragment<FTeamHostilityParameters>();
 		const TConstArrayView<FProjectileDamagableFragment> ProjectileDamagableList = Context.GetFragmentView<FProjectileDamagableFragment>();
 		const TConstArrayView<FCollisionCapsuleParametersFragment> CollisionCapsuleParametersList = Context.GetFragmentView<FCollisionCapsuleParametersFragment>();
 
@@ -70,7 +73,7 @@ void UMassTargetGridProcessor::Execute(UMassEntitySubsystem& EntitySubsystem, FM
 
 			const FMassEntityHandle& TargetEntity = Context.GetEntity(EntityIndex);
 			const bool& bIsEntitySolder = Context.DoesArchetypeHaveTag<FMassProjectileDamagableSoldierTag>();
-			FMassTargetGridItem TargetGridItem(TargetEntity, TeamMemberList[EntityIndex].IsOnTeam1, ProjectileDamagableList[EntityIndex].MinCaliberForDamage, bIsEntitySolder);
+			FMassTargetGridItem TargetGridItem(TargetEntity, HostilityParameters.TeamMask, ProjectileDamagableList[EntityIndex].MinCaliberForDamage, bIsEntitySolder);
 
 			const FBox NewBounds(EntityLocation - FVector(Radius, Radius, 0.f), EntityLocation + FVector(Radius, Radius, 0.f));
 			TargetGridCellLocationList[EntityIndex].CellLoc = TargetFinderSubsystem->GetTargetGridMutable().Add(TargetGridItem, NewBounds);
@@ -78,6 +81,7 @@ void UMassTargetGridProcessor::Execute(UMassEntitySubsystem& EntitySubsystem, FM
 			FCapsule Capsule = MakeCapsuleForEntity(CollisionCapsuleParametersList[EntityIndex], EntityTransform);
 			FMassTargetGridItemDynamicData DynamicData(EntityLocation, Capsule);
 			TargetFinderSubsystem->GetTargetDynamicDataMutable().Emplace(TargetEntity, DynamicData);
+			TargetGridCellLocationList[EntityIndex].LocationSlot = TargetFinderSubsystem->GetTargetLocationStoreMutable().Add(TargetEntity, EntityLocation);
 
 			Context.Defer().AddTag<FMassInTargetGridTag>(TargetEntity);
 		}
@@ -86,11 +90,13 @@ void UMassTargetGridProcessor::Execute(UMassEntitySubsystem& EntitySubsystem, FM
 	UpdateGridEntityQuery.ForEachEntityChunk(EntitySubsystem, Context, [this, &EntitySubsystem](FMassExecutionContext& Context)
 	{
 		const int32 NumEntities = Context.GetNumEntities();
+		const float DeltaTime = Context.GetDeltaTimeSeconds();
+		FMassTargetLocationStore& TargetLocationStore = TargetFinderSubsystem->GetTargetLocationStoreMutable();
 
 		TConstArrayView<FTransformFragment> LocationList = Context.GetFragmentView<FTransformFragment>();
 		TConstArrayView<FAgentRadiusFragment> RadiiList = Context.GetFragmentView<FAgentRadiusFragment>();
 		TArrayView<FMassTargetGridCellLocationFragment> TargetGridCellLocationList = Context.GetMutableFragmentView<FMassTargetGridCellLocationFragment>();
-		const TConstArrayView<FTeamMemberFragment> TeamMemberList = Context.GetFragmentView<FTeamMemberFragment>();
+		const FTeamHostilityParameters& HostilityParameters = Context.GetConstSharedFragment<FTeamHostilityParameters>();
 		const TConstArrayView<FProjectileDamagableFragment> ProjectileDamagableList = Context.GetFragmentView<FProjectileDamagableFragment>();
 		const TConstArrayView<FCollisionCapsuleParametersFragment> CollisionCapsuleParametersList = Context.GetFragmentView<FCollisionCapsuleParametersFragment>();
 
@@ -104,13 +110,23 @@ void UMassTargetGridProcessor::Execute(UMassEntitySubsystem& EntitySubsystem, FM
 			const FMassEntityHandle& TargetEntity = Context.GetEntity(EntityIndex);
 			const bool& bIsEntitySolder = Context.DoesArchetypeHaveTag<FMassProjectileDamagableSoldierTag>();
 			FCapsule Capsule = MakeCapsuleForEntity(CollisionCapsuleParametersList[EntityIndex], EntityTransform);
-			FMassTargetGridItem TargetGridItem(TargetEntity, TeamMemberList[EntityIndex].IsOnTeam1, ProjectileDamagableList[EntityIndex].MinCaliberForDamage, bIsEntitySolder);
+			FMassTargetGridItem TargetGridItem(TargetEntity, HostilityParameters.TeamMask, ProjectileDamagableList[EntityIndex].MinCaliberForDamage, bIsEntitySolder);
 			const FBox NewBounds(EntityLocation - FVector(Radius, Radius, 0.f), EntityLocation + FVector(Radius, Radius, 0.f));
 
 			TargetGridCellLocationList[EntityIndex].CellLoc = TargetFinderSubsystem->GetTargetGridMutable().Move(TargetGridItem, TargetGridCellLocationList[EntityIndex].CellLoc, NewBounds);
 			FMassTargetGridItemDynamicData& TargetDynamicData = TargetFinderSubsystem->GetTargetDynamicDataMutable().FindOrAdd(TargetEntity);
 			TargetDynamicData.Location = EntityLocation;
 			TargetDynamicData.Capsule = Capsule;
+
+			int32& LocationSlot = TargetGridCellLocationList[EntityIndex].LocationSlot;
+			if (TargetLocationStore.IsSlotOfEntity(LocationSlot, TargetEntity))
+			{
+				TargetLocationStore.Update(LocationSlot, EntityLocation, DeltaTime);
+			}
+			else
+			{
+				LocationSlot = TargetLocationStore.Add(TargetEntity, EntityLocation);
+			}
 		}
 	});
 }
@@ -154,6 +170,7 @@ void UMassTargetRemoverProcessor::Execute(UMassEntitySubsystem& EntitySubsystem,
 			TargetGridItem.Entity = Context.GetEntity(i);
 			TargetFinderSubsystem->GetTargetGridMutable().Remove(TargetGridItem, TargetGridCellLocationList[i].CellLoc);
 			TargetFinderSubsystem->GetTargetDynamicDataMutable().Remove(TargetGridItem.Entity);
+			TargetFinderSubsystem->GetTargetLocationStoreMutable().Remove(TargetGridCellLocationList[i].LocationSlot);
 		}
 	});
 }
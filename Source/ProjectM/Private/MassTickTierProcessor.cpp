@@ -0,0 +1,174 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#include "MassTickTierProcessor.h"
+
+#include "MassCommonFragments.h"
+#include "MassEnemyTargetFinderProcessor.h"
+#include "MassExecutionContext.h"
+#include "MassLODSubsystem.h"
+
+bool UMassTickTierProcessor_Enabled = true;
+FAutoConsoleVariableRef CVarUMassTickTierProcessor_Enabled(TEXT("pm.UMassTickTierProcessor_Enabled"), UMassTickTierProcessor_Enabled, TEXT("Lower how often far away entities are processed. When disabled, all entities move back to ticking every frame."));
+
+float UMassTickTierProcessor_EverySecondFrameDistance = 5000.f;
+FAutoConsoleVariableRef CVarUMassTickTierProcessor_EverySecondFrameDistance(TEXT("pm.UMassTickTierProcessor_EverySecondFrameDistance"), UMassTickTierProcessor_EverySecondFrameDistance, TEXT("Distance to the closest viewer from which entities not in combat tick every second frame."));
+
+float UMassTickTierProcessor_EveryFourthFrameDistance = 15000.f;
+FAutoConsoleVariableRef CVarUMassTickTierProcessor_EveryFourthFrameDistance(TEXT("pm.UMassTickTierProcessor_EveryFourthFrameDistance"), UMassTickTierProcessor_EveryFourthFrameDistance, TEXT("Distance to the closest viewer from which entities not in combat tick every fourth frame."));
+
+float UMassTickTierProcessor_EveryEighthFrameDistance = 30000.f;
+FAutoConsoleVariableRef CVarUMassTickTierProcessor_EveryEighthFrameDistance(TEXT("pm.UMassTickTierProcessor_EveryEighthFrameDistance"), UMassTickTierProcessor_EveryEighthFrameDistance, TEXT("Distance to the closest viewer from which entities not in combat tick every eighth frame."));
+
+// Changing tier moves the entity to another archetype, so require moving a bit further out before dropping to a slower tier.
+static constexpr float GTickTierHysteresis = 1.1f;
+
+template<typename TagType>
+static void AddTickTierTagRequirement(FMassEntityQuery& Query, const EMassTickTier QueryTier, const EMassTickTier TagTier)
+{
+	Query.AddTagRequirement<TagType>(QueryTier == TagTier ? EMassFragmentPresence::All : EMassFragmentPresence::None);
+}
+
+static void PushTickTierTagChange(FMassExecutionContext& Context, const FMassEntityHandle& Entity, const EMassTickTier Tier, const bool bAdd)
+{
+	switch (Tier)
+	{
+	case EMassTickTier::EverySecondFrame:
+		bAdd ? Context.Defer().AddTag<FMassTickTierEverySecondFrameTag>(Entity) : Context.Defer().RemoveTag<FMassTickTierEverySecondFrameTag>(Entity);
+		break;
+	case EMassTickTier::EveryFourthFrame:
+		bAdd ? Context.Defer().AddTag<FMassTickTierEveryFourthFrameTag>(Entity) : Context.Defer().RemoveTag<FMassTickTierEveryFourthFrameTag>(Entity);
+		break;
+	case EMassTickTier::EveryEighthFrame:
+		bAdd ? Context.Defer().AddTag<FMassTickTierEveryEighthFrameTag>(Entity) : Context.Defer().RemoveTag<FMassTickTierEveryEighthFrameTag>(Entity);
+		break;
+	default:
+		break;
+	}
+}
+
+UMassTickTierProcessor::UMassTickTierProcessor()
+{
+	bAutoRegisterWithProcessingPhases = true;
+	ExecutionFlags = (int32)EProcessorExecutionFlags::All;
+	ExecutionOrder.ExecuteInGroup = UE::Mass::ProcessorGroupNames::LOD;
+	ExecutionOrder.ExecuteAfter.Add(UE::Mass::ProcessorGroupNames::LODCollector);
+}
+
+void UMassTickTierProcessor::ConfigureQueries()
+{
+	for (uint8 TierIndex = 0; TierIndex < static_cast<uint8>(EMassTickTier::MAX); TierIndex++)
+	{
+		const EMassTickTier Tier = static_cast<EMassTickTier>(TierIndex);
+		FMassEntityQuery& Query = TierEntityQueries[TierIndex];
+		Query.AddRequirement<FMassTickTierFragment>(EMassFragmentAccess::ReadWrite);
+		Query.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
+		Query.AddRequirement<FTargetEntityFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
+		Query.AddChunkRequirement<FMassTickTierChunkFragment>(EMassFragmentAccess::ReadWrite);
+		AddTickTierTagRequirement<FMassTickTierEverySecondFrameTag>(Query, Tier, EMassTickTier::EverySecondFrame);
+		AddTickTierTagRequirement<FMassTickTierEveryFourthFrameTag>(Query, Tier, EMassTickTier::EveryFourthFrame);
+		AddTickTierTagRequirement<FMassTickTierEveryEighthFrameTag>(Query, Tier, EMassTickTier::EveryEighthFrame);
+	}
+}
+
+void UMassTickTierProcessor::Initialize(UObject& Owner)
+{
+	Super::Initialize(Owner);
+
+	LODSubsystem = UWorld::GetSubsystem<UMassLODSubsystem>(Owner.GetWorld());
+}
+
+EMassTickTier UMassTickTierProcessor::CalculateTickTier(const float DistanceToClosestViewer, const bool bInCombat, const EMassTickTier CurrentTier)
+{
+	if (bInCombat)
+	{
+		return EMassTickTier::EveryFrame;
+	}
+
+	const float TierDistances[] = { UMassTickTierProcessor_EverySecondFrameDistance, UMassTickTierProcessor_EveryFourthFrameDistance, UMassTickTierProcessor_EveryEighthFrameDistance };
+
+	EMassTickTier Tier = EMassTickTier::EveryFrame;
+	for (uint8 TierIndex = 1; TierIndex < static_cast<uint8>(EMassTickTier::MAX); TierIndex++)
+	{
+		const float Hysteresis = TierIndex > static_cast<uint8>(CurrentTier) ? GTickTierHysteresis : 1.f;
+		if (DistanceToClosestViewer >= TierDistances[TierIndex - 1] * Hysteresis)
+		{
+			Tier = static_cast<EMassTickTier>(TierIndex);
+		}
+	}
+	return Tier;
+}
+
+void UMassTickTierProcessor::Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UMassTickTierProcessor.Execute);
+
+	FrameCounter++;
+
+	TArray<FVector, TInlineAllocator<4>> ViewerLocations;
+	if (LODSubsystem)
+	{
+		for (const FViewerInfo& Viewer : LODSubsystem->GetViewers())
+		{
+			if (Viewer.Handle.IsValid())
+			{
+				ViewerLocations.Add(Viewer.Location);
+			}
+		}
+	}
+
+	const float DeltaTime = Context.GetDeltaTimeSeconds();
+
+	for (uint8 TierIndex = 0; TierIndex < static_cast<uint8>(EMassTickTier::MAX); TierIndex++)
+	{
+		const EMassTickTier ChunkTier = static_cast<EMassTickTier>(TierIndex);
+		TierEntityQueries[TierIndex].ParallelForEachEntityChunk(EntitySubsystem, Context, [this, ChunkTier, DeltaTime, &ViewerLocations](FMassExecutionContext& Context)
+		{
+			FMassTickTierChunkFragment& ChunkFragment = Context.GetMutableChunkFragment<FMassTickTierChunkFragment>();
+			if (!ChunkFragment.IsInitialized())
+			{
+				ChunkFragment.Initialize(static_cast<uint8>(NextChunkFrameOffset.fetch_add(1, std::memory_order_relaxed)));
+			}
+			ChunkFragment.Update(ChunkTier, FrameCounter, DeltaTime);
+
+			// Reevaluating on tick frames is often enough since an entity can only act on its new tier when its chunk ticks.
+			if (!ChunkFragment.ShouldTickThisFrame())
+			{
+				return;
+			}
+
+			const int32 NumEntities = Context.GetNumEntities();
+			const TArrayView<FMassTickTierFragment> TickTierList = Context.GetMutableFragmentView<FMassTickTierFragment>();
+			const TConstArrayView<FTransformFragment> TransformList = Context.GetFragmentView<FTransformFragment>();
+			const TConstArrayView<FTargetEntityFragment> TargetEntityList = Context.GetFragmentView<FTargetEntityFragment>();
+
+			for (int32 EntityIndex = 0; EntityIndex < NumEntities; ++EntityIndex)
+			{
+				FMassTickTierFragment& TickTierFragment = TickTierList[EntityIndex];
+				TickTierFragment.Tier = ChunkTier;
+
+				EMassTickTier NewTier = EMassTickTier::EveryFrame;
+				if (UMassTickTierProcessor_Enabled)
+				{
+					const FVector& Location = TransformList[EntityIndex].GetTransform().GetLocation();
+					float ClosestViewerDistanceSq = MAX_flt;
+					for (const FVector& ViewerLocation : ViewerLocations)
+					{
+						ClosestViewerDistanceSq = FMath::Min(ClosestViewerDistanceSq, FVector::DistSquared(Location, ViewerLocation));
+					}
+
+					const bool bInCombat = TargetEntityList.Num() > 0 && TargetEntityList[EntityIndex].Entity.IsSet();
+					const float ClosestViewerDistance = ViewerLocations.Num() > 0 ? FMath::Sqrt(ClosestViewerDistanceSq) : MAX_flt;
+					NewTier = CalculateTickTier(ClosestViewerDistance, bInCombat, ChunkTier);
+				}
+
+				if (NewTier != ChunkTier)
+				{
+					const FMassEntityHandle Entity = Context.GetEntity(EntityIndex);
+					PushTickTierTagChange(Context, Entity, ChunkTier, false);
+					PushTickTierTagChange(Context, Entity, NewTier, true);
+					TickTierFragment.Tier = NewTier;
+				}
+			}
+		});
+	}
+}
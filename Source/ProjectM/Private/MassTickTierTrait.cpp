@@ -0,0 +1,53 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#include "MassTickTierTrait.h"
+
+#include "MassEntityTemplateRegistry.h"
+#include "MassExecutionContext.h"
+
+bool FMassTickTierChunkFragment::ShouldTickChunkThisFrame(const FMassExecutionContext& Context)
+{
+	const FMassTickTierChunkFragment* ChunkFragment = Context.GetChunkFragmentPtr<FMassTickTierChunkFragment>();
+	return ChunkFragment == nullptr || ChunkFragment->ShouldTickThisFrame();
+}
+
+float FMassTickTierChunkFragment::GetChunkDeltaTime(const FMassExecutionContext& Context)
+{
+	const FMassTickTierChunkFragment* ChunkFragment = Context.GetChunkFragmentPtr<FMassTickTierChunkFragment>();
+	return ChunkFragment && ChunkFragment->bInitialized ? ChunkFragment->DeltaTime : Context.GetDeltaTimeSeconds();
+}
+
+int32 FMassTickTierChunkFragment::GetChunkTickPeriod(const FMassExecutionContext& Context)
+{
+	const FMassTickTierChunkFragment* ChunkFragment = Context.GetChunkFragmentPtr<FMassTickTierChunkFragment>();
+	return ChunkFragment ? GetTickPeriod(ChunkFragment->Tier) : 1;
+}
+
+void FMassTickTierChunkFragment::Initialize(const uint8 InFrameOffset)
+{
+	bInitialized = true;
+	FrameOffset = InFrameOffset;
+	TimeSinceLastTick = 0.f;
+}
+
+void FMassTickTierChunkFragment::Update(const EMassTickTier InTier, const uint32 FrameCounter, const float InDeltaTime)
+{
+	check(bInitialized);
+
+	Tier = InTier;
+	TimeSinceLastTick += InDeltaTime;
+
+	const uint32 Period = GetTickPeriod(Tier);
+	bShouldTickThisFrame = (FrameCounter + FrameOffset) % Period == 0;
+	if (bShouldTickThisFrame)
+	{
+		DeltaTime = TimeSinceLastTick;
+		TimeSinceLastTick = 0.f;
+	}
+}
+
+void UMassTickTierTrait::BuildTemplate(FMassEntityTemplateBuildContext& BuildContext, UWorld& World) const
+{
+	BuildContext.AddFragment<FMassTickTierFragment>();
+	BuildContext.AddChunkFragment<FMassTickTierChunkFragment>();
+}
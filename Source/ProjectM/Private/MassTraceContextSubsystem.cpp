@@ -0,0 +1,37 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#include "MassTraceContextSubsystem.h"
+
+#include "ProjectMStats.h"
+
+void UMassTraceContextSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	TraceContext.VisibilityQueryParams = FCollisionQueryParams(SCENE_QUERY_STAT(MassVisibilityTrace), false);
+
+	TraceContext.StaticVisibilityQueryParams = TraceContext.VisibilityQueryParams;
+	TraceContext.StaticVisibilityQueryParams.StatId = SCENE_QUERY_STAT_ONLY(StaticOccluderField);
+	TraceContext.StaticVisibilityQueryParams.MobilityType = EQueryMobilityType::Static;
+}
+
+bool UMassTraceContextSubsystem::LineTraceTest(const UWorld& World, const FVector& Start, const FVector& End) const
+{
+	UE::ProjectM::Stats::Add(EProjectMStat::LineTraces);
+	const FMassTraceContext& Context = GetTraceContext();
+	return World.LineTraceTestByChannel(Start, End, Context.VisibilityChannel, Context.VisibilityQueryParams, Context.ResponseParams);
+}
+
+bool UMassTraceContextSubsystem::LineTraceSingle(const UWorld& World, FHitResult& OutHitResult, const FVector& Start, const FVector& End) const
+{
+	UE::ProjectM::Stats::Add(EProjectMStat::LineTraces);
+	const FMassTraceContext& Context = GetTraceContext();
+	return World.LineTraceSingleByChannel(OutHitResult, Start, End, Context.VisibilityChannel, Context.VisibilityQueryParams, Context.ResponseParams);
+}
+
+bool UMassTraceContextSubsystem::SphereTraceTest(const UWorld& World, const FVector& Start, const FVector& End, const float Radius) const
+{
+	UE::ProjectM::Stats::Add(EProjectMStat::SphereTraces);
+	const FMassTraceContext& Context = GetTraceContext();
+	return World.SweepTestByChannel(Start, End, FQuat::Identity, Context.VisibilityChannel, FCollisionShape::MakeSphere(Radius), Context.VisibilityQueryParams, Context.ResponseParams);
+}
@@ -7,6 +7,9 @@
 #include "MassRepresentationTypes.h"
 #include "MassEnemyTargetFinderProcessor.h"
 #include "MassNavigationFragments.h"
+#include "MassTargetFinderSubsystem.h"
+#include "MassProjectileDamageProcessor.h"
+#include "MassTickTierTrait.h"
 
 UMassTrackTargetProcessor::UMassTrackTargetProcessor()
 {
@@ -19,46 +22,65 @@ UMassTrackTargetProcessor::UMassTrackTargetProcessor()
 void UMassTrackTargetProcessor::ConfigureQueries()
 {
 	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
-	EntityQuery.AddRequirement<FTargetEntityFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FTargetEntityFragment>(EMassFragmentAccess::ReadWrite);
 	EntityQuery.AddRequirement<FMassMoveTargetFragment>(EMassFragmentAccess::ReadWrite);
 	EntityQuery.AddTagRequirement<FMassTrackTargetTag>(EMassFragmentPresence::All);
+	EntityQuery.AddChunkRequirement<FMassTickTierChunkFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
+	EntityQuery.SetChunkFilter(&FMassTickTierChunkFragment::ShouldTickChunkThisFrame);
+}
+
+void UMassTrackTargetProcessor::Initialize(UObject& Owner)
+{
+	Super::Initialize(Owner);
+
+	TargetFinderSubsystem = UWorld::GetSubsystem<UMassTargetFinderSubsystem>(Owner.GetWorld());
 }
 
 void UMassTrackTargetProcessor::Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context)
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE_STR("UMassTrackTargetProcessor_Execute");
 
-	EntityQuery.ForEachEntityChunk(EntitySubsystem, Context, [this, &EntitySubsystem](FMassExecutionContext& Context)
+	if (!TargetFinderSubsystem)
+	{
+		return;
+	}
+
+	// The store is only written by UMassTargetGridProcessor, so it can be read from every chunk in parallel.
+	const FMassTargetLocationStore& TargetLocationStore = TargetFinderSubsystem->GetTargetLocationStore();
+	const bool bLeadTargets = UMassTrackTargetProcessor_LeadTargets;
+
+	EntityQuery.ParallelForEachEntityChunk(EntitySubsystem, Context, [&TargetLocationStore, bLeadTargets](FMassExecutionContext& Context)
 	{
 		const int32 NumEntities = Context.GetNumEntities();
 		const TConstArrayView<FTransformFragment> TransformList = Context.GetFragmentView<FTransformFragment>();
-		const TConstArrayView<FTargetEntityFragment> TargetEntityList = Context.GetFragmentView<FTargetEntityFragment>();
+		const TArrayView<FTargetEntityFragment> TargetEntityList = Context.GetMutableFragmentView<FTargetEntityFragment>();
 		const TArrayView<FMassMoveTargetFragment> MoveTargetList = Context.GetMutableFragmentView<FMassMoveTargetFragment>();
 
+		const bool bIsEntitySoldier = Context.DoesArchetypeHaveTag<FMassProjectileDamagableSoldierTag>();
+		const float ProjectileXYSpeed = bLeadTargets ? GetProjectileInitialXYVelocityMagnitude(bIsEntitySoldier) : 0.f;
+
 		for (int32 i = 0; i < NumEntities; ++i)
 		{
-			UpdateLookAtTrackedEntity(EntitySubsystem, TransformList[i], TargetEntityList[i], MoveTargetList[i]);
+			UpdateLookAtTrackedEntity(TargetLocationStore, TransformList[i], TargetEntityList[i], MoveTargetList[i], ProjectileXYSpeed);
 		}
 	});
 }
 
-void UMassTrackTargetProcessor::UpdateLookAtTrackedEntity(const UMassEntitySubsystem& EntitySubsystem, const FTransformFragment& TransformFragment, const FTargetEntityFragment& TargetEntityFragment, FMassMoveTargetFragment& MoveTargetFragment) const
+void UMassTrackTargetProcessor::UpdateLookAtTrackedEntity(const FMassTargetLocationStore& TargetLocationStore, const FTransformFragment& TransformFragment, FTargetEntityFragment& TargetEntityFragment, FMassMoveTargetFragment& MoveTargetFragment, const float ProjectileXYSpeed)
 {
 	const FMassEntityHandle& TargetEntity = TargetEntityFragment.Entity;
 	if (!TargetEntity.IsSet()) {
 		return;
 	}
 
-	if (!EntitySubsystem.IsEntityValid(TargetEntity)) {
+	// The slot is resolved once per target. Targets that are no longer in the store were destroyed.
+	if (!TargetLocationStore.ResolveSlot(TargetEntityFragment.TargetLocationSlot, TargetEntity))
+	{
 		return;
 	}
-	const FTransformFragment* TargetTransformFragment = EntitySubsystem.GetFragmentDataPtr<FTransformFragment>(TargetEntity);
-	check(TargetTransformFragment);
 
-	const FTransform& EntityTransform = TransformFragment.GetTransform();
-	const FVector& EntityLocation = EntityTransform.GetLocation();
-	const FVector NewGlobalDirection = (TargetTransformFragment->GetTransform().GetLocation() - EntityLocation).GetSafeNormal();
+	const FVector& EntityLocation = TransformFragment.GetTransform().GetLocation();
+	const FVector TargetLocation = TargetLocationStore.PredictLocation(TargetEntityFragment.TargetLocationSlot, EntityLocation, ProjectileXYSpeed);
 
-	UWorld* World = EntitySubsystem.GetWorld();
-	MoveTargetFragment.Forward = NewGlobalDirection;
+	MoveTargetFragment.Forward = (TargetLocation - EntityLocation).GetSafeNormal();
 }
@@ -2,6 +2,15 @@
 
 
 #include "MassTrackedVehicleOrientationProcessor.h"
+#include "MassTickTierTrait.h"
+#include "MassCommonFragments.h"
+#include "MassMovementFragments.h"
+#include "MassNavigationFragments.h"
+#include "MassNavigationUtils.h"
+#include "MassEnemyTargetFinderProcessor.h"
+#include "MassProjectileDamageProcessor.h"
+#include "MassTargetFinderSubsystem.h"
+#include "MassTrackTargetProcessor.h"
 
 void UMassTrackedVehicleOrientationTrait::BuildTemplate(FMassEntityTemplateBuildContext& BuildContext, UWorld& World) const
 {
@@ -10,8 +19,15 @@ void UMassTrackedVehicleOrientationTrait::BuildTemplate(FMassEntityTemplateBuild
 
 	BuildContext.AddFragment<FMassMoveTargetFragment>();
 	BuildContext.AddFragment<FTransformFragment>();
+	BuildContext.AddFragment<FMassTrackedVehicleKinematicsFragment>();
 	BuildContext.AddTag<FMassTrackedVehicleOrientationTag>();
 
+	if (bHasTurret)
+	{
+		FMassTurretFragment& TurretTemplate = BuildContext.AddFragment_GetRef<FMassTurretFragment>();
+		TurretTemplate.FiringConeCos = FMath::Cos(FMath::DegreesToRadians(FiringConeHalfAngle));
+	}
+
 	const FConstSharedStruct OrientationFragment = EntitySubsystem->GetOrCreateConstSharedFragment(UE::StructUtils::GetStructCrc32(FConstStructView::Make(Orientation)), Orientation);
 	BuildContext.AddConstSharedFragment(OrientationFragment);
 }
@@ -20,13 +36,31 @@ UMassTrackedVehicleOrientationProcessor::UMassTrackedVehicleOrientationProcessor
 {
 	ExecutionFlags = (int32)EProcessorExecutionFlags::All;
 	ExecutionOrder.ExecuteInGroup = UE::Mass::ProcessorGroupNames::Movement;
+	// Steering and avoidance forces are projected onto the hull, so they must be final for this frame.
+	ExecutionOrder.ExecuteAfter.Add(UE::Mass::ProcessorGroupNames::Avoidance);
+	// Velocity has to be constrained to the hull before it's integrated.
+	ExecutionOrder.ExecuteBefore.Add(TEXT("MassApplyMovementProcessor"));
 }
 
 void UMassTrackedVehicleOrientationProcessor::ConfigureQueries()
 {
 	EntityQuery.AddRequirement<FMassMoveTargetFragment>(EMassFragmentAccess::ReadOnly);
 	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FMassTrackedVehicleKinematicsFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FMassVelocityFragment>(EMassFragmentAccess::ReadWrite, EMassFragmentPresence::Optional);
+	EntityQuery.AddRequirement<FMassForceFragment>(EMassFragmentAccess::ReadWrite, EMassFragmentPresence::Optional);
+	EntityQuery.AddRequirement<FMassTurretFragment>(EMassFragmentAccess::ReadWrite, EMassFragmentPresence::Optional);
+	EntityQuery.AddRequirement<FTargetEntityFragment>(EMassFragmentAccess::ReadWrite, EMassFragmentPresence::Optional);
 	EntityQuery.AddConstSharedRequirement<FMassTrackedVehicleOrientationParameters>(EMassFragmentPresence::All);
+	// Not a chunk filter, since the tracks have to constrain velocity on every frame. Only turning is skipped by the tick tier.
+	EntityQuery.AddChunkRequirement<FMassTickTierChunkFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
+}
+
+void UMassTrackedVehicleOrientationProcessor::Initialize(UObject& Owner)
+{
+	Super::Initialize(Owner);
+
+	TargetFinderSubsystem = UWorld::GetSubsystem<UMassTargetFinderSubsystem>(Owner.GetWorld());
 }
 
 bool IsTransformFacingDirection(const FTransform& Transform, const FVector& TargetDirection, float* OutCurrentHeadingRadians, float* OutDesiredHeadingRadians, float* OutDeltaAngleRadians, float* OutAbsDeltaAngleRadians)
@@ -62,69 +96,113 @@ bool IsTransformFacingDirection(const FTransform& Transform, const FVector& Targ
 	return FMath::IsNearlyEqual(AbsDeltaAngleRadians, 0.f, 0.01f); // TODO: Is this a good tolerance?
 }
 
-struct FProcessEntityContext
+// Turning rate towards a heading that still lets the hull stop at it without overshooting, integrated under the turning acceleration limit.
+static float IntegrateYawRate(const float YawRate, const float DeltaYawRadians, const float MaxYawRate, const float MaxYawAcceleration, const float DeltaTime)
 {
-	FProcessEntityContext(const FMassMoveTargetFragment& InMoveTarget, FTransform& InTransform, const FMassTrackedVehicleOrientationParameters& InOrientationParams, const float& InDeltaTime, const FMassEntityHandle& InEntity) : MoveTarget(InMoveTarget), Transform(InTransform), OrientationParams(InOrientationParams), DeltaTime(InDeltaTime), Entity(InEntity) {}
-
-	const FMassMoveTargetFragment& MoveTarget;
-	FTransform& Transform;
-	const FMassTrackedVehicleOrientationParameters& OrientationParams;
-	const float& DeltaTime;
-	const FMassEntityHandle& Entity;
-
-	void ProcessEntity()
-	{
-		// These are in range of (-PI, PI].
-		float OutCurrentHeadingRadians;
-		float OutDesiredHeadingRadians;
-
-		// In Range [-PI, PI].
-		float OutTotalDeltaAngleRadians;
-
-		// In Range [0, PI].
-		float OutAbsTotalDeltaAngleRadians;
-
-		const bool& bIsAtDesiredHeading = IsTransformFacingDirection(Transform, MoveTarget.Forward, &OutCurrentHeadingRadians, &OutDesiredHeadingRadians, &OutTotalDeltaAngleRadians, &OutAbsTotalDeltaAngleRadians);
-		if (bIsAtDesiredHeading)
-		{
-			return;
-		}
-
-		float NewHeadingRadians;
-		float DeltaHeadingRadians = FMath::DegreesToRadians(OrientationParams.TurningSpeed) * DeltaTime;
-		if (OutAbsTotalDeltaAngleRadians <= DeltaHeadingRadians)
-		{
-			NewHeadingRadians = OutDesiredHeadingRadians;
-		}
-		else
-		{
-			NewHeadingRadians = OutCurrentHeadingRadians + (OutTotalDeltaAngleRadians > 0.f ? DeltaHeadingRadians : -DeltaHeadingRadians);
-		}
+	const float AbsDeltaYawRadians = FMath::Abs(DeltaYawRadians);
+	const float StoppingYawRate = FMath::Sqrt(2.f * MaxYawAcceleration * AbsDeltaYawRadians);
+	const float DesiredYawRate = FMath::Sign(DeltaYawRadians) * FMath::Min3(MaxYawRate, StoppingYawRate, AbsDeltaYawRadians / DeltaTime);
+	const float MaxYawRateChange = MaxYawAcceleration * DeltaTime;
+	return YawRate + FMath::Clamp(DesiredYawRate - YawRate, -MaxYawRateChange, MaxYawRateChange);
+}
 
-		FQuat Rotation(FVector::UpVector, NewHeadingRadians);
-		Transform.SetRotation(Rotation);
-	}
-};
+// Tracks only push along the hull, so whatever steering and avoidance ask for is projected onto it and reached under the acceleration limits.
+static void IntegrateTrackVelocity(FMassVelocityFragment& Velocity, FMassForceFragment& Force, const FVector& HullForward, const FMassTrackedVehicleOrientationParameters& Params, const float DeltaTime)
+{
+	const FVector2D Forward2D = FVector2D(HullForward).GetSafeNormal();
+	const FVector2D SteeredVelocity2D = FVector2D(Velocity.Value + Force.Value * DeltaTime);
+	const float CurrentSpeed = FVector2D::DotProduct(FVector2D(Velocity.Value), Forward2D);
+	const float DesiredSpeed = FMath::Max(0.f, FVector2D::DotProduct(SteeredVelocity2D, Forward2D));
+	const float NewSpeed = CurrentSpeed + FMath::Clamp(DesiredSpeed - CurrentSpeed, -Params.MaxDeceleration * DeltaTime, Params.MaxAcceleration * DeltaTime);
+
+	Velocity.Value = FVector(Forward2D * NewSpeed, Velocity.Value.Z);
+	Force.Value = FVector::ZeroVector;
+}
 
 void UMassTrackedVehicleOrientationProcessor::Execute(UMassEntitySubsystem& EntitySubsystem,
 	FMassExecutionContext& Context)
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE_STR("UMassTrackedVehicleOrientationProcessor_Execute");
 
-	// Clamp max delta time to avoid large values during initialization.
-	const float DeltaTime = FMath::Min(0.1f, Context.GetDeltaTimeSeconds());
+	if (!TargetFinderSubsystem)
+	{
+		return;
+	}
+
+	// The store is only written by UMassTargetGridProcessor, which runs after the movement group.
+	const FMassTargetLocationStore& TargetLocationStore = TargetFinderSubsystem->GetTargetLocationStore();
+	const bool bLeadTargets = UMassTrackTargetProcessor_LeadTargets;
 
-	EntityQuery.ForEachEntityChunk(EntitySubsystem, Context, [DeltaTime](FMassExecutionContext& Context)
+	EntityQuery.ParallelForEachEntityChunk(EntitySubsystem, Context, [&TargetLocationStore, bLeadTargets](FMassExecutionContext& Context)
 	{
 		const int32 NumEntities = Context.GetNumEntities();
 
-		const FMassTrackedVehicleOrientationParameters& OrientationParams = Context.GetConstSharedFragment<FMassTrackedVehicleOrientationParameters>();
+		const FMassTrackedVehicleOrientationParameters& Params = Context.GetConstSharedFragment<FMassTrackedVehicleOrientationParameters>();
 		const TConstArrayView<FMassMoveTargetFragment> MoveTargetList = Context.GetFragmentView<FMassMoveTargetFragment>();
 		const TArrayView<FTransformFragment> LocationList = Context.GetMutableFragmentView<FTransformFragment>();
+		const TArrayView<FMassTrackedVehicleKinematicsFragment> KinematicsList = Context.GetMutableFragmentView<FMassTrackedVehicleKinematicsFragment>();
+		const TArrayView<FMassVelocityFragment> VelocityList = Context.GetMutableFragmentView<FMassVelocityFragment>();
+		const TArrayView<FMassForceFragment> ForceList = Context.GetMutableFragmentView<FMassForceFragment>();
+		const TArrayView<FMassTurretFragment> TurretList = Context.GetMutableFragmentView<FMassTurretFragment>();
+		const TArrayView<FTargetEntityFragment> TargetEntityList = Context.GetMutableFragmentView<FTargetEntityFragment>();
+
+		if (FMassTickTierChunkFragment::ShouldTickChunkThisFrame(Context))
+		{
+			// Clamp max delta time to avoid large values during initialization. Chunks in slower tick tiers accumulate several frames.
+			const float TurningDeltaTime = FMath::Min(0.1f * FMassTickTierChunkFragment::GetChunkTickPeriod(Context), FMassTickTierChunkFragment::GetChunkDeltaTime(Context));
+			const float MaxYawRate = FMath::DegreesToRadians(Params.TurningSpeed);
+			const float MaxYawAcceleration = Params.TurningAcceleration > 0.f ? FMath::DegreesToRadians(Params.TurningAcceleration) : BIG_NUMBER;
+
+			for (int32 EntityIndex = 0; TurningDeltaTime > 0.f && EntityIndex < NumEntities; ++EntityIndex)
+			{
+				FTransform& Transform = LocationList[EntityIndex].GetMutableTransform();
+				float& YawRate = KinematicsList[EntityIndex].YawRate;
+
+				// In range (-PI, PI].
+				const float CurrentHeadingRadians = UE::MassNavigation::GetYawFromDirection(Transform.GetRotation().GetForwardVector());
+				const float DesiredHeadingRadians = UE::MassNavigation::GetYawFromDirection(MoveTargetList[EntityIndex].Forward);
+
+				YawRate = IntegrateYawRate(YawRate, FMath::FindDeltaAngleRadians(CurrentHeadingRadians, DesiredHeadingRadians), MaxYawRate, MaxYawAcceleration, TurningDeltaTime);
+				Transform.SetRotation(FQuat(FVector::UpVector, CurrentHeadingRadians + YawRate * TurningDeltaTime));
+			}
+
+			if (TurretList.Num() > 0)
+			{
+				const float MaxTurretDeltaYaw = FMath::DegreesToRadians(Params.TurretTurningSpeed) * TurningDeltaTime;
+				const float ProjectileXYSpeed = bLeadTargets ? GetProjectileInitialXYVelocityMagnitude(Context.DoesArchetypeHaveTag<FMassProjectileDamagableSoldierTag>()) : 0.f;
+				const bool bHasTargets = TargetEntityList.Num() > 0;
+
+				for (int32 EntityIndex = 0; EntityIndex < NumEntities; ++EntityIndex)
+				{
+					const FTransform& Transform = LocationList[EntityIndex].GetTransform();
+					FMassTurretFragment& Turret = TurretList[EntityIndex];
+
+					// Turrets without a target return to the hull's forward.
+					float DesiredRelativeYaw = 0.f;
+					if (bHasTargets)
+					{
+						FTargetEntityFragment& TargetEntityFragment = TargetEntityList[EntityIndex];
+						if (TargetEntityFragment.Entity.IsSet() && TargetLocationStore.ResolveSlot(TargetEntityFragment.TargetLocationSlot, TargetEntityFragment.Entity))
+						{
+							const FVector TargetLocation = TargetLocationStore.PredictLocation(TargetEntityFragment.TargetLocationSlot, Transform.GetLocation(), ProjectileXYSpeed);
+							const FVector RelativeDirection = Transform.GetRotation().UnrotateVector(TargetLocation - Transform.GetLocation());
+							DesiredRelativeYaw = UE::MassNavigation::GetYawFromDirection(RelativeDirection);
+						}
+					}
+
+					const float DeltaYawRadians = FMath::FindDeltaAngleRadians(Turret.RelativeYaw, DesiredRelativeYaw);
+					Turret.RelativeYaw = FMath::UnwindRadians(Turret.RelativeYaw + FMath::Clamp(DeltaYawRadians, -MaxTurretDeltaYaw, MaxTurretDeltaYaw));
+				}
+			}
+		}
 
-		for (int32 EntityIndex = 0; EntityIndex < NumEntities; ++EntityIndex)
+		if (VelocityList.Num() > 0 && ForceList.Num() > 0)
 		{
-			FProcessEntityContext(MoveTargetList[EntityIndex], LocationList[EntityIndex].GetMutableTransform(), OrientationParams, DeltaTime, Context.GetEntity(EntityIndex)).ProcessEntity();
+			const float DeltaTime = Context.GetDeltaTimeSeconds();
+			for (int32 EntityIndex = 0; EntityIndex < NumEntities; ++EntityIndex)
+			{
+				IntegrateTrackVelocity(VelocityList[EntityIndex], ForceList[EntityIndex], LocationList[EntityIndex].GetTransform().GetRotation().GetForwardVector(), Params, DeltaTime);
+			}
 		}
 	});
 }
@@ -0,0 +1,179 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#include "MassVertexAnimationMontageProcessor.h"
+
+#include "MassEntityTemplateRegistry.h"
+#include "MassExecutionContext.h"
+#include "MassRepresentationFragments.h"
+#include "MassGenericAnimationProcessor.h"
+#include "AnimToTextureDataAsset.h"
+#include "Animation/AnimSequence.h"
+
+int32 FMassVertexAnimationMontageParameters::FindMontageIndex(const FName Name) const
+{
+	return Montages.IndexOfByPredicate([Name](const FMassVertexAnimationMontage& Montage) { return Montage.Name == Name; });
+}
+
+void UMassVertexAnimationMontageTrait::BuildTemplate(FMassEntityTemplateBuildContext& BuildContext, UWorld& World) const
+{
+	UMassEntitySubsystem* EntitySubsystem = UWorld::GetSubsystem<UMassEntitySubsystem>(&World);
+	check(EntitySubsystem);
+
+	BuildContext.AddFragment<FMassVertexAnimationMontageFragment>();
+
+	FMassVertexAnimationMontageParameters Parameters;
+	Parameters.AnimToTextureData = AnimToTextureData;
+	Parameters.StateBlendTime = StateBlendTime;
+	for (const FMassVertexAnimationMontageDefinition& Definition : Montages)
+	{
+		const int32 StateIndex = AnimToTextureData && Definition.Sequence ? AnimToTextureData->GetIndexFromAnimSequence(Definition.Sequence) : INDEX_NONE;
+		if (StateIndex < 0)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("UMassVertexAnimationMontageTrait: Montage %s has no sequence in %s"), *Definition.Name.ToString(), *GetNameSafe(AnimToTextureData));
+			continue;
+		}
+
+		FMassVertexAnimationMontage& Montage = Parameters.Montages.AddDefaulted_GetRef();
+		Montage.Name = Definition.Name;
+		Montage.StateIndex = StateIndex;
+		Montage.PlayRate = Definition.PlayRate;
+		Montage.Length = Definition.Sequence->GetPlayLength() / Definition.PlayRate;
+		Montage.BlendInTime = Definition.BlendInTime;
+		Montage.BlendOutTime = Definition.BlendOutTime;
+	}
+
+	const FConstSharedStruct ParametersFragment = EntitySubsystem->GetOrCreateConstSharedFragment(UE::StructUtils::GetStructCrc32(FConstStructView::Make(Parameters)), Parameters);
+	BuildContext.AddConstSharedFragment(ParametersFragment);
+}
+
+//----------------------------------------------------------------------//
+//  UMassVertexAnimationMontageProcessor
+//----------------------------------------------------------------------//
+UMassVertexAnimationMontageProcessor::UMassVertexAnimationMontageProcessor()
+{
+	ExecutionFlags = (int32)(EProcessorExecutionFlags::Client | EProcessorExecutionFlags::Standalone);
+	ExecutionOrder.ExecuteInGroup = UE::Mass::ProcessorGroupNames::Tasks;
+	ExecutionOrder.ExecuteAfter.Add(TEXT("MassGenericAnimationProcessor"));
+}
+
+void UMassVertexAnimationMontageProcessor::ConfigureQueries()
+{
+	EntityQuery.AddRequirement<FMassRepresentationFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FGenericAnimationFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FMassVertexAnimationMontageFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddConstSharedRequirement<FMassVertexAnimationMontageParameters>(EMassFragmentPresence::All);
+	EntityQuery.AddChunkRequirement<FMassVisualizationChunkFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.SetChunkFilter(&FMassVisualizationChunkFragment::AreAnyEntitiesVisibleInChunk);
+}
+
+void UMassVertexAnimationMontageProcessor::Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context)
+{
+	const UWorld* World = EntitySubsystem.GetWorld();
+	check(World);
+
+	QUICK_SCOPE_CYCLE_COUNTER(UMassVertexAnimationMontageProcessor_Run);
+
+	const float GlobalTime = World->GetTimeSeconds();
+
+	EntityQuery.ParallelForEachEntityChunk(EntitySubsystem, Context, [GlobalTime](FMassExecutionContext& Context)
+	{
+		const FMassVertexAnimationMontageParameters& Parameters = Context.GetConstSharedFragment<FMassVertexAnimationMontageParameters>();
+		TConstArrayView<FMassRepresentationFragment> RepresentationList = Context.GetFragmentView<FMassRepresentationFragment>();
+		TConstArrayView<FGenericAnimationFragment> AnimationDataList = Context.GetFragmentView<FGenericAnimationFragment>();
+		TArrayView<FMassVertexAnimationMontageFragment> MontageList = Context.GetMutableFragmentView<FMassVertexAnimationMontageFragment>();
+
+		const int32 NumEntities = Context.GetNumEntities();
+		for (int32 EntityIdx = 0; EntityIdx < NumEntities; EntityIdx++)
+		{
+			if (RepresentationList[EntityIdx].CurrentRepresentation == EMassRepresentationType::None)
+			{
+				continue;
+			}
+
+			const FGenericAnimationFragment& AnimationData = AnimationDataList[EntityIdx];
+			FMassVertexAnimationMontageFragment& Montage = MontageList[EntityIdx];
+
+			// Montage states are only valid for the data asset they were resolved with.
+			const bool bCanPlayMontages = AnimationData.AnimToTextureData.Get() == Parameters.AnimToTextureData;
+
+			const int32 PrevMontageIndex = Montage.MontageIndex;
+			bool bMontageStarted = false;
+			if (!Montage.RequestedMontage.IsNone())
+			{
+				const int32 RequestedMontageIndex = bCanPlayMontages ? Parameters.FindMontageIndex(Montage.RequestedMontage) : INDEX_NONE;
+				// Requests made while the entity wasn't visible may already be over, they are dropped instead of starting and ending at once.
+				if (RequestedMontageIndex != INDEX_NONE && GlobalTime - Montage.RequestTime < Parameters.Montages[RequestedMontageIndex].Length)
+				{
+					Montage.MontageIndex = RequestedMontageIndex;
+					Montage.MontageStartTime = Montage.RequestTime;
+					bMontageStarted = true;
+				}
+				Montage.RequestedMontage = NAME_None;
+			}
+
+			if (Montage.MontageIndex != INDEX_NONE && (!bCanPlayMontages || GlobalTime - Montage.MontageStartTime >= Parameters.Montages[Montage.MontageIndex].Length))
+			{
+				Montage.MontageIndex = INDEX_NONE;
+			}
+
+			FMassVertexAnimationState Target;
+			if (Montage.MontageIndex != INDEX_NONE)
+			{
+				const FMassVertexAnimationMontage& MontageData = Parameters.Montages[Montage.MontageIndex];
+				Target.StateIndex = MontageData.StateIndex;
+				Target.GlobalStartTime = Montage.MontageStartTime;
+				Target.PlayRate = MontageData.PlayRate;
+			}
+			else
+			{
+				Target.StateIndex = AnimationData.AnimationStateIndex;
+				Target.GlobalStartTime = AnimationData.GlobalStartTime;
+				Target.PlayRate = AnimationData.PlayRate;
+			}
+
+			// Changes of play rate within the same state are conserved by the looping state itself and don't need a blend.
+			const bool bStateChanged = Target.StateIndex != Montage.Current.StateIndex || bMontageStarted;
+			if (bStateChanged && Montage.Current.StateIndex != INDEX_NONE)
+			{
+				Montage.Previous = Montage.Current;
+				Montage.BlendStartTime = GlobalTime;
+				if (bMontageStarted && Parameters.Montages.IsValidIndex(Montage.MontageIndex))
+				{
+					Montage.BlendTime = Parameters.Montages[Montage.MontageIndex].BlendInTime;
+				}
+				else if (PrevMontageIndex != INDEX_NONE && Montage.MontageIndex == INDEX_NONE && Parameters.Montages.IsValidIndex(PrevMontageIndex))
+				{
+					Montage.BlendTime = Parameters.Montages[PrevMontageIndex].BlendOutTime;
+				}
+				else
+				{
+					Montage.BlendTime = Parameters.StateBlendTime;
+				}
+			}
+			Montage.Current = Target;
+
+			const float BlendAlpha = Montage.BlendTime > 0.f ? FMath::Clamp((GlobalTime - Montage.BlendStartTime) / Montage.BlendTime, 0.f, 1.f) : 1.f;
+			Montage.PreviousWeight = Montage.Previous.StateIndex != INDEX_NONE ? 1.f - BlendAlpha : 0.f;
+		}
+	});
+}
+
+FMassBlendedVertexAnimationInstanceData UMassVertexAnimationMontageProcessor::MakeInstancePlaybackData(const FGenericAnimationFragment& AnimationData, const FMassVertexAnimationMontageFragment& MontageFragment)
+{
+	const UAnimToTextureDataAsset* AnimToTextureData = AnimationData.AnimToTextureData.Get();
+
+	FMassBlendedVertexAnimationInstanceData InstanceData;
+	const FMassVertexAnimationState& Current = MontageFragment.Current.StateIndex != INDEX_NONE ? MontageFragment.Current : FMassVertexAnimationState{ AnimationData.AnimationStateIndex, AnimationData.GlobalStartTime, AnimationData.PlayRate };
+	UAnimToTextureInstancePlaybackLibrary::AnimStateFromDataAsset(AnimToTextureData, Current.StateIndex, InstanceData.Current.CurrentState);
+	InstanceData.Current.CurrentState.GlobalStartTime = Current.GlobalStartTime;
+	InstanceData.Current.CurrentState.PlayRate = Current.PlayRate;
+
+	if (MontageFragment.PreviousWeight > 0.f)
+	{
+		UAnimToTextureInstancePlaybackLibrary::AnimStateFromDataAsset(AnimToTextureData, MontageFragment.Previous.StateIndex, InstanceData.Previous);
+		InstanceData.Previous.GlobalStartTime = MontageFragment.Previous.GlobalStartTime;
+		InstanceData.Previous.PlayRate = MontageFragment.Previous.PlayRate;
+		InstanceData.PreviousWeight = MontageFragment.PreviousWeight;
+	}
+	return InstanceData;
+}
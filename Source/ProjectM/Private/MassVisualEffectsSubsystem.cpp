@@ -2,6 +2,20 @@
 
 
 #include "MassVisualEffectsSubsystem.h"
+#include "MassWorldContext.h"
+#include "MassEntitySubsystem.h"
+#include "MassEntityView.h"
+#include "MassEntityConfigAsset.h"
+#include "MassSpawnerSubsystem.h"
+#include "MassSpawnLocationProcessor.h"
+#include "MassEntitySpawnDataGeneratorBase.h"
+#include "MassCommonFragments.h"
+#include "MassDelayedDestructionProcessor.h"
+#include "MassDelayedDestructionSubsystem.h"
+#include "MassGenericAnimationProcessor.h"
+#include "MassRepresentationFragments.h"
+
+const FVector UMassVisualEffectsSubsystem::DormantLocation(0.f, 0.f, -1000000.f);
 
 int16 UMassVisualEffectsSubsystem::FindOrAddEntityConfig(UMassEntityConfigAsset* EntityConfigAsset)
 {
@@ -14,31 +28,198 @@ int16 UMassVisualEffectsSubsystem::FindOrAddEntityConfig(UMassEntityConfigAsset*
 	return (int16)Index;
 }
 
-void UMassVisualEffectsSubsystem::SpawnEntity(const int16 EntityConfigIndex, const FVector& Location)
+void UMassVisualEffectsSubsystem::RequestEffect(const int16 EntityConfigIndex, const FVector& Location)
 {
 	FTransform Transform;
 	Transform.SetLocation(Location);
-	SpawnEntity(EntityConfigIndex, Transform);
+	RequestEffect(EntityConfigIndex, Transform);
 }
 
-void UMassVisualEffectsSubsystem::SpawnEntity(const int16 EntityConfigIndex, const FTransform& Transform)
+void UMassVisualEffectsSubsystem::RequestEffect(const int16 EntityConfigIndex, const FTransform& Transform)
 {
-	UWorld* World = GetWorld();
-	UMassSpawnerSubsystem* SpawnerSystem = UWorld::GetSubsystem<UMassSpawnerSubsystem>(World);
-	if (SpawnerSystem == nullptr)
+	FScopeLock Lock(&RequestsLock);
+	PendingRequests.Add({ EntityConfigIndex, Transform });
+}
+
+void UMassVisualEffectsSubsystem::RequestEffects(TConstArrayView<FMassVisualEffectRequest> Requests)
+{
+	FScopeLock Lock(&RequestsLock);
+	PendingRequests.Append(Requests.GetData(), Requests.Num());
+}
+
+void UMassVisualEffectsSubsystem::ReleaseEntity(const FMassEntityHandle Entity)
+{
+	const int16* EntityConfigIndex = PooledEntityToConfigIndex.Find(Entity);
+	if (ensureMsgf(EntityConfigIndex, TEXT("UMassVisualEffectsSubsystem: Released entity (idx=%d,sn=%d) isn't pooled."), Entity.Index, Entity.SerialNumber))
+	{
+		Pools[*EntityConfigIndex].DormantEntities.Add(Entity);
+	}
+}
+
+void UMassVisualEffectsSubsystem::Tick(float DeltaTime)
+{
+	ProcessRequests();
+}
+
+TStatId UMassVisualEffectsSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UMassVisualEffectsSubsystem, STATGROUP_Tickables);
+}
+
+void UMassVisualEffectsSubsystem::ProcessRequests()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UMassVisualEffectsSubsystem.ProcessRequests);
+
+	UMassEntitySubsystem* EntitySubsystem = UWorld::GetSubsystem<UMassEntitySubsystem>(GetWorld());
+	if (EntitySubsystem == nullptr)
+	{
+		return;
+	}
+
+	// Preallocate pools of types registered since the last frame, so that their first effects already reuse entities.
+	for (int16 EntityConfigIndex = Pools.Num(); EntityConfigIndex < MassEntityConfigAssets.Num(); EntityConfigIndex++)
+	{
+		InitializePool(EntityConfigIndex, *EntitySubsystem);
+	}
+
+	{
+		FScopeLock Lock(&RequestsLock);
+		Swap(PendingRequests, ProcessingRequests);
+	}
+
+	// Each type is activated and spawned in one batch.
+	ProcessingRequests.StableSort([](const FMassVisualEffectRequest& A, const FMassVisualEffectRequest& B) { return A.EntityConfigIndex < B.EntityConfigIndex; });
+
+	for (int32 GroupStart = 0, GroupEnd = 0; GroupStart < ProcessingRequests.Num(); GroupStart = GroupEnd)
+	{
+		const int16 EntityConfigIndex = ProcessingRequests[GroupStart].EntityConfigIndex;
+		while (GroupEnd < ProcessingRequests.Num() && ProcessingRequests[GroupEnd].EntityConfigIndex == EntityConfigIndex)
+		{
+			GroupEnd++;
+		}
+
+		if (!Pools.IsValidIndex(EntityConfigIndex))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("UMassVisualEffectsSubsystem: Invalid EntityConfigIndex"));
+			continue;
+		}
+
+		FMassVisualEffectPool& Pool = Pools[EntityConfigIndex];
+		TransformsToSpawn.Reset();
+		RequestIndicesToSpawn.Reset();
+		for (int32 RequestIndex = GroupStart; RequestIndex < GroupEnd; RequestIndex++)
+		{
+			const FMassVisualEffectRequest& Request = ProcessingRequests[RequestIndex];
+			const FTransform& Transform = Request.Transform;
+
+			// Pooled entities can still be destroyed by others, e.g. when a world snapshot is loaded.
+			FMassEntityHandle Entity;
+			while (!Entity.IsSet() && Pool.DormantEntities.Num() > 0)
+			{
+				const FMassEntityHandle DormantEntity = Pool.DormantEntities.Pop(false);
+				if (EntitySubsystem->IsEntityValid(DormantEntity))
+				{
+					Entity = DormantEntity;
+				}
+				else
+				{
+					PooledEntityToConfigIndex.Remove(DormantEntity);
+				}
+			}
+
+			if (Entity.IsSet())
+			{
+				ActivateEntity(Entity, Transform, *EntitySubsystem);
+				HandOffRepresentation(Entity, Request, *EntitySubsystem);
+			}
+			else
+			{
+				TransformsToSpawn.Add(Transform);
+				RequestIndicesToSpawn.Add(RequestIndex);
+			}
+		}
+
+		if (TransformsToSpawn.Num() > 0)
+		{
+			SpawnEntities(EntityConfigIndex, TransformsToSpawn, SpawnedEntities);
+
+			// Spawned entities are in the order of their transforms.
+			for (int32 EntityIndex = 0; EntityIndex < SpawnedEntities.Num(); EntityIndex++)
+			{
+				HandOffRepresentation(SpawnedEntities[EntityIndex], ProcessingRequests[RequestIndicesToSpawn[EntityIndex]], *EntitySubsystem);
+			}
+
+			// The pool grows by the entities spawned beyond its capacity.
+			for (int32 EntityIndex = 0; Pool.bIsPoolable && EntityIndex < SpawnedEntities.Num(); EntityIndex++)
+			{
+				EntitySubsystem->Defer().PushCommand(FCommandAddFragmentInstance(SpawnedEntities[EntityIndex], FConstStructView::Make(FMassPooledVisualEffectFragment())));
+				PooledEntityToConfigIndex.Add(SpawnedEntities[EntityIndex], EntityConfigIndex);
+			}
+		}
+	}
+	ProcessingRequests.Reset();
+
+	EntitySubsystem->FlushCommands();
+}
+
+void UMassVisualEffectsSubsystem::InitializePool(const int16 EntityConfigIndex, UMassEntitySubsystem& EntitySubsystem)
+{
+	FMassVisualEffectPool& Pool = Pools.AddDefaulted_GetRef();
+	check(Pools.Num() == EntityConfigIndex + 1);
+
+	UMassSpawnerSubsystem* SpawnerSystem = UWorld::GetSubsystem<UMassSpawnerSubsystem>(GetWorld());
+	if (SpawnerSystem == nullptr || MassEntityConfigAssets[EntityConfigIndex] == nullptr)
+	{
+		return;
+	}
+
+	const FMassEntityTemplate* EntityTemplate = MassEntityConfigAssets[EntityConfigIndex]->GetConfig().GetOrCreateEntityTemplate(GetMassWorldContextActor(*GetWorld()), *SpawnerSystem); // TODO: passing SpawnerSystem is a hack
+	if (!EntityTemplate->IsValid())
 	{
-		UE_LOG(LogTemp, Warning, TEXT("UMassVisualEffectsSubsystem: Invalid SpawnerSystem"));
 		return;
 	}
 
-	if (EntityConfigIndex < 0 || EntityConfigIndex >= MassEntityConfigAssets.Num())
+	for (const FInstancedStruct& InitialFragmentValue : EntityTemplate->GetInitialFragmentValues())
+	{
+		if (InitialFragmentValue.GetScriptStruct() == FMassDelayedDestructionFragment::StaticStruct())
+		{
+			Pool.bIsPoolable = true;
+		}
+	}
+
+	if (!Pool.bIsPoolable || UMassVisualEffectsSubsystem_PoolCapacity <= 0)
+	{
+		return;
+	}
+
+	TArray<FTransform> DormantTransforms;
+	DormantTransforms.Init(FTransform(DormantLocation), UMassVisualEffectsSubsystem_PoolCapacity);
+	SpawnEntities(EntityConfigIndex, DormantTransforms, Pool.DormantEntities);
+	FMassPooledVisualEffectFragment DormantFragment;
+	DormantFragment.bIsDormant = true;
+	for (const FMassEntityHandle& Entity : Pool.DormantEntities)
+	{
+		EntitySubsystem.Defer().PushCommand(FCommandAddFragmentInstance(Entity, FConstStructView::Make(DormantFragment)));
+		PooledEntityToConfigIndex.Add(Entity, EntityConfigIndex);
+	}
+	EntitySubsystem.FlushCommands();
+}
+
+void UMassVisualEffectsSubsystem::SpawnEntities(const int16 EntityConfigIndex, TConstArrayView<FTransform> Transforms, TArray<FMassEntityHandle>& OutEntities)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UMassVisualEffectsSubsystem.SpawnEntities);
+
+	OutEntities.Reset();
+
+	UWorld* World = GetWorld();
+	UMassSpawnerSubsystem* SpawnerSystem = UWorld::GetSubsystem<UMassSpawnerSubsystem>(World);
+	if (SpawnerSystem == nullptr)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("UMassVisualEffectsSubsystem: Invalid EntityConfigIndex"));
+		UE_LOG(LogTemp, Warning, TEXT("UMassVisualEffectsSubsystem: Invalid SpawnerSystem"));
 		return;
 	}
 
-	// TODO: A bit hacky to get first actor here.
-	const FMassEntityTemplate* EntityTemplate = MassEntityConfigAssets[EntityConfigIndex]->GetConfig().GetOrCreateEntityTemplate(*World->GetLevel(0)->Actors[0], *SpawnerSystem); // TODO: passing SpawnerSystem is a hack
+	const FMassEntityTemplate* EntityTemplate = MassEntityConfigAssets[EntityConfigIndex]->GetConfig().GetOrCreateEntityTemplate(GetMassWorldContextActor(*World), *SpawnerSystem); // TODO: passing SpawnerSystem is a hack
 
 	if (!EntityTemplate->IsValid())
 	{
@@ -49,15 +230,59 @@ void UMassVisualEffectsSubsystem::SpawnEntity(const int16 EntityConfigIndex, con
 	FMassEntitySpawnDataGeneratorResult Result;
 	Result.SpawnDataProcessor = UMassSpawnLocationProcessor::StaticClass();
 	Result.SpawnData.InitializeAs<FMassTransformsSpawnData>();
-	Result.NumEntities = 1;
-	FMassTransformsSpawnData& Transforms = Result.SpawnData.GetMutable<FMassTransformsSpawnData>();
+	Result.NumEntities = Transforms.Num();
+	FMassTransformsSpawnData& SpawnDataTransforms = Result.SpawnData.GetMutable<FMassTransformsSpawnData>();
+	SpawnDataTransforms.Transforms.Append(Transforms.GetData(), Transforms.Num());
 
-	Transforms.Transforms.Reserve(1);
-	FTransform& SpawnDataTransform = Transforms.Transforms.AddDefaulted_GetRef();
-	SpawnDataTransform.SetLocation(Transform.GetLocation());
-	SpawnDataTransform.SetRotation(Transform.GetRotation());
-	SpawnDataTransform.SetScale3D(Transform.GetScale3D());
+	SpawnerSystem->SpawnEntities(EntityTemplate->GetTemplateID(), Result.NumEntities, Result.SpawnData, Result.SpawnDataProcessor, OutEntities);
+}
 
-	TArray<FMassEntityHandle> SpawnedEntities;
-	SpawnerSystem->SpawnEntities(EntityTemplate->GetTemplateID(), Result.NumEntities, Result.SpawnData, Result.SpawnDataProcessor, SpawnedEntities);
+void UMassVisualEffectsSubsystem::ActivateEntity(const FMassEntityHandle Entity, const FTransform& Transform, UMassEntitySubsystem& EntitySubsystem) const
+{
+	const FMassEntityView EntityView(EntitySubsystem, Entity);
+	if (FTransformFragment* TransformFragment = EntityView.GetFragmentDataPtr<FTransformFragment>())
+	{
+		TransformFragment->SetTransform(Transform);
+	}
+	UMassDelayedDestructionSubsystem* DelayedDestructionSubsystem = UWorld::GetSubsystem<UMassDelayedDestructionSubsystem>(GetWorld());
+	FMassDelayedDestructionFragment* DelayedDestructionFragment = EntityView.GetFragmentDataPtr<FMassDelayedDestructionFragment>();
+	if (DelayedDestructionSubsystem && DelayedDestructionFragment)
+	{
+		DelayedDestructionSubsystem->Schedule(Entity, *DelayedDestructionFragment);
+	}
+	if (FGenericAnimationFragment* AnimationFragment = EntityView.GetFragmentDataPtr<FGenericAnimationFragment>())
+	{
+		AnimationFragment->GlobalStartTime = GetWorld()->GetTimeSeconds();
+	}
+	// Otherwise the first update of the instance interpolates from the dormant location below the world.
+	if (FMassRepresentationFragment* RepresentationFragment = EntityView.GetFragmentDataPtr<FMassRepresentationFragment>())
+	{
+		RepresentationFragment->PrevTransform = Transform;
+	}
+	if (FMassPooledVisualEffectFragment* PooledFragment = EntityView.GetFragmentDataPtr<FMassPooledVisualEffectFragment>())
+	{
+		PooledFragment->bIsDormant = false;
+	}
+}
+
+void UMassVisualEffectsSubsystem::HandOffRepresentation(const FMassEntityHandle Entity, const FMassVisualEffectRequest& Request, UMassEntitySubsystem& EntitySubsystem)
+{
+	if (!Request.bReplacesSourceEntity)
+	{
+		return;
+	}
+
+	// Without this the first update of a new instance interpolates from an identity transform and the LOD significance of an unseen entity.
+	// PrevTransform and PrevLODSignificance are the only representation state carried from one frame to the next for instanced meshes, as
+	// instances are rebuilt every frame from the batched transforms. The source entity's actor, if it had one, isn't handed off: the replacement
+	// is a different mesh and gets its own representation. So copying both values into the request is all the link to the source that's needed.
+	const FMassEntityView EntityView(EntitySubsystem, Entity);
+	if (FMassRepresentationFragment* RepresentationFragment = EntityView.GetFragmentDataPtr<FMassRepresentationFragment>())
+	{
+		RepresentationFragment->PrevTransform = Request.Transform;
+		if (Request.SourceLODSignificance >= 0.f)
+		{
+			RepresentationFragment->PrevLODSignificance = Request.SourceLODSignificance;
+		}
+	}
 }
@@ -0,0 +1,791 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#include "MassWorldSnapshotSubsystem.h"
+
+#include "MassEntitySubsystem.h"
+#include "MassEntityView.h"
+#include "MassEntityQuery.h"
+#include "MassExecutionContext.h"
+#include "MassCommonFragments.h"
+#include "MassMovementFragments.h"
+#include "MassNavigationFragments.h"
+#include "MassSimulationSubsystem.h"
+#include "MassAgentLocationSyncTrait.h"
+#include "MassEnemyTargetFinderProcessor.h"
+#include "MassMoveToCommandProcessor.h"
+#include "MassMoveToCommandSubsystem.h"
+#include "MassMoveTargetForwardCompleteProcessor.h"
+#include "MassNavMeshMoveProcessor.h"
+#include "MassProjectileDamageProcessor.h"
+#include "MassTrackTargetProcessor.h"
+#include "MassSoundPerceptionSubsystem.h"
+#include "MassBattlefieldClutterSubsystem.h"
+#include "MilitaryStructureSubsystem.h"
+#include "MilitaryUnitMassSpawner.h"
+#include "Character/CommanderCharacter.h"
+#include "Kismet/GameplayStatics.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/BufferArchive.h"
+#include "Serialization/MemoryReader.h"
+
+FString UMassWorldSnapshotSubsystem_LoadOnBeginPlay;
+FAutoConsoleVariableRef CVarUMassWorldSnapshotSubsystem_LoadOnBeginPlay(TEXT("pm.UMassWorldSnapshotSubsystem_LoadOnBeginPlay"), UMassWorldSnapshotSubsystem_LoadOnBeginPlay, TEXT("Name of a world snapshot to load when the Mass simulation starts instead of spawning military units, e.g. from -ini or -ExecCmds."));
+
+static constexpr uint32 GMassWorldSnapshotMagic = 0x534D5750; // "PWMS"
+
+enum class EMassWorldSnapshotVersion : int32
+{
+	Initial = 1,
+	BattlefieldClutter,
+	EntityReferencesOutsideSnapshotUnset,
+	TargetLocationNotValidated,
+
+	VersionPlusOne,
+	LatestVersion = VersionPlusOne - 1
+};
+
+// Tags that hold gameplay state rather than being set up by traits. Order is part of the format, only append.
+template<typename... TTags>
+struct TMassWorldSnapshotTags
+{
+	template<typename TFunction>
+	static void ForEach(TFunction&& Function)
+	{
+		int32 Bit = 0;
+		(Function(static_cast<TTags*>(nullptr), Bit++), ...);
+	}
+};
+
+using FMassWorldSnapshotTags = TMassWorldSnapshotTags<
+	FMassNeedsEnemyTargetTag,
+	FMassWillNeedEnemyTargetTag,
+	FMassTrackTargetTag,
+	FMassTrackSoundTag,
+	FMassHasStashedMoveTargetTag,
+	FMassNeedsMoveTargetForwardCompleteSignalTag,
+	FMassNeedsNavMeshMoveTag,
+	FMassCommandableTag>;
+
+enum class EMassWorldSnapshotFragments : uint32
+{
+	None = 0,
+	Velocity = 1 << 0,
+	MovementSpeed = 1 << 1,
+	TargetEntity = 1 << 2,
+	MoveTarget = 1 << 3,
+	StashedMoveTarget = 1 << 4,
+	NavMeshMove = 1 << 5,
+};
+ENUM_CLASS_FLAGS(EMassWorldSnapshotFragments);
+
+void FMassWorldSnapshotEntityMap::SerializeEntity(FArchive& Ar, FMassEntityHandle& Entity) const
+{
+	int32 SnapshotIndex = INDEX_NONE;
+	if (Ar.IsSaving())
+	{
+		const int32* SnapshotIndexPtr = Entity.IsSet() ? EntityToSnapshotIndex.Find(Entity) : nullptr;
+		SnapshotIndex = SnapshotIndexPtr ? *SnapshotIndexPtr : INDEX_NONE;
+	}
+
+	Ar << SnapshotIndex;
+	if (!Ar.IsLoading())
+	{
+		return;
+	}
+
+	if (SnapshotIndex != INDEX_NONE)
+	{
+		Entity = SnapshotEntities.IsValidIndex(SnapshotIndex) ? SnapshotEntities[SnapshotIndex] : FMassEntityHandle();
+		return;
+	}
+
+	// Older snapshots followed with the raw handle, which is skipped.
+	if (Version < static_cast<int32>(EMassWorldSnapshotVersion::EntityReferencesOutsideSnapshotUnset))
+	{
+		FMassEntityHandle SavedEntity;
+		Ar << SavedEntity.Index;
+		Ar << SavedEntity.SerialNumber;
+	}
+	Entity = FMassEntityHandle();
+}
+
+struct FMassWorldSnapshotMoveTarget
+{
+	void CopyFrom(const FMassMoveTargetFragment& MoveTarget)
+	{
+		Center = MoveTarget.Center;
+		Forward = MoveTarget.Forward;
+		DistanceToGoal = MoveTarget.DistanceToGoal;
+		DesiredSpeed = MoveTarget.DesiredSpeed.Get();
+		SlackRadius = MoveTarget.SlackRadius;
+		IntentAtGoal = static_cast<uint8>(MoveTarget.IntentAtGoal);
+		CurrentAction = static_cast<uint8>(MoveTarget.GetCurrentAction());
+	}
+
+	void CopyTo(FMassMoveTargetFragment& MoveTarget, const UWorld& World) const
+	{
+		// Restarts the action, actions are only compared by ID within a run.
+		MoveTarget.CreateNewAction(static_cast<EMassMovementAction>(CurrentAction), World);
+		MoveTarget.Center = Center;
+		MoveTarget.Forward = Forward;
+		MoveTarget.DistanceToGoal = DistanceToGoal;
+		MoveTarget.DesiredSpeed.Set(DesiredSpeed);
+		MoveTarget.SlackRadius = SlackRadius;
+		MoveTarget.IntentAtGoal = static_cast<EMassMovementAction>(IntentAtGoal);
+	}
+
+	friend FArchive& operator<<(FArchive& Ar, FMassWorldSnapshotMoveTarget& MoveTarget)
+	{
+		Ar << MoveTarget.Center << MoveTarget.Forward << MoveTarget.DistanceToGoal << MoveTarget.DesiredSpeed << MoveTarget.SlackRadius << MoveTarget.IntentAtGoal << MoveTarget.CurrentAction;
+		return Ar;
+	}
+
+	FVector Center = FVector::ZeroVector;
+	FVector Forward = FVector::ForwardVector;
+	float DistanceToGoal = 0.f;
+	float DesiredSpeed = 0.f;
+	float SlackRadius = 0.f;
+	uint8 IntentAtGoal = 0;
+	uint8 CurrentAction = 0;
+};
+
+// Transforms are stored per group so that entities can be spawned at their location before the rest of their state is read.
+struct FMassWorldSnapshotEntity
+{
+	uint32 Tags = 0;
+	EMassWorldSnapshotFragments Fragments = EMassWorldSnapshotFragments::None;
+	int16 Health = 0;
+	uint8 TeamIndex = 0;
+	FVector Velocity = FVector::ZeroVector;
+	float MovementSpeed = 0.f;
+
+	FMassEntityHandle TargetEntity;
+	FMassEntityHandle LastValidatedEntity;
+	float TargetMinCaliberForDamage = 0.f;
+	float VerticalAimOffset = 0.f;
+	FVector LastValidatedEntityLocation = FVector::ZeroVector;
+	float SecondsUntilNextValidation = 0.f;
+
+	FMassWorldSnapshotMoveTarget MoveTarget;
+	FMassWorldSnapshotMoveTarget StashedMoveTarget;
+
+	// Index into the snapshot's action lists, which are shared by squad members like FMassNavMeshMoveFragment::ActionList.
+	int32 ActionListIndex = INDEX_NONE;
+	int32 CurrentActionIndex = 0;
+	int32 ActionsRemaining = -1;
+	int8 SquadMemberIndex = -1;
+	bool bIsWaitingOnSquadMates = false;
+
+	void Serialize(FArchive& Ar, const FMassWorldSnapshotEntityMap& EntityMap)
+	{
+		Ar << Tags << Health << TeamIndex;
+
+		uint32 FragmentBits = static_cast<uint32>(Fragments);
+		Ar << FragmentBits;
+		Fragments = static_cast<EMassWorldSnapshotFragments>(FragmentBits);
+
+		if (EnumHasAnyFlags(Fragments, EMassWorldSnapshotFragments::Velocity))
+		{
+			Ar << Velocity;
+		}
+		if (EnumHasAnyFlags(Fragments, EMassWorldSnapshotFragments::MovementSpeed))
+		{
+			Ar << MovementSpeed;
+		}
+		if (EnumHasAnyFlags(Fragments, EMassWorldSnapshotFragments::TargetEntity))
+		{
+			EntityMap.SerializeEntity(Ar, TargetEntity);
+			EntityMap.SerializeEntity(Ar, LastValidatedEntity);
+			Ar << TargetMinCaliberForDamage << VerticalAimOffset << LastValidatedEntityLocation;
+			// Older snapshots followed with the target's location at the last validation, which is skipped.
+			if (EntityMap.Version < static_cast<int32>(EMassWorldSnapshotVersion::TargetLocationNotValidated))
+			{
+				FVector LastValidatedTargetEntityLocation;
+				Ar << LastValidatedTargetEntityLocation;
+			}
+			Ar << SecondsUntilNextValidation;
+		}
+		if (EnumHasAnyFlags(Fragments, EMassWorldSnapshotFragments::MoveTarget))
+		{
+			Ar << MoveTarget;
+		}
+		if (EnumHasAnyFlags(Fragments, EMassWorldSnapshotFragments::StashedMoveTarget))
+		{
+			Ar << StashedMoveTarget;
+		}
+		if (EnumHasAnyFlags(Fragments, EMassWorldSnapshotFragments::NavMeshMove))
+		{
+			Ar << ActionListIndex << CurrentActionIndex << ActionsRemaining << SquadMemberIndex << bIsWaitingOnSquadMates;
+		}
+	}
+};
+
+struct FMassWorldSnapshotEntityGroup
+{
+	FString SpawnerName;
+	int32 EntityTypeIndex = 0;
+	TArray<FMassEntityHandle> Entities;
+	TArray<FTransform> Transforms;
+	TArray<FMassWorldSnapshotEntity> Records;
+};
+
+static void SerializeActionList(FArchive& Ar, TArray<FNavigationAction>& Actions)
+{
+	int32 NumActions = Actions.Num();
+	Ar << NumActions;
+	if (Ar.IsLoading())
+	{
+		Actions.Reset(NumActions);
+		for (int32 ActionIndex = 0; ActionIndex < NumActions; ActionIndex++)
+		{
+			Actions.Emplace(FVector::ZeroVector, FVector::ForwardVector);
+		}
+	}
+
+	for (FNavigationAction& Action : Actions)
+	{
+		uint8 MovementAction = static_cast<uint8>(Action.Action);
+		Ar << Action.TargetLocation << Action.Forward << MovementAction;
+		Action.Action = static_cast<EMassMovementAction>(MovementAction);
+	}
+}
+
+// Soldiers and vehicles of military unit spawner teams. Players and dying soldiers are left out.
+static void GatherSnapshotEntities(UMassEntitySubsystem& EntitySubsystem, TFunctionRef<void(const FMassEntityHandle Entity)> Function)
+{
+	FMassEntityQuery EntityQuery;
+	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FTeamMemberFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FMassHealthFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddTagRequirement<FMassPlayerControllableCharacterTag>(EMassFragmentPresence::None);
+	EntityQuery.AddTagRequirement<FMassSoldierIsDyingTag>(EMassFragmentPresence::None);
+	FMassExecutionContext Context(0.0f);
+
+	EntityQuery.ForEachEntityChunk(EntitySubsystem, Context, [&Function](FMassExecutionContext& Context)
+	{
+		for (int32 EntityIndex = 0; EntityIndex < Context.GetNumEntities(); ++EntityIndex)
+		{
+			Function(Context.GetEntity(EntityIndex));
+		}
+	});
+}
+
+// In-flight projectiles and dying soldiers. They aren't part of the snapshot and would otherwise outlive the simulation they belong to.
+static void GatherTransientEntities(UMassEntitySubsystem& EntitySubsystem, TArray<FMassEntityHandle>& OutEntities)
+{
+	FMassEntityQuery ProjectileQuery;
+	ProjectileQuery.AddTagRequirement<FMassProjectileTag>(EMassFragmentPresence::All);
+	FMassEntityQuery DyingSoldierQuery;
+	DyingSoldierQuery.AddTagRequirement<FMassSoldierIsDyingTag>(EMassFragmentPresence::All);
+	FMassExecutionContext Context(0.0f);
+
+	for (FMassEntityQuery* EntityQuery : { &ProjectileQuery, &DyingSoldierQuery })
+	{
+		EntityQuery->ForEachEntityChunk(EntitySubsystem, Context, [&OutEntities](FMassExecutionContext& Context)
+		{
+			OutEntities.Append(Context.GetEntities().GetData(), Context.GetNumEntities());
+		});
+	}
+}
+
+static FMassWorldSnapshotEntity MakeSnapshotEntity(const FMassEntityView& EntityView, const float WorldTime, TMap<const FNavigationActionList*, int32>& ActionListIndices)
+{
+	FMassWorldSnapshotEntity Record;
+	Record.Health = EntityView.GetFragmentData<FMassHealthFragment>().Value;
+	Record.TeamIndex = EntityView.GetFragmentData<FTeamMemberFragment>().TeamIndex;
+
+	FMassWorldSnapshotTags::ForEach([&EntityView, &Record](auto* Tag, const int32 Bit)
+	{
+		using TTag = std::remove_pointer_t<decltype(Tag)>;
+		if (EntityView.HasTag<TTag>())
+		{
+			Record.Tags |= 1u << Bit;
+		}
+	});
+
+	if (const FMassVelocityFragment* VelocityFragment = EntityView.GetFragmentDataPtr<FMassVelocityFragment>())
+	{
+		Record.Fragments |= EMassWorldSnapshotFragments::Velocity;
+		Record.Velocity = VelocityFragment->Value;
+	}
+
+	if (const FMassCommandableMovementSpeedFragment* MovementSpeedFragment = EntityView.GetFragmentDataPtr<FMassCommandableMovementSpeedFragment>())
+	{
+		Record.Fragments |= EMassWorldSnapshotFragments::MovementSpeed;
+		Record.MovementSpeed = MovementSpeedFragment->MovementSpeed;
+	}
+
+	if (const FTargetEntityFragment* TargetEntityFragment = EntityView.GetFragmentDataPtr<FTargetEntityFragment>())
+	{
+		Record.Fragments |= EMassWorldSnapshotFragments::TargetEntity;
+		Record.TargetEntity = TargetEntityFragment->Entity;
+		Record.LastValidatedEntity = TargetEntityFragment->LastValidatedEntity;
+		Record.TargetMinCaliberForDamage = TargetEntityFragment->TargetMinCaliberForDamage;
+		Record.VerticalAimOffset = TargetEntityFragment->VerticalAimOffset;
+		Record.LastValidatedEntityLocation = TargetEntityFragment->LastValidatedEntityLocation;
+		Record.SecondsUntilNextValidation = TargetEntityFragment->NextValidationTime - WorldTime;
+	}
+
+	if (const FMassMoveTargetFragment* MoveTargetFragment = EntityView.GetFragmentDataPtr<FMassMoveTargetFragment>())
+	{
+		Record.Fragments |= EMassWorldSnapshotFragments::MoveTarget;
+		Record.MoveTarget.CopyFrom(*MoveTargetFragment);
+	}
+
+	if (const FMassStashedMoveTargetFragment* StashedMoveTargetFragment = EntityView.GetFragmentDataPtr<FMassStashedMoveTargetFragment>())
+	{
+		Record.Fragments |= EMassWorldSnapshotFragments::StashedMoveTarget;
+		Record.StashedMoveTarget.CopyFrom(*StashedMoveTargetFragment);
+	}
+
+	if (const FMassNavMeshMoveFragment* NavMeshMoveFragment = EntityView.GetFragmentDataPtr<FMassNavMeshMoveFragment>())
+	{
+		Record.Fragments |= EMassWorldSnapshotFragments::NavMeshMove;
+		if (const FNavigationActionList* ActionList = NavMeshMoveFragment->ActionList.Get())
+		{
+			Record.ActionListIndex = ActionListIndices.FindOrAdd(ActionList, ActionListIndices.Num());
+		}
+		Record.CurrentActionIndex = NavMeshMoveFragment->CurrentActionIndex;
+		Record.ActionsRemaining = NavMeshMoveFragment->ActionsRemaining;
+		Record.SquadMemberIndex = NavMeshMoveFragment->SquadMemberIndex;
+		Record.bIsWaitingOnSquadMates = NavMeshMoveFragment->bIsWaitingOnSquadMates;
+	}
+
+	return Record;
+}
+
+static void ApplySnapshotEntity(const FMassWorldSnapshotEntity& Record, const FTransform& Transform, const FMassEntityView& EntityView, UMassEntitySubsystem& EntitySubsystem, const UWorld& World, const TArray<FNavActionListSharedPtr>& ActionLists)
+{
+	EntityView.GetFragmentData<FTransformFragment>().SetTransform(Transform);
+	EntityView.GetFragmentData<FMassHealthFragment>().Value = Record.Health;
+	EntityView.GetFragmentData<FTeamMemberFragment>().TeamIndex = Record.TeamIndex;
+
+	FMassWorldSnapshotTags::ForEach([&EntityView, &EntitySubsystem, &Record](auto* Tag, const int32 Bit)
+	{
+		using TTag = std::remove_pointer_t<decltype(Tag)>;
+		const bool bShouldHaveTag = (Record.Tags & (1u << Bit)) != 0;
+		if (bShouldHaveTag != EntityView.HasTag<TTag>())
+		{
+			if (bShouldHaveTag)
+			{
+				EntitySubsystem.Defer().AddTag<TTag>(EntityView.GetEntity());
+			}
+			else
+			{
+				EntitySubsystem.Defer().RemoveTag<TTag>(EntityView.GetEntity());
+			}
+		}
+	});
+
+	FMassVelocityFragment* VelocityFragment = EntityView.GetFragmentDataPtr<FMassVelocityFragment>();
+	if (VelocityFragment && EnumHasAnyFlags(Record.Fragments, EMassWorldSnapshotFragments::Velocity))
+	{
+		VelocityFragment->Value = Record.Velocity;
+	}
+
+	FMassCommandableMovementSpeedFragment* MovementSpeedFragment = EntityView.GetFragmentDataPtr<FMassCommandableMovementSpeedFragment>();
+	if (MovementSpeedFragment && EnumHasAnyFlags(Record.Fragments, EMassWorldSnapshotFragments::MovementSpeed))
+	{
+		MovementSpeedFragment->MovementSpeed = Record.MovementSpeed;
+	}
+
+	FTargetEntityFragment* TargetEntityFragment = EntityView.GetFragmentDataPtr<FTargetEntityFragment>();
+	if (TargetEntityFragment && EnumHasAnyFlags(Record.Fragments, EMassWorldSnapshotFragments::TargetEntity))
+	{
+		TargetEntityFragment->Entity = Record.TargetEntity;
+		TargetEntityFragment->LastValidatedEntity = Record.LastValidatedEntity;
+		TargetEntityFragment->TargetMinCaliberForDamage = Record.TargetMinCaliberForDamage;
+		TargetEntityFragment->VerticalAimOffset = Record.VerticalAimOffset;
+		TargetEntityFragment->LastValidatedEntityLocation = Record.LastValidatedEntityLocation;
+		TargetEntityFragment->NextValidationTime = World.GetTimeSeconds() + Record.SecondsUntilNextValidation;
+	}
+
+	FMassMoveTargetFragment* MoveTargetFragment = EntityView.GetFragmentDataPtr<FMassMoveTargetFragment>();
+	if (MoveTargetFragment && EnumHasAnyFlags(Record.Fragments, EMassWorldSnapshotFragments::MoveTarget))
+	{
+		Record.MoveTarget.CopyTo(*MoveTargetFragment, World);
+	}
+
+	FMassStashedMoveTargetFragment* StashedMoveTargetFragment = EntityView.GetFragmentDataPtr<FMassStashedMoveTargetFragment>();
+	if (StashedMoveTargetFragment && EnumHasAnyFlags(Record.Fragments, EMassWorldSnapshotFragments::StashedMoveTarget))
+	{
+		Record.StashedMoveTarget.CopyTo(*StashedMoveTargetFragment, World);
+	}
+
+	FMassNavMeshMoveFragment* NavMeshMoveFragment = EntityView.GetFragmentDataPtr<FMassNavMeshMoveFragment>();
+	if (NavMeshMoveFragment && EnumHasAnyFlags(Record.Fragments, EMassWorldSnapshotFragments::NavMeshMove))
+	{
+		NavMeshMoveFragment->Reset();
+		if (ActionLists.IsValidIndex(Record.ActionListIndex))
+		{
+			NavMeshMoveFragment->ActionList = ActionLists[Record.ActionListIndex];
+		}
+		NavMeshMoveFragment->CurrentActionIndex = Record.CurrentActionIndex;
+		NavMeshMoveFragment->ActionsRemaining = Record.ActionsRemaining;
+		NavMeshMoveFragment->SquadMemberIndex = Record.SquadMemberIndex;
+		NavMeshMoveFragment->bIsWaitingOnSquadMates = Record.bIsWaitingOnSquadMates;
+	}
+}
+
+static TMap<FString, AMilitaryUnitMassSpawner*> GetMilitaryUnitMassSpawners(const UWorld* World)
+{
+	TArray<AActor*> Actors;
+	UGameplayStatics::GetAllActorsOfClass(World, AMilitaryUnitMassSpawner::StaticClass(), Actors);
+
+	TMap<FString, AMilitaryUnitMassSpawner*> Spawners;
+	for (AActor* Actor : Actors)
+	{
+		Spawners.Add(Actor->GetName(), CastChecked<AMilitaryUnitMassSpawner>(Actor));
+	}
+	return Spawners;
+}
+
+//----------------------------------------------------------------------//
+//  UMassWorldSnapshotSubsystem
+//----------------------------------------------------------------------//
+void UMassWorldSnapshotSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	if (!ShouldLoadSnapshotOnBeginPlay())
+	{
+		return;
+	}
+
+	const UMassSimulationSubsystem* MassSimulationSubsystem = UWorld::GetSubsystem<UMassSimulationSubsystem>(&InWorld);
+	if (MassSimulationSubsystem == nullptr || MassSimulationSubsystem->IsSimulationStarted())
+	{
+		LoadSnapshot(UMassWorldSnapshotSubsystem_LoadOnBeginPlay);
+		return;
+	}
+
+	SimulationStartedHandle = UMassSimulationSubsystem::GetOnSimulationStarted().AddLambda([this](UWorld* InWorld)
+	{
+		if (GetWorld() == InWorld)
+		{
+			UMassSimulationSubsystem::GetOnSimulationStarted().Remove(SimulationStartedHandle);
+			SimulationStartedHandle.Reset();
+			LoadSnapshot(UMassWorldSnapshotSubsystem_LoadOnBeginPlay);
+		}
+	});
+}
+
+void UMassWorldSnapshotSubsystem::Deinitialize()
+{
+	if (SimulationStartedHandle.IsValid())
+	{
+		UMassSimulationSubsystem::GetOnSimulationStarted().Remove(SimulationStartedHandle);
+		SimulationStartedHandle.Reset();
+	}
+
+	Super::Deinitialize();
+}
+
+bool UMassWorldSnapshotSubsystem::ShouldLoadSnapshotOnBeginPlay()
+{
+	return !UMassWorldSnapshotSubsystem_LoadOnBeginPlay.IsEmpty();
+}
+
+FString UMassWorldSnapshotSubsystem::GetSnapshotFilePath(const FString& SnapshotName) const
+{
+	const FString MapName = UGameplayStatics::GetCurrentLevelName(GetWorld(), true);
+	return FPaths::ProjectSavedDir() / TEXT("WorldSnapshots") / MapName + TEXT("_") + SnapshotName + TEXT(".bin");
+}
+
+bool UMassWorldSnapshotSubsystem::SaveSnapshot(const FString& SnapshotName)
+{
+	FBufferArchive Writer;
+	SaveSnapshot(Writer);
+	const bool bSuccess = FFileHelper::SaveArrayToFile(Writer, *GetSnapshotFilePath(SnapshotName));
+	if (bSuccess)
+	{
+		UE_LOG(LogTemp, Log, TEXT("UMassWorldSnapshotSubsystem: Saved %d byte world snapshot to %s."), Writer.Num(), *GetSnapshotFilePath(SnapshotName));
+	}
+	else
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UMassWorldSnapshotSubsystem: Failed to save world snapshot to %s."), *GetSnapshotFilePath(SnapshotName));
+	}
+	return bSuccess;
+}
+
+bool UMassWorldSnapshotSubsystem::LoadSnapshot(const FString& SnapshotName)
+{
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *GetSnapshotFilePath(SnapshotName)))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UMassWorldSnapshotSubsystem: Failed to read world snapshot %s."), *GetSnapshotFilePath(SnapshotName));
+		return false;
+	}
+
+	FMemoryReader Reader(Bytes);
+	return LoadSnapshot(Reader);
+}
+
+void UMassWorldSnapshotSubsystem::SaveSnapshot(FArchive& Ar)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UMassWorldSnapshotSubsystem.SaveSnapshot);
+	check(Ar.IsSaving());
+
+	UWorld* World = GetWorld();
+	UMassEntitySubsystem* EntitySubsystem = UWorld::GetSubsystem<UMassEntitySubsystem>(World);
+	UMilitaryStructureSubsystem* MilitaryStructureSubsystem = UWorld::GetSubsystem<UMilitaryStructureSubsystem>(World);
+	UMassSoundPerceptionSubsystem* SoundPerceptionSubsystem = UWorld::GetSubsystem<UMassSoundPerceptionSubsystem>(World);
+	UMassBattlefieldClutterSubsystem* BattlefieldClutterSubsystem = UWorld::GetSubsystem<UMassBattlefieldClutterSubsystem>(World);
+	check(EntitySubsystem && MilitaryStructureSubsystem && SoundPerceptionSubsystem && BattlefieldClutterSubsystem);
+
+	// Entities are grouped by the spawner and spawner entity type that spawned them, which is what they are restored with.
+	TArray<FMassWorldSnapshotEntityGroup> Groups;
+	TMap<FMassEntityHandle, int32> EntityGroupIndices;
+	for (const TPair<FString, AMilitaryUnitMassSpawner*>& Spawner : GetMilitaryUnitMassSpawners(World))
+	{
+		TMap<int32, int32> SpawnerGroupIndices;
+		Spawner.Value->ForEachSpawnedEntity([&](const FMassEntityHandle Entity, const int32 EntityTypeIndex)
+		{
+			int32& GroupIndex = SpawnerGroupIndices.FindOrAdd(EntityTypeIndex, INDEX_NONE);
+			if (GroupIndex == INDEX_NONE)
+			{
+				GroupIndex = Groups.AddDefaulted();
+				Groups[GroupIndex].SpawnerName = Spawner.Key;
+				Groups[GroupIndex].EntityTypeIndex = EntityTypeIndex;
+			}
+			EntityGroupIndices.Add(Entity, GroupIndex);
+		});
+	}
+
+	int32 NumSkippedEntities = 0;
+	GatherSnapshotEntities(*EntitySubsystem, [&](const FMassEntityHandle Entity)
+	{
+		if (const int32* GroupIndex = EntityGroupIndices.Find(Entity))
+		{
+			Groups[*GroupIndex].Entities.Add(Entity);
+		}
+		else
+		{
+			NumSkippedEntities++;
+		}
+	});
+	Groups.RemoveAll([](const FMassWorldSnapshotEntityGroup& Group) { return Group.Entities.Num() == 0; });
+
+	if (NumSkippedEntities > 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UMassWorldSnapshotSubsystem: Skipped %d entities that weren't spawned by an AMilitaryUnitMassSpawner."), NumSkippedEntities);
+	}
+
+	FMassWorldSnapshotEntityMap EntityMap(static_cast<int32>(EMassWorldSnapshotVersion::LatestVersion));
+	for (const FMassWorldSnapshotEntityGroup& Group : Groups)
+	{
+		for (const FMassEntityHandle& Entity : Group.Entities)
+		{
+			EntityMap.EntityToSnapshotIndex.Add(Entity, EntityMap.EntityToSnapshotIndex.Num());
+		}
+	}
+
+	const float WorldTime = World->GetTimeSeconds();
+	TMap<const FNavigationActionList*, int32> ActionListIndices;
+	for (FMassWorldSnapshotEntityGroup& Group : Groups)
+	{
+		Group.Transforms.Reserve(Group.Entities.Num());
+		Group.Records.Reserve(Group.Entities.Num());
+		for (const FMassEntityHandle& Entity : Group.Entities)
+		{
+			const FMassEntityView EntityView(*EntitySubsystem, Entity);
+			Group.Transforms.Add(EntityView.GetFragmentData<FTransformFragment>().GetTransform());
+			Group.Records.Add(MakeSnapshotEntity(EntityView, WorldTime, ActionListIndices));
+		}
+	}
+
+	uint32 Magic = GMassWorldSnapshotMagic;
+	int32 Version = static_cast<int32>(EMassWorldSnapshotVersion::LatestVersion);
+	FString MapName = UGameplayStatics::GetCurrentLevelName(World, true);
+	Ar << Magic << Version << MapName;
+
+	TArray<TArray<FNavigationAction>> ActionLists;
+	ActionLists.SetNum(ActionListIndices.Num());
+	for (const TPair<const FNavigationActionList*, int32>& ActionListIndex : ActionListIndices)
+	{
+		ActionLists[ActionListIndex.Value] = ActionListIndex.Key->Actions;
+	}
+	int32 NumActionLists = ActionLists.Num();
+	Ar << NumActionLists;
+	for (TArray<FNavigationAction>& Actions : ActionLists)
+	{
+		SerializeActionList(Ar, Actions);
+	}
+
+	int32 NumGroups = Groups.Num();
+	Ar << NumGroups;
+	for (FMassWorldSnapshotEntityGroup& Group : Groups)
+	{
+		Ar << Group.SpawnerName << Group.EntityTypeIndex << Group.Transforms;
+	}
+	for (FMassWorldSnapshotEntityGroup& Group : Groups)
+	{
+		for (FMassWorldSnapshotEntity& Record : Group.Records)
+		{
+			Record.Serialize(Ar, EntityMap);
+		}
+	}
+
+	MilitaryStructureSubsystem->SerializeSnapshot(Ar, EntityMap);
+	SoundPerceptionSubsystem->SerializeSnapshot(Ar);
+	BattlefieldClutterSubsystem->SerializeSnapshot(Ar);
+}
+
+bool UMassWorldSnapshotSubsystem::LoadSnapshot(FArchive& Ar)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UMassWorldSnapshotSubsystem.LoadSnapshot);
+	check(Ar.IsLoading());
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	UWorld* World = GetWorld();
+	UMassEntitySubsystem* EntitySubsystem = UWorld::GetSubsystem<UMassEntitySubsystem>(World);
+	UMilitaryStructureSubsystem* MilitaryStructureSubsystem = UWorld::GetSubsystem<UMilitaryStructureSubsystem>(World);
+	UMassSoundPerceptionSubsystem* SoundPerceptionSubsystem = UWorld::GetSubsystem<UMassSoundPerceptionSubsystem>(World);
+	UMassMoveToCommandSubsystem* MoveToCommandSubsystem = UWorld::GetSubsystem<UMassMoveToCommandSubsystem>(World);
+	UMassBattlefieldClutterSubsystem* BattlefieldClutterSubsystem = UWorld::GetSubsystem<UMassBattlefieldClutterSubsystem>(World);
+	check(EntitySubsystem && MilitaryStructureSubsystem && SoundPerceptionSubsystem && MoveToCommandSubsystem && BattlefieldClutterSubsystem);
+
+	uint32 Magic = 0;
+	int32 Version = 0;
+	FString MapName;
+	Ar << Magic << Version << MapName;
+	// Older snapshots are read without the parts added since, see the checks against EMassWorldSnapshotVersion below.
+	if (Ar.IsError() || Magic != GMassWorldSnapshotMagic || Version < static_cast<int32>(EMassWorldSnapshotVersion::Initial) || Version > static_cast<int32>(EMassWorldSnapshotVersion::LatestVersion))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UMassWorldSnapshotSubsystem: World snapshot is not valid or was saved with a newer version."));
+		return false;
+	}
+	if (MapName != UGameplayStatics::GetCurrentLevelName(World, true))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UMassWorldSnapshotSubsystem: World snapshot was saved in map %s."), *MapName);
+		return false;
+	}
+
+	TArray<FNavActionListSharedPtr> ActionLists;
+	int32 NumActionLists = 0;
+	Ar << NumActionLists;
+	ActionLists.Reserve(NumActionLists);
+	for (int32 ActionListIndex = 0; ActionListIndex < NumActionLists && !Ar.IsError(); ActionListIndex++)
+	{
+		FNavActionListSharedPtr& ActionList = ActionLists.Add_GetRef(MakeShareable(new FNavigationActionList()));
+		SerializeActionList(Ar, ActionList->Actions);
+	}
+
+	const TMap<FString, AMilitaryUnitMassSpawner*> Spawners = GetMilitaryUnitMassSpawners(World);
+	TArray<FMassWorldSnapshotEntityGroup> Groups;
+	int32 NumGroups = 0;
+	Ar << NumGroups;
+	for (int32 GroupIndex = 0; GroupIndex < NumGroups && !Ar.IsError(); GroupIndex++)
+	{
+		FMassWorldSnapshotEntityGroup& Group = Groups.AddDefaulted_GetRef();
+		Ar << Group.SpawnerName << Group.EntityTypeIndex << Group.Transforms;
+		if (!Spawners.Contains(Group.SpawnerName))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("UMassWorldSnapshotSubsystem: World snapshot refers to spawner %s which isn't in the level."), *Group.SpawnerName);
+			return false;
+		}
+	}
+	if (Ar.IsError())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UMassWorldSnapshotSubsystem: World snapshot is truncated."));
+		return false;
+	}
+
+	// Replace the current simulation.
+	TArray<FMassEntityHandle> EntitiesToDestroy;
+	GatherSnapshotEntities(*EntitySubsystem, [&EntitiesToDestroy](const FMassEntityHandle Entity)
+	{
+		EntitiesToDestroy.Add(Entity);
+	});
+	GatherTransientEntities(*EntitySubsystem, EntitiesToDestroy);
+	EntitySubsystem->Defer().DestroyEntities(EntitiesToDestroy);
+	EntitySubsystem->FlushCommands();
+	for (const TPair<FString, AMilitaryUnitMassSpawner*>& Spawner : Spawners)
+	{
+		Spawner.Value->ResetSpawnedEntities();
+	}
+	MoveToCommandSubsystem->ResetMoveToCommands();
+
+	// Each group is spawned in a single batch, then the rest of the entities' state is read with entity references resolving to the spawned
+	// entities.
+	FMassWorldSnapshotEntityMap EntityMap(Version);
+	for (FMassWorldSnapshotEntityGroup& Group : Groups)
+	{
+		Spawners[Group.SpawnerName]->SpawnEntitiesFromSnapshot(Group.EntityTypeIndex, Group.Transforms, Group.Entities);
+		if (Group.Entities.Num() != Group.Transforms.Num())
+		{
+			UE_LOG(LogTemp, Error, TEXT("UMassWorldSnapshotSubsystem: Spawned %d of %d entities for spawner %s."), Group.Entities.Num(), Group.Transforms.Num(), *Group.SpawnerName);
+			Group.Entities.SetNum(Group.Transforms.Num());
+		}
+		EntityMap.SnapshotEntities.Append(Group.Entities);
+	}
+
+	for (FMassWorldSnapshotEntityGroup& Group : Groups)
+	{
+		Group.Records.SetNum(Group.Transforms.Num());
+		for (int32 EntityIndex = 0; EntityIndex < Group.Records.Num(); EntityIndex++)
+		{
+			FMassWorldSnapshotEntity& Record = Group.Records[EntityIndex];
+			Record.Serialize(Ar, EntityMap);
+
+			const FMassEntityHandle& Entity = Group.Entities[EntityIndex];
+			if (Entity.IsSet() && EntitySubsystem->IsEntityValid(Entity))
+			{
+				ApplySnapshotEntity(Record, Group.Transforms[EntityIndex], FMassEntityView(*EntitySubsystem, Entity), *EntitySubsystem, *World, ActionLists);
+			}
+		}
+	}
+	EntitySubsystem->FlushCommands();
+
+	MilitaryStructureSubsystem->SerializeSnapshot(Ar, EntityMap);
+	SoundPerceptionSubsystem->SerializeSnapshot(Ar);
+	if (Version >= static_cast<int32>(EMassWorldSnapshotVersion::BattlefieldClutter))
+	{
+		BattlefieldClutterSubsystem->SerializeSnapshot(Ar);
+	}
+	else
+	{
+		BattlefieldClutterSubsystem->Reset();
+	}
+
+	if (Ar.IsError())
+	{
+		UE_LOG(LogTemp, Error, TEXT("UMassWorldSnapshotSubsystem: World snapshot is truncated, the restored simulation is incomplete."));
+		return false;
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("UMassWorldSnapshotSubsystem: Restored %d entities from world snapshot in %.2f seconds."), EntityMap.SnapshotEntities.Num(), FPlatformTime::Seconds() - StartTime);
+	return true;
+}
+
+static void SaveWorldSnapshot(const TArray<FString>& Args, UWorld* World)
+{
+	UMassWorldSnapshotSubsystem* WorldSnapshotSubsystem = UWorld::GetSubsystem<UMassWorldSnapshotSubsystem>(World);
+	if (WorldSnapshotSubsystem)
+	{
+		WorldSnapshotSubsystem->SaveSnapshot(Args.Num() > 0 ? Args[0] : TEXT("Default"));
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs SaveWorldSnapshotCmd(
+	TEXT("pm.SaveWorldSnapshot"),
+	TEXT("Save the Mass simulation to Saved/WorldSnapshots. Optional argument is the snapshot name."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(SaveWorldSnapshot)
+);
+
+static void LoadWorldSnapshot(const TArray<FString>& Args, UWorld* World)
+{
+	UMassWorldSnapshotSubsystem* WorldSnapshotSubsystem = UWorld::GetSubsystem<UMassWorldSnapshotSubsystem>(World);
+	if (WorldSnapshotSubsystem)
+	{
+		WorldSnapshotSubsystem->LoadSnapshot(Args.Num() > 0 ? Args[0] : TEXT("Default"));
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs LoadWorldSnapshotCmd(
+	TEXT("pm.LoadWorldSnapshot"),
+	TEXT("Replace the Mass simulation with a snapshot saved with pm.SaveWorldSnapshot. Optional argument is the snapshot name."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(LoadWorldSnapshot)
+);
@@ -6,6 +6,8 @@
 #include "Internationalization/Internationalization.h"
 #include <Kismet/GameplayStatics.h>
 #include "MilitaryUnitMassSpawner.h"
+#include "MassEnemyTargetFinderProcessor.h"
+#include "MassWorldSnapshotSubsystem.h"
 
 #define LOCTEXT_NAMESPACE "MyNamespace" // TODO
 
@@ -147,18 +149,16 @@ FMilitaryUnitCounts RecursivelyCreateArmorUnits(UMilitaryUnit* Unit, UMilitaryUn
 //----------------------------------------------------------------------//
 //  UMilitaryStructureSubsystem
 //----------------------------------------------------------------------//
-FMilitaryUnitCounts UMilitaryStructureSubsystem::CreateMilitaryUnit(uint8 MilitaryUnitIndex, bool bIsTeam1)
+FMilitaryUnitCounts UMilitaryStructureSubsystem::CreateMilitaryUnit(uint8 MilitaryUnitIndex, uint8 TeamIndex)
 {
+	check(TeamIndex < GMaxTeams);
 	UMilitaryUnit* RootUnit = NewObject<UMilitaryUnit>();
 	FMilitaryUnitCounts Counts = RecursivelyCreateUnits(RootUnit, nullptr, MilitaryUnitIndex);
-	if (bIsTeam1)
+	if (TeamRootUnits.Num() <= TeamIndex)
 	{
-		Team1RootUnit = RootUnit;
-	}
-	else
-	{
-		Team2RootUnit = RootUnit;
+		TeamRootUnits.SetNumZeroed(TeamIndex + 1);
 	}
+	TeamRootUnits[TeamIndex] = RootUnit;
 	return Counts;
 }
 
@@ -179,13 +179,34 @@ void UMilitaryStructureSubsystem::Initialize(FSubsystemCollectionBase& Collectio
 
 void UMilitaryStructureSubsystem::BindUnitToMassEntity(UMilitaryUnit* MilitaryUnit, FMassEntityHandle Entity)
 {
-	if (EntityToUnitMap.Contains(Entity))
-	{
-		EntityToUnitMap.Remove(Entity);
-	}
 	MilitaryUnit->MassEntityIndex = Entity.Index;
 	MilitaryUnit->MassEntitySerialNumber = Entity.SerialNumber;
-	EntityToUnitMap.Add(Entity, MilitaryUnit);
+	EntityToUnitMap.Add(Entity, MilitaryUnit); // Replaces any previous unit.
+}
+
+void UMilitaryStructureSubsystem::ReserveUnitBindings(const int32 NumAdditionalEntities)
+{
+	EntityToUnitMap.Reserve(EntityToUnitMap.Num() + NumAdditionalEntities);
+}
+
+int32 UMilitaryStructureSubsystem::GetRemainingSpawnBudget(const int32 BudgetPerFrame)
+{
+	if (SpawnBudgetFrame != GFrameCounter)
+	{
+		SpawnBudgetFrame = GFrameCounter;
+		NumSoldiersSpawnedThisFrame = 0;
+	}
+	return FMath::Max(BudgetPerFrame - NumSoldiersSpawnedThisFrame, 0);
+}
+
+void UMilitaryStructureSubsystem::ConsumeSpawnBudget(const int32 NumSpawnedSoldiers)
+{
+	if (SpawnBudgetFrame != GFrameCounter)
+	{
+		SpawnBudgetFrame = GFrameCounter;
+		NumSoldiersSpawnedThisFrame = 0;
+	}
+	NumSoldiersSpawnedThisFrame += NumSpawnedSoldiers;
 }
 
 void UMilitaryStructureSubsystem::DestroyEntity(FMassEntityHandle Entity)
@@ -260,9 +281,41 @@ void UMilitaryStructureSubsystem::PromoteNewLeaderIfNeeded(UMilitaryUnit* Soldie
 	SoldierToRemoveParentUnit->Commander = NewLeader;
 }
 
-UMilitaryUnit* UMilitaryStructureSubsystem::GetRootUnitForTeam(const bool bIsTeam1)
+UMilitaryUnit* UMilitaryStructureSubsystem::GetRootUnitForTeam(const uint8 TeamIndex)
 {
-	return bIsTeam1 ? Team1RootUnit : Team2RootUnit;
+	return TeamRootUnits.IsValidIndex(TeamIndex) ? TeamRootUnits[TeamIndex] : nullptr;
+}
+
+static void RecursivelyGetSquads(UMilitaryUnit* Unit, TArray<UMilitaryUnit*>& OutSquads)
+{
+	if (Unit->bIsSoldier || Unit->bIsVehicle)
+	{
+		return;
+	}
+
+	// Squad leaders are direct sub units of their squad, unlike the other squad members which are in fire teams.
+	const bool bIsSquad = Unit->SubUnits.ContainsByPredicate([Unit](const UMilitaryUnit* SubUnit) { return SubUnit->bIsSoldier && SubUnit->SquadMilitaryUnit == Unit; });
+	if (bIsSquad)
+	{
+		OutSquads.Add(Unit);
+		return;
+	}
+
+	for (UMilitaryUnit* SubUnit : Unit->SubUnits)
+	{
+		RecursivelyGetSquads(SubUnit, OutSquads);
+	}
+}
+
+void UMilitaryStructureSubsystem::GetSquads(TArray<UMilitaryUnit*>& OutSquads) const
+{
+	for (UMilitaryUnit* RootUnit : TeamRootUnits)
+	{
+		if (RootUnit)
+		{
+			RecursivelyGetSquads(RootUnit, OutSquads);
+		}
+	}
 }
 
 UMilitaryUnit* UMilitaryStructureSubsystem::GetUnitForEntity(const FMassEntityHandle Entity)
@@ -276,21 +329,137 @@ UMilitaryUnit* UMilitaryStructureSubsystem::GetUnitForEntity(const FMassEntityHa
 	return *MilitaryUnit;
 }
 
-void UMilitaryStructureSubsystem::DidCompleteAssigningEntitiesToMilitaryUnits(const bool bIsTeam1)
+void UMilitaryStructureSubsystem::DidCompleteAssigningEntitiesToMilitaryUnits(const uint8 TeamIndex)
 {
 	TArray<AActor*> MilitaryUnitMassSpawners;
 	UGameplayStatics::GetAllActorsOfClass(this, AMilitaryUnitMassSpawner::StaticClass(), MilitaryUnitMassSpawners);
 
+	DidCompleteAssigningEntitiesToMilitaryUnitsTeamsMask |= GetTeamMask(TeamIndex);
 
-	(bIsTeam1 ? bDidCompleteAssigningEntitiesToMilitaryUnitsForTeam1 : bDidCompleteAssigningEntitiesToMilitaryUnitsForTeam2) = true;
+	// Wait until every team that has a spawner in the level has finished.
+	uint32 SpawnerTeamsMask = 0;
+	for (const AActor* Actor : MilitaryUnitMassSpawners)
+	{
+		SpawnerTeamsMask |= GetTeamMask(CastChecked<AMilitaryUnitMassSpawner>(Actor)->TeamIndex);
+	}
 
-	if (MilitaryUnitMassSpawners.Num() == 1)
+	if ((DidCompleteAssigningEntitiesToMilitaryUnitsTeamsMask & SpawnerTeamsMask) == SpawnerTeamsMask)
 	{
 		OnCompletedAssigningEntitiesToMilitaryUnitsEvent.Broadcast();
 	}
-	else if (bDidCompleteAssigningEntitiesToMilitaryUnitsForTeam1 && bDidCompleteAssigningEntitiesToMilitaryUnitsForTeam2)
+}
+
+static void FlattenMilitaryUnits(UMilitaryUnit* Unit, TArray<UMilitaryUnit*>& OutUnits)
+{
+	OutUnits.Add(Unit);
+	for (UMilitaryUnit* SubUnit : Unit->SubUnits)
 	{
-		OnCompletedAssigningEntitiesToMilitaryUnitsEvent.Broadcast();
+		FlattenMilitaryUnits(SubUnit, OutUnits);
+	}
+}
+
+void UMilitaryStructureSubsystem::SerializeSnapshot(FArchive& Ar, const FMassWorldSnapshotEntityMap& EntityMap)
+{
+	TMap<const UMilitaryUnit*, FMassEntityHandle> UnitToEntityMap;
+	if (Ar.IsSaving())
+	{
+		for (const TPair<FMassEntityHandle, UMilitaryUnit*>& EntityToUnit : EntityToUnitMap)
+		{
+			UnitToEntityMap.Add(EntityToUnit.Value, EntityToUnit.Key);
+		}
+	}
+	else
+	{
+		EntityToUnitMap.Reset();
+	}
+
+	int32 NumTeams = TeamRootUnits.Num();
+	Ar << NumTeams;
+	if (Ar.IsLoading())
+	{
+		TeamRootUnits.Reset();
+		TeamRootUnits.SetNumZeroed(FMath::Clamp(NumTeams, 0, GMaxTeams));
+	}
+
+	for (int32 TeamIndex = 0; TeamIndex < NumTeams && !Ar.IsError(); TeamIndex++)
+	{
+		// Units are written in pre-order, so parents come before their sub units and pointers between units are written as indices.
+		TArray<UMilitaryUnit*> Units;
+		if (Ar.IsSaving() && TeamRootUnits[TeamIndex])
+		{
+			FlattenMilitaryUnits(TeamRootUnits[TeamIndex], Units);
+		}
+
+		int32 NumUnits = Units.Num();
+		Ar << NumUnits;
+		if (Ar.IsLoading())
+		{
+			Units.Reserve(NumUnits);
+			for (int32 UnitIndex = 0; UnitIndex < NumUnits; UnitIndex++)
+			{
+				Units.Add(NewObject<UMilitaryUnit>());
+			}
+		}
+
+		TMap<const UMilitaryUnit*, int32> UnitIndices;
+		for (int32 UnitIndex = 0; UnitIndex < Units.Num(); UnitIndex++)
+		{
+			UnitIndices.Add(Units[UnitIndex], UnitIndex);
+		}
+		auto SerializeUnitIndex = [&Ar, &Units, &UnitIndices](UMilitaryUnit*& Unit)
+		{
+			int32 UnitIndex = INDEX_NONE;
+			if (Ar.IsSaving() && Unit)
+			{
+				const int32* UnitIndexPtr = UnitIndices.Find(Unit);
+				UnitIndex = UnitIndexPtr ? *UnitIndexPtr : INDEX_NONE;
+			}
+			Ar << UnitIndex;
+			if (Ar.IsLoading())
+			{
+				Unit = Units.IsValidIndex(UnitIndex) ? Units[UnitIndex] : nullptr;
+			}
+		};
+
+		for (UMilitaryUnit* Unit : Units)
+		{
+			SerializeUnitIndex(Unit->Parent);
+			SerializeUnitIndex(Unit->Commander);
+			SerializeUnitIndex(Unit->SquadMilitaryUnit);
+			Ar << Unit->Name << Unit->Depth << Unit->bIsSoldier << Unit->bIsVehicle << Unit->bIsCommander << Unit->bIsPlayer;
+			Ar << Unit->SquadMemberIndex << Unit->SquadIndex;
+
+			FMassEntityHandle Entity = Ar.IsSaving() ? UnitToEntityMap.FindRef(Unit) : FMassEntityHandle();
+			EntityMap.SerializeEntity(Ar, Entity);
+			if (Ar.IsLoading())
+			{
+				if (Entity.IsSet())
+				{
+					BindUnitToMassEntity(Unit, Entity);
+				}
+				if (Unit->Parent)
+				{
+					Unit->Parent->SubUnits.Add(Unit);
+				}
+			}
+		}
+
+		if (Ar.IsLoading() && Units.Num() > 0 && TeamRootUnits.IsValidIndex(TeamIndex))
+		{
+			TeamRootUnits[TeamIndex] = Units[0];
+		}
+	}
+
+	// When the snapshot replaces spawning, the restored teams stand in for the spawners finishing their assignment.
+	if (Ar.IsLoading())
+	{
+		for (int32 TeamIndex = 0; TeamIndex < TeamRootUnits.Num(); TeamIndex++)
+		{
+			if (TeamRootUnits[TeamIndex] && (DidCompleteAssigningEntitiesToMilitaryUnitsTeamsMask & GetTeamMask(TeamIndex)) == 0)
+			{
+				DidCompleteAssigningEntitiesToMilitaryUnits(TeamIndex);
+			}
+		}
 	}
 }
 
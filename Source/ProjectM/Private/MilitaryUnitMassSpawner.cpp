@@ -8,16 +8,26 @@
 #include "MassEntityTraitBase.h"
 #include "MassEntityConfigAsset.h"
 #include "MassEnemyTargetFinderProcessor.h"
+#include "ProjectMCustomVersion.h"
 #include <Engine/AssetManager.h>
 #include <MassSimulationSubsystem.h>
 #include "VisualLogger/VisualLogger.h"
 #include "Engine/StreamableManager.h"
 #include "MassSpawnLocationProcessor.h"
 #include "MassOrderedSpawnLocationProcessor.h"
+#include "MassSpawnerSubsystem.h"
+#include "Async/ParallelFor.h"
+#include "Kismet/GameplayStatics.h"
+#include "MassWorldSnapshotSubsystem.h"
+#include "MassCommandReplaySubsystem.h"
 
 AMilitaryUnitMassSpawner::AMilitaryUnitMassSpawner()
 {
 	bAutoSpawnOnBeginPlay = false;
+
+	// Only ticks while spawning in stages.
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
 }
 
 void AMilitaryUnitMassSpawner::BeginPlay()
@@ -53,12 +63,45 @@ void AMilitaryUnitMassSpawner::BeginPlay()
 bool AMilitaryUnitMassSpawner_SpawnVehiclesOnly = false;
 FAutoConsoleVariableRef CVar_AMilitaryUnitMassSpawner_SpawnVehiclesOnly(TEXT("pm.AMilitaryUnitMassSpawner_SpawnVehiclesOnly"), AMilitaryUnitMassSpawner_SpawnVehiclesOnly, TEXT("AMilitaryUnitMassSpawner_SpawnVehiclesOnly"));
 
-bool AMilitaryUnitMassSpawner_SpawnTeam1SoldiersOnly = false;
-FAutoConsoleVariableRef CVar_AMilitaryUnitMassSpawner_SpawnTeam1SoldiersOnly(TEXT("pm.AMilitaryUnitMassSpawner_SpawnTeam1SoldiersOnly"), AMilitaryUnitMassSpawner_SpawnTeam1SoldiersOnly, TEXT("AMilitaryUnitMassSpawner_SpawnTeam1SoldiersOnly"));
+int32 AMilitaryUnitMassSpawner_SpawnBudgetPerFrame = 2048;
+FAutoConsoleVariableRef CVar_AMilitaryUnitMassSpawner_SpawnBudgetPerFrame(TEXT("pm.AMilitaryUnitMassSpawner_SpawnBudgetPerFrame"), AMilitaryUnitMassSpawner_SpawnBudgetPerFrame, TEXT("Soldiers spawned per frame by all spawners together, rounded to whole squads. 0 spawns everything at once."));
+
+float AMilitaryUnitMassSpawner_FrontLineDepth = 20000.f;
+FAutoConsoleVariableRef CVar_AMilitaryUnitMassSpawner_FrontLineDepth(TEXT("pm.AMilitaryUnitMassSpawner_FrontLineDepth"), AMilitaryUnitMassSpawner_FrontLineDepth, TEXT("Squads within this distance (cm) of the team's squad closest to an enemy spawner are spawned first."));
+
+float AMilitaryUnitMassSpawner_NearPlayerRadius = 10000.f;
+FAutoConsoleVariableRef CVar_AMilitaryUnitMassSpawner_NearPlayerRadius(TEXT("pm.AMilitaryUnitMassSpawner_NearPlayerRadius"), AMilitaryUnitMassSpawner_NearPlayerRadius, TEXT("Squads within this distance (cm) of the player are spawned after the front line and before the reserves."));
+
+int32 AMilitaryUnitMassSpawner_SpawnSoldiersOnlyTeamsMask = 0;
+FAutoConsoleVariableRef CVar_AMilitaryUnitMassSpawner_SpawnSoldiersOnlyTeamsMask(TEXT("pm.AMilitaryUnitMassSpawner_SpawnSoldiersOnlyTeamsMask"), AMilitaryUnitMassSpawner_SpawnSoldiersOnlyTeamsMask, TEXT("Bitmask of team indices that spawn soldiers only, e.g. 1 for the first team."));
+
+void AMilitaryUnitMassSpawner::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+
+	Ar.UsingCustomVersion(FProjectMCustomVersion::GUID);
+}
+
+void AMilitaryUnitMassSpawner::PostLoad()
+{
+	Super::PostLoad();
+
+	// Levels saved before N-team support only stored whether the spawner was for team 1 (defaulting to team 2).
+	if (GetLinkerCustomVersion(FProjectMCustomVersion::GUID) < FProjectMCustomVersion::TeamIndexReplacesTeam1Flag)
+	{
+		TeamIndex = bIsTeam1_DEPRECATED ? 0 : 1;
+	}
+}
 
 void AMilitaryUnitMassSpawner::DoMilitaryUnitSpawning()
 {
-	// TODO: Get team from EntityTypes (UMassEntityConfigAsset) once figure out linker issue with using FMassSpawnedEntityType::GetEntityConfig(). Then replace bIsTeam1 below.
+	// The snapshot holds this spawner's entities and military units.
+	if (UMassWorldSnapshotSubsystem::ShouldLoadSnapshotOnBeginPlay())
+	{
+		return;
+	}
+
+	// TODO: Get team from EntityTypes (UMassEntityConfigAsset) once figure out linker issue with using FMassSpawnedEntityType::GetEntityConfig(). Then replace TeamIndex below.
 	// https://forums.unrealengine.com/t/how-to-resolve-unresolved-external-symbol-fmassspawnedentitytype-getentityconfig-error/636923
 	// Error	LNK2019	unresolved external symbol "public: class UMassEntityConfigAsset * __cdecl FMassSpawnedEntityType::GetEntityConfig(void)" (? GetEntityConfig@FMassSpawnedEntityType@@QEAAPEAVUMassEntityConfigAsset@@XZ) referenced in function "protected: virtual void __cdecl AMilitaryUnitMassSpawner::BeginPlay(void)" (? BeginPlay@AMilitaryUnitMassSpawner@@MEAAXXZ)
 
@@ -69,7 +112,7 @@ void AMilitaryUnitMassSpawner::DoMilitaryUnitSpawning()
 	//{
 	//	if (UMassTeamMemberTrait* TeamMemberTrait = Cast<UMassTeamMemberTrait>(Trait))
 	//	{
-	//		bIsTeam1 = TeamMemberTrait->IsOnTeam1;
+	//		TeamIndex = TeamMemberTrait->TeamIndex;
 	//		bFoundTeamMemberTrait = true;
 	//		break;
 	//	}
@@ -83,7 +126,7 @@ void AMilitaryUnitMassSpawner::DoMilitaryUnitSpawning()
 	MilitaryStructureSubsystem = UWorld::GetSubsystem<UMilitaryStructureSubsystem>(GetWorld());
 	check(MilitaryStructureSubsystem);
 
-	UnitCounts = MilitaryStructureSubsystem->CreateMilitaryUnit(MilitaryUnitIndex, bIsTeam1);
+	UnitCounts = MilitaryStructureSubsystem->CreateMilitaryUnit(MilitaryUnitIndex, TeamIndex);
 
 	// No spawn point generators configured. Let user know and fall back to the spawner's location.
 	if (SpawnDataGenerators.Num() == 0)
@@ -117,7 +160,7 @@ void AMilitaryUnitMassSpawner::DoMilitaryUnitSpawning()
 		}
 	}
 
-	bDidSpawnSoldiersOnly = AMilitaryUnitMassSpawner_SpawnSoldiersOnly || (bIsTeam1 && AMilitaryUnitMassSpawner_SpawnTeam1SoldiersOnly);
+	bDidSpawnSoldiersOnly = AMilitaryUnitMassSpawner_SpawnSoldiersOnly || (AMilitaryUnitMassSpawner_SpawnSoldiersOnlyTeamsMask & GetTeamMask(TeamIndex)) != 0;
 	bDidSpawnVehiclesOnly = bSpawnVehiclesOnly || AMilitaryUnitMassSpawner_SpawnVehiclesOnly;
 
 	auto GenerateSpawningPoints = [this, &UnitCounts = UnitCounts]()
@@ -128,6 +171,11 @@ void AMilitaryUnitMassSpawner::DoMilitaryUnitSpawning()
 			return;
 		}
 
+		if (const UMassCommandReplaySubsystem* CommandReplaySubsystem = UWorld::GetSubsystem<UMassCommandReplaySubsystem>(GetWorld()))
+		{
+			CommandReplaySubsystem->SeedRandomForSpawning();
+		}
+
 		uint8 Index = 0;
 		for (FMassSpawnDataGenerator& Generator : SpawnDataGenerators)
 		{
@@ -157,17 +205,33 @@ void AMilitaryUnitMassSpawner::DoMilitaryUnitSpawning()
 	}
 }
 
-TArray<FVector> GetRelativePointsForSquad(const FVector& SquadOrigin)
+// Writes the transforms of every squad member in squad order, GNumSoldiersInSquad per squad. Squads are independent so they are expanded in
+// parallel, straight into the spawn data.
+static void ExpandSquadSpawnTransforms(TConstArrayView<FTransform> SquadTransforms, TArrayView<FTransform> OutSquadMemberTransforms)
 {
-	TArray<FVector> Result;
+	TRACE_CPUPROFILER_EVENT_SCOPE(AMilitaryUnitMassSpawner.ExpandSquadSpawnTransforms);
+	check(OutSquadMemberTransforms.Num() == SquadTransforms.Num() * GNumSoldiersInSquad);
 
-	for (int i = 0; i < GNumSoldiersInSquad; i++)
+	FVector SquadMemberOffsets[GNumSoldiersInSquad];
+	for (int32 SquadMemberIndex = 0; SquadMemberIndex < GNumSoldiersInSquad; SquadMemberIndex++)
 	{
-		const FVector2D Offset(GSquadMemberOffsetsMeters[i] * 100.f * GSquadSpacingScalingFactor);
-		Result.Add(SquadOrigin + FVector(Offset, 0.f));
+		SquadMemberOffsets[SquadMemberIndex] = FVector(GSquadMemberOffsetsMeters[SquadMemberIndex] * 100.f * GSquadSpacingScalingFactor, 0.f);
 	}
 
-	return Result;
+	static constexpr int32 MinSquadsPerBatch = 64;
+	const int32 NumBatches = FMath::DivideAndRoundUp(SquadTransforms.Num(), MinSquadsPerBatch);
+	ParallelFor(NumBatches, [&SquadTransforms, &OutSquadMemberTransforms, &SquadMemberOffsets](const int32 BatchIndex)
+	{
+		const int32 EndSquadIndex = FMath::Min((BatchIndex + 1) * MinSquadsPerBatch, SquadTransforms.Num());
+		for (int32 SquadIndex = BatchIndex * MinSquadsPerBatch; SquadIndex < EndSquadIndex; SquadIndex++)
+		{
+			const FVector SquadOrigin = SquadTransforms[SquadIndex].GetLocation();
+			for (int32 SquadMemberIndex = 0; SquadMemberIndex < GNumSoldiersInSquad; SquadMemberIndex++)
+			{
+				OutSquadMemberTransforms[SquadIndex * GNumSoldiersInSquad + SquadMemberIndex] = FTransform(SquadOrigin + SquadMemberOffsets[SquadMemberIndex]);
+			}
+		}
+	});
 }
 
 void AMilitaryUnitMassSpawner::OnMilitaryUnitSpawnDataGenerationFinished(TConstArrayView<FMassEntitySpawnDataGeneratorResult> ConstResults, FMassSpawnDataGenerator* FinishedGenerator)
@@ -194,31 +258,24 @@ void AMilitaryUnitMassSpawner::OnMilitaryUnitSpawnDataGenerationFinished(TConstA
 		SquadResult.SpawnData.InitializeAs<FMassTransformsSpawnData>();
 		FMassTransformsSpawnData& Transforms = SquadResult.SpawnData.GetMutable<FMassTransformsSpawnData>();
 
-		Transforms.Transforms.Reserve(SquadResult.NumEntities);
-		for (int SquadIndex = 0; SquadIndex < UnitCounts.SquadCount; SquadIndex++)
-		{
-			const TArray<FVector>& SquadMemberSpawnLocations = GetRelativePointsForSquad(ResultTransforms[SquadIndex].GetLocation());
-			for (const FVector& SquadMemberSpawnLocation : SquadMemberSpawnLocations)
-			{
-				FTransform& Transform = Transforms.Transforms.AddDefaulted_GetRef();
-				Transform.SetLocation(SquadMemberSpawnLocation);
-			}
-		}
-		int32 NumHigherCommandSoldiers = UnitCounts.SoldierCount - GNumSoldiersInSquad * UnitCounts.SquadCount;
+		const int32 NumSquadMembers = GNumSoldiersInSquad * UnitCounts.SquadCount;
+		const int32 NumHigherCommandSoldiers = UnitCounts.SoldierCount - NumSquadMembers;
+		// The views below and the higher command loop skip bounds checks, the generator must have made a transform per squad and higher command soldier.
+		check(ResultTransforms.Num() >= UnitCounts.SquadCount + NumHigherCommandSoldiers);
+		Transforms.Transforms.SetNumUninitialized(SquadResult.NumEntities);
+		ExpandSquadSpawnTransforms(MakeArrayView(ResultTransforms.GetData(), UnitCounts.SquadCount), MakeArrayView(Transforms.Transforms.GetData(), NumSquadMembers));
+
 		for (int CommandIndex = 0; CommandIndex < NumHigherCommandSoldiers; CommandIndex++)
 		{
-			FTransform& Transform = Transforms.Transforms.AddDefaulted_GetRef();
-			Transform = ResultTransforms[CommandIndex + UnitCounts.SquadCount];
+			Transforms.Transforms[NumSquadMembers + CommandIndex] = ResultTransforms[CommandIndex + UnitCounts.SquadCount];
 		}
 
-		ResultArray.Add(SquadResult);
+		ResultArray.Add(MoveTemp(SquadResult));
 	}
-	TConstArrayView<FMassEntitySpawnDataGeneratorResult> Results(ResultArray);
-
-	// Rest is copied from AMassSpawner::OnSpawnDataGenerationFinished.
 
-	// @todo: this can be potentially expensive copy for the instanced structs, could there be a way to use move gere instead?
-	AllGeneratedResults.Append(Results.GetData(), Results.Num());
+	// Rest is copied from AMassSpawner::OnSpawnDataGenerationFinished, except the results are moved rather than copied, they hold every
+	// soldier's transform.
+	AllGeneratedResults.Append(MoveTemp(ResultArray));
 
 	bool bAllSpawnPointsGenerated = true;
 	bool bFoundFinishedGenerator = false;
@@ -237,7 +294,21 @@ void AMilitaryUnitMassSpawner::OnMilitaryUnitSpawnDataGenerationFinished(TConstA
 
 	if (bAllSpawnPointsGenerated)
 	{
-		SpawnGeneratedEntities(AllGeneratedResults);
+		// Generators may finish frames later, e.g. EQS, so spawning gets its own seed too.
+		if (const UMassCommandReplaySubsystem* CommandReplaySubsystem = UWorld::GetSubsystem<UMassCommandReplaySubsystem>(GetWorld()))
+		{
+			CommandReplaySubsystem->SeedRandomForSpawning();
+		}
+
+		const bool bHasSoldierResult = AllGeneratedResults.ContainsByPredicate([](const FMassEntitySpawnDataGeneratorResult& Result) { return Result.EntityConfigIndex == 0; });
+		if (AMilitaryUnitMassSpawner_SpawnBudgetPerFrame > 0 && bHasSoldierResult)
+		{
+			BeginStagedSpawning(AllGeneratedResults);
+		}
+		else
+		{
+			SpawnGeneratedEntities(AllGeneratedResults);
+		}
 		AllGeneratedResults.Reset();
 	}
 }
@@ -275,6 +346,12 @@ void GatherSquadsAndHigherCommand(UMilitaryUnit* MilitaryUnit, TArray<UMilitaryU
 
 void AMilitaryUnitMassSpawner::BeginAssignEntitiesToMilitaryUnits()
 {
+	// Staged spawning binds soldiers as they spawn and only broadcasts OnSpawningFinishedEvent once it's done.
+	if (bIsStagedSpawning)
+	{
+		return;
+	}
+
 	// TODO: This is a bit hacky, refactor.
 	if (const UMassEntityConfigAsset* SoldierEntityConfig = EntityTypes[0].EntityConfig.LoadSynchronous())
 	{
@@ -296,10 +373,13 @@ void AMilitaryUnitMassSpawner::BeginAssignEntitiesToMilitaryUnits()
 
 	TArray<UMilitaryUnit*> Squads;
 	TArray<UMilitaryUnit*> HigherCommandSoldiers;
-	GatherSquadsAndHigherCommand(MilitaryStructureSubsystem->GetRootUnitForTeam(bIsTeam1), Squads, HigherCommandSoldiers);
+	Squads.Reserve(UnitCounts.SquadCount);
+	HigherCommandSoldiers.Reserve(UnitCounts.SoldierCount - UnitCounts.SquadCount * GNumSoldiersInSquad);
+	GatherSquadsAndHigherCommand(MilitaryStructureSubsystem->GetRootUnitForTeam(TeamIndex), Squads, HigherCommandSoldiers);
+	MilitaryStructureSubsystem->ReserveUnitBindings(UnitCounts.SoldierCount);
 	AssignEntitiesToMilitaryUnits(Squads, HigherCommandSoldiers);
 
-	MilitaryStructureSubsystem->DidCompleteAssigningEntitiesToMilitaryUnits(bIsTeam1);
+	MilitaryStructureSubsystem->DidCompleteAssigningEntitiesToMilitaryUnits(TeamIndex);
 }
 
 void AMilitaryUnitMassSpawner::SafeBindSoldier(UMilitaryUnit* SoldierMilitaryUnit, const TArray<FMassEntityHandle>& SpawnedEntities, int32& EntityIndex)
@@ -322,7 +402,7 @@ void AMilitaryUnitMassSpawner::AssignEntitiesToMilitaryUnits(TArray<UMilitaryUni
 		UMilitaryUnit* Squad = Squads[SquadIndex];
 		Squad->SquadIndex = SquadIndex;
 		int32 SquadMemberIndex = 0;
-		AssignEntitiesToSquad(SoldierIndex, Squad, Squad, SquadMemberIndex);
+		AssignEntitiesToSquad(SoldierIndex, Squad, Squad, SquadMemberIndex, AllSpawnedEntities[AllSpawnedEntitiesSoldierIndex].Entities);
 	}
 
 	for (UMilitaryUnit* Soldier : HigherCommandSoldiers)
@@ -331,11 +411,11 @@ void AMilitaryUnitMassSpawner::AssignEntitiesToMilitaryUnits(TArray<UMilitaryUni
 	}
 }
 
-void AMilitaryUnitMassSpawner::AssignEntitiesToSquad(int32& SoldierIndex, UMilitaryUnit* MilitaryUnit, UMilitaryUnit* SquadMilitaryUnit, int32& SquadMemberIndex)
+void AMilitaryUnitMassSpawner::AssignEntitiesToSquad(int32& SoldierIndex, UMilitaryUnit* MilitaryUnit, UMilitaryUnit* SquadMilitaryUnit, int32& SquadMemberIndex, const TArray<FMassEntityHandle>& SpawnedEntities)
 {
 	if (MilitaryUnit->bIsSoldier)
 	{
-		SafeBindSoldier(MilitaryUnit, AllSpawnedEntities[AllSpawnedEntitiesSoldierIndex].Entities, SoldierIndex);
+		SafeBindSoldier(MilitaryUnit, SpawnedEntities, SoldierIndex);
 		MilitaryUnit->SquadMemberIndex = SquadMemberIndex++;
 		MilitaryUnit->SquadMilitaryUnit = SquadMilitaryUnit;
 		MilitaryUnit->SquadIndex = SquadMilitaryUnit->SquadIndex;
@@ -344,7 +424,281 @@ void AMilitaryUnitMassSpawner::AssignEntitiesToSquad(int32& SoldierIndex, UMilit
 	{
 		for (UMilitaryUnit* SubUnit : MilitaryUnit->SubUnits)
 		{
- 			AssignEntitiesToSquad(SoldierIndex, SubUnit, SquadMilitaryUnit, SquadMemberIndex);
+ 			AssignEntitiesToSquad(SoldierIndex, SubUnit, SquadMilitaryUnit, SquadMemberIndex, SpawnedEntities);
+		}
+	}
+}
+
+void AMilitaryUnitMassSpawner::ResetSpawnedEntities()
+{
+	AllSpawnedEntities.Reset();
+}
+
+void AMilitaryUnitMassSpawner::ForEachSpawnedEntity(TFunctionRef<void(const FMassEntityHandle Entity, const int32 EntityTypeIndex)> Function)
+{
+	TArray<FMassEntityTemplateID> EntityTypeTemplateIDs;
+	for (const FMassSpawnedEntityType& EntityType : EntityTypes)
+	{
+		const UMassEntityConfigAsset* EntityConfig = EntityType.EntityConfig.LoadSynchronous();
+		const FMassEntityTemplate* EntityTemplate = EntityConfig ? EntityConfig->GetConfig().GetOrCreateEntityTemplate(*this, *EntityConfig) : nullptr;
+		EntityTypeTemplateIDs.Add(EntityTemplate ? EntityTemplate->GetTemplateID() : FMassEntityTemplateID());
+	}
+
+	for (const FSpawnedEntities& SpawnedEntities : AllSpawnedEntities)
+	{
+		const int32 EntityTypeIndex = EntityTypeTemplateIDs.IndexOfByKey(SpawnedEntities.TemplateID);
+		if (EntityTypeIndex == INDEX_NONE)
+		{
+			continue;
+		}
+
+		for (const FMassEntityHandle& Entity : SpawnedEntities.Entities)
+		{
+			Function(Entity, EntityTypeIndex);
 		}
 	}
 }
+
+void AMilitaryUnitMassSpawner::SpawnEntitiesFromSnapshot(const int32 EntityTypeIndex, const TArray<FTransform>& Transforms, TArray<FMassEntityHandle>& OutEntities)
+{
+	if (!EntityTypes.IsValidIndex(EntityTypeIndex) || Transforms.Num() == 0)
+	{
+		return;
+	}
+
+	const UMassEntityConfigAsset* EntityConfig = EntityTypes[EntityTypeIndex].EntityConfig.LoadSynchronous();
+	UMassSpawnerSubsystem* SpawnerSubsystem = UWorld::GetSubsystem<UMassSpawnerSubsystem>(GetWorld());
+	if (!EntityConfig || !SpawnerSubsystem)
+	{
+		UE_VLOG_UELOG(this, LogTemp, Error, TEXT("AMilitaryUnitMassSpawner: Could not load entity config %d to spawn snapshot entities."), EntityTypeIndex);
+		return;
+	}
+
+	const FMassEntityTemplate* EntityTemplate = EntityConfig->GetConfig().GetOrCreateEntityTemplate(*this, *EntityConfig);
+	check(EntityTemplate && EntityTemplate->IsValid());
+
+	FMassEntitySpawnDataGeneratorResult Result;
+	Result.SpawnDataProcessor = UMassOrderedSpawnLocationProcessor::StaticClass();
+	Result.SpawnData.InitializeAs<FMassTransformsSpawnData>();
+	Result.NumEntities = Transforms.Num();
+	Result.SpawnData.GetMutable<FMassTransformsSpawnData>().Transforms = Transforms;
+
+	SpawnerSubsystem->SpawnEntities(EntityTemplate->GetTemplateID(), Result.NumEntities, Result.SpawnData, Result.SpawnDataProcessor, OutEntities);
+
+	FSpawnedEntities& SpawnedEntities = AllSpawnedEntities.AddDefaulted_GetRef();
+	SpawnedEntities.TemplateID = EntityTemplate->GetTemplateID();
+	SpawnedEntities.Entities.Append(OutEntities);
+}
+
+void AMilitaryUnitMassSpawner::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (bIsStagedSpawning)
+	{
+		SpawnNextStage();
+	}
+}
+
+TArray<int32> AMilitaryUnitMassSpawner::GetStagedSquadSpawnOrder(const int32 NumSquads) const
+{
+	TArray<FVector> EnemySpawnerLocations;
+	TArray<AActor*> MilitaryUnitMassSpawners;
+	UGameplayStatics::GetAllActorsOfClass(this, AMilitaryUnitMassSpawner::StaticClass(), MilitaryUnitMassSpawners);
+	for (const AActor* Actor : MilitaryUnitMassSpawners)
+	{
+		if (CastChecked<AMilitaryUnitMassSpawner>(Actor)->TeamIndex != TeamIndex)
+		{
+			EnemySpawnerLocations.Add(Actor->GetActorLocation());
+		}
+	}
+
+	const APawn* PlayerPawn = UGameplayStatics::GetPlayerPawn(this, 0);
+
+	// Squad leaders have no offset, so they stand at the squad's origin.
+	TArray<float> EnemyDistances;
+	EnemyDistances.SetNumUninitialized(NumSquads);
+	float MinEnemyDistance = MAX_flt;
+	for (int32 SquadIndex = 0; SquadIndex < NumSquads; SquadIndex++)
+	{
+		const FVector SquadOrigin = StagedSoldierTransforms[SquadIndex * GNumSoldiersInSquad].GetLocation();
+		float EnemyDistanceSquared = EnemySpawnerLocations.Num() > 0 ? MAX_flt : 0.f;
+		for (const FVector& EnemySpawnerLocation : EnemySpawnerLocations)
+		{
+			EnemyDistanceSquared = FMath::Min(EnemyDistanceSquared, FVector::DistSquared(SquadOrigin, EnemySpawnerLocation));
+		}
+		EnemyDistances[SquadIndex] = FMath::Sqrt(EnemyDistanceSquared);
+		MinEnemyDistance = FMath::Min(MinEnemyDistance, EnemyDistances[SquadIndex]);
+	}
+
+	// Front line, then near the player, then reserves, each closest to the enemy first.
+	TArray<uint8> Tiers;
+	Tiers.SetNumUninitialized(NumSquads);
+	for (int32 SquadIndex = 0; SquadIndex < NumSquads; SquadIndex++)
+	{
+		const FVector SquadOrigin = StagedSoldierTransforms[SquadIndex * GNumSoldiersInSquad].GetLocation();
+		if (EnemySpawnerLocations.Num() > 0 && EnemyDistances[SquadIndex] <= MinEnemyDistance + AMilitaryUnitMassSpawner_FrontLineDepth)
+		{
+			Tiers[SquadIndex] = 0;
+		}
+		else if (PlayerPawn && FVector::Dist(SquadOrigin, PlayerPawn->GetActorLocation()) <= AMilitaryUnitMassSpawner_NearPlayerRadius)
+		{
+			Tiers[SquadIndex] = 1;
+		}
+		else
+		{
+			Tiers[SquadIndex] = 2;
+		}
+	}
+
+	TArray<int32> SquadOrder;
+	SquadOrder.SetNumUninitialized(NumSquads);
+	for (int32 SquadIndex = 0; SquadIndex < NumSquads; SquadIndex++)
+	{
+		SquadOrder[SquadIndex] = SquadIndex;
+	}
+	SquadOrder.StableSort([&Tiers, &EnemyDistances](const int32 A, const int32 B)
+	{
+		return Tiers[A] != Tiers[B] ? Tiers[A] < Tiers[B] : EnemyDistances[A] < EnemyDistances[B];
+	});
+	return SquadOrder;
+}
+
+void AMilitaryUnitMassSpawner::BeginStagedSpawning(TArray<FMassEntitySpawnDataGeneratorResult>& Results)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(AMilitaryUnitMassSpawner.BeginStagedSpawning);
+
+	StagedSquads.Reset();
+	StagedHigherCommandSoldiers.Reset();
+	GatherSquadsAndHigherCommand(MilitaryStructureSubsystem->GetRootUnitForTeam(TeamIndex), StagedSquads, StagedHigherCommandSoldiers);
+
+	// Staging binds soldiers by their position in the spawn data, so it needs a transform per soldier. Otherwise spawn everything at once and
+	// let BeginAssignEntitiesToMilitaryUnits bind what it can.
+	const FMassEntitySpawnDataGeneratorResult* SoldierResult = Results.FindByPredicate([](const FMassEntitySpawnDataGeneratorResult& Result) { return Result.EntityConfigIndex == 0; });
+	check(SoldierResult);
+	const int32 NumSoldierTransforms = SoldierResult->SpawnData.Get<FMassTransformsSpawnData>().Transforms.Num();
+	if (!ensureMsgf(NumSoldierTransforms == StagedSquads.Num() * GNumSoldiersInSquad + StagedHigherCommandSoldiers.Num(), TEXT("AMilitaryUnitMassSpawner: %d soldier transforms for %d squads and %d higher command soldiers."), NumSoldierTransforms, StagedSquads.Num(), StagedHigherCommandSoldiers.Num()))
+	{
+		StagedSquads.Reset();
+		StagedHigherCommandSoldiers.Reset();
+		SpawnGeneratedEntities(Results);
+		return;
+	}
+
+	UMassSpawnerSubsystem* SpawnerSubsystem = UWorld::GetSubsystem<UMassSpawnerSubsystem>(GetWorld());
+	check(SpawnerSubsystem);
+
+	// Soldiers are staged, anything else is spawned right away like SpawnGeneratedEntities would.
+	for (FMassEntitySpawnDataGeneratorResult& Result : Results)
+	{
+		const UMassEntityConfigAsset* EntityConfig = EntityTypes[Result.EntityConfigIndex].EntityConfig.LoadSynchronous();
+		check(EntityConfig);
+		const FMassEntityTemplate* EntityTemplate = EntityConfig->GetConfig().GetOrCreateEntityTemplate(*this, *EntityConfig);
+		check(EntityTemplate && EntityTemplate->IsValid());
+
+		const int32 SpawnedEntitiesIndex = AllSpawnedEntities.AddDefaulted();
+		AllSpawnedEntities[SpawnedEntitiesIndex].TemplateID = EntityTemplate->GetTemplateID();
+		if (Result.EntityConfigIndex == 0)
+		{
+			AllSpawnedEntitiesSoldierIndex = SpawnedEntitiesIndex;
+			StagedSoldierTemplateID = EntityTemplate->GetTemplateID();
+			StagedSoldierTransforms = MoveTemp(Result.SpawnData.GetMutable<FMassTransformsSpawnData>().Transforms);
+		}
+		else
+		{
+			AllSpawnedEntitiesVehicleIndex = SpawnedEntitiesIndex;
+			SpawnerSubsystem->SpawnEntities(EntityTemplate->GetTemplateID(), Result.NumEntities, Result.SpawnData, Result.SpawnDataProcessor, AllSpawnedEntities[SpawnedEntitiesIndex].Entities);
+		}
+	}
+
+	MilitaryStructureSubsystem->ReserveUnitBindings(StagedSoldierTransforms.Num());
+
+	StagedSquadOrder = GetStagedSquadSpawnOrder(StagedSquads.Num());
+	NextStagedSquadOrderIndex = 0;
+	bIsStagedSpawning = true;
+	SetActorTickEnabled(true);
+
+	SpawnNextStage();
+}
+
+void AMilitaryUnitMassSpawner::SpawnNextStage()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(AMilitaryUnitMassSpawner.SpawnNextStage);
+
+	// Whole squads only, so every squad's members exist by the time it gets a move to command. The budget is shared with the other spawners,
+	// the first spawner to tick in a frame always gets at least a squad.
+	const int32 Budget = MilitaryStructureSubsystem->GetRemainingSpawnBudget(FMath::Max(AMilitaryUnitMassSpawner_SpawnBudgetPerFrame, GNumSoldiersInSquad));
+	TArray<int32> StageSquadIndices;
+	TArray<FTransform> StageTransforms;
+	while (StagedSquadOrder.IsValidIndex(NextStagedSquadOrderIndex) && StageTransforms.Num() + GNumSoldiersInSquad <= Budget)
+	{
+		const int32 SquadIndex = StagedSquadOrder[NextStagedSquadOrderIndex++];
+		StageSquadIndices.Add(SquadIndex);
+		StageTransforms.Append(StagedSoldierTransforms.GetData() + SquadIndex * GNumSoldiersInSquad, GNumSoldiersInSquad);
+	}
+
+	// Other spawners used up this frame's budget.
+	if (StageSquadIndices.Num() == 0 && StagedSquadOrder.IsValidIndex(NextStagedSquadOrderIndex))
+	{
+		return;
+	}
+
+	// Higher command is spawned last, in one stage since there are few of them.
+	const bool bIsLastStage = StageSquadIndices.Num() == 0;
+	if (bIsLastStage)
+	{
+		const int32 FirstHigherCommandIndex = StagedSquads.Num() * GNumSoldiersInSquad;
+		StageTransforms.Append(StagedSoldierTransforms.GetData() + FirstHigherCommandIndex, StagedSoldierTransforms.Num() - FirstHigherCommandIndex);
+	}
+
+	TArray<FMassEntityHandle> StageEntities;
+	if (StageTransforms.Num() > 0)
+	{
+		FInstancedStruct SpawnData;
+		SpawnData.InitializeAs<FMassTransformsSpawnData>();
+		SpawnData.GetMutable<FMassTransformsSpawnData>().Transforms = StageTransforms;
+
+		UMassSpawnerSubsystem* SpawnerSubsystem = UWorld::GetSubsystem<UMassSpawnerSubsystem>(GetWorld());
+		check(SpawnerSubsystem);
+		SpawnerSubsystem->SpawnEntities(StagedSoldierTemplateID, StageTransforms.Num(), SpawnData, UMassOrderedSpawnLocationProcessor::StaticClass(), StageEntities);
+		MilitaryStructureSubsystem->ConsumeSpawnBudget(StageTransforms.Num());
+	}
+
+	int32 EntityIndex = 0;
+	for (const int32 SquadIndex : StageSquadIndices)
+	{
+		UMilitaryUnit* Squad = StagedSquads[SquadIndex];
+		Squad->SquadIndex = SquadIndex;
+		int32 SquadMemberIndex = 0;
+		AssignEntitiesToSquad(EntityIndex, Squad, Squad, SquadMemberIndex, StageEntities);
+	}
+	if (bIsLastStage)
+	{
+		for (UMilitaryUnit* Soldier : StagedHigherCommandSoldiers)
+		{
+			SafeBindSoldier(Soldier, StageEntities, EntityIndex);
+		}
+	}
+	AllSpawnedEntities[AllSpawnedEntitiesSoldierIndex].Entities.Append(StageEntities);
+
+	if (bIsLastStage)
+	{
+		FinishStagedSpawning();
+	}
+}
+
+void AMilitaryUnitMassSpawner::FinishStagedSpawning()
+{
+	SetActorTickEnabled(false);
+
+	StagedSoldierTransforms.Empty();
+	StagedSquadOrder.Empty();
+	StagedSquads.Empty();
+	StagedHigherCommandSoldiers.Empty();
+
+	MilitaryStructureSubsystem->DidCompleteAssigningEntitiesToMilitaryUnits(TeamIndex);
+
+	// Same as the unstaged path, where SpawnGeneratedEntities broadcasts. Still staging so that BeginAssignEntitiesToMilitaryUnits skips it.
+	OnSpawningFinishedEvent.Broadcast();
+	bIsStagedSpawning = false;
+}
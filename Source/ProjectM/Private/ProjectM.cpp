@@ -1,6 +1,11 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "ProjectM.h"
+#include "ProjectMCustomVersion.h"
+#include "MassDebugDrawRecorder.h"
+#include "ProjectMStats.h"
+#include "Misc/CoreDelegates.h"
+#include "Serialization/CustomVersion.h"
 
 #define LOCTEXT_NAMESPACE "FProjectMModule"
 
@@ -9,6 +14,17 @@
 #include "GameplayDebuggerCategory_ProjectM.h"
 #endif // WITH_GAMEPLAY_DEBUGGER
 
+const FGuid FProjectMCustomVersion::GUID(0x5C1F2A7E, 0x4B8D4E21, 0x9A3F6D10, 0xE7B24C95);
+
+// Register the custom version with core
+FCustomVersionRegistration GRegisterProjectMCustomVersion(FProjectMCustomVersion::GUID, FProjectMCustomVersion::LatestVersion, TEXT("ProjectMVer"));
+
+static void OnProjectMEndFrame()
+{
+	UE::ProjectM::Stats::EndFrame();
+	UE::ProjectM::DebugDraw::EndFrame();
+}
+
 void FProjectMModule::StartupModule()
 {
 #if WITH_GAMEPLAY_DEBUGGER
@@ -16,12 +32,15 @@ void FProjectMModule::StartupModule()
   GameplayDebuggerModule.RegisterCategory("ProjectM", IGameplayDebugger::FOnGetCategory::CreateStatic(&FGameplayDebuggerCategory_ProjectM::MakeInstance), EGameplayDebuggerCategoryState::EnabledInGameAndSimulate, 1);
   GameplayDebuggerModule.NotifyCategoriesChanged();
 #endif
+
+	OnEndFrameHandle = FCoreDelegates::OnEndFrame.AddStatic(&OnProjectMEndFrame);
 }
 
 void FProjectMModule::ShutdownModule()
 {
 	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
 	// we call this function before unloading the module.
+	FCoreDelegates::OnEndFrame.Remove(OnEndFrameHandle);
 }
 
 #undef LOCTEXT_NAMESPACE
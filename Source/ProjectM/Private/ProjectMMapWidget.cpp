@@ -31,10 +31,19 @@ static const float GTankButtonSize = 20.f;
 static const FLinearColor GSelectedUnitColor = FLinearColor(0.f, 1.f, 0.f);
 static const FLinearColor GPlayerSoldierColor = FLinearColor(1.f, 1.f, 0.f);
 static const FLinearColor GTeamColors[] = {
-  FLinearColor(0.f, 0.f, 1.f),
   FLinearColor(1.f, 0.f, 0.f),
+  FLinearColor(0.f, 0.f, 1.f),
+  FLinearColor(1.f, 0.f, 1.f),
+  FLinearColor(0.f, 1.f, 1.f),
+  FLinearColor(1.f, 0.5f, 0.f),
+  FLinearColor(0.5f, 0.f, 1.f),
 };
 
+static const FLinearColor& GetTeamColor(const uint8& TeamIndex)
+{
+  return GTeamColors[TeamIndex % UE_ARRAY_COUNT(GTeamColors)];
+}
+
 //----------------------------------------------------------------------//
 //  UProjectMMapWidget
 //----------------------------------------------------------------------//
@@ -63,17 +72,19 @@ void UProjectMMapWidget::UpdateSoldierCountLabels()
 {
   if (TextBlock_Team1Count)
   {
-    TextBlock_Team1Count->SetText(FText::Format(LOCTEXT("TODO", "Team 1: {0}"), CachedTeam1AliveSoldierCount));
+    TextBlock_Team1Count->SetText(FText::Format(LOCTEXT("TODO", "Team 1: {0}"), CachedTeamAliveSoldierCounts[0]));
   }
   if (TextBlock_Team2Count)
   {
-    TextBlock_Team2Count->SetText(FText::Format(LOCTEXT("TODO", "Team 2: {0}"), CachedTeam2AliveSoldierCount));
+    TextBlock_Team2Count->SetText(FText::Format(LOCTEXT("TODO", "Team 2: {0}"), CachedTeamAliveSoldierCounts[1]));
   }
 }
 
 void UProjectMMapWidget::CreateMapButtons()
 {
-  ForEachMapDisplayableEntity([this](const FVector& EntityLocation, const bool& bIsOnTeam1, const bool& bIsPlayer, const FMassEntityHandle& Entity)
+  CachedTeamAliveSoldierCounts.Init(0, GMaxTeams);
+
+  ForEachMapDisplayableEntity([this](const FVector& EntityLocation, const uint8& TeamIndex, const bool& bIsPlayer, const FMassEntityHandle& Entity)
   {
     UMilitaryUnit* Unit = MilitaryStructureSubsystem->GetUnitForEntity(Entity);
 
@@ -83,10 +94,9 @@ void UProjectMMapWidget::CreateMapButtons()
       return;
     }
 
-    FLinearColor Color = GTeamColors[bIsOnTeam1];
-    (bIsOnTeam1 ? CachedTeam1AliveSoldierCount : CachedTeam2AliveSoldierCount)++;
+    CachedTeamAliveSoldierCounts[TeamIndex]++;
     UButton* Button = CreateButton(Unit->bIsSoldier);
-    UpdateButton(Button, WorldPositionToMapPosition(EntityLocation), Unit, bIsOnTeam1, bIsPlayer);
+    UpdateButton(Button, WorldPositionToMapPosition(EntityLocation), Unit, TeamIndex, bIsPlayer);
     ButtonToMilitaryUnitMap.Add(Button, Unit);
     MilitaryUnitToButtonMap.Add(Unit, Button);
   });
@@ -113,7 +123,7 @@ void UProjectMMapWidget::ForEachMapDisplayableEntity(const FMapDisplayableEntity
     for (int32 EntityIndex = 0; EntityIndex < NumEntities; ++EntityIndex)
     {
       const bool& bIsPlayer = Context.DoesArchetypeHaveTag<FMassPlayerControllableCharacterTag>();
-      EntityExecuteFunction(TransformList[EntityIndex].GetTransform().GetLocation(), TeamMemberList[EntityIndex].IsOnTeam1, bIsPlayer, Context.GetEntity(EntityIndex));
+      EntityExecuteFunction(TransformList[EntityIndex].GetTransform().GetLocation(), TeamMemberList[EntityIndex].TeamIndex, bIsPlayer, Context.GetEntity(EntityIndex));
     }
   });
 }
@@ -147,9 +157,9 @@ UButton* UProjectMMapWidget::CreateButton(const bool& bIsSolder)
   return Button;
 }
 
-void UProjectMMapWidget::UpdateButton(UButton* Button, const FVector2D& Position, UMilitaryUnit* Unit, const bool& bIsOnTeam1, const bool& bIsPlayer)
+void UProjectMMapWidget::UpdateButton(UButton* Button, const FVector2D& Position, UMilitaryUnit* Unit, const uint8& TeamIndex, const bool& bIsPlayer)
 {
-  Button->WidgetStyle.Normal.TintColor = bIsPlayer ? GPlayerSoldierColor : (Unit->IsChildOfUnit(SelectedUnit) ? GSelectedUnitColor : GTeamColors[bIsOnTeam1]);
+  Button->WidgetStyle.Normal.TintColor = bIsPlayer ? GPlayerSoldierColor : (Unit->IsChildOfUnit(SelectedUnit) ? GSelectedUnitColor : GetTeamColor(TeamIndex));
 
   UCanvasPanelSlot* CanvasPanelSlot = CastChecked<UCanvasPanelSlot>(Button->Slot.Get());
   CanvasPanelSlot->SetPosition(Position);
@@ -157,12 +167,12 @@ void UProjectMMapWidget::UpdateButton(UButton* Button, const FVector2D& Position
 
 void UProjectMMapWidget::UpdateMapButtons()
 {
-  CachedTeam1AliveSoldierCount = CachedTeam2AliveSoldierCount = 0;
+  CachedTeamAliveSoldierCounts.Init(0, GMaxTeams);
 
   TSet<UButton*> UpdatedButtons;
-  ForEachMapDisplayableEntity([this, &UpdatedButtons](const FVector& EntityLocation, const bool& bIsOnTeam1, const bool& bIsPlayer, const FMassEntityHandle& Entity)
+  ForEachMapDisplayableEntity([this, &UpdatedButtons](const FVector& EntityLocation, const uint8& TeamIndex, const bool& bIsPlayer, const FMassEntityHandle& Entity)
   {
-    (bIsOnTeam1 ? CachedTeam1AliveSoldierCount : CachedTeam2AliveSoldierCount)++;
+    CachedTeamAliveSoldierCounts[TeamIndex]++;
     UMilitaryUnit* Unit = MilitaryStructureSubsystem->GetUnitForEntity(Entity);
 
     if (!Unit)
@@ -171,7 +181,7 @@ void UProjectMMapWidget::UpdateMapButtons()
       return;
     }
     UButton* Button = MilitaryUnitToButtonMap[Unit];
-    UpdateButton(Button, WorldPositionToMapPosition(EntityLocation), Unit, bIsOnTeam1, bIsPlayer);
+    UpdateButton(Button, WorldPositionToMapPosition(EntityLocation), Unit, TeamIndex, bIsPlayer);
     UpdatedButtons.Add(Button);
     UCanvasPanelSlot* ButtonSlot = CastChecked<UCanvasPanelSlot>(Button->Slot.Get());
     const FVector2D& MapPosition = WorldPositionToMapPosition(EntityLocation);
@@ -0,0 +1,95 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#include "ProjectMStats.h"
+
+#include "ProfilingDebugging/CountersTrace.h"
+
+CSV_DEFINE_CATEGORY_MODULE(PROJECTM_API, ProjectM, true);
+
+TRACE_DECLARE_INT_COUNTER(ProjectMSphereTraces, TEXT("ProjectM/SphereTraces"));
+TRACE_DECLARE_INT_COUNTER(ProjectMLineTraces, TEXT("ProjectM/LineTraces"));
+TRACE_DECLARE_INT_COUNTER(ProjectMTargetGridQueries, TEXT("ProjectM/TargetGridQueries"));
+TRACE_DECLARE_INT_COUNTER(ProjectMTargetGridQueryCandidates, TEXT("ProjectM/TargetGridQueryCandidates"));
+TRACE_DECLARE_INT_COUNTER(ProjectMCollisionsTested, TEXT("ProjectM/CollisionsTested"));
+TRACE_DECLARE_INT_COUNTER(ProjectMPathsRequested, TEXT("ProjectM/PathsRequested"));
+TRACE_DECLARE_INT_COUNTER(ProjectMDeathsResolved, TEXT("ProjectM/DeathsResolved"));
+TRACE_DECLARE_INT_COUNTER(ProjectMProjectilesAlive, TEXT("ProjectM/ProjectilesAlive"));
+TRACE_DECLARE_INT_COUNTER(ProjectMSoundsAlive, TEXT("ProjectM/SoundsAlive"));
+
+int32 ProjectMStats_LogInterval = 0;
+FAutoConsoleVariableRef CVarProjectMStats_LogInterval(TEXT("pm.ProjectMStats_LogInterval"), ProjectMStats_LogInterval, TEXT("Log ProjectM stats every this many frames. 0 disables logging."));
+
+static constexpr int32 GNumProjectMStats = static_cast<int32>(EProjectMStat::Count);
+static constexpr EProjectMStat GFirstProjectMGaugeStat = EProjectMStat::ProjectilesAlive;
+
+static const char* const GProjectMStatNames[GNumProjectMStats] = {
+	"SphereTraces",
+	"LineTraces",
+	"TargetGridQueries",
+	"TargetGridQueryCandidates",
+	"CollisionsTested",
+	"PathsRequested",
+	"DeathsResolved",
+	"ProjectilesAlive",
+	"SoundsAlive",
+};
+
+// A cache line per stat, so that threads adding to different stats don't contend.
+struct alignas(PLATFORM_CACHE_LINE_SIZE) FProjectMStatValue
+{
+	std::atomic<int64> Value;
+};
+
+static FProjectMStatValue GProjectMStatValues[GNumProjectMStats];
+
+static uint64 GProjectMStatsFrameCounter = 0;
+
+void UE::ProjectM::Stats::Add(const EProjectMStat Stat, const int64 Value)
+{
+	GProjectMStatValues[static_cast<int32>(Stat)].Value.fetch_add(Value, std::memory_order_relaxed);
+}
+
+void UE::ProjectM::Stats::Set(const EProjectMStat Stat, const int64 Value)
+{
+	GProjectMStatValues[static_cast<int32>(Stat)].Value.store(Value, std::memory_order_relaxed);
+}
+
+void UE::ProjectM::Stats::EndFrame()
+{
+	check(IsInGameThread());
+
+	int64 Values[GNumProjectMStats];
+	for (int32 StatIndex = 0; StatIndex < GNumProjectMStats; StatIndex++)
+	{
+		const bool bIsGauge = StatIndex >= static_cast<int32>(GFirstProjectMGaugeStat);
+		Values[StatIndex] = bIsGauge ? GProjectMStatValues[StatIndex].Value.load(std::memory_order_relaxed) : GProjectMStatValues[StatIndex].Value.exchange(0, std::memory_order_relaxed);
+	}
+
+#if CSV_PROFILER
+	for (int32 StatIndex = 0; StatIndex < GNumProjectMStats; StatIndex++)
+	{
+		FCsvProfiler::RecordCustomStat(GProjectMStatNames[StatIndex], CSV_CATEGORY_INDEX(ProjectM), static_cast<int32>(Values[StatIndex]), ECsvCustomStatOp::Set);
+	}
+#endif
+
+	TRACE_COUNTER_SET(ProjectMSphereTraces, Values[static_cast<int32>(EProjectMStat::SphereTraces)]);
+	TRACE_COUNTER_SET(ProjectMLineTraces, Values[static_cast<int32>(EProjectMStat::LineTraces)]);
+	TRACE_COUNTER_SET(ProjectMTargetGridQueries, Values[static_cast<int32>(EProjectMStat::TargetGridQueries)]);
+	TRACE_COUNTER_SET(ProjectMTargetGridQueryCandidates, Values[static_cast<int32>(EProjectMStat::TargetGridQueryCandidates)]);
+	TRACE_COUNTER_SET(ProjectMCollisionsTested, Values[static_cast<int32>(EProjectMStat::CollisionsTested)]);
+	TRACE_COUNTER_SET(ProjectMPathsRequested, Values[static_cast<int32>(EProjectMStat::PathsRequested)]);
+	TRACE_COUNTER_SET(ProjectMDeathsResolved, Values[static_cast<int32>(EProjectMStat::DeathsResolved)]);
+	TRACE_COUNTER_SET(ProjectMProjectilesAlive, Values[static_cast<int32>(EProjectMStat::ProjectilesAlive)]);
+	TRACE_COUNTER_SET(ProjectMSoundsAlive, Values[static_cast<int32>(EProjectMStat::SoundsAlive)]);
+
+	GProjectMStatsFrameCounter++;
+	if (ProjectMStats_LogInterval > 0 && GProjectMStatsFrameCounter % ProjectMStats_LogInterval == 0)
+	{
+		FString Message;
+		for (int32 StatIndex = 0; StatIndex < GNumProjectMStats; StatIndex++)
+		{
+			Message += FString::Printf(TEXT(" %s=%lld"), ANSI_TO_TCHAR(GProjectMStatNames[StatIndex]), Values[StatIndex]);
+		}
+		UE_LOG(LogTemp, Log, TEXT("ProjectMStats frame %llu:%s"), GProjectMStatsFrameCounter, *Message);
+	}
+}
@@ -0,0 +1,184 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#include "StaticOccluderField.h"
+
+#include "GridCellTraversal.h"
+
+void FStaticOccluderField::Initialize(const FVector& InOrigin, const float InCellSize, const int32 InNumX, const int32 InNumY, const float InVoxelHeight)
+{
+	check(InCellSize > 0.f && InVoxelHeight > 0.f && InNumX > 0 && InNumY > 0);
+
+	Origin = InOrigin;
+	CellSize = InCellSize;
+	VoxelHeight = InVoxelHeight;
+	NumX = InNumX;
+	NumY = InNumY;
+
+	// Until a column is set, assume it is fully occupied so that queries fall back to physics.
+	GroundHeights.Init(-MAX_flt, NumX * NumY);
+	OccupiedVoxels.Init(~0ull, NumX * NumY);
+}
+
+void FStaticOccluderField::Reset()
+{
+	NumX = NumY = 0;
+	GroundHeights.Reset();
+	OccupiedVoxels.Reset();
+}
+
+void FStaticOccluderField::SetColumn(const int32 X, const int32 Y, const float GroundHeight, const uint64 InOccupiedVoxels)
+{
+	const int32 ColumnIndex = GetColumnIndex(X, Y);
+	GroundHeights[ColumnIndex] = GroundHeight;
+	OccupiedVoxels[ColumnIndex] = InOccupiedVoxels;
+}
+
+uint64 FStaticOccluderField::MakeVoxelMask(const int32 FirstVoxel, const int32 LastVoxel)
+{
+	check(FirstVoxel >= 0 && FirstVoxel <= LastVoxel && LastVoxel < NumVoxelsPerColumn);
+
+	const uint64 UpToLastVoxel = LastVoxel == NumVoxelsPerColumn - 1 ? ~0ull : (1ull << (LastVoxel + 1)) - 1;
+	return UpToLastVoxel & ~((1ull << FirstVoxel) - 1);
+}
+
+bool FStaticOccluderField::GetVoxelRange(const float MinZ, const float MaxZ, int32& OutFirstVoxel, int32& OutLastVoxel) const
+{
+	const float LocalMinZ = MinZ - Origin.Z;
+	const float LocalMaxZ = MaxZ - Origin.Z;
+	if (LocalMinZ < 0.f || LocalMaxZ >= NumVoxelsPerColumn * VoxelHeight)
+	{
+		return false;
+	}
+
+	OutFirstVoxel = FMath::FloorToInt(LocalMinZ / VoxelHeight);
+	OutLastVoxel = FMath::Min(FMath::FloorToInt(LocalMaxZ / VoxelHeight), NumVoxelsPerColumn - 1);
+	return true;
+}
+
+EStaticOcclusionResult FStaticOccluderField::Raycast(const FVector& Start, const FVector& End, const float Radius) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FStaticOccluderField.Raycast);
+
+	if (!IsInitialized())
+	{
+		return EStaticOcclusionResult::Unknown;
+	}
+
+	EStaticOcclusionResult Result = EStaticOcclusionResult::Clear;
+
+	const bool bIsTruncated = ForEachGridCellAlongSegment(Start - Origin, End - Origin, CellSize, [this, Radius, &Result](const FVector& PieceStart, const FVector& PieceEnd)
+	{
+		const FVector PieceCenter = (PieceStart + PieceEnd) * 0.5f;
+		const int32 X = FMath::FloorToInt(PieceCenter.X / CellSize);
+		const int32 Y = FMath::FloorToInt(PieceCenter.Y / CellSize);
+		if (X < 0 || X >= NumX || Y < 0 || Y >= NumY)
+		{
+			// Keep walking in case a later piece is definitely blocked.
+			Result = EStaticOcclusionResult::Unknown;
+			return true;
+		}
+
+		const float PieceMinZ = FMath::Min(PieceStart.Z, PieceEnd.Z) + Origin.Z;
+		const float PieceMaxZ = FMath::Max(PieceStart.Z, PieceEnd.Z) + Origin.Z;
+		if (PieceMaxZ + Radius < GroundHeights[GetColumnIndex(X, Y)])
+		{
+			Result = EStaticOcclusionResult::Blocked;
+			return false;
+		}
+
+		if (Result == EStaticOcclusionResult::Unknown)
+		{
+			return true;
+		}
+
+		int32 FirstVoxel, LastVoxel;
+		if (!GetVoxelRange(PieceMinZ - Radius, PieceMaxZ + Radius, FirstVoxel, LastVoxel))
+		{
+			Result = EStaticOcclusionResult::Unknown;
+			return true;
+		}
+		const uint64 VoxelMask = MakeVoxelMask(FirstVoxel, LastVoxel);
+
+		// The swept sphere can reach into neighbouring columns.
+		const int32 MinX = FMath::FloorToInt((FMath::Min(PieceStart.X, PieceEnd.X) - Radius) / CellSize);
+		const int32 MaxX = FMath::FloorToInt((FMath::Max(PieceStart.X, PieceEnd.X) + Radius) / CellSize);
+		const int32 MinY = FMath::FloorToInt((FMath::Min(PieceStart.Y, PieceEnd.Y) - Radius) / CellSize);
+		const int32 MaxY = FMath::FloorToInt((FMath::Max(PieceStart.Y, PieceEnd.Y) + Radius) / CellSize);
+		if (MinX < 0 || MaxX >= NumX || MinY < 0 || MaxY >= NumY)
+		{
+			Result = EStaticOcclusionResult::Unknown;
+			return true;
+		}
+
+		for (int32 ColumnY = MinY; ColumnY <= MaxY; ColumnY++)
+		{
+			for (int32 ColumnX = MinX; ColumnX <= MaxX; ColumnX++)
+			{
+				if (OccupiedVoxels[GetColumnIndex(ColumnX, ColumnY)] & VoxelMask)
+				{
+					Result = EStaticOcclusionResult::Unknown;
+					return true;
+				}
+			}
+		}
+
+		return true;
+	});
+
+	// The part of the segment that wasn't walked could be blocked.
+	if (bIsTruncated && Result == EStaticOcclusionResult::Clear)
+	{
+		Result = EStaticOcclusionResult::Unknown;
+	}
+
+	return Result;
+}
+
+FBox FStaticOccluderField::GetBounds() const
+{
+	return FBox(Origin, Origin + FVector(NumX * CellSize, NumY * CellSize, NumVoxelsPerColumn * VoxelHeight));
+}
+
+FBox FStaticOccluderField::GetColumnBounds(const int32 X, const int32 Y) const
+{
+	return GetVoxelRangeBounds(X, Y, 0, NumVoxelsPerColumn - 1);
+}
+
+FBox FStaticOccluderField::GetVoxelRangeBounds(const int32 X, const int32 Y, const int32 FirstVoxel, const int32 LastVoxel) const
+{
+	const FVector Min = Origin + FVector(X * CellSize, Y * CellSize, FirstVoxel * VoxelHeight);
+	const FVector Max = Origin + FVector((X + 1) * CellSize, (Y + 1) * CellSize, (LastVoxel + 1) * VoxelHeight);
+	return FBox(Min, Max);
+}
+
+FArchive& operator<<(FArchive& Ar, FStaticOccluderField& Field)
+{
+	int32 Version = FStaticOccluderField::SerializationVersion;
+	Ar << Version;
+	if (Ar.IsLoading() && Version != FStaticOccluderField::SerializationVersion)
+	{
+		Ar.SetError();
+		Field.Reset();
+		return Ar;
+	}
+
+	Ar << Field.Origin;
+	Ar << Field.CellSize;
+	Ar << Field.VoxelHeight;
+	Ar << Field.NumX;
+	Ar << Field.NumY;
+	Ar << Field.GroundHeights;
+	Ar << Field.OccupiedVoxels;
+
+	if (Ar.IsLoading())
+	{
+		const int32 NumColumns = Field.NumX * Field.NumY;
+		if (Ar.IsError() || Field.GroundHeights.Num() != NumColumns || Field.OccupiedVoxels.Num() != NumColumns || Field.CellSize <= 0.f || Field.VoxelHeight <= 0.f)
+		{
+			Ar.SetError();
+			Field.Reset();
+		}
+	}
+
+	return Ar;
+}
@@ -0,0 +1,51 @@
+#include "CoreTypes.h"
+#include "Containers/UnrealString.h"
+#include "Misc/AutomationTest.h"
+#include "Async/ParallelFor.h"
+#include "MassDebugDrawRecorder.h"
+
+
+#if WITH_DEV_AUTOMATION_TESTS && WITH_PROJECTM_DEBUG_DRAW
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDebugDrawRecorderTest, "ProjectM.DebugDrawRecorder", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::SmokeFilter)
+
+
+bool FDebugDrawRecorderTest::RunTest(const FString& Parameters)
+{
+	TArray<FDebugDrawPrimitive> Primitives;
+	UE::ProjectM::DebugDraw::Flush(Primitives);
+	Primitives.Reset();
+
+	static constexpr int32 NumLines = 256;
+	ParallelFor(NumLines, [](const int32 Index)
+	{
+		UE::ProjectM::DebugDraw::Line(nullptr, FVector(Index, 0.f, 0.f), FVector(Index, 100.f, 0.f), FColor::Red);
+	});
+	UE::ProjectM::DebugDraw::Capsule(nullptr, FVector::ZeroVector, FVector(0.f, 0.f, 100.f), 20.f, FColor::Green, false, 0.1f);
+
+	UE::ProjectM::DebugDraw::Flush(Primitives);
+	TestEqual(TEXT("Flush must return primitives recorded from all threads"), Primitives.Num(), NumLines + 1);
+
+	int32 NumLinesFound = 0;
+	for (const FDebugDrawPrimitive& Primitive : Primitives)
+	{
+		NumLinesFound += Primitive.Type == EDebugDrawPrimitiveType::Line ? 1 : 0;
+	}
+	TestEqual(TEXT("Flush must return every recorded line"), NumLinesFound, NumLines);
+
+	const FDebugDrawPrimitive* Capsule = Primitives.FindByPredicate([](const FDebugDrawPrimitive& Primitive) { return Primitive.Type == EDebugDrawPrimitiveType::Capsule; });
+	if (TestNotNull(TEXT("Flush must return the capsule"), Capsule))
+	{
+		TestEqual(TEXT("Capsule radius must be kept"), Capsule->Size, 20.f);
+		TestTrue(TEXT("Dumped capsule must start with its type"), Capsule->ToString().StartsWith(TEXT("Capsule ")));
+	}
+
+	Primitives.Reset();
+	UE::ProjectM::DebugDraw::Flush(Primitives);
+	TestEqual(TEXT("Flush must empty the buffers"), Primitives.Num(), 0);
+
+	return true;
+}
+
+
+#endif //WITH_DEV_AUTOMATION_TESTS && WITH_PROJECTM_DEBUG_DRAW
@@ -0,0 +1,50 @@
+#include "CoreTypes.h"
+#include "Containers/UnrealString.h"
+#include "Misc/AutomationTest.h"
+#include "MassCommandReplaySubsystem.h"
+
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSimulationStateHashTest, "ProjectM.SimulationStateHash", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::SmokeFilter)
+
+
+bool FSimulationStateHashTest::RunTest(const FString& Parameters)
+{
+	static constexpr float CellSize = 100.f;
+
+	FMassSimulationStateHash StateHash;
+	StateHash.AddEntity(FVector(10.f, 20.f, 0.f), 100, CellSize);
+	StateHash.AddEntity(FVector(-150.f, 420.f, 30.f), 40, CellSize);
+	StateHash.AddEntity(FVector(1000.f, 0.f, 0.f), 0, CellSize);
+
+	FMassSimulationStateHash ReorderedStateHash;
+	ReorderedStateHash.AddEntity(FVector(1000.f, 0.f, 0.f), 0, CellSize);
+	ReorderedStateHash.AddEntity(FVector(10.f, 20.f, 0.f), 100, CellSize);
+	ReorderedStateHash.AddEntity(FVector(-150.f, 420.f, 30.f), 40, CellSize);
+	TestTrue(TEXT("Hash must not depend on entity order"), StateHash == ReorderedStateHash);
+	TestEqual(TEXT("Hash must count entities"), StateHash.NumEntities, 3);
+	TestEqual(TEXT("Hash must sum health"), StateHash.TotalHealth, 140ll);
+
+	FMassSimulationStateHash QuantizedStateHash;
+	QuantizedStateHash.AddEntity(FVector(90.f, 80.f, 50.f), 100, CellSize);
+	QuantizedStateHash.AddEntity(FVector(-101.f, 499.f, 99.f), 40, CellSize);
+	QuantizedStateHash.AddEntity(FVector(1099.f, 1.f, 1.f), 0, CellSize);
+	TestTrue(TEXT("Hash must not depend on position within a cell"), StateHash == QuantizedStateHash);
+
+	FMassSimulationStateHash MovedStateHash;
+	MovedStateHash.AddEntity(FVector(10.f, 20.f, 0.f), 100, CellSize);
+	MovedStateHash.AddEntity(FVector(-150.f, 420.f, 30.f), 40, CellSize);
+	MovedStateHash.AddEntity(FVector(1100.f, 0.f, 0.f), 0, CellSize);
+	TestTrue(TEXT("Hash must change when an entity changes cell"), StateHash != MovedStateHash);
+
+	FMassSimulationStateHash SwappedStateHash;
+	SwappedStateHash.AddEntity(FVector(10.f, 20.f, 0.f), 40, CellSize);
+	SwappedStateHash.AddEntity(FVector(-150.f, 420.f, 30.f), 100, CellSize);
+	SwappedStateHash.AddEntity(FVector(1000.f, 0.f, 0.f), 0, CellSize);
+	TestTrue(TEXT("Only totals of health are compared"), StateHash == SwappedStateHash);
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
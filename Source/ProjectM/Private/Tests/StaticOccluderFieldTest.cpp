@@ -0,0 +1,74 @@
+#include "CoreTypes.h"
+#include "Containers/UnrealString.h"
+#include "Misc/AutomationTest.h"
+#include "Serialization/BufferArchive.h"
+#include "Serialization/MemoryReader.h"
+#include "StaticOccluderField.h"
+
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStaticOccluderFieldTest, "ProjectM.StaticOccluderField", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::SmokeFilter)
+
+
+bool FStaticOccluderFieldTest::RunTest(const FString& Parameters)
+{
+	// 10x10 cells of 1m, with 10cm voxels.
+	FStaticOccluderField Field;
+	Field.Initialize(FVector::ZeroVector, 100.f, 10, 10, 10.f);
+	for (int32 Y = 0; Y < Field.GetNumY(); Y++)
+	{
+		for (int32 X = 0; X < Field.GetNumX(); X++)
+		{
+			Field.SetColumn(X, Y, -MAX_flt, 0ull);
+		}
+	}
+
+	TestEqual(TEXT("Voxel mask must set inclusive range"), FStaticOccluderField::MakeVoxelMask(1, 3), 0b1110ull);
+	TestEqual(TEXT("Voxel mask must handle last voxel"), FStaticOccluderField::MakeVoxelMask(0, FStaticOccluderField::NumVoxelsPerColumn - 1), ~0ull);
+
+	TestTrue(TEXT("Trace through empty field must be clear"), Field.Raycast(FVector(50.f, 50.f, 100.f), FVector(950.f, 950.f, 100.f)) == EStaticOcclusionResult::Clear);
+
+	Field.SetColumn(5, 5, -MAX_flt, FStaticOccluderField::MakeVoxelMask(10, 10));
+	TestTrue(TEXT("Trace through occupied voxel must be unknown"), Field.Raycast(FVector(50.f, 50.f, 105.f), FVector(950.f, 950.f, 105.f)) == EStaticOcclusionResult::Unknown);
+	TestTrue(TEXT("Trace above occupied voxel must be clear"), Field.Raycast(FVector(50.f, 50.f, 300.f), FVector(950.f, 950.f, 300.f)) == EStaticOcclusionResult::Clear);
+	TestTrue(TEXT("Trace next to occupied voxel must be clear"), Field.Raycast(FVector(50.f, 50.f, 130.f), FVector(950.f, 950.f, 130.f)) == EStaticOcclusionResult::Clear);
+	TestTrue(TEXT("Sphere trace reaching occupied voxel must be unknown"), Field.Raycast(FVector(50.f, 50.f, 130.f), FVector(950.f, 950.f, 130.f), 30.f) == EStaticOcclusionResult::Unknown);
+	TestTrue(TEXT("Sphere trace reaching into neighbouring occupied column must be unknown"), Field.Raycast(FVector(50.f, 480.f, 105.f), FVector(950.f, 480.f, 105.f), 30.f) == EStaticOcclusionResult::Unknown);
+
+	Field.SetColumn(3, 0, 200.f, FStaticOccluderField::MakeVoxelMask(0, 19));
+	TestTrue(TEXT("Trace under ground must be blocked"), Field.Raycast(FVector(50.f, 50.f, 100.f), FVector(950.f, 50.f, 100.f)) == EStaticOcclusionResult::Blocked);
+	TestTrue(TEXT("Trace over ground must be clear"), Field.Raycast(FVector(50.f, 50.f, 250.f), FVector(950.f, 50.f, 250.f)) == EStaticOcclusionResult::Clear);
+
+	TestTrue(TEXT("Trace leaving field must be unknown"), Field.Raycast(FVector(50.f, 50.f, 300.f), FVector(1500.f, 50.f, 300.f)) == EStaticOcclusionResult::Unknown);
+	TestTrue(TEXT("Trace leaving field after going under ground must be blocked"), Field.Raycast(FVector(50.f, 50.f, 100.f), FVector(1500.f, 50.f, 100.f)) == EStaticOcclusionResult::Blocked);
+
+	{
+		FBufferArchive Writer;
+		Writer << Field;
+
+		FStaticOccluderField LoadedField;
+		FMemoryReader Reader(Writer);
+		Reader << LoadedField;
+
+		TestFalse(TEXT("Loading saved field must not error"), Reader.IsError());
+		TestEqual(TEXT("Loaded field must have same size"), LoadedField.GetNumX() * LoadedField.GetNumY(), Field.GetNumX() * Field.GetNumY());
+		TestEqual(TEXT("Loaded field must have same ground heights"), LoadedField.GetGroundHeight(3, 0), 200.f);
+		TestEqual(TEXT("Loaded field must have same occupied voxels"), LoadedField.GetOccupiedVoxels(5, 5), FStaticOccluderField::MakeVoxelMask(10, 10));
+		TestTrue(TEXT("Loaded field must answer traces the same"), LoadedField.Raycast(FVector(50.f, 50.f, 100.f), FVector(950.f, 50.f, 100.f)) == EStaticOcclusionResult::Blocked);
+	}
+
+	{
+		TArray<uint8> Garbage = { 0xFF, 0xFF, 0xFF, 0xFF };
+		FStaticOccluderField LoadedField;
+		FMemoryReader Reader(Garbage);
+		Reader << LoadedField;
+		TestTrue(TEXT("Loading field with wrong version must error"), Reader.IsError());
+		TestFalse(TEXT("Field that failed to load must not be initialized"), LoadedField.IsInitialized());
+	}
+
+	return true;
+}
+
+
+#endif //WITH_DEV_AUTOMATION_TESTS
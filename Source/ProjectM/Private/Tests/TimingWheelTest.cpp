@@ -0,0 +1,62 @@
+#include "CoreTypes.h"
+#include "Containers/UnrealString.h"
+#include "Misc/AutomationTest.h"
+#include "MassDelayedDestructionSubsystem.h"
+
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTimingWheelTest, "ProjectM.TimingWheel", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::SmokeFilter)
+
+
+static FMassEntityHandle MakeEntityHandle(const int32 Index)
+{
+	FMassEntityHandle Entity;
+	Entity.Index = Index;
+	Entity.SerialNumber = 1;
+	return Entity;
+}
+
+bool FTimingWheelTest::RunTest(const FString& Parameters)
+{
+	// Durations are powers of two so that float time accumulates exactly.
+	FMassTimingWheel TimingWheel(8, 0.25f);
+	const FMassEntityHandle SoonEntity = MakeEntityHandle(1);
+	const FMassEntityHandle OneTurnEntity = MakeEntityHandle(2);
+	const FMassEntityHandle OverflowEntity = MakeEntityHandle(3);
+	const FMassEntityHandle ImmediateEntity = MakeEntityHandle(4);
+
+	TestEqual(TEXT("Delays must be rounded up to whole ticks"), TimingWheel.Schedule(SoonEntity, 0.6f), 3ll);
+	TestEqual(TEXT("A delay of one turn must fit in the wheel"), TimingWheel.Schedule(OneTurnEntity, 2.f), 8ll);
+	TestEqual(TEXT("Delays beyond one turn must keep their tick"), TimingWheel.Schedule(OverflowEntity, 5.f), 20ll);
+	TestEqual(TEXT("Zero delays must expire at the next tick"), TimingWheel.Schedule(ImmediateEntity, 0.f), 1ll);
+	TestEqual(TEXT("Wheel must count scheduled entities"), TimingWheel.Num(), 4);
+
+	TArray<FMassEntityHandle> ExpiredEntities;
+	TimingWheel.Advance(0.125f, ExpiredEntities);
+	TestEqual(TEXT("Nothing must expire within a tick"), ExpiredEntities.Num(), 0);
+
+	TimingWheel.Advance(0.375f, ExpiredEntities);
+	TestTrue(TEXT("Zero delay entity must expire"), ExpiredEntities.Num() == 1 && ExpiredEntities[0] == ImmediateEntity);
+
+	ExpiredEntities.Reset();
+	TimingWheel.Advance(0.25f, ExpiredEntities);
+	TestTrue(TEXT("Entity must expire at its tick"), ExpiredEntities.Num() == 1 && ExpiredEntities[0] == SoonEntity);
+
+	ExpiredEntities.Reset();
+	TimingWheel.Advance(1.25f, ExpiredEntities);
+	TestTrue(TEXT("Several ticks must expire in one advance"), ExpiredEntities.Num() == 1 && ExpiredEntities[0] == OneTurnEntity);
+	TestEqual(TEXT("Overflow entity must still be scheduled"), TimingWheel.Num(), 1);
+
+	ExpiredEntities.Reset();
+	TimingWheel.Advance(2.5f, ExpiredEntities);
+	TestEqual(TEXT("Overflow entity must not expire a turn early"), ExpiredEntities.Num(), 0);
+
+	TimingWheel.Advance(0.5f, ExpiredEntities);
+	TestTrue(TEXT("Overflow entity must expire at its tick"), ExpiredEntities.Num() == 1 && ExpiredEntities[0] == OverflowEntity);
+	TestEqual(TEXT("Wheel must be empty"), TimingWheel.Num(), 0);
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -47,6 +47,8 @@ public class ProjectM : ModuleRules
 			"SlateCore",
 
 			"NavigationSystem",
+
+			"Landscape",
 		});
 
 		if (Target.bBuildDeveloperTools || (Target.Configuration != UnrealTargetConfiguration.Shipping && Target.Configuration != UnrealTargetConfiguration.Test))
@@ -8,7 +8,7 @@
 #include "MassEntityTraitBase.h"
 #include "CommanderCharacter.generated.h"
 
-class UMassMoveToCommandSubsystem;
+class UMassCommandReplaySubsystem;
 
 UCLASS(meta = (DisplayName = "PlayerControllableCharacter"))
 class PROJECTM_API UMassPlayerControllableCharacterTrait : public UMassEntityTraitBase
@@ -39,7 +39,7 @@ private:
 
 protected:
 	UPROPERTY()
-	UMassMoveToCommandSubsystem* MoveToCommandSystem;
+	UMassCommandReplaySubsystem* CommandReplaySubsystem;
 
 	UPROPERTY(EditAnywhere, Category = "Mass")
 	FMassEntityConfig ProjectileEntityConfig;
@@ -71,9 +71,15 @@ public:
 	UFUNCTION(BlueprintCallable)
 	bool InitializeFromMassSoldier(const int32 MassEntityIndex, const int32 MassEntitySerialNumber);
 
+	// Takes over the soldier like a character initialized from it would, used by UMassCommandReplaySubsystem to replay possession swaps.
+	void PossessMassSoldierForReplay(const FMassEntityHandle MassSoldierEntity);
+
 	UFUNCTION(BlueprintCallable)
 	bool IsPlayerOnTeam1() const;
 
+	UFUNCTION(BlueprintCallable)
+	uint8 GetPlayerTeamIndex() const;
+
 	UFUNCTION(BlueprintCallable)
 	bool IsCommander() const;
 };
@@ -0,0 +1,47 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Calls Function(PieceStart, PieceEnd) for each piece of the segment that lies within a single 2D grid cell, in order from Start to End.
+// Stops early if Function returns false. Returns true if the walk was truncated, i.e. it gave up after the number of cells the segment spans
+// without reaching End (e.g. due to float error at cell corners), so the rest of the segment wasn't visited and callers can't treat it as clear.
+template<typename FunctionType>
+bool ForEachGridCellAlongSegment(const FVector& Start, const FVector& End, const float CellSize, const FunctionType& Function)
+{
+	const FVector Delta = End - Start;
+	const int32 StepX = Delta.X > 0.f ? 1 : -1;
+	const int32 StepY = Delta.Y > 0.f ? 1 : -1;
+	const int32 StartCellX = FMath::FloorToInt(Start.X / CellSize);
+	const int32 StartCellY = FMath::FloorToInt(Start.Y / CellSize);
+
+	// Segment parameter at which the next X/Y cell boundary is crossed, and the parameter distance between boundaries.
+	float NextX = FMath::IsNearlyZero(Delta.X) ? BIG_NUMBER : ((StartCellX + (StepX > 0 ? 1 : 0)) * CellSize - Start.X) / Delta.X;
+	float NextY = FMath::IsNearlyZero(Delta.Y) ? BIG_NUMBER : ((StartCellY + (StepY > 0 ? 1 : 0)) * CellSize - Start.Y) / Delta.Y;
+	const float StepXT = FMath::IsNearlyZero(Delta.X) ? BIG_NUMBER : CellSize / FMath::Abs(Delta.X);
+	const float StepYT = FMath::IsNearlyZero(Delta.Y) ? BIG_NUMBER : CellSize / FMath::Abs(Delta.Y);
+
+	const int32 MaxCells = FMath::Abs(FMath::FloorToInt(End.X / CellSize) - StartCellX) + FMath::Abs(FMath::FloorToInt(End.Y / CellSize) - StartCellY) + 1;
+	float PieceStartT = 0.f;
+	for (int32 CellIndex = 0; CellIndex < MaxCells; CellIndex++)
+	{
+		const float PieceEndT = FMath::Min3(NextX, NextY, 1.f);
+		if (!Function(Start + Delta * PieceStartT, Start + Delta * PieceEndT) || PieceEndT >= 1.f)
+		{
+			return false;
+		}
+
+		if (NextX < NextY)
+		{
+			NextX += StepXT;
+		}
+		else
+		{
+			NextY += StepYT;
+		}
+		PieceStartT = PieceEndT;
+	}
+
+	return true;
+}
@@ -0,0 +1,129 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityTypes.h"
+#include "Subsystems/WorldSubsystem.h"
+
+#include "MassBattlefieldClutterSubsystem.generated.h"
+
+class UInstancedStaticMeshComponent;
+class UMassEntityConfigAsset;
+class UMaterialInterface;
+class UStaticMesh;
+struct FMassEntityView;
+struct FStaticMeshInstanceVisualizationDesc;
+
+inline int32 UMassBattlefieldClutterSubsystem_MaxInstances = 8192;
+inline FAutoConsoleVariableRef CVarUMassBattlefieldClutterSubsystem_MaxInstances(TEXT("pm.UMassBattlefieldClutterSubsystem_MaxInstances"), UMassBattlefieldClutterSubsystem_MaxInstances, TEXT("Corpses and wrecks kept as static instances. The oldest are removed once there are more."));
+
+inline int32 UMassBattlefieldClutterSubsystem_MaxInstancesPerCell = 256;
+inline FAutoConsoleVariableRef CVarUMassBattlefieldClutterSubsystem_MaxInstancesPerCell(TEXT("pm.UMassBattlefieldClutterSubsystem_MaxInstancesPerCell"), UMassBattlefieldClutterSubsystem_MaxInstancesPerCell, TEXT("Corpses and wrecks kept per cell, so that one heavily fought over spot doesn't remove the history of the rest of the battlefield. The oldest in the cell are removed once there are more."));
+
+inline float UMassBattlefieldClutterSubsystem_CellSize = 5000.f;
+inline FAutoConsoleVariableRef CVarUMassBattlefieldClutterSubsystem_CellSize(TEXT("pm.UMassBattlefieldClutterSubsystem_CellSize"), UMassBattlefieldClutterSubsystem_CellSize, TEXT("Size of the cells that pm.UMassBattlefieldClutterSubsystem_MaxInstancesPerCell applies to. Read when the world starts."));
+
+/** Entity that leaves a static instance of itself in UMassBattlefieldClutterSubsystem when it's destroyed by UMassDelayedDestructionProcessor, e.g. a dead soldier. */
+USTRUCT()
+struct PROJECTM_API FMassBecomesClutterOnDestructionTag : public FMassTag
+{
+	GENERATED_BODY()
+};
+
+// Mesh, materials and custom data layout of one instanced static mesh component.
+USTRUCT()
+struct FMassBattlefieldClutterType
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Transient)
+	TObjectPtr<UStaticMesh> Mesh = nullptr;
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UMaterialInterface>> MaterialOverrides;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UInstancedStaticMeshComponent> Component = nullptr;
+
+	bool bCastShadows = true;
+	int32 NumCustomDataFloats = 0;
+
+	// Instances of evicted clutter, hidden until they are reused. Instances are never removed so that the indices of the others stay valid.
+	TArray<int32> FreeInstanceIndices;
+};
+
+struct FMassBattlefieldClutterInstance
+{
+	FTransform Transform;
+	FIntPoint Cell;
+	int32 TypeIndex;
+	int32 InstanceIndex;
+	uint32 Sequence;
+};
+
+/**
+ * Keeps corpses and wrecks as static instance records in a cell-keyed container, rendered by one instanced static mesh component per mesh. They
+ * aren't entities, so no Mass processor runs on them and long matches keep the visual evidence of the battle without the entity count growing.
+ * The number of instances is capped in total and per cell, and the oldest are evicted first. Instances are part of world snapshots.
+ */
+UCLASS()
+class PROJECTM_API UMassBattlefieldClutterSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// Game thread only. Adds an instance of the entity's static mesh representation, frozen in its current vertex animation if it has one.
+	bool AddEntity(const FMassEntityView& EntityView);
+
+	// Game thread only. Adds an instance of the entity config's static mesh representation instead of spawning the entity. Returns false if the
+	// entity config has none, in which case the entity should be spawned.
+	bool AddEntityConfig(UMassEntityConfigAsset* EntityConfig, const FTransform& Transform);
+
+	int32 Num() const { return Instances.Num(); }
+
+	// Writes or replaces the clutter instances. Called by UMassWorldSnapshotSubsystem.
+	void SerializeSnapshot(FArchive& Ar);
+
+	// Removes every instance, e.g. when restoring a world snapshot saved before clutter was part of them.
+	void Reset();
+
+protected:
+	int32 FindOrAddType(UStaticMesh* Mesh, TConstArrayView<TObjectPtr<UMaterialInterface>> MaterialOverrides, const bool bCastShadows, const int32 NumCustomDataFloats);
+	int32 FindOrAddType(const FStaticMeshInstanceVisualizationDesc& Desc, const int32 NumCustomDataFloats);
+	void AddInstance(const int32 TypeIndex, const FTransform& Transform, const TArray<float>& CustomData);
+	void RemoveInstance(const int32 InstanceId);
+	void RemoveOldestInstance();
+	// Drops the entries of Order that no longer refer to an instance, once they outnumber the instances.
+	void CompactOrder();
+	FIntPoint GetCell(const FVector& Location) const;
+
+	UPROPERTY(Transient)
+	TObjectPtr<AActor> ClutterActor = nullptr;
+
+	UPROPERTY(Transient)
+	TArray<FMassBattlefieldClutterType> Types;
+
+	TSparseArray<FMassBattlefieldClutterInstance> Instances;
+
+	// Instance ids of each cell, oldest first.
+	TMap<FIntPoint, TArray<int32>> Cells;
+
+	// Instance ids oldest first, from OldestIndex on. Entries of instances that were already evicted from their cell are skipped by their sequence.
+	struct FOrderEntry
+	{
+		int32 InstanceId;
+		uint32 Sequence;
+	};
+	TArray<FOrderEntry> Order;
+	int32 OldestIndex = 0;
+	uint32 NextSequence = 0;
+
+	// INDEX_NONE for entity configs without a static mesh representation.
+	TMap<const UMassEntityConfigAsset*, int32> EntityConfigTypeIndices;
+
+	float CellSize = 5000.f;
+};
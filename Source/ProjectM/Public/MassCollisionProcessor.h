@@ -50,6 +50,7 @@ FCapsule MakeCapsuleForEntity(const FMassEntityView& EntityView);
 // Returns true if capsules collide.
 bool TestCapsuleCapsule(FCapsule capsule1, FCapsule capsule2);
 
+// Thread-safe, recorded with UE::ProjectM::DebugDraw and drawn at the end of the frame.
 void DrawCapsule(const FCapsule& Capsule, const UWorld& World, const FLinearColor& Color = FLinearColor::Red, const bool bPersistentLines = true, float LifeTime = -1.f);
 
 UCLASS(meta = (DisplayName = "Collision"))
@@ -0,0 +1,140 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityTypes.h"
+#include "MassMoveToCommandSubsystem.h"
+#include "Subsystems/WorldSubsystem.h"
+
+#include "MassCommandReplaySubsystem.generated.h"
+
+class UMassEntitySubsystem;
+class UMilitaryUnit;
+
+/**
+ * Summary of the simulation that two runs of the same replay must agree on. Positions are quantized to cells and combined independently of
+ * entity order, so the hash doesn't depend on how processors happened to order chunks or threads.
+ */
+struct PROJECTM_API FMassSimulationStateHash
+{
+	int32 NumEntities = 0;
+	int64 TotalHealth = 0;
+	uint64 PositionsHash = 0;
+
+	void AddEntity(const FVector& Location, const int16 Health, const float CellSize);
+
+	static FMassSimulationStateHash Compute(UMassEntitySubsystem& EntitySubsystem, const float CellSize);
+
+	bool operator==(const FMassSimulationStateHash& Other) const
+	{
+		return NumEntities == Other.NumEntities && TotalHealth == Other.TotalHealth && PositionsHash == Other.PositionsHash;
+	}
+
+	bool operator!=(const FMassSimulationStateHash& Other) const { return !(*this == Other); }
+
+	FString ToString() const;
+
+	friend FArchive& operator<<(FArchive& Ar, FMassSimulationStateHash& StateHash)
+	{
+		Ar << StateHash.NumEntities << StateHash.TotalHealth << StateHash.PositionsHash;
+		return Ar;
+	}
+};
+
+enum class EMassCommandReplayEventType : uint8
+{
+	MoveToCommand,
+	PossessSoldier,
+	ReleaseSoldier,
+};
+
+// Military units are referenced by the path of sub unit indices from their team's root unit, which is the same in every run of a replay.
+struct FMassCommandReplayEvent
+{
+	uint32 Frame = 0;
+	EMassCommandReplayEventType Type = EMassCommandReplayEventType::MoveToCommand;
+	uint8 TeamIndex = 0;
+	bool bHasMilitaryUnit = false;
+	TArray<int32> MilitaryUnitPath;
+	FVector Target = FVector::ZeroVector;
+
+	friend FArchive& operator<<(FArchive& Ar, FMassCommandReplayEvent& Event);
+};
+
+/**
+ * Records everything from outside the Mass simulation that changes its outcome, i.e. player move to commands, player possession swaps and the
+ * random seed used while spawning, and replays it at a fixed time step to reproduce a match. The recording ends with a hash of the simulation
+ * state, which playback compares against once it reaches the same frame. This makes a recording a regression test for changes that must not
+ * change the outcome, such as parallelizing processors:
+ *
+ *   Record: -ExecCmds="pm.UMassCommandReplaySubsystem_Record Name" and pm.StopCommandReplayRecording (or end play).
+ *   Replay: -ExecCmds="pm.UMassCommandReplaySubsystem_Play Name, pm.UMassCommandReplaySubsystem_ExitWhenDone 1", exits with 1 on mismatch.
+ *
+ * Replays are only exact while the player's own character doesn't move or fire, which isn't recorded.
+ */
+UCLASS()
+class PROJECTM_API UMassCommandReplaySubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+
+	bool IsRecording() const { return bIsRecording; }
+	bool IsPlaying() const { return bIsPlaying; }
+
+	// Player move to commands go through here. While recording they are held until the end of the frame, which is where playback submits them.
+	void SubmitMoveToCommand(const UMilitaryUnit* MilitaryUnit, const FVector Target, const uint8 TeamIndex);
+
+	void RecordPossessSoldier(const UMilitaryUnit* SoldierMilitaryUnit, const uint8 TeamIndex);
+	void RecordReleaseSoldier(const UMilitaryUnit* SoldierMilitaryUnit, const uint8 TeamIndex);
+
+	// Spawners call this right before they generate spawn points and spawn, which may be frames after begin play since entity configs load
+	// asynchronously. Reseeds FMath's random streams with the replay's seed while recording or playing.
+	void SeedRandomForSpawning() const;
+
+	// Ends the recording at the end of this frame and writes it with the state hash. Otherwise it's written when the world is torn down.
+	void StopRecording();
+
+protected:
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	void StartRecording(const FString& ReplayName);
+	void SaveRecording(const uint32 LastFrame);
+	bool StartPlaying(const FString& ReplayName);
+	void UseFixedTimeStep();
+	void RestoreTimeStep();
+	void RecordEvent(const EMassCommandReplayEventType Type, const UMilitaryUnit* MilitaryUnit, const uint8 TeamIndex, const FVector& Target = FVector::ZeroVector);
+	void PlayEvent(const FMassCommandReplayEvent& Event);
+	void FinishPlaying();
+	UMilitaryUnit* FindMilitaryUnit(const FMassCommandReplayEvent& Event) const;
+	FString GetReplayFilePath(const FString& ReplayName) const;
+
+	bool bIsRecording = false;
+	bool bIsPlaying = false;
+	bool bIsStopRecordingRequested = false;
+	FString CurrentReplayName;
+	FDelegateHandle WorldBeginTearDownHandle;
+
+	// Frames of the simulation since begin play, advanced at the end of every frame.
+	uint32 Frame = 0;
+
+	int32 RandomSeed = 0;
+	float FixedDeltaTime = 0.f;
+
+	// FApp's time step from before UseFixedTimeStep, restored once the replay is done.
+	bool bDidOverrideTimeStep = false;
+	bool bPreviousUseFixedTimeStep = false;
+	double PreviousFixedDeltaTime = 0.;
+	TArray<FMassCommandReplayEvent> Events;
+	int32 NextEventIndex = 0;
+
+	// Playback only.
+	uint32 EndFrame = 0;
+	FMassSimulationStateHash ExpectedStateHash;
+
+	TArray<FMoveToCommand> PendingMoveToCommands;
+};
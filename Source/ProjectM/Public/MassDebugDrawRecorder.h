@@ -0,0 +1,72 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#ifndef WITH_PROJECTM_DEBUG_DRAW
+#define WITH_PROJECTM_DEBUG_DRAW !UE_BUILD_SHIPPING
+#endif
+
+class UWorld;
+
+enum class EDebugDrawPrimitiveType : uint8
+{
+	Line,
+	Arrow,
+	Point,
+	Capsule,
+	String,
+};
+
+// A - B is the segment of lines, arrows and capsules. Size is the arrow head size, point size or capsule radius.
+struct FDebugDrawPrimitive
+{
+	TWeakObjectPtr<const UWorld> World;
+	EDebugDrawPrimitiveType Type = EDebugDrawPrimitiveType::Line;
+	FVector A = FVector::ZeroVector;
+	FVector B = FVector::ZeroVector;
+	float Size = 0.f;
+	FColor Color = FColor::Red;
+	bool bPersistent = false;
+	float LifeTime = -1.f;
+	FString Text;
+
+	FString ToString() const;
+};
+
+/**
+ * Records debug draws from any thread into per thread buffers, which the game thread replays with DrawDebug* once at the end of every frame.
+ * This replaces sending an AsyncTask per draw to the game thread, so debugging an entity doesn't add task graph work to the frame it is
+ * debugged in. With pm.DebugDrawRecorder_DumpFile set, every replayed primitive is also appended to that file under the Saved directory, which
+ * lets -nullrhi runs assert on what would have been drawn. Compiles out in shipping.
+ */
+namespace UE::ProjectM::DebugDraw
+{
+#if WITH_PROJECTM_DEBUG_DRAW
+	PROJECTM_API void Line(const UWorld* World, const FVector& Start, const FVector& End, const FColor& Color, const bool bPersistent = false, const float LifeTime = -1.f);
+	PROJECTM_API void Arrow(const UWorld* World, const FVector& Start, const FVector& End, const float ArrowSize, const FColor& Color, const bool bPersistent = false, const float LifeTime = -1.f);
+	PROJECTM_API void Point(const UWorld* World, const FVector& Location, const float PointSize, const FColor& Color, const bool bPersistent = false, const float LifeTime = -1.f);
+	PROJECTM_API void Capsule(const UWorld* World, const FVector& Start, const FVector& End, const float Radius, const FColor& Color, const bool bPersistent = false, const float LifeTime = -1.f);
+	PROJECTM_API void String(const UWorld* World, const FVector& Location, const FString& Text, const FColor& Color, const float LifeTime = -1.f);
+
+	// Records debug state updates the same way, e.g. for the gameplay debugger. Commands run on the game thread at the end of the frame, before
+	// the primitives are replayed.
+	PROJECTM_API void Command(TFunction<void()>&& Command);
+
+	// Game thread. Moves everything recorded so far, from all threads, into OutPrimitives.
+	PROJECTM_API void Flush(TArray<FDebugDrawPrimitive>& OutPrimitives);
+
+	// Game thread. Replays this frame's primitives, called by the module at the end of every frame.
+	void EndFrame();
+#else
+	inline void Line(const UWorld* World, const FVector& Start, const FVector& End, const FColor& Color, const bool bPersistent = false, const float LifeTime = -1.f) {}
+	inline void Arrow(const UWorld* World, const FVector& Start, const FVector& End, const float ArrowSize, const FColor& Color, const bool bPersistent = false, const float LifeTime = -1.f) {}
+	inline void Point(const UWorld* World, const FVector& Location, const float PointSize, const FColor& Color, const bool bPersistent = false, const float LifeTime = -1.f) {}
+	inline void Capsule(const UWorld* World, const FVector& Start, const FVector& End, const float Radius, const FColor& Color, const bool bPersistent = false, const float LifeTime = -1.f) {}
+	inline void String(const UWorld* World, const FVector& Location, const FString& Text, const FColor& Color, const float LifeTime = -1.f) {}
+	inline void Command(TFunction<void()>&& Command) {}
+	inline void Flush(TArray<FDebugDrawPrimitive>& OutPrimitives) {}
+	inline void EndFrame() {}
+#endif
+} // namespace UE::ProjectM::DebugDraw
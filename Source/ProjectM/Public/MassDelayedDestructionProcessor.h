@@ -6,15 +6,24 @@
 #include "MassProcessor.h"
 #include "MassEntityTraitBase.h"
 #include "MassEntityTypes.h"
+#include "MassObserverProcessor.h"
 
 #include "MassDelayedDestructionProcessor.generated.h"
 
+class UMassVisualEffectsSubsystem;
+class UMassDelayedDestructionSubsystem;
+class UMassBattlefieldClutterSubsystem;
+
 USTRUCT()
 struct PROJECTM_API FMassDelayedDestructionFragment : public FMassFragment
 {
 	GENERATED_BODY()
+	// Delay from when the fragment is added until the entity is destroyed. It isn't counted down, UMassDelayedDestructionSubsystem keeps the time.
 	UPROPERTY(EditAnywhere, Category = "")
 	float SecondsLeftTilDestruction;
+
+	// Tick of UMassDelayedDestructionSubsystem's timing wheel at which the entity expires, so that stale schedules can be told apart.
+	int64 ExpirationTick = INDEX_NONE;
 };
 
 UCLASS(meta = (DisplayName = "DelayedDestruction"))
@@ -29,6 +38,26 @@ protected:
 	float SecondsDelay = 3.0f;
 };
 
+// Schedules entities in UMassDelayedDestructionSubsystem's timing wheel when they get a FMassDelayedDestructionFragment.
+UCLASS()
+class PROJECTM_API UMassDelayedDestructionInitializer : public UMassObserverProcessor
+{
+	GENERATED_BODY()
+public:
+	UMassDelayedDestructionInitializer();
+
+protected:
+	virtual void ConfigureQueries() override;
+	virtual void Initialize(UObject& Owner) override;
+	virtual void Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context) override;
+
+private:
+	FMassEntityQuery EntityQuery;
+	TObjectPtr<UMassDelayedDestructionSubsystem> DelayedDestructionSubsystem;
+};
+
+// Destroys the entities whose timing wheel slot expired this frame in one batch. Expired pooled visual effects go back to their pool instead,
+// and entities with FMassBecomesClutterOnDestructionTag leave a static instance in UMassBattlefieldClutterSubsystem.
 UCLASS()
 class PROJECTM_API UMassDelayedDestructionProcessor : public UMassProcessor
 {
@@ -38,8 +67,14 @@ public:
 
 protected:
 	virtual void ConfigureQueries() override;
+	virtual void Initialize(UObject& Owner) override;
 	virtual void Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context) override;
 
 private:
-	FMassEntityQuery EntityQuery;
+	TObjectPtr<UMassVisualEffectsSubsystem> VisualEffectsSubsystem;
+	TObjectPtr<UMassDelayedDestructionSubsystem> DelayedDestructionSubsystem;
+	TObjectPtr<UMassBattlefieldClutterSubsystem> BattlefieldClutterSubsystem;
+
+	TArray<FMassEntityHandle> ExpiredEntities;
+	TArray<FMassEntityHandle> EntitiesToDestroy;
 };
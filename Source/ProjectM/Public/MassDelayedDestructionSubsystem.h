@@ -0,0 +1,71 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityTypes.h"
+#include "Subsystems/WorldSubsystem.h"
+
+#include "MassDelayedDestructionSubsystem.generated.h"
+
+struct FMassDelayedDestructionFragment;
+
+/**
+ * Hashed timing wheel of entity handles. Time advances in fixed ticks and each tick owns the slot of the entities that expire at it, so
+ * advancing only touches the entities that expire. Expirations further away than one turn of the wheel wait in an overflow list, which is
+ * only revisited once per turn.
+ */
+struct PROJECTM_API FMassTimingWheel
+{
+	FMassTimingWheel(const int32 InNumSlots = 128, const float InTickDuration = 0.05f);
+
+	// Returns the tick at which the entity will be returned by Advance. Delays are rounded up to whole ticks.
+	int64 Schedule(const FMassEntityHandle Entity, const float Delay);
+
+	// Appends the entities of every tick that elapses during DeltaTime to OutExpiredEntities.
+	void Advance(const float DeltaTime, TArray<FMassEntityHandle>& OutExpiredEntities);
+
+	int64 GetCurrentTick() const { return CurrentTick; }
+	int32 Num() const { return NumScheduled; }
+	void Reset();
+
+protected:
+	struct FOverflowEntry
+	{
+		FMassEntityHandle Entity;
+		int64 Tick;
+	};
+
+	void AddToSlot(const FMassEntityHandle Entity, const int64 Tick);
+
+	TArray<TArray<FMassEntityHandle>> Slots;
+	TArray<FOverflowEntry> Overflow;
+	float TickDuration;
+	float TimeSinceCurrentTick = 0.f;
+	int64 CurrentTick = 0;
+	int32 NumScheduled = 0;
+};
+
+/**
+ * Owns the timing wheel of entities with a FMassDelayedDestructionFragment. Entities are scheduled once, when the fragment is added, and
+ * UMassDelayedDestructionProcessor only visits the entities whose slot expires, so dead soldiers and effects waiting to be destroyed cost
+ * nothing per frame.
+ */
+UCLASS()
+class PROJECTM_API UMassDelayedDestructionSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// Game thread only. Writes the expiration tick to the fragment, which makes earlier schedules of the same entity stale.
+	void Schedule(const FMassEntityHandle Entity, FMassDelayedDestructionFragment& DelayedDestructionFragment);
+
+	void Advance(const float DeltaTime, TArray<FMassEntityHandle>& OutExpiredEntities) { TimingWheel.Advance(DeltaTime, OutExpiredEntities); }
+
+	int64 GetCurrentTick() const { return TimingWheel.GetCurrentTick(); }
+
+protected:
+	virtual void Deinitialize() override;
+
+	FMassTimingWheel TimingWheel;
+};
@@ -28,6 +28,7 @@ FCapsule GetProjectileTraceCapsuleToTarget(const bool bIsEntitySoldier, const bo
 float GetProjectileInitialXYVelocityMagnitude(const bool bIsEntitySoldier);
 float GetEntityRange(const bool bIsEntitySoldier);
 bool IsTargetEntityVisibleViaSphereTrace(const UWorld& World, const FVector& StartLocation, const FVector& EndLocation, const bool DrawTrace = false);
+uint32 GetHostileTeamsMask(const uint8 TeamIndex, const TArray<uint8>& AlliedTeamIndices);
 
 #if WITH_MASSGAMEPLAY_DEBUG
 struct FDebugEntityData
@@ -62,18 +63,53 @@ struct PROJECTM_API FTargetEntityFragment : public FMassFragment
 
 	/** The entity that the fragment owner is targeting. */
 	FMassEntityHandle Entity;
+
+	/** Slot of Entity in UMassTargetFinderSubsystem's target location store, resolved again by UMassTrackTargetProcessor when it's stale. */
+	int32 TargetLocationSlot = INDEX_NONE;
 	
 	float TargetMinCaliberForDamage;
 
 	float VerticalAimOffset = 0.f;
+
+	/** State used by UInvalidTargetFinderProcessor to stagger the expensive range and obstruction checks. */
+	FMassEntityHandle LastValidatedEntity;
+	FVector LastValidatedEntityLocation = FVector::ZeroVector;
+	float NextValidationTime = 0.f;
 };
 
+// Team masks are stored in a uint32, so this is the hard limit on the number of teams.
+static constexpr uint8 GMaxTeams = 32;
+
+FORCEINLINE uint32 GetTeamMask(const uint8 TeamIndex)
+{
+	check(TeamIndex < GMaxTeams);
+	return 1u << TeamIndex;
+}
+
 USTRUCT()
 struct PROJECTM_API FTeamMemberFragment : public FMassFragment
 {
 	GENERATED_BODY()
 	UPROPERTY(EditAnywhere, Category = "")
-	bool IsOnTeam1 = true;
+	uint8 TeamIndex = 0;
+};
+
+/** Row of the hostility matrix for a team. Shared by every entity on the team so hostility filtering is a single AND against FMassTargetGridItem::TeamMask. */
+USTRUCT()
+struct PROJECTM_API FTeamHostilityParameters : public FMassSharedFragment
+{
+	GENERATED_BODY()
+
+	bool IsHostileTo(const uint32 OtherTeamMask) const
+	{
+		return (HostileTeamsMask & OtherTeamMask) != 0;
+	}
+
+	UPROPERTY(EditAnywhere, Category = "")
+	uint32 TeamMask = 1u;
+
+	UPROPERTY(EditAnywhere, Category = "")
+	uint32 HostileTeamsMask = ~1u;
 };
 
 UCLASS(meta = (DisplayName = "TeamMember"))
@@ -83,10 +119,20 @@ class PROJECTM_API UMassTeamMemberTrait : public UMassEntityTraitBase
 
 protected:
 	virtual void BuildTemplate(FMassEntityTemplateBuildContext& BuildContext, UWorld& World) const override;
+	virtual void Serialize(FArchive& Ar) override;
+	virtual void PostLoad() override;
 
 public:
+	UPROPERTY(Category = "Team", EditAnywhere, meta = (ClampMax = 31))
+	uint8 TeamIndex = 0;
+
+	/** Teams that this team will not target. Every other team is hostile. */
 	UPROPERTY(Category = "Team", EditAnywhere)
-	bool IsOnTeam1 = true;
+	TArray<uint8> AlliedTeamIndices;
+
+private:
+	UPROPERTY(meta = (DeprecatedProperty))
+	bool IsOnTeam1_DEPRECATED = true;
 };
 
 USTRUCT()
@@ -0,0 +1,22 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityTypes.h"
+
+// Stable pseudo random value in [0, 1) per entity, e.g. to stagger periodic work or spread entities over a selection window. Hashes the entity
+// index as an integer, so large indices spread as well as small ones.
+inline float GetEntityHashFraction(const FMassEntityHandle& Entity)
+{
+	// Murmur3 finalizer.
+	uint32 Hash = static_cast<uint32>(Entity.Index);
+	Hash ^= Hash >> 16;
+	Hash *= 0x85ebca6bu;
+	Hash ^= Hash >> 13;
+	Hash *= 0xc2b2ae35u;
+	Hash ^= Hash >> 16;
+
+	// Top 24 bits, as many as a float represents exactly.
+	return (Hash >> 8) * (1.f / 16777216.f);
+}
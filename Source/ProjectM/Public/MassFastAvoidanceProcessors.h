@@ -11,6 +11,30 @@ PROJECTM_API DECLARE_LOG_CATEGORY_EXTERN(LogAvoidanceAgents, Warning, All);
 PROJECTM_API DECLARE_LOG_CATEGORY_EXTERN(LogAvoidanceObstacles, Warning, All);
 
 class UMassNavigationSubsystem;
+class UMassFastAvoidanceSubsystem;
+
+/** Fills UMassFastAvoidanceSubsystem's neighbour snapshot from the navigation obstacle grid before the fast avoidance processors run. */
+UCLASS()
+class PROJECTM_API UMassFastAvoidanceNeighborSnapshotProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+
+public:
+	UMassFastAvoidanceNeighborSnapshotProcessor();
+
+protected:
+	virtual void ConfigureQueries() override;
+	virtual void Initialize(UObject& Owner) override;
+	virtual void Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context) override;
+
+private:
+	TObjectPtr<UMassNavigationSubsystem> NavigationSubsystem;
+	TObjectPtr<UMassFastAvoidanceSubsystem> FastAvoidanceSubsystem;
+	FMassEntityQuery EntityQuery;
+
+	// Obstacle grid slot per entity index, INDEX_NONE for entities not in the grid. Kept to reuse the allocation.
+	TArray<int32> SlotsByEntityIndex;
+};
 
 /** Experimental: move using cumulative forces to avoid close agents */
 UCLASS()
@@ -29,6 +53,7 @@ protected:
 private:
 	TObjectPtr<UWorld> World;
 	TObjectPtr<UMassNavigationSubsystem> NavigationSubsystem;
+	TObjectPtr<UMassFastAvoidanceSubsystem> FastAvoidanceSubsystem;
 	FMassEntityQuery EntityQuery;
 };
 
@@ -49,5 +74,6 @@ protected:
 private:
 	TObjectPtr<UWorld> World;
 	TObjectPtr<UMassNavigationSubsystem> NavigationSubsystem;
+	TObjectPtr<UMassFastAvoidanceSubsystem> FastAvoidanceSubsystem;
 	FMassEntityQuery EntityQuery;
 };
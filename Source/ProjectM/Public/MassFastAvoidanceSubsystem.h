@@ -0,0 +1,64 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#pragma once
+
+#include "MassEntityTypes.h"
+#include "Subsystems/WorldSubsystem.h"
+
+#include "MassFastAvoidanceSubsystem.generated.h"
+
+enum class EMassAvoidanceNeighborFlags : uint8
+{
+	None = 0,
+	// Slot holds a live entity. All other data is undefined when not set.
+	Valid = 1 << 0,
+	// Has a move target, so it will avoid us too.
+	CanAvoid = 1 << 1,
+	Moving = 1 << 2,
+	// Standing with a ghost valid for its current action, see GhostLocations.
+	HasStandingGhost = 1 << 3,
+	// Obstacle grid item has collider data. Only one of CircleCollider and PillCollider is set if the collider fragment was found.
+	HasColliderData = 1 << 4,
+	CircleCollider = 1 << 5,
+	PillCollider = 1 << 6,
+};
+ENUM_CLASS_FLAGS(EMassAvoidanceNeighborFlags);
+
+/**
+ * Per-frame structure-of-arrays copy of the avoidance relevant data of every entity in the navigation obstacle grid, indexed by the
+ * obstacle grid item index. Lets the avoidance neighbour loops read contiguous memory instead of going through FMassEntityView for
+ * every neighbour.
+ */
+struct PROJECTM_API FMassAvoidanceNeighborSnapshot
+{
+	void SetNum(const int32 NumSlots);
+	int32 Num() const { return Flags.Num(); }
+
+	// Slots of obstacles added to the grid after the snapshot was taken are out of range and treated as invalid.
+	bool IsValidSlot(const int32 Slot) const { return Flags.IsValidIndex(Slot) && EnumHasAnyFlags(Flags[Slot], EMassAvoidanceNeighborFlags::Valid); }
+
+	TArray<EMassAvoidanceNeighborFlags> Flags;
+	TArray<FMassEntityHandle> Entities;
+	TArray<FVector> Locations;
+	TArray<FVector> Forwards;
+	TArray<FVector> Velocities;
+	TArray<float> Radii;
+	TArray<float> ColliderRadii;
+	TArray<float> PillHalfLengths;
+	TArray<FVector> GhostLocations;
+	TArray<FVector> MoveTargetCenters;
+};
+
+/** Owns the FMassAvoidanceNeighborSnapshot shared by the fast avoidance processors. */
+UCLASS()
+class PROJECTM_API UMassFastAvoidanceSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	const FMassAvoidanceNeighborSnapshot& GetNeighborSnapshot() const { return NeighborSnapshot; }
+	FMassAvoidanceNeighborSnapshot& GetMutableNeighborSnapshot() { return NeighborSnapshot; }
+
+protected:
+	FMassAvoidanceNeighborSnapshot NeighborSnapshot;
+};
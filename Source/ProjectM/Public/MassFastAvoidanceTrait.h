@@ -4,13 +4,54 @@
 
 #include "MassEntityTraitBase.h"
 #include "Avoidance/MassAvoidanceFragments.h"
+#include "MassLODTypes.h"
 #include "MassFastAvoidanceTrait.generated.h"
 
+USTRUCT()
+struct PROJECTM_API FMassFastAvoidanceLODSettings
+{
+	GENERATED_BODY()
+
+	/** Maximum number of close agents avoided. */
+	UPROPERTY(EditAnywhere, Category = "", meta = (ClampMin = "0"))
+	int32 MaxNeighbors = 6;
+
+	/** Seconds between avoidance updates, the last avoidance force is reapplied in between. 0 updates every frame. */
+	UPROPERTY(EditAnywhere, Category = "", meta = (ClampMin = "0.0", ForceUnits = "s"))
+	float UpdateInterval = 0.f;
+
+	/** Moving avoidance only. */
+	UPROPERTY(EditAnywhere, Category = "")
+	bool bEnableEnvironmentAvoidance = true;
+};
+
+/** Per entity state for running avoidance at a lower rate than every frame. */
+USTRUCT()
+struct PROJECTM_API FMassFastAvoidanceLODFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	float NextUpdateTime = 0.f;
+
+	// Agent avoidance force from the last update. Environment avoidance is recomputed every frame.
+	FVector HeldForce = FVector::ZeroVector;
+
+	// Changing action or LOD forces an update.
+	uint16 ActionID = 0;
+	TEnumAsByte<EMassLOD::Type> LOD = EMassLOD::Max;
+};
+
 USTRUCT()
 struct PROJECTM_API FMassFastMovingAvoidanceParameters : public FMassMovingAvoidanceParameters
 {
 	GENERATED_BODY()
 
+	FMassFastMovingAvoidanceParameters();
+
+	/** Avoidance settings per simulation LOD. Entities with a target always use High. Off LOD entities don't run avoidance. */
+	UPROPERTY(EditAnywhere, Category = "LOD")
+	FMassFastAvoidanceLODSettings LODSettings[EMassLOD::Off];
+
 	FMassFastMovingAvoidanceParameters GetValidated() const
 	{
 		FMassFastMovingAvoidanceParameters Copy = *this;
@@ -20,6 +61,10 @@ struct PROJECTM_API FMassFastMovingAvoidanceParameters : public FMassMovingAvoid
 		Copy.EnvironmentSeparationDistance = FMath::Max(Copy.EnvironmentSeparationDistance, KINDA_SMALL_NUMBER);
 		Copy.StartOfPathDuration = FMath::Max(Copy.StartOfPathDuration, KINDA_SMALL_NUMBER);
 		Copy.EndOfPathDuration = FMath::Max(Copy.EndOfPathDuration, KINDA_SMALL_NUMBER);
+		for (FMassFastAvoidanceLODSettings& Settings : Copy.LODSettings)
+		{
+			Settings.UpdateInterval = FMath::Max(Settings.UpdateInterval, 0.f);
+		}
 
 		return Copy;
 	}
@@ -30,11 +75,26 @@ struct PROJECTM_API FMassFastStandingAvoidanceParameters : public FMassStandingA
 {
 	GENERATED_BODY()
 
+	FMassFastStandingAvoidanceParameters();
+
+	/** Avoidance settings per simulation LOD. Entities with a target always use High. Off LOD entities don't run avoidance. */
+	UPROPERTY(EditAnywhere, Category = "LOD")
+	FMassFastAvoidanceLODSettings LODSettings[EMassLOD::Off];
+
+	/** Squad members standing without a target use at least this LOD, however close they are. */
+	UPROPERTY(EditAnywhere, Category = "LOD")
+	TEnumAsByte<EMassLOD::Type> IdleFormationLOD = EMassLOD::Low;
+
 	FMassFastStandingAvoidanceParameters GetValidated() const
 	{
 		FMassFastStandingAvoidanceParameters Copy = *this;
 
 		Copy.GhostSteeringReactionTime = FMath::Max(Copy.GhostSteeringReactionTime, KINDA_SMALL_NUMBER);
+		Copy.IdleFormationLOD = FMath::Min(Copy.IdleFormationLOD.GetValue(), EMassLOD::Low);
+		for (FMassFastAvoidanceLODSettings& Settings : Copy.LODSettings)
+		{
+			Settings.UpdateInterval = FMath::Max(Settings.UpdateInterval, 0.f);
+		}
 
 		return Copy;
 	}
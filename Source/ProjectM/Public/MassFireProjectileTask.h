@@ -11,8 +11,10 @@ class UMassSignalSubsystem;
 struct FTransformFragment;
 struct FTeamMemberFragment;
 struct FTargetEntityFragment;
+struct FMassTurretFragment;
+struct FMassVertexAnimationMontageFragment;
 
-void SpawnProjectile(const UWorld* World, const FVector& SpawnLocation, const FQuat& SpawnRotation, const FVector& InitialVelocity, const FMassEntityConfig& EntityConfig, const bool& bIsProjectileFromTeam1);
+void SpawnProjectile(const UWorld* World, const FVector& SpawnLocation, const FQuat& SpawnRotation, const FVector& InitialVelocity, const FMassEntityConfig& EntityConfig, const uint8 SourceTeamIndex);
 
 USTRUCT()
 struct PROJECTM_API FMassFireProjectileTaskInstanceData
@@ -44,8 +46,14 @@ protected:
 	TStateTreeExternalDataHandle<FTransformFragment> EntityTransformHandle;
 	TStateTreeExternalDataHandle<FTeamMemberFragment> TeamMemberHandle;
 	TStateTreeExternalDataHandle<FTargetEntityFragment> TargetEntityHandle;
+	TStateTreeExternalDataHandle<FMassTurretFragment, EStateTreeExternalDataRequirement::Optional> TurretHandle;
+	TStateTreeExternalDataHandle<FMassVertexAnimationMontageFragment, EStateTreeExternalDataRequirement::Optional> VertexAnimationMontageHandle;
 
 	TStateTreeInstanceDataPropertyHandle<FMassEntityConfig> EntityConfigHandle;
 	TStateTreeInstanceDataPropertyHandle<float> WeaponCoolDownSecondsHandle;
 	TStateTreeInstanceDataPropertyHandle<float> LastWeaponFireTimeSecondsHandle;
+
+	/** Montage of UMassVertexAnimationMontageTrait played when firing, so that vertex animated soldiers are seen firing. */
+	UPROPERTY(EditAnywhere, Category = Parameter)
+	FName FiringVertexAnimationMontage = TEXT("Fire");
 };
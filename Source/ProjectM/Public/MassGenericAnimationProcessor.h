@@ -6,10 +6,15 @@
 #include "MassRepresentationTypes.h"
 #include "LightweightMontageInstance.h"
 #include "ContextualAnimSceneAsset.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Containers/Queue.h"
 
 #include "MassGenericAnimationProcessor.generated.h"
 
+class UAnimInstance;
 class UAnimToTextureDataAsset;
+class UMotionWarpingComponent;
+class USkeletalMeshComponent;
 struct FMassActorFragment;
 
 // TODO: Rename to remove "Crowd"
@@ -43,10 +48,34 @@ struct PROJECTM_API FMassGenericMontageFragment : public FMassFragment
 	FRootMotionMovementParams RootMotionParams = FRootMotionMovementParams();
 	float SkippedTime = 0.0f;
 
+	// Actor the montage was last played on by UMassGenericActorAnimationProcessor, so that it's only requested again for a new actor. A montage
+	// that gets interrupted on the same actor is not played again.
+	TWeakObjectPtr<const AActor> PlayedOnActor;
+
 	void Request(const UE::CrowdInteractionAnim::FRequest& InRequest);
 	void Clear();
 };
 
+// Components of an entity's actor, resolved once when the representation system spawns or recycles an actor for the entity and reset when the
+// actor is released, so that playing montages doesn't search the actor's components.
+struct PROJECTM_API FMassGenericActorComponents
+{
+	// Game thread only.
+	void Resolve(const AActor* InActor);
+	void Reset() { *this = FMassGenericActorComponents(); }
+	bool IsResolvedFor(const AActor* InActor) const { return InActor && Actor == InActor; }
+
+	// Not cached itself, as the mesh recreates its anim instance when it's reinitialized.
+	UAnimInstance* GetAnimInstance() const;
+
+	TWeakObjectPtr<const AActor> Actor;
+	TWeakObjectPtr<USkeletalMeshComponent> Mesh;
+	TWeakObjectPtr<UMotionWarpingComponent> MotionWarpingComponent;
+
+	// Skeletal mesh components attached to Mesh, e.g. heads and gear.
+	TArray<TWeakObjectPtr<USkeletalMeshComponent>> AttachedMeshes;
+};
+
 USTRUCT()
 struct PROJECTM_API FGenericAnimationFragment : public FMassFragment
 {
@@ -57,8 +86,35 @@ struct PROJECTM_API FGenericAnimationFragment : public FMassFragment
 	float PlayRate = 1.0f;
 	int32 AnimationStateIndex = 0;
 	bool bSwappedThisFrame = false;
+
+	FMassGenericActorComponents ActorComponents;
+};
+
+// Work on an actor represented entity that needs the game thread.
+struct FMassGenericActorAnimationRequest
+{
+	FMassEntityHandle Entity;
+	bool bSwappedThisFrame = false;
+};
+
+// Hands the actor animation requests of UMassGenericAnimationProcessor's parallel passes to UMassGenericActorAnimationProcessor.
+UCLASS()
+class PROJECTM_API UMassGenericAnimationSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	TQueue<FMassGenericActorAnimationRequest, EQueueMode::Mpsc>& GetActorAnimationRequests() { return ActorAnimationRequests; }
+
+protected:
+	TQueue<FMassGenericActorAnimationRequest, EQueueMode::Mpsc> ActorAnimationRequests;
 };
 
+/**
+ * Evaluates the animation state of every visible entity in parallel: advances montages, picks vertex animation states and consumes root motion.
+ * Actor represented entities that need their montage played or were swapped to an actor this frame are queued for
+ * UMassGenericActorAnimationProcessor, which is the only part that runs on the game thread.
+ */
 UCLASS()
 class PROJECTM_API UMassGenericAnimationProcessor : public UMassProcessor
 {
@@ -71,9 +127,8 @@ public:
 	float MoveThresholdSq = 750.0f;
 
 private:
-	void UpdateAnimationFragmentData(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context, float GlobalTime, TArray<FMassEntityHandle, TInlineAllocator<32>>& ActorEntities);
-	void UpdateVertexAnimationState(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context, float GlobalTime);
-	void UpdateSkeletalAnimation(UMassEntitySubsystem& EntitySubsystem, float GlobalTime, TArrayView<FMassEntityHandle> ActorEntities);
+	static void UpdateAnimationFragmentData(FMassExecutionContext& Context, float GlobalTime, TQueue<FMassGenericActorAnimationRequest, EQueueMode::Mpsc>& ActorAnimationRequests);
+	void UpdateVertexAnimationState(FMassExecutionContext& Context, float GlobalTime) const;
 
 protected:
 
@@ -82,16 +137,40 @@ protected:
 	virtual void Initialize(UObject& Owner) override;
 	virtual void Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context) override;
 
-	static class UAnimInstance* GetAnimInstanceFromActor(const class AActor* Actor);
-
 	UPROPERTY(Transient)
 	UWorld* World = nullptr;
 
+	TObjectPtr<UMassGenericAnimationSubsystem> AnimationSubsystem;
+
 	FMassEntityQuery AnimationEntityQuery_Conditional;
 	FMassEntityQuery MontageEntityQuery;
 	FMassEntityQuery MontageEntityQuery_Conditional;
 };
 
+// Applies the actor animation requests queued by UMassGenericAnimationProcessor on the game thread.
+UCLASS()
+class PROJECTM_API UMassGenericActorAnimationProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+
+public:
+	UMassGenericActorAnimationProcessor();
+
+protected:
+	virtual void ConfigureQueries() override;
+	virtual void Initialize(UObject& Owner) override;
+	virtual void Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context) override;
+
+	static void UpdateSkeletalAnimation(const AActor* Actor, FMassGenericMontageFragment& MontageFragment, FGenericAnimationFragment& AnimationData, const bool bSwappedThisFrame);
+
+	TObjectPtr<UMassGenericAnimationSubsystem> AnimationSubsystem;
+
+	FMassEntityQuery EntityQuery;
+
+	// Frame buffer, it gets reset every frame. Value is whether the entity was swapped to an actor this frame.
+	TMap<FMassEntityHandle, bool> TransientRequests;
+};
+
 // Adapted from CitySample UCitySampleCrowdVisualizationFragmentInitializer.
 UCLASS()
 class PROJECTM_API UGenericAnimationFragmentInitializer : public UMassObserverProcessor
@@ -8,6 +8,7 @@
 
 struct FMassInstancedStaticMeshInfo;
 struct FGenericAnimationFragment;
+struct FAnimToTextureInstancePlaybackData;
 
 UCLASS()
 class PROJECTM_API UMassGenericUpdateISMVertexAnimationProcessor : public UMassUpdateISMProcessor
@@ -18,6 +19,9 @@ public:
 
 	static void UpdateISMVertexAnimation(FMassInstancedStaticMeshInfo& ISMInfo, FGenericAnimationFragment& AnimationData, const float LODSignificance, const float PrevLODSignificance, const int32 NumFloatsToPad = 0);
 
+	// Custom data of a vertex animated instance, also used for the static instances of UMassBattlefieldClutterSubsystem.
+	static FAnimToTextureInstancePlaybackData MakeInstancePlaybackData(const FGenericAnimationFragment& AnimationData);
+
 protected:
 
 	/** Configure the owned FMassEntityQuery instances to express processor's requirements */
@@ -7,11 +7,10 @@
 #include "MassNavigationFragments.h"
 #include "MassEntityTraitBase.h"
 #include <MilitaryStructureSubsystem.h>
+#include "MassMoveToCommandSubsystem.h"
 
 #include "MassMoveToCommandProcessor.generated.h"
 
-class UMassMoveToCommandSubsystem;
-
 bool IsSquadMember(const UMilitaryUnit* MilitaryUnit);
 
 USTRUCT()
@@ -130,7 +129,19 @@ protected:
 	virtual void Initialize(UObject& Owner) override;
 	virtual void Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context) override;
 
+	// Queues the entities that the command applies to. Their paths are found over as many frames as the frame budget needs.
+	void BeginMoveToCommand(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context, const FMoveToCommand& MoveToCommand);
+
 private:
 	TObjectPtr<UMassMoveToCommandSubsystem> MoveToCommandSubsystem;
 	FMassEntityQuery EntityQuery;
+
+	// The command whose paths are being found. Its unit may be destroyed before all of them are, so it's only weakly referenced.
+	TWeakObjectPtr<const UMilitaryUnit> PendingMoveToCommandMilitaryUnit;
+	FVector PendingMoveToCommandTarget = FVector::ZeroVector;
+	uint8 PendingMoveToCommandTeamIndex = 0;
+	TArray<FMassEntityHandle> PendingPathEntities;
+	int32 NextPendingPathEntityIndex = 0;
+	int32 NumEntitiesSetMoveTarget = 0;
+	int32 NumEntitiesAttemptedSetMoveTarget = 0;
 };
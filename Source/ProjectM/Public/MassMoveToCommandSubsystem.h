@@ -12,14 +12,14 @@ class UMilitaryUnit;
 
 struct FMoveToCommand
 {
-	FMoveToCommand(const UMilitaryUnit* MilitaryUnit, FVector Target, bool bIsOnTeam1)
-		: MilitaryUnit(MilitaryUnit), Target(Target), bIsOnTeam1(bIsOnTeam1)
+	FMoveToCommand(const UMilitaryUnit* MilitaryUnit, FVector Target, uint8 TeamIndex)
+		: MilitaryUnit(MilitaryUnit), Target(Target), TeamIndex(TeamIndex)
 	{
 	}
 	FMoveToCommand() = default;
 	const UMilitaryUnit* MilitaryUnit;
 	FVector Target;
-	bool bIsOnTeam1;
+	uint8 TeamIndex;
 };
 
 UCLASS()
@@ -28,9 +28,12 @@ class PROJECTM_API UMassMoveToCommandSubsystem : public UWorldSubsystem
 	GENERATED_BODY()
 
 public:
-	void EnqueueMoveToCommand(const UMilitaryUnit* MilitaryUnit, const FVector Target, const bool bIsOnTeam1);
+	void EnqueueMoveToCommand(const UMilitaryUnit* MilitaryUnit, const FVector Target, const uint8 TeamIndex);
 	bool DequeueMoveToCommand(FMoveToCommand& OutMoveToCommand);
 
+	// Drops queued commands, e.g. when the military units they refer to are replaced by a world snapshot.
+	void ResetMoveToCommands();
+
 protected:
 	TQueue<FMoveToCommand> MoveToCommandQueue;
 };
@@ -0,0 +1,97 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityTypes.h"
+#include "Subsystems/WorldSubsystem.h"
+
+#include "MassProcessorBudgetSubsystem.generated.h"
+
+struct FMassEntityQuery;
+struct FMassExecutionContext;
+class UMassEntitySubsystem;
+
+/**
+ * Frame time budget of a processor that supports doing part of its work per frame. Measures the time and number of work items over the last
+ * frames and turns the millisecond budget into a work quota. Work over the quota is left for the following frames, so a spike shows up as
+ * added latency instead of a longer frame. Owned by UMassProcessorBudgetSubsystem and only used by its processor's Execute, which looks it up
+ * every time since it's destroyed with the subsystem.
+ */
+class PROJECTM_API FMassProcessorFrameBudget
+{
+public:
+	FMassProcessorFrameBudget(const FName InName, const float& InBudgetMilliseconds);
+
+	// Number of the pending work items to do this frame. All of them when the budget is disabled or nothing was measured yet.
+	int32 GetWorkQuota(const int32 NumPendingItems) const;
+
+	/**
+	 * For work items that are entities which stay pending until processed. Selects the quota's share of entities to process this frame, moving
+	 * the selection on every frame so that all pending entities get their turn. NumPendingEntities must only count entities that are
+	 * processed this frame, see CountEntitiesThisFrame.
+	 */
+	void BeginEntitySelection(const int32 NumPendingEntities);
+
+	// Number of entities the query processes this frame. Unlike GetNumMatchingEntities, this respects the query's chunk filter, e.g. tick tiers.
+	static int32 CountEntitiesThisFrame(FMassEntityQuery& EntityQuery, UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context);
+
+	// Thread-safe between BeginEntitySelection calls.
+	bool IsEntitySelected(const FMassEntityHandle& Entity) const;
+
+	void RecordWork(const int32 NumItems, const double Seconds);
+
+	FName GetName() const { return Name; }
+	float GetBudgetMilliseconds() const { return BudgetMilliseconds; }
+	double GetAverageMilliseconds() const;
+	int32 GetLastQuota() const { return LastQuota; }
+	int32 GetLastNumPendingItems() const { return LastNumPendingItems; }
+
+	static constexpr int32 WindowSize = 30;
+
+	// So that work keeps progressing even if an item is much more expensive than the budget.
+	static constexpr int32 MinItemsPerFrame = 8;
+
+private:
+	FName Name;
+
+	// References the processor's CVar so that the budget can be tuned at runtime.
+	const float& BudgetMilliseconds;
+
+	double WindowSeconds[WindowSize] = {};
+	int32 WindowItems[WindowSize] = {};
+	int32 WindowIndex = 0;
+	int32 NumWindowFrames = 0;
+	double TotalWindowSeconds = 0.;
+	int64 TotalWindowItems = 0;
+
+	float SelectionPhase = 0.f;
+	float SelectionFraction = 1.f;
+
+	mutable int32 LastQuota = 0;
+	mutable int32 LastNumPendingItems = 0;
+};
+
+/**
+ * Keeps the frame budgets of ProjectM processors. Processors look their budget up in Execute. Use pm.DumpProcessorFrameBudgets to see
+ * measured times against the budgets.
+ */
+UCLASS()
+class PROJECTM_API UMassProcessorBudgetSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	// Game thread only. The budget lives as long as the subsystem.
+	FMassProcessorFrameBudget& FindOrAddBudget(const FName Name, const float& BudgetMilliseconds);
+
+	// Game thread only. Returns nullptr if the world has no budget subsystem. Don't keep the result beyond the current Execute.
+	static FMassProcessorFrameBudget* FindOrAddBudget(const UWorld* World, const FName Name, const float& BudgetMilliseconds);
+
+	void DumpBudgets() const;
+
+protected:
+	TMap<FName, TUniquePtr<FMassProcessorFrameBudget>> Budgets;
+};
@@ -32,4 +32,5 @@ class PROJECTM_API UMassSimpleUpdateISMProcessor : public UMassUpdateISMProcesso
 protected:
 	/** Configure the owned FMassEntityQuery instances to express processor's requirements */
 	virtual void ConfigureQueries() override;
+	virtual void Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context) override;
 };
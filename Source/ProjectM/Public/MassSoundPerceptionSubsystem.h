@@ -27,18 +27,25 @@ public:
 	UMassSoundPerceptionSubsystem();
 
 	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
-	void AddSoundPerception(const FVector Location, const bool& bIsSourceFromTeam1, const bool SkipDebugDraw = false);
+	void AddSoundPerception(const FVector Location, const uint8 SourceTeamIndex, const bool SkipDebugDraw = false);
 	void AddSoundPerception(const FVector Location); // Use this overload for sounds that are not specific to a team.
-	bool GetSoundsNearLocation(const FVector& Location, TArray<FVector>& OutCloseSounds, const bool bFilterToTeam1);
+	/** Gathers sounds made by any team in SourceTeamsMask, plus environment sounds. */
+	bool GetSoundsNearLocation(const FVector& Location, TArray<FVector>& OutCloseSounds, const uint32 SourceTeamsMask);
+
+	// Writes or replaces the pending sound perceptions of every grid. Called by UMassWorldSnapshotSubsystem.
+	void SerializeSnapshot(FArchive& Ar);
 
 protected:
 	virtual void Tick(float DeltaTime) override;
 	virtual TStatId GetStatId() const override;
 
-	FSoundPerceptionHashGrid2D SoundPerceptionGridForTeam1;
-	FSoundPerceptionHashGrid2D SoundPerceptionGridForTeam2;
-	TMap<uint32, FMassSoundPerceptionItemMetaData> IdsToMetaDataForTeam1;
-	TMap<uint32, FMassSoundPerceptionItemMetaData> IdsToMetaDataForTeam2;
+	void AddSoundPerceptionToGrid(const FVector& Location, const int32 GridIndex, const uint8 TicksLeftTilDestruction = FramesUntilSoundPerceptionDestruction);
+	void TickGrid(const int32 GridIndex);
+	void QueryGrid(const FBox& QueryBox, const int32 GridIndex, TArray<FVector>& OutCloseSounds) const;
+
+	// Indexed by source team index. The extra last grid holds sounds that are not specific to a team.
+	TArray<FSoundPerceptionHashGrid2D> SoundPerceptionGrids;
+	TArray<TMap<uint32, FMassSoundPerceptionItemMetaData>> IdsToMetaData;
 
 	static constexpr int FramesUntilSoundPerceptionDestruction = 2; // We don't use 1 to avoid having to deal with ordering of various events in single game tick.
 };
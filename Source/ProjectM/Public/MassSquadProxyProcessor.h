@@ -0,0 +1,94 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassProcessor.h"
+#include "MassEntityTraitBase.h"
+#include "MassSquadProxySubsystem.h"
+#include "UObject/ObjectKey.h"
+
+#include "MassSquadProxyProcessor.generated.h"
+
+class UMassLODSubsystem;
+class UMilitaryStructureSubsystem;
+class UMilitaryUnit;
+
+inline bool UMassSquadProxyProcessor_Enabled = true;
+inline FAutoConsoleVariableRef CVarUMassSquadProxyProcessor_Enabled(TEXT("pm.UMassSquadProxyProcessor_Enabled"), UMassSquadProxyProcessor_Enabled, TEXT("Represent far away squads by a single proxy instance. When disabled, all soldiers move back to their own instances."));
+
+inline float UMassSquadProxyProcessor_Distance = 30000.f;
+inline FAutoConsoleVariableRef CVarUMassSquadProxyProcessor_Distance(TEXT("pm.UMassSquadProxyProcessor_Distance"), UMassSquadProxyProcessor_Distance, TEXT("Distance from a squad's center to the closest viewer from which the squad is represented by its proxy."));
+
+inline float UMassSquadProxyProcessor_UpdateInterval = 0.25f;
+inline FAutoConsoleVariableRef CVarUMassSquadProxyProcessor_UpdateInterval(TEXT("pm.UMassSquadProxyProcessor_UpdateInterval"), UMassSquadProxyProcessor_UpdateInterval, TEXT("Seconds between decisions of which squads are represented by proxies and which soldiers are dying and leave them. Proxies follow their squads every frame."));
+
+// Soldier that can be aggregated into its squad's proxy. Added by UMassSquadProxyTrait.
+USTRUCT()
+struct PROJECTM_API FMassSquadProxyCandidateTag : public FMassTag
+{
+	GENERATED_BODY()
+};
+
+// Soldier represented by its squad's proxy. UMassGenericUpdateISMVertexAnimationProcessor doesn't add instances for it.
+USTRUCT()
+struct PROJECTM_API FMassAggregatedIntoSquadProxyTag : public FMassTag
+{
+	GENERATED_BODY()
+};
+
+/** Lets UMassSquadProxyProcessor represent this soldier's squad by a single proxy instance when it's far away from every viewer. */
+UCLASS(meta = (DisplayName = "Squad Proxy"))
+class PROJECTM_API UMassSquadProxyTrait : public UMassEntityTraitBase
+{
+	GENERATED_BODY()
+
+protected:
+	virtual void BuildTemplate(FMassEntityTemplateBuildContext& BuildContext, UWorld& World) const override;
+
+	UPROPERTY(EditAnywhere, Category = "")
+	FMassSquadProxyParameters Proxy;
+};
+
+/**
+ * Represents squads of UMilitaryStructureSubsystem that are far away from every viewer by a single proxy instance instead of one vertex
+ * animated instance per soldier. Squads are only aggregated when every living member is a static mesh instance with UMassSquadProxyTrait,
+ * and dying soldiers are shown individually again from the next update on. The proxy follows the squad's center and its leader's rotation.
+ */
+UCLASS()
+class PROJECTM_API UMassSquadProxyProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+
+public:
+	UMassSquadProxyProcessor();
+
+protected:
+	struct FSquadProxy
+	{
+		int32 ProxyId = INDEX_NONE;
+		TArray<FMassEntityHandle> Members;
+		bool bSeen = false;
+	};
+
+	virtual void ConfigureQueries() override;
+	virtual void Initialize(UObject& Owner) override;
+	virtual void Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context) override;
+
+	void UpdateSquads(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context);
+	void UpdateProxyTransforms(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context);
+	void AggregateMembers(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context, FSquadProxy& SquadProxy, const TArray<FMassEntityHandle>& Members);
+	void RestoreMember(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context, const FMassEntityHandle Entity);
+	void RestoreSquad(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context, FSquadProxy& SquadProxy);
+
+	// Returns false if the squad has members that can't be aggregated.
+	static bool GetMembersToAggregate(const UMassEntitySubsystem& EntitySubsystem, const UMilitaryUnit* SquadUnit, TArray<FMassEntityHandle>& OutMembers);
+	static bool GetProxyTransform(const UMassEntitySubsystem& EntitySubsystem, const TArray<FMassEntityHandle>& Members, FTransform& OutTransform);
+
+	TObjectPtr<UMassLODSubsystem> LODSubsystem;
+	TObjectPtr<UMilitaryStructureSubsystem> MilitaryStructureSubsystem;
+	TObjectPtr<UMassSquadProxySubsystem> SquadProxySubsystem;
+
+	TMap<TObjectKey<UMilitaryUnit>, FSquadProxy> SquadProxies;
+	float TimeUntilUpdate = 0.f;
+};
@@ -0,0 +1,86 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityTypes.h"
+#include "Subsystems/WorldSubsystem.h"
+
+#include "MassSquadProxySubsystem.generated.h"
+
+class UInstancedStaticMeshComponent;
+class UMaterialInterface;
+class UStaticMesh;
+
+/** Mesh that stands in for a whole squad of soldiers far away from every viewer, e.g. an impostor of nine soldiers. */
+USTRUCT()
+struct PROJECTM_API FMassSquadProxyParameters : public FMassSharedFragment
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, Category = "Squad Proxy")
+	TObjectPtr<UStaticMesh> Mesh = nullptr;
+
+	UPROPERTY(EditAnywhere, Category = "Squad Proxy")
+	TArray<TObjectPtr<UMaterialInterface>> MaterialOverrides;
+
+	UPROPERTY(EditAnywhere, Category = "Squad Proxy")
+	bool bCastShadows = false;
+};
+
+USTRUCT()
+struct FMassSquadProxyType
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Transient)
+	FMassSquadProxyParameters Parameters;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UInstancedStaticMeshComponent> Component = nullptr;
+
+	// Instances of removed proxies, hidden until they are reused. Instances are never removed so that the indices of the others stay valid.
+	TArray<int32> FreeInstanceIndices;
+
+	bool bRenderStateDirty = false;
+};
+
+/**
+ * Renders squad proxies placed by UMassSquadProxyProcessor, one instanced static mesh component per proxy mesh. Proxies move with their
+ * squads, so instance transforms are batched and each component's render state is only marked dirty once per frame in FlushProxies.
+ */
+UCLASS()
+class PROJECTM_API UMassSquadProxySubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	// Game thread only. Returns the id of the proxy, or INDEX_NONE if the parameters have no mesh.
+	int32 AddProxy(const FMassSquadProxyParameters& Parameters, const FTransform& Transform);
+	void UpdateProxy(const int32 ProxyId, const FTransform& Transform);
+	void RemoveProxy(const int32 ProxyId);
+
+	// Sends the transforms changed since the last flush to the renderer.
+	void FlushProxies();
+
+	int32 Num() const { return Proxies.Num(); }
+
+protected:
+	struct FProxy
+	{
+		int32 TypeIndex;
+		int32 InstanceIndex;
+	};
+
+	int32 FindOrAddType(const FMassSquadProxyParameters& Parameters);
+
+	UPROPERTY(Transient)
+	TObjectPtr<AActor> ProxyActor = nullptr;
+
+	UPROPERTY(Transient)
+	TArray<FMassSquadProxyType> Types;
+
+	TSparseArray<FProxy> Proxies;
+};
@@ -0,0 +1,69 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Async/Future.h"
+#include "StaticOccluderField.h"
+
+#include "MassStaticOccluderSubsystem.generated.h"
+
+class UMassTraceContextSubsystem;
+
+/**
+ * Owns the level's FStaticOccluderField. The field covers AProjectMWorldInfo's world map bounds and is loaded from the Saved directory if one
+ * was saved earlier for the same bounds and static collision. Otherwise it is built from static collision on a background task and saved, and
+ * traces use physics until it's ready.
+ */
+UCLASS()
+class PROJECTM_API UMassStaticOccluderSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+
+	// Conservative answer for whether static geometry blocks the trace. Only Blocked makes the physics trace unnecessary. Thread-safe. Returns
+	// Unknown when disabled or not built yet.
+	EStaticOcclusionResult Raycast(const FVector& Start, const FVector& End, const float Radius = 0.f) const;
+
+	const FStaticOccluderField& GetField() const { return Field; }
+	// Bounds the field was requested for. The field's own bounds are rounded up to whole cells.
+	const FBox& GetSourceBounds() const { return SourceBounds; }
+
+	// Starts building the field on a background task. The current field, if any, is used until the new one replaces it and is saved.
+	void BuildField(const FBox& Bounds);
+	bool SaveField();
+
+protected:
+	struct FFieldBuild;
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	void FinishBuildField();
+	bool LoadField(const FBox& ExpectedBounds, const uint32 ExpectedContentHash);
+	FString GetFieldFilePath() const;
+
+	// Hash of the static collision the field is built from, so that a saved field is rebuilt when the level changes.
+	uint32 CalculateContentHash(const FBox& Bounds) const;
+
+	// Returns the height below which the whole cell is landscape, or -MAX_flt if any sample doesn't hit landscape or the samples are too uneven
+	// to tell. The voxels of such partially blocked cells are all tested against physics instead.
+	float CalculateGroundHeight(const FFieldBuild& Build, const FBox& ColumnBounds) const;
+	uint64 CalculateOccupiedVoxels(const FFieldBuild& Build, const int32 X, const int32 Y, const float GroundHeight) const;
+	void CalculateOccupiedVoxelRange(const FFieldBuild& Build, const int32 X, const int32 Y, const int32 FirstVoxel, const int32 LastVoxel, uint64& OutOccupiedVoxels) const;
+
+	FStaticOccluderField Field;
+	FBox SourceBounds = FBox(ForceInit);
+	uint32 SourceContentHash = 0;
+
+	TSharedPtr<FFieldBuild> PendingBuild;
+	TFuture<void> PendingBuildTask;
+
+	UPROPERTY(Transient)
+	UMassTraceContextSubsystem* TraceContextSubsystem;
+};
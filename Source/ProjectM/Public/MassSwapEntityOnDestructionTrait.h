@@ -3,15 +3,21 @@
 #include "MassEntityTraitBase.h"
 #include "MassObserverProcessor.h"
 #include "MassEntityConfigAsset.h"
+#include "MassVisualEffectsSubsystem.h"
 
 #include "MassSwapEntityOnDestructionTrait.generated.h"
 
+class UMassBattlefieldClutterSubsystem;
+
 USTRUCT()
 struct PROJECTM_API FMassSwapEntityOnDestructionFragment : public FMassFragment
 {
 	GENERATED_BODY()
 	UPROPERTY(EditAnywhere, Category = "")
 	int16 SwappedEntityConfigIndex = -1;
+
+	UPROPERTY(EditAnywhere, Category = "")
+	bool bSwapToClutter = true;
 };
 
 UCLASS(meta = (DisplayName = "SwapEntityOnDestruction"))
@@ -24,6 +30,11 @@ protected:
 
 	UPROPERTY(EditAnywhere)
 	UMassEntityConfigAsset* SwappedEntityConfig = nullptr;
+
+	// Leave the swapped entity as a static instance in UMassBattlefieldClutterSubsystem instead of spawning it, e.g. for wrecks. Falls back to
+	// spawning it if it has no static mesh representation.
+	UPROPERTY(EditAnywhere)
+	bool bSwapToClutter = true;
 };
 
 UCLASS()
@@ -35,7 +46,12 @@ class PROJECTM_API UMassSwapEntityOnDestructionProcessor : public UMassObserverP
 
 protected:
 	virtual void ConfigureQueries() override;
+	virtual void Initialize(UObject& Owner) override;
 	virtual void Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context) override;
 
 	FMassEntityQuery EntityQuery;
+	TObjectPtr<UMassVisualEffectsSubsystem> VisualEffectsSubsystem;
+	TObjectPtr<UMassBattlefieldClutterSubsystem> BattlefieldClutterSubsystem;
+
+	TArray<FMassVisualEffectRequest> SwapRequests;
 };
@@ -1,15 +1,17 @@
 #pragma once
 
 #include "MassEntityTypes.h"
+#include "MassCollisionProcessor.h"
 #include "HierarchicalHashGrid2D.h"
+#include "GridCellTraversal.h"
 #include "Subsystems/WorldSubsystem.h"
 
 #include "MassTargetFinderSubsystem.generated.h"
 
 struct FMassTargetGridItem
 {
-	FMassTargetGridItem(FMassEntityHandle InEntity, bool bInIsOnTeam1,float InMinCaliberForDamage, bool bInIsSoldier) 
-		: Entity(InEntity), bIsOnTeam1(bInIsOnTeam1), MinCaliberForDamage(InMinCaliberForDamage), bIsSoldier(bInIsSoldier)
+	FMassTargetGridItem(FMassEntityHandle InEntity, uint32 InTeamMask, float InMinCaliberForDamage, bool bInIsSoldier) 
+		: Entity(InEntity), TeamMask(InTeamMask), MinCaliberForDamage(InMinCaliberForDamage), bIsSoldier(bInIsSoldier)
 	{
 	}
 
@@ -21,7 +23,7 @@ struct FMassTargetGridItem
 	}
 
 	FMassEntityHandle Entity;
-	bool bIsOnTeam1;
+	uint32 TeamMask;
 	float MinCaliberForDamage;
 	bool bIsSoldier;
 };
@@ -40,9 +42,92 @@ struct FMassTargetGridItemDynamicData
 	FCapsule Capsule;
 };
 
+/**
+ * Locations and velocities of the entities in the target grid, packed into arrays. An entity keeps its slot for as long as it's in the grid,
+ * so processors can cache the slot of their target and read its location linearly instead of looking up its fragments. Updated once per frame
+ * by UMassTargetGridProcessor, slots of removed entities are reused.
+ */
+struct PROJECTM_API FMassTargetLocationStore
+{
+	int32 Add(const FMassEntityHandle Entity, const FVector& Location);
+	void Remove(const int32 Slot);
+	void Update(const int32 Slot, const FVector& Location, const float DeltaTime);
+
+	int32 FindSlot(const FMassEntityHandle Entity) const
+	{
+		const int32* Slot = EntityToSlot.Find(Entity);
+		return Slot ? *Slot : INDEX_NONE;
+	}
+
+	// A cached slot is stale once its entity was removed, in which case the slot may already belong to another entity.
+	bool IsSlotOfEntity(const int32 Slot, const FMassEntityHandle Entity) const
+	{
+		return Entities.IsValidIndex(Slot) && Entities[Slot] == Entity;
+	}
+
+	// Looks the slot up again when the cached one is stale. Returns false when the entity is no longer in the store.
+	bool ResolveSlot(int32& InOutSlot, const FMassEntityHandle Entity) const
+	{
+		if (!IsSlotOfEntity(InOutSlot, Entity))
+		{
+			InOutSlot = FindSlot(Entity);
+		}
+		return InOutSlot != INDEX_NONE;
+	}
+
+	// Where the entity in the slot will be once a projectile fired from FromLocation reaches it, or where it is for a ProjectileXYSpeed of 0.
+	FVector PredictLocation(const int32 Slot, const FVector& FromLocation, const float ProjectileXYSpeed) const
+	{
+		const FVector& Location = Locations[Slot];
+		if (ProjectileXYSpeed <= 0.f)
+		{
+			return Location;
+		}
+		const float TimeToTarget = FVector2D::Distance(FVector2D(Location), FVector2D(FromLocation)) / ProjectileXYSpeed;
+		return Location + Velocities[Slot] * TimeToTarget;
+	}
+
+	TArray<FMassEntityHandle> Entities;
+	TArray<FVector> Locations;
+	TArray<FVector> Velocities;
+
+protected:
+	TArray<int32> FreeSlots;
+	TMap<FMassEntityHandle, int32> EntityToSlot;
+};
+
 // TODO: Constants here may not be optimal for performance.
 typedef THierarchicalHashGrid2D<2, 2, FMassTargetGridItem> FTargetHashGrid2D;
 
+class UMassEntitySubsystem;
+
+/** Line of fire from an entity to its (potential) target, shared by target finding and target invalidation. */
+struct FLineOfFireQuery
+{
+	FMassEntityHandle Entity;
+	FMassEntityHandle TargetEntity;
+	FCapsule ProjectileTraceCapsule;
+
+	// Entities on these teams that the shooter can damage don't block the line of fire, since hitting them is fine.
+	uint32 HostileTeamsMask = 0;
+	float MinCaliberForDamage = 0.f;
+};
+
+enum class ELineOfFireResult : uint8
+{
+	Clear,
+	BlockedByEntity,
+	BlockedByWorld,
+};
+
+struct FLineOfFireCacheEntry
+{
+	FVector TraceStart;
+	FVector TraceEnd;
+	float Time;
+	ELineOfFireResult Result;
+};
+
 UCLASS()
 class PROJECTM_API UMassTargetFinderSubsystem : public UWorldSubsystem
 {
@@ -59,7 +144,34 @@ public:
 	const TMap<FMassEntityHandle, FMassTargetGridItemDynamicData>& GetTargetDynamicData() const { return TargetDynamicData; }
 	TMap<FMassEntityHandle, FMassTargetGridItemDynamicData>& GetTargetDynamicDataMutable() { return TargetDynamicData; }
 
+	const FMassTargetLocationStore& GetTargetLocationStore() const { return TargetLocationStore; }
+	FMassTargetLocationStore& GetTargetLocationStoreMutable() { return TargetLocationStore; }
+
+	/**
+	 * Checks whether other entities or the world block the line of fire. Results are cached per entity and target for a short time so that
+	 * target finding and target invalidation don't repeat each other's work. Thread-safe.
+	 */
+	ELineOfFireResult QueryLineOfFire(const FLineOfFireQuery& Query, const UMassEntitySubsystem& EntitySubsystem) const;
+
+	// Removes cache entries that are too old to be reused. Called once per frame.
+	void PruneLineOfFireCache(const float CurrentTime);
+
 protected:
+	bool AreEntitiesBlockingLineOfFire(const FLineOfFireQuery& Query, const UMassEntitySubsystem& EntitySubsystem) const;
+
 	FTargetHashGrid2D TargetGrid;
 	TMap<FMassEntityHandle, FMassTargetGridItemDynamicData> TargetDynamicData;
+	FMassTargetLocationStore TargetLocationStore;
+
+	// Finest cell size TargetGrid was created with.
+	float TargetGridCellSize;
+
+	// Sharded so that parallel queries don't all contend on one lock.
+	struct FLineOfFireCacheShard
+	{
+		FRWLock Lock;
+		TMap<TPair<FMassEntityHandle, FMassEntityHandle>, FLineOfFireCacheEntry> Entries;
+	};
+	static constexpr int32 NumLineOfFireCacheShards = 16;
+	mutable FLineOfFireCacheShard LineOfFireCacheShards[NumLineOfFireCacheShards];
 };
@@ -17,6 +17,9 @@ struct PROJECTM_API FMassTargetGridCellLocationFragment : public FMassFragment
 {
 	GENERATED_BODY()
 	FTargetHashGrid2D::FCellLocation CellLoc;
+
+	// Slot in UMassTargetFinderSubsystem's target location store.
+	int32 LocationSlot = INDEX_NONE;
 };
 
 /** Processor to update target grid. Mosty a copy of UMassNavigationObstacleGridProcessor. */
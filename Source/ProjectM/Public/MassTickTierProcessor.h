@@ -0,0 +1,39 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassProcessor.h"
+#include "MassTickTierTrait.h"
+
+#include "MassTickTierProcessor.generated.h"
+
+class UMassLODSubsystem;
+
+/**
+ * Assigns entities with UMassTickTierTrait to an EMassTickTier based on distance to the closest viewer and whether they have a target,
+ * and schedules which chunks tick this frame in FMassTickTierChunkFragment. Entity tiers are only re-evaluated on their chunk's tick
+ * frames.
+ */
+UCLASS()
+class PROJECTM_API UMassTickTierProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+
+public:
+	UMassTickTierProcessor();
+
+	static EMassTickTier CalculateTickTier(const float DistanceToClosestViewer, const bool bInCombat, const EMassTickTier CurrentTier);
+
+protected:
+	virtual void ConfigureQueries() override;
+	virtual void Initialize(UObject& Owner) override;
+	virtual void Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context) override;
+
+	TObjectPtr<UMassLODSubsystem> LODSubsystem;
+
+	FMassEntityQuery TierEntityQueries[static_cast<uint8>(EMassTickTier::MAX)];
+
+	uint32 FrameCounter = 0;
+	std::atomic<uint32> NextChunkFrameOffset{0};
+};
@@ -0,0 +1,98 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#pragma once
+
+#include "MassEntityTraitBase.h"
+#include "MassEntityTypes.h"
+
+#include "MassTickTierTrait.generated.h"
+
+struct FMassExecutionContext;
+
+// How often entities of a tier are processed by processors that filter on FMassTickTierChunkFragment.
+UENUM()
+enum class EMassTickTier : uint8
+{
+	EveryFrame,
+	EverySecondFrame,
+	EveryFourthFrame,
+	EveryEighthFrame,
+	MAX UMETA(Hidden)
+};
+
+// Entities in the EveryFrame tier have none of the tier tags, so that changing tier moves entities to a different archetype and
+// each chunk holds entities of a single tier.
+USTRUCT()
+struct PROJECTM_API FMassTickTierEverySecondFrameTag : public FMassTag
+{
+	GENERATED_BODY()
+};
+
+USTRUCT()
+struct PROJECTM_API FMassTickTierEveryFourthFrameTag : public FMassTag
+{
+	GENERATED_BODY()
+};
+
+USTRUCT()
+struct PROJECTM_API FMassTickTierEveryEighthFrameTag : public FMassTag
+{
+	GENERATED_BODY()
+};
+
+USTRUCT()
+struct PROJECTM_API FMassTickTierFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	EMassTickTier Tier = EMassTickTier::EveryFrame;
+};
+
+/**
+ * Per chunk schedule written by UMassTickTierProcessor. Processors opt in with an optional chunk requirement and
+ * SetChunkFilter(&FMassTickTierChunkFragment::ShouldTickChunkThisFrame), the same way UMassGenericAnimationProcessor skips chunks
+ * that aren't visible. Chunks of entities without UMassTickTierTrait always tick.
+ */
+USTRUCT()
+struct PROJECTM_API FMassTickTierChunkFragment : public FMassChunkFragment
+{
+	GENERATED_BODY()
+
+	static int32 GetTickPeriod(const EMassTickTier Tier) { return 1 << static_cast<uint8>(Tier); }
+
+	static bool ShouldTickChunkThisFrame(const FMassExecutionContext& Context);
+
+	// Time accumulated since the chunk last ticked. Falls back to the context's delta time for chunks without a tier.
+	static float GetChunkDeltaTime(const FMassExecutionContext& Context);
+
+	// Tier period in frames, or 1 for chunks without a tier.
+	static int32 GetChunkTickPeriod(const FMassExecutionContext& Context);
+
+	bool IsInitialized() const { return bInitialized; }
+
+	// Frame offset spreads chunks of the same tier over the tier's period.
+	void Initialize(const uint8 InFrameOffset);
+
+	void Update(const EMassTickTier InTier, const uint32 FrameCounter, const float InDeltaTime);
+
+	EMassTickTier GetTier() const { return Tier; }
+	bool ShouldTickThisFrame() const { return bShouldTickThisFrame; }
+
+private:
+	EMassTickTier Tier = EMassTickTier::EveryFrame;
+	bool bInitialized = false;
+	bool bShouldTickThisFrame = true;
+	uint8 FrameOffset = 0;
+	float TimeSinceLastTick = 0.f;
+	float DeltaTime = 0.f;
+};
+
+// Lets UMassTickTierProcessor lower how often this entity is processed based on distance to players and whether it is in combat.
+UCLASS(meta = (DisplayName = "Tick Tier"))
+class PROJECTM_API UMassTickTierTrait : public UMassEntityTraitBase
+{
+	GENERATED_BODY()
+
+protected:
+	virtual void BuildTemplate(FMassEntityTemplateBuildContext& BuildContext, UWorld& World) const override;
+};
@@ -0,0 +1,48 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "CollisionQueryParams.h"
+#include "Engine/EngineTypes.h"
+
+#include "MassTraceContextSubsystem.generated.h"
+
+/**
+ * Collision query setup shared by all Mass trace call sites, built once instead of per trace.
+ */
+struct PROJECTM_API FMassTraceContext
+{
+	ECollisionChannel VisibilityChannel = ECollisionChannel::ECC_Visibility;
+
+	// Line and sphere visibility traces against everything.
+	FCollisionQueryParams VisibilityQueryParams;
+
+	// Same as VisibilityQueryParams but only against static geometry, used to build the static occluder field.
+	FCollisionQueryParams StaticVisibilityQueryParams;
+
+	FCollisionResponseParams ResponseParams;
+};
+
+/**
+ * Owns the FMassTraceContext. The context is built once and never changes, so it is safe to read from worker threads.
+ */
+UCLASS()
+class PROJECTM_API UMassTraceContextSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	// Thread-safe.
+	const FMassTraceContext& GetTraceContext() const { return TraceContext; }
+
+	bool LineTraceTest(const UWorld& World, const FVector& Start, const FVector& End) const;
+	bool LineTraceSingle(const UWorld& World, FHitResult& OutHitResult, const FVector& Start, const FVector& End) const;
+	bool SphereTraceTest(const UWorld& World, const FVector& Start, const FVector& End, const float Radius) const;
+
+protected:
+	FMassTraceContext TraceContext;
+};
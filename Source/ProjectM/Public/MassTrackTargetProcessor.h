@@ -9,7 +9,12 @@
 struct FMassMoveTargetFragment;
 struct FTransformFragment;
 struct FTargetEntityFragment;
+struct FMassTargetLocationStore;
 class UMassEntitySubsystem;
+class UMassTargetFinderSubsystem;
+
+inline bool UMassTrackTargetProcessor_LeadTargets = true;
+inline FAutoConsoleVariableRef CVarUMassTrackTargetProcessor_LeadTargets(TEXT("pm.UMassTrackTargetProcessor_LeadTargets"), UMassTrackTargetProcessor_LeadTargets, TEXT("Aim where moving targets will be when the projectile reaches them instead of where they are."));
 
 USTRUCT()
 struct FMassTrackTargetTag : public FMassTag
@@ -17,6 +22,10 @@ struct FMassTrackTargetTag : public FMassTag
 	GENERATED_BODY()
 };
 
+/**
+ * Turns entities to face their target. Target locations come from UMassTargetFinderSubsystem's target location store through the slot cached in
+ * FTargetEntityFragment, so the pass doesn't look up the target's fragments and runs in parallel.
+ */
 UCLASS()
 class PROJECTM_API UMassTrackTargetProcessor : public UMassProcessor
 {
@@ -27,9 +36,11 @@ class PROJECTM_API UMassTrackTargetProcessor : public UMassProcessor
 protected:
 
 	virtual void ConfigureQueries() override;
+	virtual void Initialize(UObject& Owner) override;
 	virtual void Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context) override;
 
-	void UpdateLookAtTrackedEntity(const UMassEntitySubsystem& EntitySubsystem, const FTransformFragment& TransformFragment, const FTargetEntityFragment& TargetEntityFragment, FMassMoveTargetFragment& MoveTargetFragment) const;
+	static void UpdateLookAtTrackedEntity(const FMassTargetLocationStore& TargetLocationStore, const FTransformFragment& TransformFragment, FTargetEntityFragment& TargetEntityFragment, FMassMoveTargetFragment& MoveTargetFragment, const float ProjectileXYSpeed);
 
 	FMassEntityQuery EntityQuery;
+	TObjectPtr<UMassTargetFinderSubsystem> TargetFinderSubsystem;
 };
@@ -4,8 +4,11 @@
 
 #include "CoreMinimal.h"
 #include "MassProcessor.h"
+#include "MassEntityTraitBase.h"
 #include "MassTrackedVehicleOrientationProcessor.generated.h"
 
+class UMassTargetFinderSubsystem;
+
 bool IsTransformFacingDirection(const FTransform& Transform, const FVector& TargetDirection, float* OutCurrentHeadingRadians = nullptr, float* OutDesiredHeadingRadians = nullptr, float* OutDeltaAngleRadians = nullptr, float* OutAbsDeltaAngleRadians = nullptr);
 
 USTRUCT()
@@ -19,9 +22,65 @@ struct PROJECTM_API FMassTrackedVehicleOrientationParameters : public FMassShare
 {
 	GENERATED_BODY()
 
-	/** Measured in degrees per second. */
+	/** Maximum hull turning rate. Measured in degrees per second. */
 	UPROPERTY(EditAnywhere, Category = "Orientation")
 	float TurningSpeed;
+
+	/** How quickly the hull turning rate changes. Measured in degrees per second squared, 0 turns at full rate immediately. */
+	UPROPERTY(EditAnywhere, Category = "Orientation")
+	float TurningAcceleration = 90.f;
+
+	/** How quickly the tracks speed up along the hull. Measured in cm per second squared. */
+	UPROPERTY(EditAnywhere, Category = "Movement")
+	float MaxAcceleration = 250.f;
+
+	/** How quickly the tracks slow down. Measured in cm per second squared. */
+	UPROPERTY(EditAnywhere, Category = "Movement")
+	float MaxDeceleration = 500.f;
+
+	/** Measured in degrees per second. Only used by vehicles with a turret. */
+	UPROPERTY(EditAnywhere, Category = "Turret")
+	float TurretTurningSpeed = 30.f;
+};
+
+/** Hull state integrated by UMassTrackedVehicleOrientationProcessor. */
+USTRUCT()
+struct PROJECTM_API FMassTrackedVehicleKinematicsFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	/** Signed hull turning rate in radians per second. */
+	float YawRate = 0.f;
+};
+
+/** Turret that turns towards the target independently of the hull. Projectiles are fired along it instead of along the hull. */
+USTRUCT()
+struct PROJECTM_API FMassTurretFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	/** Yaw relative to the hull in radians, in range [-PI, PI]. */
+	float RelativeYaw = 0.f;
+
+	/** Cosine of the half angle of the cone around the turret's forward that it fires into. */
+	float FiringConeCos = 1.f;
+
+	FQuat GetRotation(const FTransform& HullTransform) const
+	{
+		return HullTransform.GetRotation() * FQuat(FVector::UpVector, RelativeYaw);
+	}
+
+	FVector GetForward(const FTransform& HullTransform) const
+	{
+		return GetRotation(HullTransform).GetForwardVector();
+	}
+
+	// Only compares headings, elevation is handled by the projectile's vertical aim.
+	bool IsInFiringCone(const FTransform& HullTransform, const FVector& Direction) const
+	{
+		const FVector2D Forward2D = FVector2D(GetForward(HullTransform)).GetSafeNormal();
+		return FVector2D::DotProduct(Forward2D, FVector2D(Direction).GetSafeNormal()) >= FiringConeCos;
+	}
 };
 
 UCLASS(meta = (DisplayName = "Tracked Vehicle Orientation"))
@@ -34,9 +93,21 @@ protected:
 
 	UPROPERTY(EditAnywhere, Category = "")
 	FMassTrackedVehicleOrientationParameters Orientation;
+
+	UPROPERTY(EditAnywhere, Category = "Turret")
+	bool bHasTurret = false;
+
+	/** Half angle of the cone around the turret's forward that it fires into. Measured in degrees. */
+	UPROPERTY(EditAnywhere, Category = "Turret", meta = (EditCondition = "bHasTurret"))
+	float FiringConeHalfAngle = 3.f;
 };
 
-/** Processor for turning trached vehicles towards their MoveTarget at a constant turning speed. The one used for soldiers UMassSmoothOrientationProcessor cannot be used because it does not turn entity at constant speed. */
+/**
+ * Kinematic model of tracked vehicles. The hull turns towards its MoveTarget with a limited turning rate and turning acceleration, and the tracks
+ * only move it along its forward with limited acceleration, so steering and avoidance forces can't slide it sideways. Turrets turn towards the
+ * vehicle's target independently of the hull. The one used for soldiers UMassSmoothOrientationProcessor cannot be used because it does not turn
+ * entities at a limited rate.
+ */
 UCLASS()
 class PROJECTM_API UMassTrackedVehicleOrientationProcessor : public UMassProcessor
 {
@@ -47,8 +118,10 @@ public:
 
 protected:
 	virtual void ConfigureQueries() override;
+	virtual void Initialize(UObject& Owner) override;
 	virtual void Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context) override;
 
 private:
 	FMassEntityQuery EntityQuery;
+	TObjectPtr<UMassTargetFinderSubsystem> TargetFinderSubsystem;
 };
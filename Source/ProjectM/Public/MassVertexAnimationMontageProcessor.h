@@ -0,0 +1,177 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassProcessor.h"
+#include "MassEntityTraitBase.h"
+#include "AnimToTextureInstancePlaybackHelpers.h"
+
+#include "MassVertexAnimationMontageProcessor.generated.h"
+
+class UAnimSequence;
+class UAnimToTextureDataAsset;
+struct FGenericAnimationFragment;
+
+// One-shot vertex animation that can be played over an entity's looping animation, e.g. firing.
+USTRUCT()
+struct PROJECTM_API FMassVertexAnimationMontageDefinition
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, Category = "Montage")
+	FName Name;
+
+	/** Must be one of the sequences of the trait's AnimToTexture data asset. */
+	UPROPERTY(EditAnywhere, Category = "Montage")
+	TObjectPtr<UAnimSequence> Sequence = nullptr;
+
+	UPROPERTY(EditAnywhere, Category = "Montage", meta = (ClampMin = 0.01))
+	float PlayRate = 1.f;
+
+	/** Measured in seconds. */
+	UPROPERTY(EditAnywhere, Category = "Montage", meta = (ClampMin = 0.0))
+	float BlendInTime = 0.15f;
+
+	/** Measured in seconds. */
+	UPROPERTY(EditAnywhere, Category = "Montage", meta = (ClampMin = 0.0))
+	float BlendOutTime = 0.2f;
+};
+
+// FMassVertexAnimationMontageDefinition with its sequence resolved to a state of the AnimToTexture data asset.
+USTRUCT()
+struct PROJECTM_API FMassVertexAnimationMontage
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FName Name;
+
+	UPROPERTY()
+	int32 StateIndex = INDEX_NONE;
+
+	// Measured in seconds, play rate included.
+	UPROPERTY()
+	float Length = 0.f;
+
+	UPROPERTY()
+	float PlayRate = 1.f;
+
+	UPROPERTY()
+	float BlendInTime = 0.f;
+
+	UPROPERTY()
+	float BlendOutTime = 0.f;
+};
+
+USTRUCT()
+struct PROJECTM_API FMassVertexAnimationMontageParameters : public FMassSharedFragment
+{
+	GENERATED_BODY()
+
+	int32 FindMontageIndex(const FName Name) const;
+
+	// Montages only apply to entities whose FGenericAnimationFragment uses this data asset.
+	UPROPERTY()
+	TObjectPtr<const UAnimToTextureDataAsset> AnimToTextureData = nullptr;
+
+	UPROPERTY()
+	TArray<FMassVertexAnimationMontage> Montages;
+
+	// Blend between looping states, e.g. from idle to walking, and into montages played by FMassGenericMontageFragment. Measured in seconds.
+	UPROPERTY()
+	float StateBlendTime = 0.f;
+};
+
+struct PROJECTM_API FMassVertexAnimationState
+{
+	int32 StateIndex = INDEX_NONE;
+	float GlobalStartTime = 0.f;
+	float PlayRate = 1.f;
+};
+
+// Data-only montage player of a vertex animated entity, advanced by UMassVertexAnimationMontageProcessor.
+USTRUCT()
+struct PROJECTM_API FMassVertexAnimationMontageFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	// Requests the montage of the entity's UMassVertexAnimationMontageTrait with the given name. Ignored if there is none.
+	void Play(const FName InMontageName, const float GlobalTime)
+	{
+		RequestedMontage = InMontageName;
+		RequestTime = GlobalTime;
+	}
+
+	FName RequestedMontage;
+	float RequestTime = 0.f;
+
+	int32 MontageIndex = INDEX_NONE;
+	float MontageStartTime = 0.f;
+
+	// Current blends from Previous over BlendTime seconds from BlendStartTime.
+	FMassVertexAnimationState Current;
+	FMassVertexAnimationState Previous;
+	float BlendStartTime = 0.f;
+	float BlendTime = 0.f;
+
+	// Weight of Previous in the current frame, 0 once the blend is done.
+	float PreviousWeight = 0.f;
+};
+
+/**
+ * Custom data of a vertex animated instance with a montage player. Starts with the same floats as FAnimToTextureInstancePlaybackData, so
+ * materials that don't blend show the current state, and zeroed custom data means no blend.
+ */
+struct FMassBlendedVertexAnimationInstanceData
+{
+	FAnimToTextureInstancePlaybackData Current;
+	FAnimToTextureAnimState Previous;
+	float PreviousWeight = 0.f;
+};
+
+/**
+ * Lets static mesh instances play one-shot vertex animations and blend between vertex animation states, so soldiers can be seen firing at a
+ * distance without being swapped to skeletal actors. Entities with this trait must not share static mesh descriptions with entities without it,
+ * as their instances have more custom data floats.
+ */
+UCLASS(meta = (DisplayName = "Vertex Animation Montages"))
+class PROJECTM_API UMassVertexAnimationMontageTrait : public UMassEntityTraitBase
+{
+	GENERATED_BODY()
+
+protected:
+	virtual void BuildTemplate(FMassEntityTemplateBuildContext& BuildContext, UWorld& World) const override;
+
+	/** Data asset of the entity's AnimToTexture static mesh. Montage sequences are resolved to its states when the template is built. */
+	UPROPERTY(EditAnywhere, Category = "Animation")
+	TObjectPtr<UAnimToTextureDataAsset> AnimToTextureData = nullptr;
+
+	UPROPERTY(EditAnywhere, Category = "Animation")
+	TArray<FMassVertexAnimationMontageDefinition> Montages;
+
+	/** Measured in seconds. */
+	UPROPERTY(EditAnywhere, Category = "Animation", meta = (ClampMin = 0.0))
+	float StateBlendTime = 0.2f;
+};
+
+/**
+ * Advances the montage players of visible entities in parallel. Picks the state to show from the playing montage or the entity's looping
+ * animation state and tracks the blend from the previous one, which UMassGenericUpdateISMVertexAnimationProcessor writes to instance custom data.
+ */
+UCLASS()
+class PROJECTM_API UMassVertexAnimationMontageProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+
+public:
+	UMassVertexAnimationMontageProcessor();
+
+	static FMassBlendedVertexAnimationInstanceData MakeInstancePlaybackData(const FGenericAnimationFragment& AnimationData, const FMassVertexAnimationMontageFragment& MontageFragment);
+
+protected:
+	virtual void ConfigureQueries() override;
+	virtual void Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context) override;
+
+	FMassEntityQuery EntityQuery;
+};
@@ -3,14 +3,55 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "MassEntityTypes.h"
 #include "Subsystems/WorldSubsystem.h"
 #include "MassVisualEffectsSubsystem.generated.h"
 
+class UMassEntityConfigAsset;
+class UMassEntitySubsystem;
+
+inline int32 UMassVisualEffectsSubsystem_PoolCapacity = 64;
+inline FAutoConsoleVariableRef CVarUMassVisualEffectsSubsystem_PoolCapacity(TEXT("pm.UMassVisualEffectsSubsystem_PoolCapacity"), UMassVisualEffectsSubsystem_PoolCapacity, TEXT("Number of dormant entities preallocated for each visual effect type that expires through UMassDelayedDestructionTrait. Pools grow beyond it on demand."));
+
 /**
- * 
+ * Visual effect entity that returns to its UMassVisualEffectsSubsystem pool when it expires instead of being destroyed. Going dormant and being
+ * reused only flips bIsDormant, so that it doesn't move the entity to another archetype.
+ */
+USTRUCT()
+struct PROJECTM_API FMassPooledVisualEffectFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	// Waiting to be reused. Dormant entities are parked below the world and skipped by the ISM update processors.
+	bool bIsDormant = false;
+};
+
+struct FMassVisualEffectRequest
+{
+	int16 EntityConfigIndex;
+	FTransform Transform;
+
+	// Set when the effect replaces a destroyed entity, e.g. a wreck. The new entity's representation continues from the destroyed one's, whose
+	// data is copied into the request because the entity is gone by the time requests are processed. Transform is the source's last transform.
+	bool bReplacesSourceEntity = false;
+	float SourceLODSignificance = -1.f;
+};
+
+struct FMassVisualEffectPool
+{
+	TArray<FMassEntityHandle> DormantEntities;
+
+	// Only types with a FMassDelayedDestructionFragment expire, others (e.g. wrecks) are spawned as before and never reused.
+	bool bIsPoolable = false;
+};
+
+/**
+ * Spawns visual effect entities (explosions, wrecks, ...). Requests are thread-safe and queued, and the whole frame's requests are activated in
+ * one pass on the game thread, grouped by effect type. Effect types that expire are pooled: expired entities become dormant instead of being
+ * destroyed and are reused by later requests, so effect churn doesn't allocate and free archetype chunks.
  */
 UCLASS()
-class PROJECTM_API UMassVisualEffectsSubsystem : public UWorldSubsystem
+class PROJECTM_API UMassVisualEffectsSubsystem : public UTickableWorldSubsystem
 {
 	GENERATED_BODY()
 
@@ -19,7 +60,36 @@ class PROJECTM_API UMassVisualEffectsSubsystem : public UWorldSubsystem
 
 public:
 	int16 FindOrAddEntityConfig(UMassEntityConfigAsset* ExplosionEntityConfig);
+	UMassEntityConfigAsset* GetEntityConfig(const int16 EntityConfigIndex) const { return MassEntityConfigAssets.IsValidIndex(EntityConfigIndex) ? MassEntityConfigAssets[EntityConfigIndex] : nullptr; }
+
+	// Thread-safe, the effect appears when requests are processed at the end of the frame.
+	void RequestEffect(const int16 EntityConfigIndex, const FVector& Location);
+	void RequestEffect(const int16 EntityConfigIndex, const FTransform& Transform);
+	void RequestEffects(TConstArrayView<FMassVisualEffectRequest> Requests);
+
+	// Called by UMassDelayedDestructionProcessor for expired pooled entities, which it has already made dormant. Reused entities are scheduled again.
+	void ReleaseEntity(const FMassEntityHandle Entity);
+
+	static const FVector DormantLocation;
+
+protected:
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	void ProcessRequests();
+	void InitializePool(const int16 EntityConfigIndex, UMassEntitySubsystem& EntitySubsystem);
+	void SpawnEntities(const int16 EntityConfigIndex, TConstArrayView<FTransform> Transforms, TArray<FMassEntityHandle>& OutEntities);
+	void ActivateEntity(const FMassEntityHandle Entity, const FTransform& Transform, UMassEntitySubsystem& EntitySubsystem) const;
+	static void HandOffRepresentation(const FMassEntityHandle Entity, const FMassVisualEffectRequest& Request, UMassEntitySubsystem& EntitySubsystem);
+
+	FCriticalSection RequestsLock;
+	TArray<FMassVisualEffectRequest> PendingRequests;
+	TArray<FMassVisualEffectRequest> ProcessingRequests;
+	TArray<FTransform> TransformsToSpawn;
+	TArray<int32> RequestIndicesToSpawn;
+	TArray<FMassEntityHandle> SpawnedEntities;
 
-	void SpawnEntity(const int16 EntityConfigIndex, const FVector& Location);
-	void SpawnEntity(const int16 EntityConfigIndex, const FTransform& Transform);
+	// Indexed by entity config index.
+	TArray<FMassVisualEffectPool> Pools;
+	TMap<FMassEntityHandle, int16> PooledEntityToConfigIndex;
 };
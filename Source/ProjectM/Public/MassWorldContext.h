@@ -0,0 +1,15 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/World.h"
+#include "GameFramework/WorldSettings.h"
+
+// Actor that always exists in the world, for APIs such as FMassEntityConfig::GetOrCreateEntityTemplate that need one.
+inline AActor& GetMassWorldContextActor(const UWorld& World)
+{
+	AWorldSettings* WorldSettings = World.GetWorldSettings();
+	check(WorldSettings);
+	return *WorldSettings;
+}
@@ -0,0 +1,66 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityTypes.h"
+#include "Subsystems/WorldSubsystem.h"
+
+#include "MassWorldSnapshotSubsystem.generated.h"
+
+class UMassEntitySubsystem;
+
+/**
+ * Entity references inside a world snapshot. Entities in the snapshot are written as their snapshot index and resolve to the restored entity.
+ * References to other entities (e.g. players) are written as INDEX_NONE and restored as unset handles, as their handles could refer to
+ * unrelated entities once restored.
+ */
+struct PROJECTM_API FMassWorldSnapshotEntityMap
+{
+	// Version is the snapshot version being read or written.
+	explicit FMassWorldSnapshotEntityMap(const int32 InVersion) : Version(InVersion) {}
+
+	void SerializeEntity(FArchive& Ar, FMassEntityHandle& Entity) const;
+
+	const int32 Version;
+
+	// Filled while saving.
+	TMap<FMassEntityHandle, int32> EntityToSnapshotIndex;
+
+	// Filled while loading, indexed by snapshot index.
+	TArray<FMassEntityHandle> SnapshotEntities;
+};
+
+/**
+ * Saves the ProjectM Mass simulation to a compact binary snapshot and restores it, so that benchmarks and bug repros can start at the moment of
+ * interest instead of replaying the spawning and marching that led up to it.
+ *
+ * The snapshot holds the soldiers and vehicles of every AMilitaryUnitMassSpawner team with their gameplay fragments and tags, the flattened
+ * military hierarchy, pending sound perceptions and the corpses and wrecks of UMassBattlefieldClutterSubsystem. Restoring destroys those
+ * entities and bulk spawns the snapshot's entities per spawner entity type, so each type is created in a single batch in its template's
+ * archetype. The target grid isn't stored, UMassTargetGridProcessor adds restored entities to it on their first tick. Players and queued
+ * move to commands aren't part of the snapshot. Neither are projectiles and dying soldiers, restoring destroys them.
+ */
+UCLASS()
+class PROJECTM_API UMassWorldSnapshotSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+
+	// True when pm.UMassWorldSnapshotSubsystem_LoadOnBeginPlay is set, in which case spawners skip their own spawning.
+	static bool ShouldLoadSnapshotOnBeginPlay();
+
+	bool SaveSnapshot(const FString& SnapshotName);
+	bool LoadSnapshot(const FString& SnapshotName);
+
+	void SaveSnapshot(FArchive& Ar);
+	bool LoadSnapshot(FArchive& Ar);
+
+protected:
+	FString GetSnapshotFilePath(const FString& SnapshotName) const;
+
+	FDelegateHandle SimulationStartedHandle;
+};
@@ -7,6 +7,8 @@
 #include "MassEntityTypes.h"
 #include "MilitaryStructureSubsystem.generated.h"
 
+struct FMassWorldSnapshotEntityMap;
+
 struct FMilitaryUnitCounts
 {
 	int32 SoldierCount = 0;
@@ -113,8 +115,12 @@ class PROJECTM_API UMilitaryStructureSubsystem : public UWorldSubsystem
 	GENERATED_BODY()
 
 private:
-	bool bDidCompleteAssigningEntitiesToMilitaryUnitsForTeam1;
-	bool bDidCompleteAssigningEntitiesToMilitaryUnitsForTeam2;
+	// Bit per team index.
+	uint32 DidCompleteAssigningEntitiesToMilitaryUnitsTeamsMask = 0;
+
+	// Soldiers spawned by staged spawners in SpawnBudgetFrame.
+	uint64 SpawnBudgetFrame = 0;
+	int32 NumSoldiersSpawnedThisFrame = 0;
 
 protected:
 	void PromoteNewLeaderIfNeeded(UMilitaryUnit* SoldierMilitaryUnitToDestroy);
@@ -122,26 +128,35 @@ protected:
 	UPROPERTY()
 	TMap<FMassEntityHandle, UMilitaryUnit*> EntityToUnitMap;
 
+	// Indexed by team index.
 	UPROPERTY(EditAnywhere, BlueprintReadOnly)
-	UMilitaryUnit* Team1RootUnit;
-
-	UPROPERTY(EditAnywhere, BlueprintReadOnly)
-	UMilitaryUnit* Team2RootUnit;
+	TArray<UMilitaryUnit*> TeamRootUnits;
 
 public:
 	// USubsystem BEGIN
 	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
 	// USubsystem END
 
-	FMilitaryUnitCounts CreateMilitaryUnit(uint8 MilitaryUnitIndex, bool bIsTeam1);
+	FMilitaryUnitCounts CreateMilitaryUnit(uint8 MilitaryUnitIndex, uint8 TeamIndex);
 
 	void BindUnitToMassEntity(UMilitaryUnit* MilitaryUnit, FMassEntityHandle Entity);
+	// Call before binding many entities at once, e.g. a spawner's whole team.
+	void ReserveUnitBindings(const int32 NumAdditionalEntities);
+	// Staged spawners share a soldier budget per frame, so that spawning more teams doesn't make spawning frames longer.
+	int32 GetRemainingSpawnBudget(const int32 BudgetPerFrame);
+	void ConsumeSpawnBudget(const int32 NumSpawnedSoldiers);
 	void DestroyEntity(FMassEntityHandle Entity);
 
 	UMilitaryUnit* GetUnitForEntity(const FMassEntityHandle Entity);
-	UMilitaryUnit* GetRootUnitForTeam(const bool bIsTeam1);
+	UMilitaryUnit* GetRootUnitForTeam(const uint8 TeamIndex);
+
+	// Appends the squad units of every team.
+	void GetSquads(TArray<UMilitaryUnit*>& OutSquads) const;
+
+	void DidCompleteAssigningEntitiesToMilitaryUnits(const uint8 TeamIndex);
 
-	void DidCompleteAssigningEntitiesToMilitaryUnits(const bool bIsTeam1);
+	// Writes or replaces every team's military units, flattened per team. Called by UMassWorldSnapshotSubsystem.
+	void SerializeSnapshot(FArchive& Ar, const FMassWorldSnapshotEntityMap& EntityMap);
 
 	FCompletedAssigningEntitiesToMilitaryUnitsEvent OnCompletedAssigningEntitiesToMilitaryUnitsEvent;
 };
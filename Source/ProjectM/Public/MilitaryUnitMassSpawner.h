@@ -17,34 +17,65 @@ class PROJECTM_API AMilitaryUnitMassSpawner : public AMassSpawner
 	
 protected:
 	virtual void BeginPlay() override;
+	virtual void Serialize(FArchive& Ar) override;
+	virtual void PostLoad() override;
+	virtual void Tick(float DeltaSeconds) override;
 
 	UFUNCTION()
 	void BeginAssignEntitiesToMilitaryUnits();
 
 	void AssignEntitiesToMilitaryUnits(TArray<UMilitaryUnit*>& Squads, TArray<UMilitaryUnit*>& HigherCommandSoldiers);
-	void AssignEntitiesToSquad(int32& SoldierIndex, UMilitaryUnit* MilitaryUnit, UMilitaryUnit* SquadMilitaryUnit, int32& SquadMemberIndex);
+	void AssignEntitiesToSquad(int32& SoldierIndex, UMilitaryUnit* MilitaryUnit, UMilitaryUnit* SquadMilitaryUnit, int32& SquadMemberIndex, const TArray<FMassEntityHandle>& SpawnedEntities);
 	void SafeBindSoldier(UMilitaryUnit* SoldierMilitaryUnit, const TArray<FMassEntityHandle>& SpawnedEntities, int32& EntityIndex);
 	void DoMilitaryUnitSpawning();
 	void OnMilitaryUnitSpawnDataGenerationFinished(TConstArrayView<FMassEntitySpawnDataGeneratorResult> Results, FMassSpawnDataGenerator* FinishedGenerator);
 
+	// Staged spawning spreads the soldiers over several frames, see pm.AMilitaryUnitMassSpawner_SpawnBudgetPerFrame. Squads are spawned and
+	// bound to their military units whole, front line first, then near the player, then reserves, with higher command last.
+	void BeginStagedSpawning(TArray<FMassEntitySpawnDataGeneratorResult>& Results);
+	void SpawnNextStage();
+	void FinishStagedSpawning();
+	TArray<int32> GetStagedSquadSpawnOrder(const int32 NumSquads) const;
+
 	UMilitaryStructureSubsystem* MilitaryStructureSubsystem;
 	
 	// Indices into AMassSpawner's AllSpawnedEntities.
 	int32 AllSpawnedEntitiesSoldierIndex;
 	int32 AllSpawnedEntitiesVehicleIndex;
 
+	bool bIsStagedSpawning = false;
+	FMassEntityTemplateID StagedSoldierTemplateID;
+	TArray<FTransform> StagedSoldierTransforms; // Squad members in squad order, then higher command.
+	TArray<int32> StagedSquadOrder;
+	int32 NextStagedSquadOrderIndex = 0;
+	TArray<UMilitaryUnit*> StagedSquads;
+	TArray<UMilitaryUnit*> StagedHigherCommandSoldiers;
+
 	bool bDidSpawnVehiclesOnly = false;
 	bool bDidSpawnSoldiersOnly = false;
 	FMilitaryUnitCounts UnitCounts;
 
+private:
+	UPROPERTY(meta = (DeprecatedProperty))
+	bool bIsTeam1_DEPRECATED = false;
+
 public:
 	AMilitaryUnitMassSpawner();
 
+	// Used by UMassWorldSnapshotSubsystem. Forgets the spawned entities without destroying them.
+	void ResetSpawnedEntities();
+
+	// Used by UMassWorldSnapshotSubsystem. Calls Function with every entity this spawner spawned and the index of its EntityTypes entry.
+	void ForEachSpawnedEntity(TFunctionRef<void(const FMassEntityHandle Entity, const int32 EntityTypeIndex)> Function);
+
+	// Used by UMassWorldSnapshotSubsystem. Spawns one entity of EntityTypes[EntityTypeIndex] per transform in a single batch.
+	void SpawnEntitiesFromSnapshot(const int32 EntityTypeIndex, const TArray<FTransform>& Transforms, TArray<FMassEntityHandle>& OutEntities);
+
 	UPROPERTY(EditAnywhere)
 	uint8 MilitaryUnitIndex = 0; // Index into MilitaryUnits in MilitaryStructureSubsystem.cpp; TODO: make this an enum
 
-	UPROPERTY(EditAnywhere)
-	bool bIsTeam1;
+	UPROPERTY(EditAnywhere, meta = (ClampMax = 31))
+	uint8 TeamIndex = 0;
 
 	UPROPERTY(EditAnywhere)
 	bool bSpawnVehiclesOnly;
@@ -0,0 +1,29 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/Guid.h"
+
+// Custom serialization version for assets and levels saved with ProjectM types.
+struct PROJECTM_API FProjectMCustomVersion
+{
+	enum Type
+	{
+		// Before any version changes were made
+		BeforeCustomVersionWasAdded = 0,
+
+		// Replaced AMilitaryUnitMassSpawner::bIsTeam1 and UMassTeamMemberTrait::IsOnTeam1 with TeamIndex.
+		TeamIndexReplacesTeam1Flag,
+
+		// -----<new versions can be added above this line>-------------------------------------------------
+		VersionPlusOne,
+		LatestVersion = VersionPlusOne - 1
+	};
+
+	// The GUID for this custom version number
+	const static FGuid GUID;
+
+private:
+	FProjectMCustomVersion() {}
+};
@@ -11,7 +11,7 @@
 class USceneCaptureComponent2D;
 class UImage;
 
-typedef TFunction< void(const FVector& /*EntityLocation*/, const bool& /*bIsOnTeam1*/, const bool& /*bIsPlayer*/, const FMassEntityHandle& /*Entity*/) > FMapDisplayableEntityFunction;
+typedef TFunction< void(const FVector& /*EntityLocation*/, const uint8& /*TeamIndex*/, const bool& /*bIsPlayer*/, const FMassEntityHandle& /*Entity*/) > FMapDisplayableEntityFunction;
 
 // Adapted from UCitySampleMapWidget.
 UCLASS()
@@ -43,11 +43,9 @@ public:
 
 	virtual void NativeOnInitialized() override;
 
+	// Indexed by team index.
 	UPROPERTY(Transient, VisibleAnywhere)
-	int32 CachedTeam1AliveSoldierCount;
-	
-	UPROPERTY(Transient, VisibleAnywhere)
-	int32 CachedTeam2AliveSoldierCount;
+	TArray<int32> CachedTeamAliveSoldierCounts;
 
 protected:
 	virtual void NativeTick(const FGeometry& MyGeometry, float InDeltaTime) override;
@@ -75,7 +73,7 @@ private:
 	void CreateMapButtons();
 	void UpdateMapButtons();
 	class UButton* CreateButton(const bool& bIsSolder);
-	void UpdateButton(class UButton* Button, const FVector2D& Position, UMilitaryUnit* Unit, const bool& bIsOnTeam1, const bool& bIsPlayer);
+	void UpdateButton(class UButton* Button, const FVector2D& Position, UMilitaryUnit* Unit, const uint8& TeamIndex, const bool& bIsPlayer);
 	void ForEachMapDisplayableEntity(const FMapDisplayableEntityFunction& EntityExecuteFunction);
 	void UpdateSoldierCountLabels();
 
@@ -0,0 +1,43 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+
+CSV_DECLARE_CATEGORY_MODULE_EXTERN(PROJECTM_API, ProjectM);
+
+/**
+ * Per frame workload counts of ProjectM processors, to explain where the time seen in CPU profiler scopes went. Recorded at the end of every
+ * frame as CSV profiler stats in the ProjectM category and as Trace counters under ProjectM/. In -nullrhi runs, use -csvCaptureFrames or
+ * pm.ProjectMStats_LogInterval to read them.
+ */
+enum class EProjectMStat : uint8
+{
+	// Counts, reset every frame.
+	SphereTraces,
+	LineTraces,
+	TargetGridQueries,
+	TargetGridQueryCandidates,
+	CollisionsTested,
+	PathsRequested,
+	DeathsResolved,
+
+	// Gauges, keep their last set value.
+	ProjectilesAlive,
+	SoundsAlive,
+
+	Count
+};
+
+namespace UE::ProjectM::Stats
+{
+	// Thread-safe. Prefer adding once per chunk or stage over once per item in hot loops.
+	PROJECTM_API void Add(const EProjectMStat Stat, const int64 Value = 1);
+
+	// Thread-safe. For gauges.
+	PROJECTM_API void Set(const EProjectMStat Stat, const int64 Value);
+
+	// Game thread. Records this frame's values and resets the counts, called by the module at the end of every frame.
+	void EndFrame();
+} // namespace UE::ProjectM::Stats
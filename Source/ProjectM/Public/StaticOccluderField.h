@@ -0,0 +1,73 @@
+// Copyright (c) 2022 Leroy Technologies. Licensed under MIT License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+enum class EStaticOcclusionResult : uint8
+{
+	// No static geometry can be in the way. Movable geometry still can, so callers must still trace against physics.
+	Clear,
+	// The trace definitely passes underground.
+	Blocked,
+	// The trace passes through occupied voxels, so a physics trace is needed to know.
+	Unknown,
+};
+
+/**
+ * Conservative acceleration structure for traces against a level's static geometry: a 2.5D ground heightfield plus a column of coarse
+ * voxel occupancy bits per XY cell. Answers most traces in open terrain without touching the physics scene. Immutable after being built,
+ * so it is safe to query from any thread. Has no engine dependencies so it can be built and tested in isolation.
+ */
+class PROJECTM_API FStaticOccluderField
+{
+public:
+	static constexpr int32 NumVoxelsPerColumn = 64;
+	static constexpr int32 SerializationVersion = 1;
+
+	// Origin is the minimum corner of the field.
+	void Initialize(const FVector& InOrigin, const float InCellSize, const int32 InNumX, const int32 InNumY, const float InVoxelHeight);
+	void Reset();
+	bool IsInitialized() const { return NumX > 0 && NumY > 0; }
+
+	// GroundHeight is the lowest point of solid ground (e.g. landscape) in the column, everything below it is solid. Use -MAX_flt if unknown.
+	void SetColumn(const int32 X, const int32 Y, const float GroundHeight, const uint64 OccupiedVoxels);
+	float GetGroundHeight(const int32 X, const int32 Y) const { return GroundHeights[GetColumnIndex(X, Y)]; }
+	uint64 GetOccupiedVoxels(const int32 X, const int32 Y) const { return OccupiedVoxels[GetColumnIndex(X, Y)]; }
+
+	// Conservative answer for whether a sphere of Radius swept from Start to End hits static geometry.
+	EStaticOcclusionResult Raycast(const FVector& Start, const FVector& End, const float Radius = 0.f) const;
+
+	FBox GetBounds() const;
+	FBox GetColumnBounds(const int32 X, const int32 Y) const;
+	FBox GetVoxelRangeBounds(const int32 X, const int32 Y, const int32 FirstVoxel, const int32 LastVoxel) const;
+
+	int32 GetNumX() const { return NumX; }
+	int32 GetNumY() const { return NumY; }
+	float GetCellSize() const { return CellSize; }
+	float GetVoxelHeight() const { return VoxelHeight; }
+
+	// Bits FirstVoxel through LastVoxel (inclusive) set.
+	static uint64 MakeVoxelMask(const int32 FirstVoxel, const int32 LastVoxel);
+
+	friend PROJECTM_API FArchive& operator<<(FArchive& Ar, FStaticOccluderField& Field);
+
+private:
+	int32 GetColumnIndex(const int32 X, const int32 Y) const
+	{
+		check(X >= 0 && X < NumX && Y >= 0 && Y < NumY);
+		return Y * NumX + X;
+	}
+
+	// Returns false if the range is outside the field vertically.
+	bool GetVoxelRange(const float MinZ, const float MaxZ, int32& OutFirstVoxel, int32& OutLastVoxel) const;
+
+	FVector Origin = FVector::ZeroVector;
+	float CellSize = 0.f;
+	float VoxelHeight = 0.f;
+	int32 NumX = 0;
+	int32 NumY = 0;
+
+	TArray<float> GroundHeights;
+	TArray<uint64> OccupiedVoxels;
+};